@@ -11,9 +11,29 @@
 #define ABCG_HPP_
 
 #include "abcg_application.hpp"
+#include "abcg_assetmanager.hpp"
+#include "abcg_asyncload.hpp"
+#include "abcg_bounds.hpp"
+#include "abcg_compressedimage.hpp"
 #include "abcg_elapsedtimer.hpp"
 #include "abcg_image.hpp"
+#include "abcg_imageops.hpp"
+#include "abcg_mappedfile.hpp"
+#include "abcg_meshcache.hpp"
+#include "abcg_meshloader.hpp"
+#include "abcg_meshnormals.hpp"
+#include "abcg_meshoptimizer.hpp"
+#include "abcg_objreader.hpp"
+#include "abcg_pixelunpackring.hpp"
+#include "abcg_progressivemesh.hpp"
 #include "abcg_string.hpp"
+#include "abcg_textureatlas.hpp"
+#include "abcg_texturecache.hpp"
+#include "abcg_texturestreamer.hpp"
+#include "abcg_threadpool.hpp"
 #include "abcg_trackball.hpp"
+#include "abcg_uploadqueue.hpp"
+#include "abcg_vertexwelder.hpp"
+#include "abcg_virtualtexture.hpp"
 
 #endif
\ No newline at end of file
@@ -0,0 +1,349 @@
+/**
+ * @file abcg_assetmanager.cpp
+ * @brief Definition of abcg::AssetManager and abcg::Texture class members.
+ *
+ * This project is released under the MIT License.
+ */
+
+#include "abcg_assetmanager.hpp"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <filesystem>
+
+#include "abcg_compressedimage.hpp"
+#include "abcg_texturecache.hpp"
+#include "abcg_texturestreamer.hpp"
+
+abcg::Texture::~Texture() { glDeleteTextures(1, &m_name); }
+
+namespace {
+// Creates a texture from the levels stored in a texture cache
+std::shared_ptr<abcg::Texture> createTexture(const abcg::TextureCache& cache,
+                                             bool generateMipmaps) {
+  const auto& base{cache.getLevels().front()};
+  return std::make_shared<abcg::Texture>(
+      abcg::opengl::createTexture(cache, generateMipmaps),
+      abcg::Texture::computeByteSize({.width = base.width,
+                                      .height = base.height,
+                                      .channels = cache.getChannels(),
+                                      .pixels = {}},
+                                     generateMipmaps));
+}
+
+// Creates a texture from a KTX2 or DDS file
+std::shared_ptr<abcg::Texture> createTexture(const abcg::CompressedImage& image,
+                                             bool generateMipmaps) {
+  return std::make_shared<abcg::Texture>(
+      abcg::opengl::createTexture(image, generateMipmaps),
+      abcg::Texture::computeByteSize(image, generateMipmaps));
+}
+}  // namespace
+
+/**
+ * @brief Returns the memory used by a texture created from an image.
+ *
+ * @param image Image uploaded to the texture.
+ * @param generateMipmaps Whether the texture has a full mipmap chain.
+ * @return Size of the texture, in bytes, assuming no padding.
+ */
+std::size_t abcg::Texture::computeByteSize(const Image& image,
+                                           bool generateMipmaps) noexcept {
+  auto width{static_cast<std::size_t>(std::max(image.width, 0))};
+  auto height{static_cast<std::size_t>(std::max(image.height, 0))};
+  const auto channels{static_cast<std::size_t>(std::max(image.channels, 0))};
+  auto byteSize{width * height * channels};
+  while (generateMipmaps && (width > 1 || height > 1)) {
+    width = std::max<std::size_t>(width / 2, 1);
+    height = std::max<std::size_t>(height / 2, 1);
+    byteSize += width * height * channels;
+  }
+  return byteSize;
+}
+
+/**
+ * @brief Returns the memory used by a texture created from a compressed
+ * image.
+ *
+ * Follows the choices of abcg::opengl::createTexture: levels uploaded in a
+ * compressed format use the size of their blocks, and decoded levels use 4
+ * bytes per texel.
+ *
+ * @param image Compressed image uploaded to the texture.
+ * @param generateMipmaps Whether the texture uses mipmap levels.
+ * @return Size of the texture, in bytes, assuming no padding.
+ */
+std::size_t abcg::Texture::computeByteSize(const CompressedImage& image,
+                                           bool generateMipmaps) {
+  const auto& levels{image.getLevels()};
+  if (levels.empty()) return 0;
+  if (generateMipmaps && levels.size() == 1) {
+    // Decoded and completed by glGenerateMipmap
+    return computeByteSize({.width = levels.front().width,
+                            .height = levels.front().height,
+                            .channels = 4,
+                            .pixels = {}},
+                           true);
+  }
+
+  const auto compressed{opengl::isCompressedFormatSupported(image.getFormat())};
+  const auto levelCount{generateMipmaps ? levels.size() : 1};
+  std::size_t byteSize{};
+  for (const auto& level : gsl::span{levels}.first(levelCount)) {
+    byteSize += compressed ? level.data.size()
+                           : static_cast<std::size_t>(level.width) *
+                                 static_cast<std::size_t>(level.height) * 4;
+  }
+  return byteSize;
+}
+
+/**
+ * @brief Returns the cached texture loaded from an image file, loading it on
+ * a miss.
+ *
+ * Images compiled by abcg-assetc with the box filter are created from their
+ * texture cache, with the stored mipmap levels. KTX2 and DDS files keep
+ * their compressed format when the OpenGL context supports it (see
+ * abcg::opengl::createTexture).
+ *
+ * @param path Path to the image file.
+ * @param generateMipmaps Whether to generate the mipmap levels.
+ * @return Shared handle to the texture.
+ *
+ * @throw abcg::Exception if the file cannot be opened or decoded.
+ */
+std::shared_ptr<abcg::Texture> abcg::AssetManager::loadTexture(
+    std::string_view path, bool generateMipmaps) {
+  return load<Texture>(path, generateMipmaps ? 1U : 0U, [&] {
+    if (CompressedImage::isCompressedImage(path)) {
+      return createTexture(CompressedImage{path}, generateMipmaps);
+    }
+
+    if (TextureCache cache;
+        cache.load(TextureCache::getCachePath(path),
+                   TextureCache::computeKey(
+                       path, static_cast<std::uint64_t>(MipmapFilter::Box)))) {
+      return createTexture(cache, generateMipmaps);
+    }
+
+    const auto image{decodeImage(path)};
+    return std::make_shared<Texture>(
+        opengl::createTexture(image, generateMipmaps),
+        Texture::computeByteSize(image, generateMipmaps));
+  });
+}
+
+/**
+ * @brief Returns the cached texture loaded from an image file, with a mipmap
+ * chain generated on the CPU, loading it on a miss.
+ *
+ * See abcg::opengl::loadTexture. Textures loaded with different filters, or
+ * with glGenerateMipmap, are cached separately.
+ *
+ * @param path Path to the image file.
+ * @param filter Filter used to compute each level from the previous one.
+ * @param persist Whether to store the generated chain in the texture cache.
+ * @return Shared handle to the texture.
+ *
+ * @throw abcg::Exception if the file cannot be opened or decoded.
+ */
+std::shared_ptr<abcg::Texture> abcg::AssetManager::loadTexture(
+    std::string_view path, MipmapFilter filter, bool persist) {
+  return load<Texture>(path, 2U + static_cast<std::uint64_t>(filter), [&] {
+    if (CompressedImage::isCompressedImage(path)) {
+      if (CompressedImage image{path}; image.getLevels().size() > 1) {
+        return createTexture(image, true);
+      }
+    }
+
+    if (TextureCache cache;
+        cache.load(TextureCache::getCachePath(path),
+                   TextureCache::computeKey(
+                       path, static_cast<std::uint64_t>(filter))) &&
+        cache.getLevels().size() > 1) {
+      return createTexture(cache, true);
+    }
+
+    const auto levels{loadMipmaps(path, filter, persist)};
+    return std::make_shared<Texture>(
+        opengl::createTexture(levels),
+        Texture::computeByteSize(levels.front(), true));
+  });
+}
+
+/**
+ * @brief Returns the cached texture streamed from an image file, starting to
+ * stream it on a miss.
+ *
+ * See abcg::TextureStreamer::loadTexture. The texture can be drawn at once,
+ * and gets sharper as abcg::TextureStreamer::process uploads its larger
+ * mipmap levels. Streamed textures are cached separately from the ones
+ * loaded by the other overloads.
+ *
+ * @param path Path to the image file.
+ * @param streamer Streamer that uploads the larger mipmap levels.
+ * @param filter Filter used to generate the mipmap chain, if not stored.
+ * @param persist Whether to store the generated chain in the texture cache.
+ * @return Shared handle to the texture.
+ *
+ * @throw abcg::Exception if the file cannot be opened.
+ */
+std::shared_ptr<abcg::Texture> abcg::AssetManager::loadTexture(
+    std::string_view path, TextureStreamer& streamer, MipmapFilter filter,
+    bool persist) {
+  return load<Texture>(path, 5U + static_cast<std::uint64_t>(filter), [&] {
+    return streamer.loadTexture(path, filter, persist);
+  });
+}
+
+/**
+ * @brief Returns the cached texture loaded from an image file, if any.
+ *
+ * Finds the textures loaded with loadTexture(std::string_view, bool) or
+ * added with insertTexture().
+ *
+ * @param path Path to the image file.
+ * @param generateMipmaps Whether the texture has a mipmap chain.
+ * @return Shared handle to the texture, or a null pointer on a miss.
+ */
+std::shared_ptr<abcg::Texture> abcg::AssetManager::findTexture(
+    std::string_view path, bool generateMipmaps) {
+  return find<Texture>(path, generateMipmaps ? 1U : 0U);
+}
+
+/**
+ * @brief Adds a texture created from an image file to the cache.
+ *
+ * Used to share textures uploaded by other means, e.g. with
+ * abcg::UploadQueue, with later calls to loadTexture(std::string_view, bool)
+ * and findTexture().
+ *
+ * @param path Path to the image file.
+ * @param texture Shared handle to the texture.
+ * @param generateMipmaps Whether the texture has a mipmap chain.
+ */
+void abcg::AssetManager::insertTexture(std::string_view path,
+                                       std::shared_ptr<Texture> texture,
+                                       bool generateMipmaps) {
+  insert(path, generateMipmaps ? 1U : 0U, std::move(texture));
+}
+
+/**
+ * @brief Evicts the assets that are only referenced by the cache.
+ *
+ * Assets holding handles to other cached assets (e.g. a model and its
+ * texture) are released first, so their dependencies are evicted in the same
+ * call.
+ *
+ * @return Number of evicted entries.
+ */
+std::size_t abcg::AssetManager::collectGarbage() {
+  std::size_t numEvicted{};
+  for (auto evicted{true}; evicted;) {
+    evicted = false;
+    for (auto iter{m_entries.begin()}; iter != m_entries.end();) {
+      if (iter->second.asset.use_count() == 1) {
+        m_statistics.bytes -= iter->second.byteSize;
+        m_recentKeys.erase(iter->second.recent);
+        iter = m_entries.erase(iter);
+        ++numEvicted;
+        evicted = true;
+      } else {
+        ++iter;
+      }
+    }
+  }
+  m_statistics.evictions += numEvicted;
+  m_statistics.entries = m_entries.size();
+  return numEvicted;
+}
+
+/**
+ * @brief Drops every cached asset.
+ *
+ * Assets still in use are kept alive by their handles but are no longer
+ * shared with later loads. Statistics other than the entry and byte counts
+ * are kept.
+ */
+void abcg::AssetManager::clear() noexcept {
+  m_entries.clear();
+  m_recentKeys.clear();
+  m_statistics.entries = 0;
+  m_statistics.bytes = 0;
+}
+
+/**
+ * @brief Sets the memory the cached assets may use.
+ *
+ * Loading an asset that exceeds the budget evicts the least recently used
+ * assets that are only referenced by the cache, until the budget is met or
+ * no such asset is left. The assets in use are kept, so the budget is
+ * exceeded while they use more memory than it allows.
+ *
+ * @param byteBudget Budget in bytes. Unlimited by default.
+ */
+void abcg::AssetManager::setBudget(std::size_t byteBudget) {
+  m_budget = byteBudget;
+  evictOverBudget();
+}
+
+std::string abcg::AssetManager::makeKey(std::string_view typeName,
+                                        std::string_view path,
+                                        std::uint64_t options) {
+  // weakly_canonical also accepts paths to missing files
+  std::error_code error;
+  auto canonical{std::filesystem::weakly_canonical(path, error).string()};
+  if (error) canonical = path;
+  return fmt::format("{}|{}|{}", typeName, canonical, options);
+}
+
+std::shared_ptr<void> abcg::AssetManager::findEntry(const std::string& key) {
+  if (auto iter{m_entries.find(key)}; iter != m_entries.end()) {
+    ++m_statistics.hits;
+    auto& entry{iter->second};
+    m_recentKeys.splice(m_recentKeys.begin(), m_recentKeys, entry.recent);
+    return entry.asset;
+  }
+  ++m_statistics.misses;
+  return {};
+}
+
+void abcg::AssetManager::insertEntry(std::string key,
+                                     std::shared_ptr<void> asset,
+                                     std::size_t byteSize) {
+  auto [iter, inserted]{m_entries.try_emplace(std::move(key))};
+  auto& entry{iter->second};
+  if (inserted) {
+    entry.recent = m_recentKeys.insert(m_recentKeys.begin(), iter->first);
+  } else {
+    m_statistics.bytes -= entry.byteSize;
+    m_recentKeys.splice(m_recentKeys.begin(), m_recentKeys, entry.recent);
+  }
+  entry.asset = std::move(asset);
+  entry.byteSize = byteSize;
+  m_statistics.bytes += byteSize;
+  m_statistics.entries = m_entries.size();
+  evictOverBudget();
+}
+
+void abcg::AssetManager::evictOverBudget() {
+  // Evicting an asset may release the last user of an asset that was
+  // visited before it, which is then evicted by the next pass
+  for (auto evicted{true}; evicted && m_statistics.bytes > m_budget;) {
+    evicted = false;
+    for (auto recent{m_recentKeys.end()};
+         recent != m_recentKeys.begin() && m_statistics.bytes > m_budget;) {
+      --recent;
+      if (auto iter{m_entries.find(*recent)};
+          iter->second.asset.use_count() == 1) {
+        m_statistics.bytes -= iter->second.byteSize;
+        m_entries.erase(iter);
+        recent = m_recentKeys.erase(recent);
+        ++m_statistics.evictions;
+        evicted = true;
+      }
+    }
+  }
+  m_statistics.entries = m_entries.size();
+}
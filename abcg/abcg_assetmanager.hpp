@@ -0,0 +1,221 @@
+/**
+ * @file abcg_assetmanager.hpp
+ * @brief abcg::AssetManager header file.
+ *
+ * Declaration of abcg::AssetManager class, used to share meshes and textures
+ * loaded from the same file, and of abcg::Texture class.
+ *
+ * This project is released under the MIT License.
+ */
+
+#ifndef ABCG_ASSETMANAGER_HPP_
+#define ABCG_ASSETMANAGER_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <list>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <typeinfo>
+#include <unordered_map>
+#include <utility>
+
+#include "abcg_external.hpp"
+#include "abcg_image.hpp"
+
+namespace abcg {
+class AssetManager;
+class Texture;
+class TextureStreamer;
+}  // namespace abcg
+
+/**
+ * @brief abcg::Texture class.
+ *
+ * Owner of a 2D texture name. The texture is deleted with the object, so a
+ * texture shared through std::shared_ptr lives as long as its last user.
+ */
+class abcg::Texture {
+ public:
+  Texture(GLuint name, std::size_t byteSize) noexcept
+      : m_name{name}, m_byteSize{byteSize} {}
+  ~Texture();
+
+  Texture(const Texture&) = delete;
+  Texture(Texture&&) = delete;
+  Texture& operator=(const Texture&) = delete;
+  Texture& operator=(Texture&&) = delete;
+
+  [[nodiscard]] GLuint getName() const noexcept { return m_name; }
+  [[nodiscard]] std::size_t getByteSize() const noexcept { return m_byteSize; }
+
+  [[nodiscard]] static std::size_t computeByteSize(
+      const Image& image, bool generateMipmaps) noexcept;
+  [[nodiscard]] static std::size_t computeByteSize(
+      const CompressedImage& image, bool generateMipmaps);
+
+ private:
+  GLuint m_name{};
+  std::size_t m_byteSize{};
+};
+
+/**
+ * @brief abcg::AssetManager class.
+ *
+ * Cache of loaded assets keyed on their type, the canonical path of their
+ * source file and user-defined loading options. Loading the same asset again
+ * returns a handle to the cached object, so N instances of a model cost one
+ * parse and one upload.
+ *
+ * The cache keeps a reference to each asset, so that an asset released by
+ * every user can be handed out again until it is evicted. Assets are evicted
+ * by collectGarbage(), or in least recently used order when the memory they
+ * use exceeds the budget set with setBudget(). Assets still in use are never
+ * evicted, as that would not free their memory. All member functions must be
+ * called on the thread that owns the OpenGL context.
+ */
+class abcg::AssetManager {
+ public:
+  /**
+   * @brief Cache statistics.
+   *
+   */
+  struct Statistics {
+    /** @brief Number of loads served from the cache. */
+    std::size_t hits{};
+    /** @brief Number of loads that called the loader. */
+    std::size_t misses{};
+    /** @brief Number of entries removed by collectGarbage() or the budget. */
+    std::size_t evictions{};
+    /** @brief Number of cached assets. */
+    std::size_t entries{};
+    /** @brief GPU memory used by the cached assets, in bytes. */
+    std::size_t bytes{};
+  };
+
+  [[nodiscard]] std::shared_ptr<Texture> loadTexture(
+      std::string_view path, bool generateMipmaps = true);
+  [[nodiscard]] std::shared_ptr<Texture> loadTexture(std::string_view path,
+                                                     MipmapFilter filter,
+                                                     bool persist = false);
+  [[nodiscard]] std::shared_ptr<Texture> loadTexture(
+      std::string_view path, TextureStreamer& streamer,
+      MipmapFilter filter = MipmapFilter::Box, bool persist = false);
+  [[nodiscard]] std::shared_ptr<Texture> findTexture(
+      std::string_view path, bool generateMipmaps = true);
+  void insertTexture(std::string_view path, std::shared_ptr<Texture> texture,
+                     bool generateMipmaps = true);
+  template <typename T, typename TLoader>
+  [[nodiscard]] std::shared_ptr<T> load(std::string_view path,
+                                        std::uint64_t options,
+                                        TLoader&& loader);
+  template <typename T>
+  [[nodiscard]] std::shared_ptr<T> find(std::string_view path,
+                                        std::uint64_t options);
+  template <typename T>
+  void insert(std::string_view path, std::uint64_t options,
+              std::shared_ptr<T> asset);
+
+  std::size_t collectGarbage();
+  void clear() noexcept;
+
+  void setBudget(std::size_t byteBudget);
+  /**
+   * @brief Returns the memory the cached assets may use before the least
+   * recently used ones are evicted, in bytes.
+   */
+  [[nodiscard]] std::size_t getBudget() const noexcept { return m_budget; }
+  [[nodiscard]] const Statistics& getStatistics() const noexcept {
+    return m_statistics;
+  }
+
+ private:
+  struct Entry {
+    std::shared_ptr<void> asset;
+    std::size_t byteSize{};
+    std::list<std::string>::iterator recent;  // Position in m_recentKeys
+  };
+
+  [[nodiscard]] static std::string makeKey(std::string_view typeName,
+                                           std::string_view path,
+                                           std::uint64_t options);
+  [[nodiscard]] std::shared_ptr<void> findEntry(const std::string& key);
+  void insertEntry(std::string key, std::shared_ptr<void> asset,
+                   std::size_t byteSize);
+  void evictOverBudget();
+
+  std::unordered_map<std::string, Entry> m_entries;
+  // Keys of the cached assets, from the most to the least recently used
+  std::list<std::string> m_recentKeys;
+  std::size_t m_budget{std::numeric_limits<std::size_t>::max()};
+  Statistics m_statistics;
+};
+
+/**
+ * @brief Returns the cached asset loaded from a file, loading it on a miss.
+ *
+ * @tparam T Type of the asset. Must provide a getByteSize() member function
+ * returning the GPU memory used by the asset.
+ * @param path Path to the source file. Paths to the same file share the
+ * cache entry.
+ * @param options User-defined options that change the loaded asset.
+ * @param loader Callable object returning a std::shared_ptr<T> to the loaded
+ * asset. Called only on a miss.
+ * @return Shared handle to the asset.
+ */
+template <typename T, typename TLoader>
+std::shared_ptr<T> abcg::AssetManager::load(std::string_view path,
+                                            std::uint64_t options,
+                                            TLoader&& loader) {
+  auto key{makeKey(typeid(T).name(), path, options)};
+  if (auto asset{findEntry(key)}) {
+    return std::static_pointer_cast<T>(std::move(asset));
+  }
+
+  std::shared_ptr<T> asset{std::forward<TLoader>(loader)()};
+  if (asset) insertEntry(std::move(key), asset, asset->getByteSize());
+  return asset;
+}
+
+/**
+ * @brief Returns the cached asset loaded from a file, if any.
+ *
+ * Counts as a hit or a miss, as with load(). Used with insert() to load the
+ * missing assets elsewhere, e.g. on a background thread.
+ *
+ * @tparam T Type of the asset.
+ * @param path Path to the source file.
+ * @param options User-defined options that change the loaded asset.
+ * @return Shared handle to the asset, or a null pointer on a miss.
+ */
+template <typename T>
+std::shared_ptr<T> abcg::AssetManager::find(std::string_view path,
+                                            std::uint64_t options) {
+  return std::static_pointer_cast<T>(
+      findEntry(makeKey(typeid(T).name(), path, options)));
+}
+
+/**
+ * @brief Adds an asset loaded from a file to the cache.
+ *
+ * Replaces the cached asset with the same key, if any, and evicts the least
+ * recently used assets if the budget is exceeded.
+ *
+ * @tparam T Type of the asset. Must provide a getByteSize() member function
+ * returning the GPU memory used by the asset.
+ * @param path Path to the source file.
+ * @param options User-defined options that change the loaded asset.
+ * @param asset Shared handle to the asset. Null pointers are ignored.
+ */
+template <typename T>
+void abcg::AssetManager::insert(std::string_view path, std::uint64_t options,
+                                std::shared_ptr<T> asset) {
+  if (!asset) return;
+  const auto byteSize{asset->getByteSize()};
+  insertEntry(makeKey(typeid(T).name(), path, options), std::move(asset),
+              byteSize);
+}
+
+#endif
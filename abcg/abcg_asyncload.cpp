@@ -0,0 +1,60 @@
+/**
+ * @file abcg_asyncload.cpp
+ * @brief Definition of abcg::LoadProgress class members.
+ *
+ * This project is released under the MIT License.
+ */
+
+#include "abcg_asyncload.hpp"
+
+#include <algorithm>
+
+#include "abcg_exception.hpp"
+
+/**
+ * @brief Starts a new stage of the task.
+ *
+ * Stage boundaries are cancellation points.
+ *
+ * @param stage Description of the stage, shown to the user.
+ * @param fraction Fraction of the work done when the stage starts.
+ *
+ * @throw abcg::Exception if cancel() has been called.
+ */
+void abcg::LoadProgress::setStage(std::string_view stage, float fraction) {
+  throwIfCancelled();
+  {
+    std::scoped_lock lock{m_mutex};
+    m_stage = stage;
+  }
+  setFraction(fraction);
+}
+
+/**
+ * @brief Sets the fraction of the work done, in [0, 1].
+ */
+void abcg::LoadProgress::setFraction(float fraction) noexcept {
+  m_fraction = std::clamp(fraction, 0.0f, 1.0f);
+}
+
+float abcg::LoadProgress::getFraction() const noexcept { return m_fraction; }
+
+std::string abcg::LoadProgress::getStage() const {
+  std::scoped_lock lock{m_mutex};
+  return m_stage;
+}
+
+void abcg::LoadProgress::cancel() noexcept { m_cancelled = true; }
+
+bool abcg::LoadProgress::isCancelled() const noexcept { return m_cancelled; }
+
+/**
+ * @brief Stops the task if it has been cancelled.
+ *
+ * @throw abcg::Exception if cancel() has been called.
+ */
+void abcg::LoadProgress::throwIfCancelled() const {
+  if (m_cancelled) {
+    throw abcg::Exception{abcg::Exception::Runtime("Loading cancelled")};
+  }
+}
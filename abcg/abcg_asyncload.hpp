@@ -0,0 +1,151 @@
+/**
+ * @file abcg_asyncload.hpp
+ * @brief abcg::AsyncLoad header file.
+ *
+ * Declaration of abcg::LoadProgress class and of abcg::AsyncLoad class
+ * template, used to run loaders on a background thread.
+ *
+ * This project is released under the MIT License.
+ */
+
+#ifndef ABCG_ASYNCLOAD_HPP_
+#define ABCG_ASYNCLOAD_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#include "abcg_threadpool.hpp"
+
+namespace abcg {
+class LoadProgress;
+template <typename T>
+class AsyncLoad;
+
+template <typename TFun>
+[[nodiscard]] auto loadAsync(TFun&& function)
+    -> AsyncLoad<std::invoke_result_t<TFun, LoadProgress&>>;
+}  // namespace abcg
+
+/**
+ * @brief abcg::LoadProgress class.
+ *
+ * Progress and cancellation state shared by a loading task and the
+ * abcg::AsyncLoad handle that waits for it. The task reports the current
+ * stage and the fraction of work done. Starting a stage throws if the task
+ * has been cancelled; long stages can also call throwIfCancelled().
+ */
+class abcg::LoadProgress {
+ public:
+  void setStage(std::string_view stage, float fraction);
+  void setFraction(float fraction) noexcept;
+  [[nodiscard]] float getFraction() const noexcept;
+  [[nodiscard]] std::string getStage() const;
+
+  void cancel() noexcept;
+  [[nodiscard]] bool isCancelled() const noexcept;
+  void throwIfCancelled() const;
+
+ private:
+  std::atomic<float> m_fraction{};
+  std::atomic<bool> m_cancelled{};
+  mutable std::mutex m_mutex;
+  std::string m_stage;
+};
+
+/**
+ * @brief abcg::AsyncLoad class template.
+ *
+ * Handle to a task started with abcg::loadAsync. Poll isReady() once per
+ * frame and call get() when it returns true. Destroying or reassigning the
+ * handle cancels the task.
+ *
+ * @tparam T Type of the loaded object.
+ */
+template <typename T>
+class abcg::AsyncLoad {
+ public:
+  AsyncLoad() = default;
+  AsyncLoad(std::future<T> future, std::shared_ptr<LoadProgress> progress)
+      : m_future{std::move(future)}, m_progress{std::move(progress)} {}
+  ~AsyncLoad() { cancel(); }
+
+  AsyncLoad(const AsyncLoad&) = delete;
+  AsyncLoad(AsyncLoad&&) noexcept = default;
+  AsyncLoad& operator=(const AsyncLoad&) = delete;
+  AsyncLoad& operator=(AsyncLoad&& other) noexcept {
+    if (this != &other) {
+      cancel();
+      m_future = std::move(other.m_future);
+      m_progress = std::move(other.m_progress);
+    }
+    return *this;
+  }
+
+  /**
+   * @brief Returns true while the result has not been retrieved with get().
+   */
+  [[nodiscard]] bool isPending() const noexcept { return m_future.valid(); }
+
+  /**
+   * @brief Returns true if the task has finished and get() will not block.
+   */
+  [[nodiscard]] bool isReady() const {
+    return m_future.valid() && m_future.wait_for(std::chrono::seconds{0}) ==
+                                   std::future_status::ready;
+  }
+
+  /**
+   * @brief Waits for the task and returns its result.
+   *
+   * @throw The exception thrown by the task, if any. A cancelled task throws
+   * abcg::Exception.
+   */
+  [[nodiscard]] T get() { return m_future.get(); }
+
+  [[nodiscard]] float getProgress() const noexcept {
+    return m_progress ? m_progress->getFraction() : 0.0f;
+  }
+  [[nodiscard]] std::string getStage() const {
+    return m_progress ? m_progress->getStage() : std::string{};
+  }
+
+  /**
+   * @brief Asks the task to stop at its next cancellation point.
+   */
+  void cancel() noexcept {
+    if (m_progress) m_progress->cancel();
+  }
+
+ private:
+  std::future<T> m_future;
+  std::shared_ptr<LoadProgress> m_progress;
+};
+
+/**
+ * @brief Runs a loader on the background thread pool.
+ *
+ * Without threads (e.g. WebAssembly builds without pthreads), the loader
+ * runs on the calling thread and the returned handle is already ready.
+ *
+ * @param function Callable object taking an abcg::LoadProgress reference.
+ * @return Handle to the result of the function.
+ */
+template <typename TFun>
+auto abcg::loadAsync(TFun&& function)
+    -> AsyncLoad<std::invoke_result_t<TFun, LoadProgress&>> {
+  auto progress{std::make_shared<LoadProgress>()};
+  auto future{ThreadPool::getBackground().submit(
+      [progress, function = std::forward<TFun>(function)]() mutable {
+        return function(*progress);
+      })};
+  return {std::move(future), std::move(progress)};
+}
+
+#endif
@@ -0,0 +1,281 @@
+/**
+ * @file abcg_bounds.cpp
+ * @brief Definition of bounding volume computation functions for vertex
+ * arrays.
+ *
+ * This project is released under the MIT License.
+ */
+
+#include "abcg_bounds.hpp"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <functional>
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <limits>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#include <xmmintrin.h>
+#endif
+
+#include "abcg_exception.hpp"
+
+namespace {
+// Number of vertices (or indices) processed by each task
+constexpr std::size_t blockSize{65536};
+
+// Unchecked strided view of the vertex positions
+struct PositionArray {
+  const std::byte* data{};
+  std::size_t stride{};
+  std::size_t count{};
+
+  [[nodiscard]] const glm::vec3& operator[](std::size_t vertex) const {
+    return *reinterpret_cast<const glm::vec3*>(data + vertex * stride);
+  }
+};
+
+struct Box {
+  glm::vec3 min{std::numeric_limits<float>::max()};
+  glm::vec3 max{std::numeric_limits<float>::lowest()};
+};
+
+#if defined(__SSE2__)
+// Loads a position into the first three lanes. The fourth lane is undefined.
+// A 16-byte load reads past the position, so it is only used when the extra
+// bytes belong to the next vertex
+__m128 load(const PositionArray& positions, std::size_t vertex) {
+  if (positions.stride >= 16 && vertex + 1 < positions.count) {
+    return _mm_loadu_ps(reinterpret_cast<const float*>(
+        positions.data + vertex * positions.stride));
+  }
+  const auto& position{positions[vertex]};
+  return _mm_setr_ps(position.x, position.y, position.z, 0.0f);
+}
+
+glm::vec3 toVec3(__m128 value) {
+  alignas(16) std::array<float, 4> lanes{};
+  _mm_store_ps(lanes.data(), value);
+  return {lanes[0], lanes[1], lanes[2]};
+}
+#endif
+
+// Bounding box of the positions of vertices getVertex(first), ...,
+// getVertex(last - 1)
+template <typename TGetVertex>
+Box reduceBox(const PositionArray& positions, const TGetVertex& getVertex,
+              std::size_t first, std::size_t last) {
+  Box box{};
+  auto element{first};
+#if defined(__SSE2__)
+  // Two accumulators to hide the latency of min/max
+  auto minA{_mm_set1_ps(std::numeric_limits<float>::max())};
+  auto maxA{_mm_set1_ps(std::numeric_limits<float>::lowest())};
+  auto minB{minA};
+  auto maxB{maxA};
+  for (; element + 2 <= last; element += 2) {
+    const auto a{load(positions, getVertex(element))};
+    const auto b{load(positions, getVertex(element + 1))};
+    minA = _mm_min_ps(minA, a);
+    maxA = _mm_max_ps(maxA, a);
+    minB = _mm_min_ps(minB, b);
+    maxB = _mm_max_ps(maxB, b);
+  }
+  box.min = toVec3(_mm_min_ps(minA, minB));
+  box.max = toVec3(_mm_max_ps(maxA, maxB));
+#endif
+  for (; element < last; ++element) {
+    const auto& position{positions[getVertex(element)]};
+    box.min = glm::min(box.min, position);
+    box.max = glm::max(box.max, position);
+  }
+  return box;
+}
+
+// Largest squared distance from the center to the positions of vertices
+// getVertex(first), ..., getVertex(last - 1)
+template <typename TGetVertex>
+float reduceSquaredRadius(const PositionArray& positions,
+                          const TGetVertex& getVertex, const glm::vec3& center,
+                          std::size_t first, std::size_t last) {
+  auto squaredRadius{0.0f};
+  auto element{first};
+#if defined(__SSE2__)
+  // Transpose groups of four positions to compute four distances at once
+  const auto centerX{_mm_set1_ps(center.x)};
+  const auto centerY{_mm_set1_ps(center.y)};
+  const auto centerZ{_mm_set1_ps(center.z)};
+  auto maximum{_mm_setzero_ps()};
+  for (; element + 4 <= last; element += 4) {
+    auto x{load(positions, getVertex(element))};
+    auto y{load(positions, getVertex(element + 1))};
+    auto z{load(positions, getVertex(element + 2))};
+    auto w{load(positions, getVertex(element + 3))};
+    _MM_TRANSPOSE4_PS(x, y, z, w);
+    x = _mm_sub_ps(x, centerX);
+    y = _mm_sub_ps(y, centerY);
+    z = _mm_sub_ps(z, centerZ);
+    const auto squaredDistance{_mm_add_ps(
+        _mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z))};
+    maximum = _mm_max_ps(maximum, squaredDistance);
+  }
+  alignas(16) std::array<float, 4> lanes{};
+  _mm_store_ps(lanes.data(), maximum);
+  squaredRadius = *std::max_element(lanes.begin(), lanes.end());
+#endif
+  for (; element < last; ++element) {
+    const auto offset{positions[getVertex(element)] - center};
+    squaredRadius = std::max(squaredRadius, glm::dot(offset, offset));
+  }
+  return squaredRadius;
+}
+
+void forEachBlock(
+    abcg::ThreadPool& threadPool, std::size_t count,
+    const std::function<void(std::size_t, std::size_t, std::size_t)>&
+        function) {
+  const auto numBlocks{(count + blockSize - 1) / blockSize};
+  threadPool.parallelFor(numBlocks, [&](std::size_t block) {
+    const auto first{block * blockSize};
+    function(block, first, std::min(first + blockSize, count));
+  });
+}
+
+// Computes the bounds of count vertices in two passes (box, then sphere).
+// Each pass reduces blocks of vertices concurrently
+template <typename TGetVertex>
+abcg::Bounds reduceBounds(const PositionArray& positions,
+                          const TGetVertex& getVertex, std::size_t count,
+                          abcg::ThreadPool& threadPool) {
+  if (count == 0) return {};
+
+  abcg::Bounds bounds{};
+  if (threadPool.getNumThreads() == 0 || count <= blockSize) {
+    const auto box{reduceBox(positions, getVertex, 0, count)};
+    bounds.min = box.min;
+    bounds.max = box.max;
+    bounds.center = (box.min + box.max) / 2.0f;
+    bounds.radius = std::sqrt(
+        reduceSquaredRadius(positions, getVertex, bounds.center, 0, count));
+    return bounds;
+  }
+
+  const auto numBlocks{(count + blockSize - 1) / blockSize};
+  std::vector<Box> boxes(numBlocks);
+  forEachBlock(threadPool, count,
+               [&](std::size_t block, std::size_t first, std::size_t last) {
+                 boxes[block] = reduceBox(positions, getVertex, first, last);
+               });
+  Box box{};
+  for (const auto& blockBox : boxes) {
+    box.min = glm::min(box.min, blockBox.min);
+    box.max = glm::max(box.max, blockBox.max);
+  }
+  bounds.min = box.min;
+  bounds.max = box.max;
+  bounds.center = (box.min + box.max) / 2.0f;
+
+  std::vector<float> squaredRadii(numBlocks);
+  forEachBlock(threadPool, count,
+               [&](std::size_t block, std::size_t first, std::size_t last) {
+                 squaredRadii[block] = reduceSquaredRadius(
+                     positions, getVertex, bounds.center, first, last);
+               });
+  bounds.radius =
+      std::sqrt(*std::max_element(squaredRadii.begin(), squaredRadii.end()));
+  return bounds;
+}
+}  // namespace
+
+/**
+ * @brief Computes the bounds of an array of vertices.
+ *
+ * The bounding box is reduced with SSE2 when available, and blocks of
+ * vertices are processed concurrently by the thread pool. The bounding sphere
+ * is centered at the center of the box and is computed in a second pass.
+ *
+ * @param positions Position of the first vertex.
+ * @param vertexCount Number of vertices.
+ * @param stride Distance in bytes between consecutive positions.
+ * @param threadPool Pool used to process blocks of vertices concurrently.
+ * @return Bounds of the vertex positions, or empty bounds at the origin if
+ * there are no vertices.
+ */
+abcg::Bounds abcg::computeBounds(const glm::vec3* positions,
+                                 std::size_t vertexCount, std::size_t stride,
+                                 ThreadPool& threadPool) {
+  const PositionArray array{
+      .data = reinterpret_cast<const std::byte*>(positions),
+      .stride = stride,
+      .count = vertexCount};
+  return reduceBounds(
+      array, [](std::size_t element) { return element; }, vertexCount,
+      threadPool);
+}
+
+/**
+ * @brief Computes the bounds of the vertices referenced by an index buffer.
+ *
+ * Useful to bound a part of a mesh (e.g. a submesh drawn from a range of the
+ * index buffer) without copying its vertices.
+ *
+ * @param indices Indices of the vertices to be bounded.
+ * @param positions Position of the first vertex.
+ * @param vertexCount Number of vertices.
+ * @param stride Distance in bytes between consecutive positions.
+ * @param threadPool Pool used to process blocks of indices concurrently.
+ * @return Bounds of the referenced vertex positions, or empty bounds at the
+ * origin if there are no indices.
+ *
+ * @throw abcg::Exception if an index is out of range.
+ */
+abcg::Bounds abcg::computeBounds(gsl::span<const std::uint32_t> indices,
+                                 const glm::vec3* positions,
+                                 std::size_t vertexCount, std::size_t stride,
+                                 ThreadPool& threadPool) {
+  const auto* indicesBegin{indices.data()};
+  const auto* indicesEnd{indicesBegin + indices.size()};
+  if (const auto* invalid{std::find_if(
+          indicesBegin, indicesEnd,
+          [vertexCount](std::uint32_t index) { return index >= vertexCount; })};
+      invalid != indicesEnd) {
+    throw abcg::Exception{abcg::Exception::Runtime(fmt::format(
+        "Vertex index {} out of range ({} vertices)", *invalid, vertexCount))};
+  }
+
+  const PositionArray array{
+      .data = reinterpret_cast<const std::byte*>(positions),
+      .stride = stride,
+      .count = vertexCount};
+  return reduceBounds(
+      array,
+      [indicesBegin](std::size_t element) {
+        return std::size_t{indicesBegin[element]};
+      },
+      indices.size(), threadPool);
+}
+
+/**
+ * @brief Returns the bounds of a set of points after a uniform scaling
+ * followed by a translation.
+ *
+ * @param bounds Bounds of the original points.
+ * @param scaling Scale factor.
+ * @param translation Translation applied after scaling.
+ * @return Bounds of the transformed points.
+ */
+abcg::Bounds abcg::transformBounds(const Bounds& bounds, float scaling,
+                                   const glm::vec3& translation) {
+  const auto a{bounds.min * scaling + translation};
+  const auto b{bounds.max * scaling + translation};
+  return {.min = glm::min(a, b),
+          .max = glm::max(a, b),
+          .center = bounds.center * scaling + translation,
+          .radius = bounds.radius * std::abs(scaling)};
+}
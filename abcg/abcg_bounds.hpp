@@ -0,0 +1,92 @@
+/**
+ * @file abcg_bounds.hpp
+ * @brief Declaration of bounding volume computation functions for vertex
+ * arrays.
+ *
+ * This project is released under the MIT License.
+ */
+
+#ifndef ABCG_BOUNDS_HPP_
+#define ABCG_BOUNDS_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <glm/vec3.hpp>
+#include <gsl/gsl>
+
+#include "abcg_threadpool.hpp"
+
+namespace abcg {
+/**
+ * @brief Axis-aligned bounding box and bounding sphere of a set of points.
+ *
+ * The sphere is centered at the center of the box, which is not the minimal
+ * sphere but is usually close to it and cheap to compute.
+ */
+struct Bounds {
+  /** @brief Minimum corner of the bounding box. */
+  glm::vec3 min{};
+  /** @brief Maximum corner of the bounding box. */
+  glm::vec3 max{};
+  /** @brief Center of the bounding sphere. */
+  glm::vec3 center{};
+  /** @brief Radius of the bounding sphere. */
+  float radius{};
+};
+
+[[nodiscard]] Bounds computeBounds(const glm::vec3* positions,
+                                   std::size_t vertexCount, std::size_t stride,
+                                   ThreadPool& threadPool);
+[[nodiscard]] Bounds computeBounds(gsl::span<const std::uint32_t> indices,
+                                   const glm::vec3* positions,
+                                   std::size_t vertexCount, std::size_t stride,
+                                   ThreadPool& threadPool);
+[[nodiscard]] Bounds transformBounds(const Bounds& bounds, float scaling,
+                                     const glm::vec3& translation);
+
+template <typename TVertex>
+[[nodiscard]] Bounds computeBounds(gsl::span<const TVertex> vertices);
+template <typename TVertex>
+[[nodiscard]] Bounds computeBounds(gsl::span<const std::uint32_t> indices,
+                                   gsl::span<const TVertex> vertices);
+}  // namespace abcg
+
+/**
+ * @brief Computes the bounds of an array of vertices using the default thread
+ * pool.
+ *
+ * @tparam TVertex Vertex type with a glm::vec3 member named position.
+ * @param vertices Vertex array.
+ * @return Bounds of the vertex positions, or empty bounds at the origin if
+ * there are no vertices.
+ */
+template <typename TVertex>
+abcg::Bounds abcg::computeBounds(gsl::span<const TVertex> vertices) {
+  const auto* positions{vertices.empty() ? nullptr
+                                         : &vertices.front().position};
+  return computeBounds(positions, vertices.size(), sizeof(TVertex),
+                       ThreadPool::getDefault());
+}
+
+/**
+ * @brief Computes the bounds of the vertices referenced by an index buffer
+ * using the default thread pool.
+ *
+ * @tparam TVertex Vertex type with a glm::vec3 member named position.
+ * @param indices Indices of the vertices to be bounded.
+ * @param vertices Vertex array.
+ * @return Bounds of the referenced vertex positions, or empty bounds at the
+ * origin if there are no indices.
+ *
+ * @throw abcg::Exception if an index is out of range.
+ */
+template <typename TVertex>
+abcg::Bounds abcg::computeBounds(gsl::span<const std::uint32_t> indices,
+                                 gsl::span<const TVertex> vertices) {
+  const auto* positions{vertices.empty() ? nullptr
+                                         : &vertices.front().position};
+  return computeBounds(indices, positions, vertices.size(), sizeof(TVertex),
+                       ThreadPool::getDefault());
+}
+
+#endif
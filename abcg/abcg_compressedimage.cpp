@@ -0,0 +1,1063 @@
+/**
+ * @file abcg_compressedimage.cpp
+ * @brief Definition of abcg::CompressedImage class members.
+ *
+ * This project is released under the MIT License.
+ */
+
+#include "abcg_compressedimage.hpp"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cppitertools/itertools.hpp>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+
+#include "abcg_exception.hpp"
+#include "abcg_threadpool.hpp"
+
+namespace {
+// Decoded 4x4 block: RGBA texels, row by row
+using Block = std::array<std::uint8_t, 64>;
+
+// Number of texels decoded by each task of CompressedImage::decode
+constexpr std::size_t texelsPerTask{65536};
+
+// Largest width or height accepted, so that sizes never overflow an int
+constexpr std::uint32_t maxDimension{65536};
+
+void setTexel(Block& texels, int texel, int red, int green, int blue,
+              int alpha) {
+  const auto offset{static_cast<std::size_t>(texel) * 4};
+  texels.at(offset + 0) = static_cast<std::uint8_t>(std::clamp(red, 0, 255));
+  texels.at(offset + 1) = static_cast<std::uint8_t>(std::clamp(green, 0, 255));
+  texels.at(offset + 2) = static_cast<std::uint8_t>(std::clamp(blue, 0, 255));
+  texels.at(offset + 3) = static_cast<std::uint8_t>(std::clamp(alpha, 0, 255));
+}
+
+std::uint32_t readUint32LE(const std::uint8_t* bytes) {
+  return static_cast<std::uint32_t>(bytes[0]) |
+         static_cast<std::uint32_t>(bytes[1]) << 8U |
+         static_cast<std::uint32_t>(bytes[2]) << 16U |
+         static_cast<std::uint32_t>(bytes[3]) << 24U;
+}
+
+std::uint64_t readUint48LE(const std::uint8_t* bytes) {
+  std::uint64_t value{};
+  for (auto index : {5, 4, 3, 2, 1, 0}) value = value << 8U | bytes[index];
+  return value;
+}
+
+std::uint64_t readUint48BE(const std::uint8_t* bytes) {
+  std::uint64_t value{};
+  for (auto index : {0, 1, 2, 3, 4, 5}) value = value << 8U | bytes[index];
+  return value;
+}
+
+// BC1 to BC3 ------------------------------------------------------------------
+
+// Color block of BC1, BC2 and BC3. The three-color mode, selected by
+// color0 <= color1, is only used by BC1. Its fourth color is black, and
+// also transparent with 1-bit alpha
+void decodeBC1(const std::uint8_t* block, Block& texels, bool threeColorMode,
+               bool punchThrough) {
+  const auto color0{static_cast<unsigned>(block[0] | block[1] << 8U)};
+  const auto color1{static_cast<unsigned>(block[2] | block[3] << 8U)};
+
+  std::array<std::array<int, 4>, 4> palette{};
+  for (auto&& [index, color] : {std::pair{0, color0}, std::pair{1, color1}}) {
+    const auto red{static_cast<int>(color >> 11U)};
+    const auto green{static_cast<int>(color >> 5U & 63U)};
+    const auto blue{static_cast<int>(color & 31U)};
+    palette.at(static_cast<std::size_t>(index)) = {
+        red << 3 | red >> 2, green << 2 | green >> 4, blue << 3 | blue >> 2,
+        255};
+  }
+  for (std::size_t channel{}; channel < 3; ++channel) {
+    const auto value0{palette[0].at(channel)};
+    const auto value1{palette[1].at(channel)};
+    if (threeColorMode && color0 <= color1) {
+      palette[2].at(channel) = (value0 + value1) / 2;
+      palette[3].at(channel) = 0;
+    } else {
+      palette[2].at(channel) = (2 * value0 + value1) / 3;
+      palette[3].at(channel) = (value0 + 2 * value1) / 3;
+    }
+  }
+  palette[2][3] = 255;
+  palette[3][3] = punchThrough && color0 <= color1 ? 0 : 255;
+
+  const auto indices{readUint32LE(block + 4)};
+  for (auto texel : iter::range(16)) {
+    const auto& color{palette.at(
+        indices >> (2U * static_cast<std::uint32_t>(texel)) & 3U)};
+    setTexel(texels, texel, color[0], color[1], color[2], color[3]);
+  }
+}
+
+// Explicit 4-bit alpha of BC2
+void decodeBC2Alpha(const std::uint8_t* block, Block& texels) {
+  for (auto texel : iter::range(16)) {
+    const auto value{block[texel / 2] >> (4 * (texel % 2)) & 15};
+    texels.at(static_cast<std::size_t>(texel) * 4 + 3) =
+        static_cast<std::uint8_t>(value * 17);
+  }
+}
+
+// Single channel of BC3, BC4 and BC5, interpolated between two 8-bit values
+void decodeBC4(const std::uint8_t* block, Block& texels, int channel) {
+  const int value0{block[0]};
+  const int value1{block[1]};
+
+  std::array<int, 8> palette{value0, value1};
+  if (value0 > value1) {
+    for (auto index : iter::range(1, 7)) {
+      palette.at(static_cast<std::size_t>(index) + 1) =
+          ((7 - index) * value0 + index * value1) / 7;
+    }
+  } else {
+    for (auto index : iter::range(1, 5)) {
+      palette.at(static_cast<std::size_t>(index) + 1) =
+          ((5 - index) * value0 + index * value1) / 5;
+    }
+    palette[6] = 0;
+    palette[7] = 255;
+  }
+
+  const auto indices{readUint48LE(block + 2)};
+  for (auto texel : iter::range(16)) {
+    texels.at(static_cast<std::size_t>(texel * 4 + channel)) =
+        static_cast<std::uint8_t>(palette.at(
+            indices >> (3U * static_cast<std::uint32_t>(texel)) & 7U));
+  }
+}
+
+// BC7 -------------------------------------------------------------------------
+
+struct BC7Mode {
+  int subsets{};
+  int partitionBits{};
+  int rotationBits{};
+  int indexSelectionBits{};
+  int colorBits{};
+  int alphaBits{};
+  int endpointPBits{};
+  int sharedPBits{};
+  int indexBits{};
+  int secondaryIndexBits{};
+};
+
+constexpr std::array<BC7Mode, 8> bc7Modes{{{3, 4, 0, 0, 4, 0, 1, 0, 3, 0},
+                                           {2, 6, 0, 0, 6, 0, 0, 1, 3, 0},
+                                           {3, 6, 0, 0, 5, 0, 0, 0, 2, 0},
+                                           {2, 6, 0, 0, 7, 0, 1, 0, 2, 0},
+                                           {1, 0, 2, 1, 5, 6, 0, 0, 2, 3},
+                                           {1, 0, 2, 0, 7, 8, 0, 0, 2, 2},
+                                           {1, 0, 0, 0, 7, 7, 1, 0, 4, 0},
+                                           {2, 6, 0, 0, 5, 5, 1, 0, 2, 0}}};
+
+// Subset of each texel for the 2-subset partitions, one bit per texel
+constexpr std::array<std::uint16_t, 64> bc7Partitions2{
+    0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80,
+    0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+    0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE,
+    0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+    0xAAAA, 0xF0F0, 0x5A5A, 0x33CC, 0x3C3C, 0x55AA, 0x9696, 0xA55A,
+    0x73CE, 0x13C8, 0x324C, 0x3BDC, 0x6996, 0xC33C, 0x9966, 0x0660,
+    0x0272, 0x04E4, 0x4E40, 0x2720, 0xC936, 0x936C, 0x39C6, 0x639C,
+    0x9336, 0x9CC6, 0x817E, 0xE718, 0xCCF0, 0x0FCC, 0x7744, 0xEE22};
+
+// Subset of each texel for the 3-subset partitions, two bits per texel
+constexpr std::array<std::uint32_t, 64> bc7Partitions3{
+    0xAA685050, 0x6A5A5040, 0x5A5A4200, 0x5450A0A8, 0xA5A50000, 0xA0A05050,
+    0x5555A0A0, 0x5A5A5050, 0xAA550000, 0xAA555500, 0xAAAA5500, 0x90909090,
+    0x94949494, 0xA4A4A4A4, 0xA9A59450, 0x2A0A4250, 0xA5945040, 0x0A425054,
+    0xA5A5A500, 0x55A0A0A0, 0xA8A85454, 0x6A6A4040, 0xA4A45000, 0x1A1A0500,
+    0x0050A4A4, 0xAAA59090, 0x14696914, 0x69691400, 0xA08585A0, 0xAA821414,
+    0x50A4A450, 0x6A5A0200, 0xA9A58000, 0x5090A0A8, 0xA8A09050, 0x24242424,
+    0x00AA5500, 0x24924924, 0x24499224, 0x50A50A50, 0x500AA550, 0xAAAA4444,
+    0x66660000, 0xA5A0A5A0, 0x50A050A0, 0x69286928, 0x44AAAA44, 0x66666600,
+    0xAA444444, 0x54A854A8, 0x95809580, 0x96969600, 0xA85454A8, 0x80959580,
+    0xAA141414, 0x96960000, 0xAAAA1414, 0xA05050A0, 0xA0A5A5A0, 0x96000000,
+    0x40804080, 0xA9A8A9A8, 0xAAAAAA44, 0x2A4A5254};
+
+// Texels whose index has an implicit most significant bit of zero, besides
+// texel 0
+constexpr std::array<std::uint8_t, 64> bc7Anchors2{
+    15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+    15, 2, 8, 2, 2, 8, 8, 15, 2, 8, 2, 2, 8, 8, 2, 2,
+    15, 15, 6, 8, 2, 8, 15, 15, 2, 8, 2, 2, 2, 15, 15, 6,
+    6, 2, 6, 8, 15, 15, 2, 2, 15, 15, 15, 15, 15, 2, 2, 15};
+constexpr std::array<std::uint8_t, 64> bc7Anchors3Second{
+    3, 3, 15, 15, 8, 3, 15, 15, 8, 8, 6, 6, 6, 5, 3, 3,
+    3, 3, 8, 15, 3, 3, 6, 10, 5, 8, 8, 6, 8, 5, 15, 15,
+    8, 15, 3, 5, 6, 10, 8, 15, 15, 3, 15, 5, 15, 15, 15, 15,
+    3, 15, 5, 5, 5, 8, 5, 10, 5, 10, 8, 13, 15, 12, 3, 3};
+constexpr std::array<std::uint8_t, 64> bc7Anchors3Third{
+    15, 8, 8, 3, 15, 15, 3, 8, 15, 15, 15, 15, 15, 15, 15, 8,
+    15, 8, 15, 3, 15, 8, 15, 8, 3, 15, 6, 10, 15, 15, 10, 8,
+    15, 3, 15, 10, 10, 8, 9, 10, 6, 15, 8, 15, 3, 6, 6, 8,
+    15, 3, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 3, 15, 15, 8};
+
+constexpr std::array<int, 4> bc7Weights2{0, 21, 43, 64};
+constexpr std::array<int, 8> bc7Weights3{0, 9, 18, 27, 37, 46, 55, 64};
+constexpr std::array<int, 16> bc7Weights4{0,  4,  9,  13, 17, 21, 26, 30,
+                                          34, 38, 43, 47, 51, 55, 60, 64};
+
+int getBC7Weight(int indexBits, unsigned index) {
+  switch (indexBits) {
+    case 2:
+      return bc7Weights2.at(index);
+    case 3:
+      return bc7Weights3.at(index);
+    default:
+      return bc7Weights4.at(index);
+  }
+}
+
+// Reads the fields of a 128-bit block, from the least significant bit
+class BC7Reader {
+ public:
+  explicit BC7Reader(const std::uint8_t* block) {
+    std::memcpy(&m_low, block, 8);
+    std::memcpy(&m_high, block + 8, 8);
+  }
+
+  unsigned read(int count) {
+    if (count == 0) return 0;
+    const auto value{static_cast<unsigned>(m_low & ((1ULL << count) - 1))};
+    m_low = m_low >> count | m_high << (64 - count);
+    m_high >>= count;
+    return value;
+  }
+
+ private:
+  std::uint64_t m_low{};
+  std::uint64_t m_high{};
+};
+
+void decodeBC7(const std::uint8_t* block, Block& texels) {
+  BC7Reader reader{block};
+  std::size_t modeIndex{};
+  while (modeIndex < bc7Modes.size() && reader.read(1) == 0) ++modeIndex;
+  if (modeIndex == bc7Modes.size()) {
+    // Reserved mode
+    texels.fill(0);
+    return;
+  }
+
+  const auto& mode{bc7Modes.at(modeIndex)};
+  const auto partition{reader.read(mode.partitionBits)};
+  const auto rotation{reader.read(mode.rotationBits)};
+  const auto indexSelection{reader.read(mode.indexSelectionBits)};
+
+  // Endpoints 2 * s and 2 * s + 1 belong to subset s
+  const auto endpointCount{static_cast<std::size_t>(mode.subsets) * 2};
+  std::array<std::array<int, 4>, 6> endpoints{};
+  for (std::size_t channel{}; channel < 3; ++channel) {
+    for (std::size_t endpoint{}; endpoint < endpointCount; ++endpoint) {
+      endpoints.at(endpoint).at(channel) =
+          static_cast<int>(reader.read(mode.colorBits));
+    }
+  }
+  for (std::size_t endpoint{}; endpoint < endpointCount; ++endpoint) {
+    endpoints.at(endpoint)[3] = static_cast<int>(reader.read(mode.alphaBits));
+  }
+
+  auto colorBits{mode.colorBits};
+  auto alphaBits{mode.alphaBits};
+  if (mode.endpointPBits + mode.sharedPBits > 0) {
+    std::array<unsigned, 6> pBits{};
+    for (std::size_t endpoint{}; endpoint < endpointCount; ++endpoint) {
+      if (mode.endpointPBits > 0 || endpoint % 2 == 0) {
+        pBits.at(endpoint) = reader.read(1);
+      } else {
+        pBits.at(endpoint) = pBits.at(endpoint - 1);
+      }
+    }
+    for (std::size_t endpoint{}; endpoint < endpointCount; ++endpoint) {
+      for (auto& value : endpoints.at(endpoint)) {
+        value = value << 1 | static_cast<int>(pBits.at(endpoint));
+      }
+    }
+    ++colorBits;
+    if (alphaBits > 0) ++alphaBits;
+  }
+
+  // Replicate the most significant bits into the missing low bits
+  for (std::size_t endpoint{}; endpoint < endpointCount; ++endpoint) {
+    auto& color{endpoints.at(endpoint)};
+    for (std::size_t channel{}; channel < 3; ++channel) {
+      color.at(channel) <<= 8 - colorBits;
+      color.at(channel) |= color.at(channel) >> colorBits;
+    }
+    if (alphaBits > 0) {
+      color[3] <<= 8 - alphaBits;
+      color[3] |= color[3] >> alphaBits;
+    } else {
+      color[3] = 255;
+    }
+  }
+
+  auto getSubset{[&](int texel) -> std::size_t {
+    if (mode.subsets == 2) return bc7Partitions2.at(partition) >> texel & 1U;
+    if (mode.subsets == 3) {
+      return bc7Partitions3.at(partition) >> (2 * texel) & 3U;
+    }
+    return 0;
+  }};
+  auto isAnchor{[&](int texel) {
+    return texel == 0 ||
+           (mode.subsets == 2 && texel == bc7Anchors2.at(partition)) ||
+           (mode.subsets == 3 && (texel == bc7Anchors3Second.at(partition) ||
+                                  texel == bc7Anchors3Third.at(partition)));
+  }};
+
+  std::array<unsigned, 16> indices{};
+  for (auto texel : iter::range(16)) {
+    indices.at(static_cast<std::size_t>(texel)) =
+        reader.read(mode.indexBits - (isAnchor(texel) ? 1 : 0));
+  }
+  std::array<unsigned, 16> secondaryIndices{};
+  if (mode.secondaryIndexBits > 0) {
+    for (auto texel : iter::range(16)) {
+      secondaryIndices.at(static_cast<std::size_t>(texel)) =
+          reader.read(mode.secondaryIndexBits - (texel == 0 ? 1 : 0));
+    }
+  }
+
+  for (auto texel : iter::range(16)) {
+    const auto subset{getSubset(texel)};
+    const auto& color0{endpoints.at(2 * subset)};
+    const auto& color1{endpoints.at(2 * subset + 1)};
+    const auto index{indices.at(static_cast<std::size_t>(texel))};
+    auto colorWeight{getBC7Weight(mode.indexBits, index)};
+    auto alphaWeight{colorWeight};
+    if (mode.secondaryIndexBits > 0) {
+      const auto secondaryIndex{
+          secondaryIndices.at(static_cast<std::size_t>(texel))};
+      alphaWeight = getBC7Weight(mode.secondaryIndexBits, secondaryIndex);
+      if (indexSelection != 0) std::swap(colorWeight, alphaWeight);
+    }
+
+    std::array<int, 4> color{};
+    for (std::size_t channel{}; channel < 4; ++channel) {
+      const auto weight{channel < 3 ? colorWeight : alphaWeight};
+      color.at(channel) = ((64 - weight) * color0.at(channel) +
+                           weight * color1.at(channel) + 32) >>
+                          6;
+    }
+    if (rotation > 0) std::swap(color.at(rotation - 1), color[3]);
+    setTexel(texels, texel, color[0], color[1], color[2], color[3]);
+  }
+}
+
+// ETC2 and EAC ----------------------------------------------------------------
+
+constexpr std::array<std::array<int, 4>, 8> etcModifiers{
+    {{2, 8, -2, -8},
+     {5, 17, -5, -17},
+     {9, 29, -9, -29},
+     {13, 42, -13, -42},
+     {18, 60, -18, -60},
+     {24, 80, -24, -80},
+     {33, 106, -33, -106},
+     {47, 183, -47, -183}}};
+
+constexpr std::array<int, 8> etcDistances{3, 6, 11, 16, 23, 32, 41, 64};
+
+constexpr std::array<std::array<int, 8>, 16> eacModifiers{
+    {{-3, -6, -9, -15, 2, 5, 8, 14},
+     {-3, -7, -10, -13, 2, 6, 9, 12},
+     {-2, -5, -8, -13, 1, 4, 7, 12},
+     {-2, -4, -6, -13, 1, 3, 5, 12},
+     {-3, -6, -8, -12, 2, 5, 7, 11},
+     {-3, -7, -9, -11, 2, 6, 8, 10},
+     {-4, -7, -8, -11, 3, 6, 7, 10},
+     {-3, -5, -8, -11, 2, 4, 7, 10},
+     {-2, -6, -8, -10, 1, 5, 7, 9},
+     {-2, -5, -8, -10, 1, 4, 7, 9},
+     {-2, -4, -8, -10, 1, 3, 7, 9},
+     {-2, -5, -7, -10, 1, 4, 6, 9},
+     {-3, -4, -7, -10, 2, 3, 6, 9},
+     {-1, -2, -3, -10, 0, 1, 2, 9},
+     {-4, -6, -8, -9, 3, 5, 7, 8},
+     {-3, -5, -7, -9, 2, 4, 6, 8}}};
+
+int extend4(int value) { return value << 4 | value; }
+int extend5(int value) { return value << 3 | value >> 2; }
+int extend6(int value) { return value << 2 | value >> 4; }
+int extend7(int value) { return value << 1 | value >> 6; }
+
+// Sign-extends a 3-bit two's complement value
+int signExtend3(int value) { return (value ^ 4) - 4; }
+
+// Color block of ETC2, including the individual and differential modes of
+// ETC1 and the T, H and planar modes selected by overflowing differential
+// colors. With 1-bit alpha, the bit that selects the differential mode
+// tells whether the block is opaque instead
+void decodeETC2(const std::uint8_t* block, Block& texels, bool punchThrough) {
+  const auto flag{(block[3] & 2) != 0};
+  const auto opaque{!punchThrough || flag};
+
+  // Texels are indexed column by column. Bit n holds the least significant
+  // bit of the index of texel n, and bit n + 16 its most significant bit
+  const auto indexBits{static_cast<std::uint32_t>(
+      block[4] << 24U | block[5] << 16U | block[6] << 8U | block[7])};
+  auto getIndex{[&](int x, int y) {
+    const auto bit{static_cast<unsigned>(x * 4 + y)};
+    return static_cast<std::size_t>((indexBits >> (bit + 16) & 1U) << 1U |
+                                    (indexBits >> bit & 1U));
+  }};
+  auto setPaletteTexels{[&](const std::array<std::array<int, 3>, 4>& palette) {
+    for (auto y : iter::range(4)) {
+      for (auto x : iter::range(4)) {
+        const auto index{getIndex(x, y)};
+        if (!opaque && index == 2) {
+          setTexel(texels, y * 4 + x, 0, 0, 0, 0);
+          continue;
+        }
+        const auto& color{palette.at(index)};
+        setTexel(texels, y * 4 + x, color[0], color[1], color[2], 255);
+      }
+    }
+  }};
+
+  std::array<std::array<int, 3>, 2> baseColors{};
+  if (!punchThrough && !flag) {
+    // Individual mode
+    for (std::size_t channel{}; channel < 3; ++channel) {
+      baseColors[0].at(channel) = extend4(block[channel] >> 4);
+      baseColors[1].at(channel) = extend4(block[channel] & 15);
+    }
+  } else {
+    std::array<int, 3> values{};
+    std::array<int, 3> sums{};
+    for (std::size_t channel{}; channel < 3; ++channel) {
+      values.at(channel) = block[channel] >> 3;
+      sums.at(channel) = values.at(channel) + signExtend3(block[channel] & 7);
+    }
+
+    auto overflows{[](int value) { return value < 0 || value > 31; }};
+    if (overflows(sums[0])) {
+      // T mode
+      const std::array<int, 3> color0{
+          extend4((block[0] >> 1 & 12) | (block[0] & 3)),
+          extend4(block[1] >> 4), extend4(block[1] & 15)};
+      const std::array<int, 3> color1{extend4(block[2] >> 4),
+                                      extend4(block[2] & 15),
+                                      extend4(block[3] >> 4)};
+      const auto distance{
+          etcDistances.at(static_cast<std::size_t>((block[3] >> 1 & 6) |
+                                                   (block[3] & 1)))};
+      std::array<std::array<int, 3>, 4> palette{color0, color1, color1,
+                                                color1};
+      for (std::size_t channel{}; channel < 3; ++channel) {
+        palette[1].at(channel) += distance;
+        palette[3].at(channel) -= distance;
+      }
+      setPaletteTexels(palette);
+      return;
+    }
+
+    if (overflows(sums[1])) {
+      // H mode
+      const std::array<int, 3> color0{
+          block[0] >> 3 & 15, (block[0] & 7) << 1 | (block[1] >> 4 & 1),
+          (block[1] & 8) | (block[1] & 3) << 1 | block[2] >> 7};
+      const std::array<int, 3> color1{block[2] >> 3 & 15,
+                                      (block[2] & 7) << 1 | block[3] >> 7,
+                                      block[3] >> 3 & 15};
+      auto distanceIndex{(block[3] & 4) | (block[3] & 1) << 1};
+      if ((color0[0] << 8 | color0[1] << 4 | color0[2]) >=
+          (color1[0] << 8 | color1[1] << 4 | color1[2])) {
+        distanceIndex |= 1;
+      }
+      const auto distance{
+          etcDistances.at(static_cast<std::size_t>(distanceIndex))};
+      std::array<std::array<int, 3>, 4> palette{};
+      for (std::size_t channel{}; channel < 3; ++channel) {
+        palette[0].at(channel) = extend4(color0.at(channel)) + distance;
+        palette[1].at(channel) = extend4(color0.at(channel)) - distance;
+        palette[2].at(channel) = extend4(color1.at(channel)) + distance;
+        palette[3].at(channel) = extend4(color1.at(channel)) - distance;
+      }
+      setPaletteTexels(palette);
+      return;
+    }
+
+    if (overflows(sums[2])) {
+      // Planar mode: colors at the origin, and at x = 4 and y = 4
+      const std::array<int, 3> origin{
+          extend6(block[0] >> 1 & 63),
+          extend7((block[0] & 1) << 6 | (block[1] >> 1 & 63)),
+          extend6((block[1] & 1) << 5 | (block[2] >> 3 & 3) << 3 |
+                  (block[2] & 3) << 1 | block[3] >> 7)};
+      const std::array<int, 3> horizontal{
+          extend6((block[3] >> 2 & 31) << 1 | (block[3] & 1)),
+          extend7(block[4] >> 1), extend6((block[4] & 1) << 5 | block[5] >> 3)};
+      const std::array<int, 3> vertical{
+          extend6((block[5] & 7) << 3 | block[6] >> 5),
+          extend7((block[6] & 31) << 2 | block[7] >> 6),
+          extend6(block[7] & 63)};
+      for (auto y : iter::range(4)) {
+        for (auto x : iter::range(4)) {
+          std::array<int, 3> color{};
+          for (std::size_t channel{}; channel < 3; ++channel) {
+            color.at(channel) =
+                (x * (horizontal.at(channel) - origin.at(channel)) +
+                 y * (vertical.at(channel) - origin.at(channel)) +
+                 4 * origin.at(channel) + 2) >>
+                2;
+          }
+          setTexel(texels, y * 4 + x, color[0], color[1], color[2], 255);
+        }
+      }
+      return;
+    }
+
+    // Differential mode
+    for (std::size_t channel{}; channel < 3; ++channel) {
+      baseColors[0].at(channel) = extend5(values.at(channel));
+      baseColors[1].at(channel) = extend5(sums.at(channel));
+    }
+  }
+
+  // Two subblocks of 2x4 texels side by side, or of 4x2 texels on top of
+  // each other if the flip bit is set
+  const auto flip{(block[3] & 1) != 0};
+  const std::array<std::size_t, 2> tables{
+      static_cast<std::size_t>(block[3] >> 5),
+      static_cast<std::size_t>(block[3] >> 2 & 7)};
+  for (auto y : iter::range(4)) {
+    for (auto x : iter::range(4)) {
+      const auto subblock{static_cast<std::size_t>(flip ? y >= 2 : x >= 2)};
+      const auto index{getIndex(x, y)};
+      if (!opaque && index == 2) {
+        setTexel(texels, y * 4 + x, 0, 0, 0, 0);
+        continue;
+      }
+      // Non-opaque blocks replace the smaller modifiers with zero
+      const auto modifier{!opaque && index == 0
+                              ? 0
+                              : etcModifiers.at(tables.at(subblock)).at(index)};
+      const auto& color{baseColors.at(subblock)};
+      setTexel(texels, y * 4 + x, color[0] + modifier, color[1] + modifier,
+               color[2] + modifier, 255);
+    }
+  }
+}
+
+// EAC block of the 8-bit alpha of ETC2, or of an 11-bit channel. 11-bit
+// values are rounded to 8 bits
+void decodeEAC(const std::uint8_t* block, Block& texels, int channel,
+               bool elevenBits) {
+  const int base{block[0]};
+  const auto multiplier{block[1] >> 4};
+  const auto& modifiers{eacModifiers.at(block[1] & 15U)};
+
+  // Texels are indexed column by column, from the most significant bits
+  const auto indices{readUint48BE(block + 2)};
+  for (auto x : iter::range(4)) {
+    for (auto y : iter::range(4)) {
+      const auto shift{static_cast<unsigned>(45 - 3 * (x * 4 + y))};
+      const auto modifier{modifiers.at(indices >> shift & 7U)};
+      int value{};
+      if (elevenBits) {
+        const auto scaledModifier{multiplier == 0 ? modifier
+                                                  : modifier * multiplier * 8};
+        value = std::clamp(base * 8 + 4 + scaledModifier, 0, 2047);
+        value = (value * 255 + 1023) / 2047;
+      } else {
+        value = std::clamp(base + modifier * multiplier, 0, 255);
+      }
+      texels.at(static_cast<std::size_t>((y * 4 + x) * 4 + channel)) =
+          static_cast<std::uint8_t>(value);
+    }
+  }
+}
+
+// Decodes a block into RGBA texels. Missing channels are set as OpenGL does
+// when sampling a texture with fewer channels: 0 for green and blue, 255 for
+// alpha
+void decodeBlock(abcg::CompressedFormat format, const std::uint8_t* block,
+                 Block& texels) {
+  using abcg::CompressedFormat;
+  switch (format) {
+    case CompressedFormat::BC1:
+      decodeBC1(block, texels, true, false);
+      break;
+    case CompressedFormat::BC1A:
+      decodeBC1(block, texels, true, true);
+      break;
+    case CompressedFormat::BC2:
+      decodeBC1(block + 8, texels, false, false);
+      decodeBC2Alpha(block, texels);
+      break;
+    case CompressedFormat::BC3:
+      decodeBC1(block + 8, texels, false, false);
+      decodeBC4(block, texels, 3);
+      break;
+    case CompressedFormat::BC4:
+    case CompressedFormat::BC5:
+      for (auto texel : iter::range(16)) setTexel(texels, texel, 0, 0, 0, 255);
+      decodeBC4(block, texels, 0);
+      if (format == CompressedFormat::BC5) decodeBC4(block + 8, texels, 1);
+      break;
+    case CompressedFormat::BC7:
+      decodeBC7(block, texels);
+      break;
+    case CompressedFormat::ETC2RGB:
+      decodeETC2(block, texels, false);
+      break;
+    case CompressedFormat::ETC2RGBA1:
+      decodeETC2(block, texels, true);
+      break;
+    case CompressedFormat::ETC2RGBA:
+      decodeETC2(block + 8, texels, false);
+      decodeEAC(block, texels, 3, false);
+      break;
+    case CompressedFormat::EACR11:
+    case CompressedFormat::EACRG11:
+      for (auto texel : iter::range(16)) setTexel(texels, texel, 0, 0, 0, 255);
+      decodeEAC(block, texels, 0, true);
+      if (format == CompressedFormat::EACRG11) {
+        decodeEAC(block + 8, texels, 1, true);
+      }
+      break;
+  }
+}
+
+// Containers ------------------------------------------------------------------
+
+constexpr std::array<std::uint8_t, 12> ktx2Identifier{
+    0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+
+struct KTX2Header {
+  std::array<std::uint8_t, 12> identifier{};
+  std::uint32_t vkFormat{};
+  std::uint32_t typeSize{};
+  std::uint32_t pixelWidth{};
+  std::uint32_t pixelHeight{};
+  std::uint32_t pixelDepth{};
+  std::uint32_t layerCount{};
+  std::uint32_t faceCount{};
+  std::uint32_t levelCount{};
+  std::uint32_t supercompressionScheme{};
+  std::uint32_t dfdByteOffset{};
+  std::uint32_t dfdByteLength{};
+  std::uint32_t kvdByteOffset{};
+  std::uint32_t kvdByteLength{};
+  std::uint64_t sgdByteOffset{};
+  std::uint64_t sgdByteLength{};
+};
+static_assert(sizeof(KTX2Header) == 80, "Unexpected padding in KTX2 header");
+
+// Entry of the level index that follows the KTX2 header
+struct KTX2Level {
+  std::uint64_t byteOffset{};
+  std::uint64_t byteLength{};
+  std::uint64_t uncompressedByteLength{};
+};
+static_assert(sizeof(KTX2Level) == 24, "Unexpected padding in KTX2 level");
+
+struct FormatMapping {
+  std::uint32_t code{};
+  abcg::CompressedFormat format{};
+  bool sRGB{};
+};
+
+// VkFormat values of the supported formats
+constexpr std::array<FormatMapping, 20> vkFormats{
+    {{131, abcg::CompressedFormat::BC1, false},
+     {132, abcg::CompressedFormat::BC1, true},
+     {133, abcg::CompressedFormat::BC1A, false},
+     {134, abcg::CompressedFormat::BC1A, true},
+     {135, abcg::CompressedFormat::BC2, false},
+     {136, abcg::CompressedFormat::BC2, true},
+     {137, abcg::CompressedFormat::BC3, false},
+     {138, abcg::CompressedFormat::BC3, true},
+     {139, abcg::CompressedFormat::BC4, false},
+     {141, abcg::CompressedFormat::BC5, false},
+     {145, abcg::CompressedFormat::BC7, false},
+     {146, abcg::CompressedFormat::BC7, true},
+     {147, abcg::CompressedFormat::ETC2RGB, false},
+     {148, abcg::CompressedFormat::ETC2RGB, true},
+     {149, abcg::CompressedFormat::ETC2RGBA1, false},
+     {150, abcg::CompressedFormat::ETC2RGBA1, true},
+     {151, abcg::CompressedFormat::ETC2RGBA, false},
+     {152, abcg::CompressedFormat::ETC2RGBA, true},
+     {153, abcg::CompressedFormat::EACR11, false},
+     {155, abcg::CompressedFormat::EACRG11, false}}};
+
+// DXGI_FORMAT values of the supported formats
+constexpr std::array<FormatMapping, 10> dxgiFormats{
+    {{71, abcg::CompressedFormat::BC1A, false},
+     {72, abcg::CompressedFormat::BC1A, true},
+     {74, abcg::CompressedFormat::BC2, false},
+     {75, abcg::CompressedFormat::BC2, true},
+     {77, abcg::CompressedFormat::BC3, false},
+     {78, abcg::CompressedFormat::BC3, true},
+     {80, abcg::CompressedFormat::BC4, false},
+     {83, abcg::CompressedFormat::BC5, false},
+     {98, abcg::CompressedFormat::BC7, false},
+     {99, abcg::CompressedFormat::BC7, true}}};
+
+const FormatMapping* findFormat(gsl::span<const FormatMapping> mappings,
+                                std::uint32_t code) {
+  const auto mapping{std::find_if(
+      mappings.begin(), mappings.end(),
+      [code](const FormatMapping& entry) { return entry.code == code; })};
+  return mapping == mappings.end() ? nullptr : &*mapping;
+}
+
+struct DDSHeader {
+  std::array<char, 4> magic{};
+  std::uint32_t size{};
+  std::uint32_t flags{};
+  std::uint32_t height{};
+  std::uint32_t width{};
+  std::uint32_t pitchOrLinearSize{};
+  std::uint32_t depth{};
+  std::uint32_t mipMapCount{};
+  std::array<std::uint32_t, 11> reserved1{};
+  std::uint32_t pixelFormatSize{};
+  std::uint32_t pixelFormatFlags{};
+  std::array<char, 4> fourCC{};
+  std::uint32_t rgbBitCount{};
+  std::array<std::uint32_t, 4> masks{};
+  std::uint32_t caps{};
+  std::uint32_t caps2{};
+  std::uint32_t caps3{};
+  std::uint32_t caps4{};
+  std::uint32_t reserved2{};
+};
+static_assert(sizeof(DDSHeader) == 128, "Unexpected padding in DDS header");
+
+// Extended header that follows the DDS header when the FourCC is "DX10"
+struct DDSHeaderDX10 {
+  std::uint32_t dxgiFormat{};
+  std::uint32_t resourceDimension{};
+  std::uint32_t miscFlag{};
+  std::uint32_t arraySize{};
+  std::uint32_t miscFlags2{};
+};
+static_assert(sizeof(DDSHeaderDX10) == 20,
+              "Unexpected padding in DDS DX10 header");
+
+constexpr std::array<char, 4> ddsMagic{'D', 'D', 'S', ' '};
+constexpr std::uint32_t ddsMipMapCountFlag{0x20000};
+constexpr std::uint32_t ddsFourCCFlag{0x4};
+constexpr std::uint32_t ddsCubemapFlag{0x200};
+constexpr std::uint32_t ddsVolumeFlag{0x200000};
+constexpr std::uint32_t dxgiTexture2D{3};
+constexpr std::uint32_t dxgiTextureCubeFlag{0x4};
+
+// Number of levels of a complete mipmap chain
+std::size_t countLevels(std::uint32_t width, std::uint32_t height) {
+  std::size_t count{1};
+  while (width > 1 || height > 1) {
+    width = std::max(width / 2, 1U);
+    height = std::max(height / 2, 1U);
+    ++count;
+  }
+  return count;
+}
+
+std::size_t computeLevelSize(abcg::CompressedFormat format, int width,
+                             int height) {
+  const auto blocksX{static_cast<std::size_t>(width + 3) / 4};
+  const auto blocksY{static_cast<std::size_t>(height + 3) / 4};
+  return blocksX * blocksY * abcg::CompressedImage::getBlockSize(format);
+}
+
+[[noreturn]] void throwUnsupported(std::string_view path) {
+  throw abcg::Exception{abcg::Exception::Runtime(
+      fmt::format("Unsupported texture file {}", path))};
+}
+
+[[noreturn]] void throwInvalid(std::string_view path) {
+  throw abcg::Exception{
+      abcg::Exception::Runtime(fmt::format("Invalid texture file {}", path))};
+}
+}  // namespace
+
+/**
+ * @brief Constructs an object and loads a KTX2 or DDS file.
+ *
+ * @param path Path to the file.
+ *
+ * @throw abcg::Exception if the file cannot be opened, is invalid or holds
+ * an unsupported texture.
+ */
+abcg::CompressedImage::CompressedImage(std::string_view path) { load(path); }
+
+/**
+ * @brief Returns whether a file is loaded by abcg::CompressedImage, based on
+ * its extension (`.ktx2` or `.dds`, in any case).
+ *
+ * @param path Path to the file.
+ * @return true if the file is a KTX2 or DDS file.
+ */
+bool abcg::CompressedImage::isCompressedImage(std::string_view path) {
+  auto extension{std::filesystem::path{path}.extension().string()};
+  std::transform(extension.begin(), extension.end(), extension.begin(),
+                 [](unsigned char character) {
+                   return static_cast<char>(std::tolower(character));
+                 });
+  return extension == ".ktx2" || extension == ".dds";
+}
+
+/**
+ * @brief Returns the size of a 4x4 block of a compressed format.
+ *
+ * @param format Compressed format.
+ * @return Block size, in bytes.
+ */
+std::size_t abcg::CompressedImage::getBlockSize(
+    CompressedFormat format) noexcept {
+  switch (format) {
+    case CompressedFormat::BC1:
+    case CompressedFormat::BC1A:
+    case CompressedFormat::BC4:
+    case CompressedFormat::ETC2RGB:
+    case CompressedFormat::ETC2RGBA1:
+    case CompressedFormat::EACR11:
+      return 8;
+    default:
+      return 16;
+  }
+}
+
+/**
+ * @brief Maps a KTX2 or DDS file into memory and reads its header.
+ *
+ * Only 2D textures without supercompression are supported: cube maps, array
+ * and volume textures, and KTX2 files compressed with Basis Universal or
+ * Zstandard are rejected.
+ *
+ * @param path Path to the file.
+ *
+ * @throw abcg::Exception if the file cannot be opened, is invalid or holds
+ * an unsupported texture.
+ */
+void abcg::CompressedImage::load(std::string_view path) {
+  close();
+
+  try {
+    m_file.open(path);
+  } catch (const abcg::Exception&) {
+    throw abcg::Exception{abcg::Exception::Runtime(
+        fmt::format("Failed to open texture file {}", path))};
+  }
+
+  try {
+    const auto data{m_file.getData()};
+    if (data.size() >= ktx2Identifier.size() &&
+        std::memcmp(data.data(), ktx2Identifier.data(),
+                    ktx2Identifier.size()) == 0) {
+      parseKTX2(path);
+    } else if (data.size() >= ddsMagic.size() &&
+               std::memcmp(data.data(), ddsMagic.data(), ddsMagic.size()) ==
+                   0) {
+      parseDDS(path);
+    } else {
+      throwUnsupported(path);
+    }
+  } catch (...) {
+    close();
+    throw;
+  }
+}
+
+/**
+ * @brief Unmaps the file and releases the levels.
+ */
+void abcg::CompressedImage::close() noexcept {
+  m_levels.clear();
+  m_file.close();
+}
+
+/**
+ * @brief Decodes a level into 8-bit RGBA texels.
+ *
+ * Used when the OpenGL context does not support the compressed format. The
+ * blocks are decoded on the default thread pool. Formats with fewer
+ * channels are expanded as OpenGL does when sampling them: missing color
+ * channels are 0 and a missing alpha channel is 255. sRGB-encoded colors are
+ * not converted.
+ *
+ * @param level Index of the level, 0 being the base level.
+ * @return Decoded image, with the rows in the order they are stored.
+ *
+ * @throw abcg::Exception if the level does not exist.
+ */
+abcg::Image abcg::CompressedImage::decode(std::size_t level) const {
+  if (level >= m_levels.size()) {
+    throw abcg::Exception{abcg::Exception::Runtime(
+        fmt::format("Invalid mipmap level {}", level))};
+  }
+
+  const auto& source{m_levels.at(level)};
+  const auto width{static_cast<std::size_t>(source.width)};
+  const auto height{static_cast<std::size_t>(source.height)};
+  Image image{.width = source.width,
+              .height = source.height,
+              .channels = 4,
+              .pixels = std::vector<std::byte>(width * height * 4)};
+
+  const auto blocksX{(width + 3) / 4};
+  const auto blocksY{(height + 3) / 4};
+  const auto blockSize{getBlockSize(m_format)};
+  const auto rowsPerTask{std::max<std::size_t>(texelsPerTask / 16 / blocksX,
+                                               1)};
+  const auto taskCount{(blocksY + rowsPerTask - 1) / rowsPerTask};
+
+  ThreadPool::getDefault().parallelFor(taskCount, [&](std::size_t task) {
+    const auto* blocks{reinterpret_cast<const std::uint8_t*>(
+        source.data.data())};
+    const auto lastRow{std::min((task + 1) * rowsPerTask, blocksY)};
+    Block texels{};
+    for (auto blockY{task * rowsPerTask}; blockY < lastRow; ++blockY) {
+      for (std::size_t blockX{}; blockX < blocksX; ++blockX) {
+        decodeBlock(m_format, blocks + (blockY * blocksX + blockX) * blockSize,
+                    texels);
+
+        // Blocks on the right and top edges may be partially used
+        const auto columns{std::min<std::size_t>(width - blockX * 4, 4)};
+        const auto rows{std::min<std::size_t>(height - blockY * 4, 4)};
+        for (std::size_t row{}; row < rows; ++row) {
+          std::memcpy(image.pixels.data() +
+                          ((blockY * 4 + row) * width + blockX * 4) * 4,
+                      texels.data() + row * 16, columns * 4);
+        }
+      }
+    }
+  });
+
+  return image;
+}
+
+void abcg::CompressedImage::parseKTX2(std::string_view path) {
+  const auto data{m_file.getData()};
+  KTX2Header header{};
+  if (data.size() < sizeof(header)) throwInvalid(path);
+  std::memcpy(&header, data.data(), sizeof(header));
+
+  if (header.supercompressionScheme != 0 || header.pixelDepth > 1 ||
+      header.layerCount > 1 || header.faceCount != 1) {
+    throwUnsupported(path);
+  }
+  const auto* mapping{findFormat(vkFormats, header.vkFormat)};
+  if (mapping == nullptr) throwUnsupported(path);
+  m_format = mapping->format;
+  m_sRGB = mapping->sRGB;
+
+  // A level count of 0 asks the loader to generate the mipmap levels
+  const auto levelCount{std::max<std::size_t>(header.levelCount, 1)};
+  if (header.pixelWidth == 0 || header.pixelHeight == 0 ||
+      header.pixelWidth > maxDimension || header.pixelHeight > maxDimension ||
+      levelCount > countLevels(header.pixelWidth, header.pixelHeight) ||
+      data.size() < sizeof(header) + levelCount * sizeof(KTX2Level)) {
+    throwInvalid(path);
+  }
+
+  for (std::size_t index{}; index < levelCount; ++index) {
+    KTX2Level level{};
+    std::memcpy(&level,
+                data.data() + sizeof(header) + index * sizeof(KTX2Level),
+                sizeof(level));
+    const auto width{std::max(header.pixelWidth >> index, 1U)};
+    const auto height{std::max(header.pixelHeight >> index, 1U)};
+    if (level.byteOffset > data.size()) throwInvalid(path);
+    addLevel(path, level.byteOffset, level.byteLength,
+             static_cast<int>(width), static_cast<int>(height));
+  }
+}
+
+void abcg::CompressedImage::parseDDS(std::string_view path) {
+  const auto data{m_file.getData()};
+  DDSHeader header{};
+  if (data.size() < sizeof(header)) throwInvalid(path);
+  std::memcpy(&header, data.data(), sizeof(header));
+  if (header.size != sizeof(header) - ddsMagic.size()) throwInvalid(path);
+
+  if ((header.pixelFormatFlags & ddsFourCCFlag) == 0 ||
+      (header.caps2 & (ddsCubemapFlag | ddsVolumeFlag)) != 0) {
+    throwUnsupported(path);
+  }
+
+  auto offset{sizeof(header)};
+  const FormatMapping* mapping{};
+  if (const std::string_view fourCC{header.fourCC.data(),
+                                    header.fourCC.size()};
+      fourCC == "DX10") {
+    DDSHeaderDX10 extension{};
+    if (data.size() < offset + sizeof(extension)) throwInvalid(path);
+    std::memcpy(&extension, data.data() + offset, sizeof(extension));
+    offset += sizeof(extension);
+    if (extension.resourceDimension != dxgiTexture2D ||
+        extension.arraySize > 1 ||
+        (extension.miscFlag & dxgiTextureCubeFlag) != 0) {
+      throwUnsupported(path);
+    }
+    mapping = findFormat(dxgiFormats, extension.dxgiFormat);
+  } else {
+    // Legacy FourCC codes. DXT2 and DXT4 hold premultiplied alpha, which is
+    // decoded the same way
+    static constexpr std::array<std::pair<std::string_view, FormatMapping>, 8>
+        fourCCs{{{"DXT1", {0, CompressedFormat::BC1A, false}},
+                 {"DXT2", {0, CompressedFormat::BC2, false}},
+                 {"DXT3", {0, CompressedFormat::BC2, false}},
+                 {"DXT4", {0, CompressedFormat::BC3, false}},
+                 {"DXT5", {0, CompressedFormat::BC3, false}},
+                 {"ATI1", {0, CompressedFormat::BC4, false}},
+                 {"BC4U", {0, CompressedFormat::BC4, false}},
+                 {"ATI2", {0, CompressedFormat::BC5, false}}}};
+    const auto* entry{std::find_if(
+        fourCCs.begin(), fourCCs.end(),
+        [fourCC](const auto& candidate) { return candidate.first == fourCC; })};
+    if (entry != fourCCs.end()) mapping = &entry->second;
+  }
+  if (mapping == nullptr) throwUnsupported(path);
+  m_format = mapping->format;
+  m_sRGB = mapping->sRGB;
+
+  if (header.width == 0 || header.height == 0 ||
+      header.width > maxDimension || header.height > maxDimension) {
+    throwInvalid(path);
+  }
+  const auto levelCount{
+      (header.flags & ddsMipMapCountFlag) != 0 && header.mipMapCount > 0
+          ? std::min<std::size_t>(header.mipMapCount,
+                                  countLevels(header.width, header.height))
+          : std::size_t{1}};
+
+  // Levels are stored one after the other, from the base level
+  for (std::size_t index{}; index < levelCount; ++index) {
+    const auto width{static_cast<int>(std::max(header.width >> index, 1U))};
+    const auto height{static_cast<int>(std::max(header.height >> index, 1U))};
+    const auto size{computeLevelSize(m_format, width, height)};
+    addLevel(path, offset, size, width, height);
+    offset += size;
+  }
+}
+
+// Appends a level after checking that it lies within the file and has the
+// size expected for its dimensions
+void abcg::CompressedImage::addLevel(std::string_view path,
+                                     std::size_t offset, std::size_t size,
+                                     int width, int height) {
+  const auto data{m_file.getData()};
+  if (size != computeLevelSize(m_format, width, height) ||
+      offset > data.size() || size > data.size() - offset) {
+    throwInvalid(path);
+  }
+  m_levels.push_back({.width = width,
+                      .height = height,
+                      .data = data.subspan(offset, size)});
+}
@@ -0,0 +1,128 @@
+/**
+ * @file abcg_compressedimage.hpp
+ * @brief abcg::CompressedImage header file.
+ *
+ * Declaration of abcg::CompressedImage class, a reader of KTX2 and DDS files
+ * holding block-compressed textures.
+ *
+ * This project is released under the MIT License.
+ */
+
+#ifndef ABCG_COMPRESSEDIMAGE_HPP_
+#define ABCG_COMPRESSEDIMAGE_HPP_
+
+#include <cstddef>
+#include <gsl/gsl>
+#include <string_view>
+#include <vector>
+
+#include "abcg_image.hpp"
+#include "abcg_mappedfile.hpp"
+
+namespace abcg {
+class CompressedImage;
+struct CompressedImageLevel;
+
+/**
+ * @brief Block compression format of an abcg::CompressedImage.
+ *
+ * Every format encodes blocks of 4x4 texels.
+ */
+enum class CompressedFormat {
+  /** @brief BC1 (DXT1) RGB, 8 bytes per block. */
+  BC1,
+  /** @brief BC1 (DXT1) RGB with 1-bit alpha, 8 bytes per block. */
+  BC1A,
+  /** @brief BC2 (DXT3) RGBA with 4-bit alpha, 16 bytes per block. */
+  BC2,
+  /** @brief BC3 (DXT5) RGBA, 16 bytes per block. */
+  BC3,
+  /** @brief BC4 (RGTC1) single channel, 8 bytes per block. */
+  BC4,
+  /** @brief BC5 (RGTC2) two channels, 16 bytes per block. */
+  BC5,
+  /** @brief BC7 (BPTC) RGBA, 16 bytes per block. */
+  BC7,
+  /** @brief ETC2 RGB, 8 bytes per block. Also decodes ETC1. */
+  ETC2RGB,
+  /** @brief ETC2 RGB with 1-bit alpha, 8 bytes per block. */
+  ETC2RGBA1,
+  /** @brief ETC2 RGB with EAC alpha, 16 bytes per block. */
+  ETC2RGBA,
+  /** @brief EAC single channel, 8 bytes per block. */
+  EACR11,
+  /** @brief EAC two channels, 16 bytes per block. */
+  EACRG11
+};
+}  // namespace abcg
+
+/**
+ * @brief Mipmap level stored in a compressed image.
+ *
+ * Blocks are stored row by row, in the order they are uploaded with
+ * glCompressedTexImage2D.
+ */
+struct abcg::CompressedImageLevel {
+  int width{};
+  int height{};
+  gsl::span<const std::byte> data{};
+};
+
+/**
+ * @brief abcg::CompressedImage class.
+ *
+ * Reads 2D textures stored in KTX2 or DDS files without supercompression,
+ * together with their mipmap levels. The levels are not copied: they point
+ * into the file, which stays mapped while the object is alive.
+ *
+ * The first row of blocks is uploaded as the bottom row of the texture, as
+ * with any data given to OpenGL. Files must therefore be exported with the
+ * origin at the lower left corner (e.g. with `toktx
+ * --lower_left_maps_to_s0t0` or `texconv -vflip`) to match the textures
+ * loaded from PNG or JPEG files.
+ */
+class abcg::CompressedImage {
+ public:
+  CompressedImage() = default;
+  explicit CompressedImage(std::string_view path);
+
+  [[nodiscard]] static bool isCompressedImage(std::string_view path);
+  [[nodiscard]] static std::size_t getBlockSize(
+      CompressedFormat format) noexcept;
+
+  void load(std::string_view path);
+  void close() noexcept;
+
+  [[nodiscard]] Image decode(std::size_t level) const;
+
+  [[nodiscard]] CompressedFormat getFormat() const noexcept {
+    return m_format;
+  }
+  /**
+   * @brief Returns whether the color channels are sRGB-encoded.
+   */
+  [[nodiscard]] bool isSRGB() const noexcept { return m_sRGB; }
+  /**
+   * @brief Returns the stored levels, from the base level to the smallest.
+   *
+   * Either the base level only, or a mipmap chain that may stop before 1x1.
+   */
+  [[nodiscard]] const std::vector<CompressedImageLevel>& getLevels()
+      const noexcept {
+    return m_levels;
+  }
+
+ private:
+  void parseKTX2(std::string_view path);
+  void parseDDS(std::string_view path);
+  void addLevel(std::string_view path, std::size_t offset, std::size_t size,
+                int width, int height);
+
+  MappedFile m_file;
+
+  CompressedFormat m_format{};
+  bool m_sRGB{};
+  std::vector<CompressedImageLevel> m_levels;
+};
+
+#endif
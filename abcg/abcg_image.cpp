@@ -9,153 +9,1141 @@
 
 #include <fmt/core.h>
 
+#include <algorithm>
+#include <array>
+#include <cmath>
 #include <cppitertools/itertools.hpp>
-#include <fstream>
-#include <gsl/gsl>
+#include <cstring>
+#include <glm/vec2.hpp>
+#include <memory>
+#include <numbers>
+#include <string_view>
 #include <vector>
 
 #include "SDL_image.h"
+#include "abcg_compressedimage.hpp"
 #include "abcg_exception.hpp"
 #include "abcg_external.hpp"
+#include "abcg_imageops.hpp"
+#include "abcg_mappedfile.hpp"
+#include "abcg_texturecache.hpp"
+#include "abcg_threadpool.hpp"
 
-void flipY(gsl::not_null<SDL_Surface*> surface) {
-  auto width{static_cast<size_t>(surface->w * surface->format->BytesPerPixel)};
-  auto height{static_cast<size_t>(surface->h)};
-  gsl::span pixels{static_cast<std::byte*>(surface->pixels), width * height};
+namespace {
+struct SurfaceDeleter {
+  void operator()(SDL_Surface* surface) const noexcept {
+    SDL_FreeSurface(surface);
+  }
+};
+using SurfacePtr = std::unique_ptr<SDL_Surface, SurfaceDeleter>;
 
-  // Row of pixels for the swap
-  std::vector<std::byte> row(width, std::byte{});
+// Reads the whole file with a single read (or maps it) and decodes it from
+// memory, instead of letting SDL_image read the file in small chunks
+SurfacePtr loadSurface(std::string_view path) {
+  abcg::MappedFile file;
+  try {
+    file.open(path);
+  } catch (const abcg::Exception&) {
+    throw abcg::Exception{abcg::Exception::Runtime(
+        fmt::format("Failed to open texture file {}", path))};
+  }
+
+  const auto data{file.getData()};
+  SurfacePtr surface{
+      IMG_Load_RW(SDL_RWFromConstMem(data.data(),
+                                     static_cast<int>(data.size())),
+                  1)};
+  if (!surface) {
+    throw abcg::Exception{abcg::Exception::Runtime(
+        fmt::format("Failed to load texture file {}", path))};
+  }
 
-  // If height is odd, don't need to swap middle row
-  size_t height_div_2{height / 2};
-  for (size_t index = 0; index < height_div_2; index++) {
-    auto offsetFromTop{width * index};
-    auto offsetFromBottom{width * (height - index - 1)};
-    memcpy(row.data(), pixels.subspan(offsetFromTop).data(), width);
-    memcpy(pixels.subspan(offsetFromTop).data(),
-           pixels.subspan(offsetFromBottom).data(), width);
-    memcpy(pixels.subspan(offsetFromBottom).data(), row.data(), width);
+  // Decoders output 8-bit RGB or RGBA in byte order for most files. Other
+  // formats (e.g. palettized images) are converted
+  const auto format{surface->format->format};
+  if (format != SDL_PIXELFORMAT_RGB24 && format != SDL_PIXELFORMAT_RGBA32) {
+    surface.reset(SDL_ConvertSurfaceFormat(surface.get(),
+                                           surface->format->BytesPerPixel == 3
+                                               ? SDL_PIXELFORMAT_RGB24
+                                               : SDL_PIXELFORMAT_RGBA32,
+                                           0));
+    if (!surface) {
+      throw abcg::Exception{abcg::Exception::Runtime(
+          fmt::format("Failed to convert texture file {}", path))};
+    }
   }
+  return surface;
 }
 
-GLuint abcg::opengl::loadTexture(std::string_view path, bool generateMipmaps) {
-  GLuint textureID{};
+int getChannels(const SDL_Surface& surface) {
+  return surface.format->format == SDL_PIXELFORMAT_RGB24 ? 3 : 4;
+}
+
+// Reverses the order of the rows in place
+void flipRows(SDL_Surface& surface) {
+  abcg::image::flipVertically(
+      {static_cast<std::byte*>(surface.pixels),
+       static_cast<std::size_t>(surface.h) *
+           static_cast<std::size_t>(surface.pitch)},
+      static_cast<std::size_t>(surface.pitch));
+}
+
+// Uploads the pixels of a surface without copying them first. Returns false
+// if the row padding cannot be described with GL_UNPACK_ALIGNMENT
+bool uploadSurface(GLenum target, const SDL_Surface& surface) {
+  const auto channels{getChannels(surface)};
+  const auto rowSize{surface.w * channels};
+  for (const auto alignment : {1, 2, 4, 8}) {
+    if ((rowSize + alignment - 1) / alignment * alignment != surface.pitch) {
+      continue;
+    }
+    const GLenum format{channels == 3 ? GLenum{GL_RGB} : GLenum{GL_RGBA}};
+    glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+    glTexImage2D(target, 0, static_cast<GLint>(format), surface.w, surface.h,
+                 0, format, GL_UNSIGNED_BYTE, surface.pixels);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    return true;
+  }
+  return false;
+}
+
+// Copies the rows of a surface bottom to top, dropping the padding at the end
+// of each row
+abcg::Image copySurface(const SDL_Surface& surface) {
+  abcg::Image image{.width = surface.w,
+                    .height = surface.h,
+                    .channels = getChannels(surface),
+                    .pixels = {}};
+  const auto rowSize{static_cast<std::size_t>(image.width * image.channels)};
+  const auto height{static_cast<std::size_t>(image.height)};
+  const auto pitch{static_cast<std::size_t>(surface.pitch)};
+  image.pixels.resize(rowSize * height);
+  const auto* source{static_cast<const std::byte*>(surface.pixels)};
+  for (std::size_t row{}; row < height; ++row) {
+    std::memcpy(image.pixels.data() + row * rowSize,
+                source + (height - row - 1) * pitch, rowSize);
+  }
+  return image;
+}
+
+// Sets the filtering and wrapping parameters of the bound texture, and
+// generates its mipmap levels if required
+void setTextureParameters(GLenum target, GLint wrap, bool generateMipmaps,
+                          bool hasMipmaps) {
+  // Set texture filtering
+  glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+  // Generate the mipmap levels
+  if (generateMipmaps) {
+    if (!hasMipmaps) glGenerateMipmap(target);
+
+    // Override minifying filtering
+    glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+  }
+
+  // Set texture wrapping
+  glTexParameteri(target, GL_TEXTURE_WRAP_S, wrap);
+  glTexParameteri(target, GL_TEXTURE_WRAP_T, wrap);
+  if (target == GL_TEXTURE_CUBE_MAP) {
+    glTexParameteri(target, GL_TEXTURE_WRAP_R, wrap);
+  }
+}
+
+// Number of destination pixels computed by each task of the mipmap
+// generation
+constexpr std::size_t blockSize{65536};
+
+// Computes one mipmap level with the 2x2 box filter, in blocks of rows
+void downsampleBox(const abcg::Image& source, abcg::Image& level,
+                   abcg::ThreadPool& threadPool) {
+  const auto channels{static_cast<std::size_t>(source.channels)};
+  const auto width{static_cast<std::size_t>(level.width)};
+  const auto height{static_cast<std::size_t>(level.height)};
+  if (source.height < 2) {
+    abcg::image::downsample(source.pixels, source.width, source.height,
+                            source.channels, level.pixels);
+    return;
+  }
+
+  // Rows y0 to y1 - 1 of the level only depend on rows 2 * y0 to 2 * y1 - 1
+  // of the source level, which form a smaller image on their own
+  const auto sourcePitch{static_cast<std::size_t>(source.width) * channels};
+  const auto pitch{width * channels};
+  const auto rowsPerBlock{std::max<std::size_t>(blockSize / width, 1)};
+  const auto numBlocks{(height + rowsPerBlock - 1) / rowsPerBlock};
+  threadPool.parallelFor(numBlocks, [&](std::size_t block) {
+    const auto firstRow{block * rowsPerBlock};
+    const auto numRows{std::min(rowsPerBlock, height - firstRow)};
+    abcg::image::downsample(
+        gsl::span{source.pixels}.subspan(2 * firstRow * sourcePitch,
+                                         2 * numRows * sourcePitch),
+        source.width, static_cast<int>(2 * numRows), source.channels,
+        gsl::span{level.pixels}.subspan(firstRow * pitch, numRows * pitch));
+  });
+}
+
+// Radius, in destination pixels, of the windowed sinc filters
+constexpr double filterRadius{3.0};
+
+double sinc(double x) {
+  if (std::abs(x) < 1e-8) return 1.0;
+  const auto angle{std::numbers::pi * x};
+  return std::sin(angle) / angle;
+}
+
+// Modified Bessel function of the first kind and order 0
+double besselI0(double x) {
+  auto sum{1.0};
+  auto term{1.0};
+  for (auto k{1.0}; term > sum * 1e-12; k += 1.0) {
+    term *= (x / (2.0 * k)) * (x / (2.0 * k));
+    sum += term;
+  }
+  return sum;
+}
+
+// Filter weight at a distance of x destination pixels
+double evaluateFilter(abcg::MipmapFilter filter, double x) {
+  if (std::abs(x) >= filterRadius) return 0.0;
+  const auto window{x / filterRadius};
+  if (filter == abcg::MipmapFilter::Kaiser) {
+    constexpr auto alpha{4.0};
+    return sinc(x) *
+           besselI0(alpha * std::sqrt(1.0 - window * window)) /
+           besselI0(alpha);
+  }
+  return sinc(x) * sinc(window);
+}
+
+// Source pixels and normalized weights of each destination pixel along one
+// axis. Every destination pixel has the same number of taps, and source
+// pixels past the edges are clamped
+struct FilterTaps {
+  std::size_t count{};
+  std::vector<std::size_t> indices;
+  std::vector<float> weights;
+};
+
+FilterTaps computeFilterTaps(abcg::MipmapFilter filter,
+                             std::size_t sourceSize, std::size_t size) {
+  const auto scale{static_cast<double>(sourceSize) /
+                   static_cast<double>(size)};
+  const auto support{filterRadius * scale};
+  FilterTaps taps{
+      .count = static_cast<std::size_t>(std::ceil(2.0 * support)) + 1,
+      .indices = {},
+      .weights = {}};
+  taps.indices.resize(size * taps.count);
+  taps.weights.resize(size * taps.count);
+
+  const auto lastSource{static_cast<double>(sourceSize - 1)};
+  for (std::size_t pixel{}; pixel < size; ++pixel) {
+    const auto center{(static_cast<double>(pixel) + 0.5) * scale};
+    const auto first{std::floor(center - support)};
+    std::vector<double> weights(taps.count);
+    auto sum{0.0};
+    for (std::size_t tap{}; tap < taps.count; ++tap) {
+      const auto source{first + static_cast<double>(tap)};
+      weights[tap] = evaluateFilter(filter, (source + 0.5 - center) / scale);
+      sum += weights[tap];
+      taps.indices[pixel * taps.count + tap] =
+          static_cast<std::size_t>(std::clamp(source, 0.0, lastSource));
+    }
+    for (std::size_t tap{}; tap < taps.count; ++tap) {
+      taps.weights[pixel * taps.count + tap] =
+          static_cast<float>(weights[tap] / sum);
+    }
+  }
+  return taps;
+}
+
+// Filters a row of pixels, converted to floating point, horizontally. RGB
+// pixels are filtered as RGBA, so that each tap is a single vector operation.
+// The input row must therefore hold one more value past its last pixel
+template <std::size_t Channels>
+void filterRow(const float* input, float* output, const FilterTaps& columns,
+               std::size_t width) {
+  constexpr std::size_t lanes{Channels == 3 ? 4 : Channels};
+  const auto* indices{columns.indices.data()};
+  const auto* weights{columns.weights.data()};
+  for (std::size_t x{}; x < width; ++x, output += Channels) {
+    std::array<float, lanes> sum{};
+    for (std::size_t tap{}; tap < columns.count; ++tap) {
+      const auto* pixel{input + *indices++ * Channels};
+      const auto weight{*weights++};
+      for (std::size_t lane{}; lane < lanes; ++lane) {
+        sum[lane] += weight * pixel[lane];
+      }
+    }
+    std::copy_n(sum.begin(), Channels, output);
+  }
+}
+
+// Computes one mipmap level with a separable windowed sinc filter. Each
+// block of rows filters the source rows it needs horizontally, then
+// vertically. Values are clamped, as the filters have negative lobes
+void downsampleSinc(const abcg::Image& source, abcg::Image& level,
+                    abcg::MipmapFilter filter, abcg::ThreadPool& threadPool) {
+  const auto channels{static_cast<std::size_t>(source.channels)};
+  const auto sourceWidth{static_cast<std::size_t>(source.width)};
+  const auto width{static_cast<std::size_t>(level.width)};
+  const auto height{static_cast<std::size_t>(level.height)};
+  const auto columns{computeFilterTaps(filter, sourceWidth, width)};
+  const auto rows{computeFilterTaps(
+      filter, static_cast<std::size_t>(source.height), height)};
+
+  const auto pitch{width * channels};
+  const auto rowsPerBlock{std::max<std::size_t>(blockSize / width, 1)};
+  const auto numBlocks{(height + rowsPerBlock - 1) / rowsPerBlock};
+  threadPool.parallelFor(numBlocks, [&](std::size_t block) {
+    const auto firstRow{block * rowsPerBlock};
+    const auto lastRow{std::min(firstRow + rowsPerBlock, height)};
+    const auto [minSource, maxSource]{std::minmax_element(
+        rows.indices.begin() +
+            static_cast<std::ptrdiff_t>(firstRow * rows.count),
+        rows.indices.begin() +
+            static_cast<std::ptrdiff_t>(lastRow * rows.count))};
+    const auto firstSource{*minSource};
+    const auto numSources{*maxSource - firstSource + 1};
+
+    std::vector<float> filtered(numSources * pitch);
+    std::vector<float> sourceRow(sourceWidth * channels + 1);
+    for (std::size_t row{}; row < numSources; ++row) {
+      const auto* input{source.pixels.data() +
+                        (firstSource + row) * sourceWidth * channels};
+      std::transform(input, input + sourceWidth * channels, sourceRow.begin(),
+                     [](std::byte value) {
+                       return static_cast<float>(std::to_integer<int>(value));
+                     });
+      auto* output{filtered.data() + row * pitch};
+      switch (channels) {
+      case 1:
+        filterRow<1>(sourceRow.data(), output, columns, width);
+        break;
+      case 2:
+        filterRow<2>(sourceRow.data(), output, columns, width);
+        break;
+      case 3:
+        filterRow<3>(sourceRow.data(), output, columns, width);
+        break;
+      default:
+        filterRow<4>(sourceRow.data(), output, columns, width);
+      }
+    }
+
+    std::vector<float> sum(pitch);
+    for (auto y{firstRow}; y < lastRow; ++y) {
+      std::fill(sum.begin(), sum.end(), 0.0f);
+      for (std::size_t tap{}; tap < rows.count; ++tap) {
+        const auto weight{rows.weights[y * rows.count + tap]};
+        const auto* input{filtered.data() +
+                          (rows.indices[y * rows.count + tap] - firstSource) *
+                              pitch};
+        for (std::size_t index{}; index < pitch; ++index) {
+          sum[index] += weight * input[index];
+        }
+      }
+      auto* output{level.pixels.data() + y * pitch};
+      for (std::size_t index{}; index < pitch; ++index) {
+        output[index] = static_cast<std::byte>(
+            static_cast<int>(std::clamp(sum[index], 0.0f, 255.0f) + 0.5f));
+      }
+    }
+  });
+}
+
+// OpenGL internal format of each abcg::CompressedFormat. The values are those
+// of EXT_texture_compression_s3tc, ARB_texture_compression_rgtc,
+// ARB_texture_compression_bptc and OpenGL ES 3.0, which not every OpenGL
+// header defines
+constexpr std::array<GLenum, 12> compressedFormats{
+    0x83F0,   // BC1: GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+    0x83F1,   // BC1A: GL_COMPRESSED_RGBA_S3TC_DXT1_EXT
+    0x83F2,   // BC2: GL_COMPRESSED_RGBA_S3TC_DXT3_EXT
+    0x83F3,   // BC3: GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+    0x8DBB,   // BC4: GL_COMPRESSED_RED_RGTC1
+    0x8DBD,   // BC5: GL_COMPRESSED_RG_RGTC2
+    0x8E8C,   // BC7: GL_COMPRESSED_RGBA_BPTC_UNORM
+    0x9274,   // ETC2RGB: GL_COMPRESSED_RGB8_ETC2
+    0x9276,   // ETC2RGBA1: GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2
+    0x9278,   // ETC2RGBA: GL_COMPRESSED_RGBA8_ETC2_EAC
+    0x9270,   // EACR11: GL_COMPRESSED_R11_EAC
+    0x9272};  // EACRG11: GL_COMPRESSED_RG11_EAC
+
+// Families of compressed formats supported by the OpenGL context
+struct CompressionSupport {
+  bool s3tc{};
+  bool rgtc{};
+  bool bptc{};
+  bool etc2{};
+};
+
+CompressionSupport queryCompressionSupport() {
+  CompressionSupport support{};
+
+#if !defined(__EMSCRIPTEN__)
+  // Core formats. WebGL 2 exposes every family as an extension, even ETC2
+  GLint major{};
+  GLint minor{};
+  glGetIntegerv(GL_MAJOR_VERSION, &major);
+  glGetIntegerv(GL_MINOR_VERSION, &minor);
+  const auto version{major * 10 + minor};
+  support.rgtc = version >= 30;
+  support.bptc = version >= 42;
+  support.etc2 = version >= 43;
+#endif
+
+  GLint count{};
+  glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+  for (GLint index{}; index < count; ++index) {
+    const auto* string{glGetStringi(GL_EXTENSIONS, static_cast<GLuint>(index))};
+    if (string == nullptr) continue;
+    std::string_view name{reinterpret_cast<const char*>(string)};
+    if (name.starts_with("GL_")) name.remove_prefix(3);
 
-  // Copy file data into buffer
-  std::ifstream input(path.data(), std::ios::binary);
-  if (!input) {
+    if (name == "EXT_texture_compression_s3tc" ||
+        name == "WEBGL_compressed_texture_s3tc") {
+      support.s3tc = true;
+    } else if (name == "ARB_texture_compression_rgtc" ||
+               name == "EXT_texture_compression_rgtc") {
+      support.rgtc = true;
+    } else if (name == "ARB_texture_compression_bptc" ||
+               name == "EXT_texture_compression_bptc") {
+      support.bptc = true;
+    } else if (name == "ARB_ES3_compatibility" ||
+               name == "WEBGL_compressed_texture_etc") {
+      support.etc2 = true;
+    }
+  }
+  return support;
+}
+}  // namespace
+
+/**
+ * @brief Decodes an image file into an RGB or RGBA image.
+ *
+ * Only touches CPU memory, so it can be called from worker threads. If the
+ * image has been compiled by abcg-assetc with the box filter, its base level
+ * is read from the texture cache and the file is not decoded.
+ *
+ * The file is read once and decoded from memory. The decoded pixels are
+ * copied once, flipped, into the returned image. The base level of KTX2 and
+ * DDS files is decoded to RGBA with abcg::CompressedImage::decode, keeping
+ * the order of the rows.
+ *
+ * @param path Path to the image file.
+ * @return Decoded image, flipped vertically.
+ *
+ * @throw abcg::Exception if the file cannot be opened or decoded.
+ */
+abcg::Image abcg::decodeImage(std::string_view path) {
+  if (TextureCache cache;
+      cache.load(TextureCache::getCachePath(path),
+                 TextureCache::computeKey(
+                     path, static_cast<std::uint64_t>(MipmapFilter::Box)))) {
+    const auto& base{cache.getLevels().front()};
+    return {.width = base.width,
+            .height = base.height,
+            .channels = cache.getChannels(),
+            .pixels = {base.pixels.begin(), base.pixels.end()}};
+  }
+
+  if (CompressedImage::isCompressedImage(path)) {
+    return CompressedImage{path}.decode(0);
+  }
+
+  const auto surface{loadSurface(path)};
+  return copySurface(*surface);
+}
+
+/**
+ * @brief Generates the mipmap chain of an image using the default thread
+ * pool.
+ *
+ * @param image Base level.
+ * @param filter Filter used to compute each level from the previous one.
+ * @return Base level followed by each mipmap level, down to 1x1.
+ *
+ * @throw abcg::Exception if the image dimensions are invalid or the size of
+ * the pixel array does not match them.
+ */
+std::vector<abcg::Image> abcg::generateMipmaps(Image image,
+                                               MipmapFilter filter) {
+  return generateMipmaps(std::move(image), filter, ThreadPool::getDefault());
+}
+
+/**
+ * @brief Generates the mipmap chain of an image.
+ *
+ * Each level is computed from the previous one, in blocks of rows processed
+ * concurrently by the thread pool. With MipmapFilter::Box, each level is
+ * computed with abcg::image::downsample: odd rows and columns are clamped to
+ * the edge of the previous level, as in glGenerateMipmap. The windowed sinc
+ * filters give sharper levels with less aliasing, at a higher cost. They are
+ * applied to the stored values, which is also how the GPU filters textures
+ * that do not use an sRGB format.
+ *
+ * @param image Base level.
+ * @param filter Filter used to compute each level from the previous one.
+ * @param threadPool Thread pool used to process blocks of rows.
+ * @return Base level followed by each mipmap level, down to 1x1.
+ *
+ * @throw abcg::Exception if the image dimensions are invalid or the size of
+ * the pixel array does not match them.
+ */
+std::vector<abcg::Image> abcg::generateMipmaps(Image image,
+                                               MipmapFilter filter,
+                                               ThreadPool& threadPool) {
+  if (image.width < 1 || image.height < 1 || image.channels < 1 ||
+      image.channels > 4 ||
+      image.pixels.size() != static_cast<std::size_t>(image.width) *
+                                 static_cast<std::size_t>(image.height) *
+                                 static_cast<std::size_t>(image.channels)) {
     throw abcg::Exception{abcg::Exception::Runtime(
-        fmt::format("Failed to open texture file {}", path))};
+        fmt::format("Invalid {}x{} image with {} channels", image.width,
+                    image.height, image.channels))};
   }
-  std::vector<char> buffer((std::istreambuf_iterator<char>(input)),
-                           std::istreambuf_iterator<char>());
-
-  // Load the bitmap
-  if (SDL_Surface * surface{IMG_Load(path.data())}) {
-    // Enforce RGB/RGBA
-    GLenum format{0};
-    SDL_Surface* formattedSurface{nullptr};
-    if (surface->format->BytesPerPixel == 3) {
-      formattedSurface =
-          SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_RGB24, 0);
-      format = GL_RGB;
+
+  std::vector<Image> levels;
+  levels.push_back(std::move(image));
+  while (levels.back().width > 1 || levels.back().height > 1) {
+    const auto& source{levels.back()};
+    Image level{.width = std::max(source.width / 2, 1),
+                .height = std::max(source.height / 2, 1),
+                .channels = source.channels,
+                .pixels = {}};
+    level.pixels.resize(static_cast<std::size_t>(level.width) *
+                        static_cast<std::size_t>(level.height) *
+                        static_cast<std::size_t>(level.channels));
+    if (filter == MipmapFilter::Box) {
+      downsampleBox(source, level, threadPool);
     } else {
-      formattedSurface =
-          SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_RGBA32, 0);
-      format = GL_RGBA;
+      downsampleSinc(source, level, filter, threadPool);
     }
-    SDL_FreeSurface(surface);
-
-    // Flip horizontally
-    flipY(formattedSurface);
+    levels.push_back(std::move(level));
+  }
+  return levels;
+}
 
-    // Generate the texture
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_2D, textureID);
-    glTexImage2D(GL_TEXTURE_2D, 0, static_cast<GLint>(format),
-                 formattedSurface->w, formattedSurface->h, 0, format,
-                 GL_UNSIGNED_BYTE, formattedSurface->pixels);
+/**
+ * @brief Decodes an image file and generates its mipmap chain.
+ *
+ * Only touches CPU memory, so it can be called from worker threads. If the
+ * texture cache of the image holds a complete mipmap chain generated with
+ * the same filter, the chain is read from the cache and nothing is decoded
+ * or filtered.
+ *
+ * @param path Path to the image file.
+ * @param filter Filter used to compute each level from the previous one.
+ * @param persist Whether to store the generated chain in the texture cache
+ * of the image, so that later loads skip decoding and filtering. Failing to
+ * write the cache (e.g. in a read-only directory) is not an error.
+ * @return Base level followed by each mipmap level, down to 1x1.
+ *
+ * @throw abcg::Exception if the file cannot be opened or decoded.
+ */
+std::vector<abcg::Image> abcg::loadMipmaps(std::string_view path,
+                                           MipmapFilter filter,
+                                           bool persist) {
+  const auto cachePath{TextureCache::getCachePath(path)};
+  const auto key{
+      TextureCache::computeKey(path, static_cast<std::uint64_t>(filter))};
+  if (TextureCache cache;
+      cache.load(cachePath, key) && cache.getLevels().size() > 1) {
+    std::vector<Image> levels;
+    for (const auto& level : cache.getLevels()) {
+      levels.push_back({.width = level.width,
+                        .height = level.height,
+                        .channels = cache.getChannels(),
+                        .pixels = {level.pixels.begin(), level.pixels.end()}});
+    }
+    return levels;
+  }
 
-    SDL_FreeSurface(formattedSurface);
+  auto levels{generateMipmaps(decodeImage(path), filter)};
+  if (persist && key != 0) {
+    try {
+      TextureCache::store(cachePath, key, levels);
+    } catch (const abcg::Exception&) {
+      // The cache only saves time on later loads
+    }
+  }
+  return levels;
+}
 
-    // Set texture filtering
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+/**
+ * @brief Resizes an image with a bilinear filter.
+ *
+ * Images at least twice as large as the result are first halved with
+ * abcg::image::downsample, so that the bilinear filter does not skip texels.
+ * The filter wraps around the edges of the image, as with GL_REPEAT.
+ *
+ * @param image Image with 3 or 4 channels.
+ * @param width Width of the resized image.
+ * @param height Height of the resized image.
+ * @return Resized RGBA image.
+ *
+ * @throw abcg::Exception if the size of the pixel array does not match the
+ * image dimensions.
+ */
+abcg::Image abcg::resizeImage(const Image& image, int width, int height) {
+  Image source{.width = image.width,
+               .height = image.height,
+               .channels = 4,
+               .pixels = {}};
+  if (image.channels == 4) {
+    source.pixels = image.pixels;
+  } else {
+    source.pixels.resize(static_cast<std::size_t>(image.width) *
+                         static_cast<std::size_t>(image.height) * 4);
+    image::convertRGBToRGBA(image.pixels, source.pixels);
+  }
 
-    // Generate the mipmap levels
-    if (generateMipmaps) {
-      glGenerateMipmap(GL_TEXTURE_2D);
+  while (source.width >= width * 2 && source.height >= height * 2) {
+    Image half{.width = source.width / 2,
+               .height = source.height / 2,
+               .channels = 4,
+               .pixels = {}};
+    half.pixels.resize(static_cast<std::size_t>(half.width) *
+                       static_cast<std::size_t>(half.height) * 4);
+    image::downsample(source.pixels, source.width, source.height, 4,
+                      half.pixels);
+    source = std::move(half);
+  }
+  if (source.width == width && source.height == height) return source;
 
-      // Override minifying filtering
-      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
-                      GL_LINEAR_MIPMAP_LINEAR);
+  // Bilinear filter between texel centers, wrapped at the edges
+  Image resized{.width = width,
+              .height = height,
+              .channels = 4,
+              .pixels = std::vector<std::byte>(
+                  static_cast<std::size_t>(width) *
+                  static_cast<std::size_t>(height) * 4)};
+  const auto texel{[&](int x, int y, int channel) {
+    x = (x % source.width + source.width) % source.width;
+    y = (y % source.height + source.height) % source.height;
+    return static_cast<float>(
+        source.pixels[(static_cast<std::size_t>(y) *
+                           static_cast<std::size_t>(source.width) +
+                       static_cast<std::size_t>(x)) *
+                          4 +
+                      static_cast<std::size_t>(channel)]);
+  }};
+  const glm::vec2 ratio{static_cast<float>(source.width) /
+                            static_cast<float>(width),
+                        static_cast<float>(source.height) /
+                            static_cast<float>(height)};
+  auto* destination{resized.pixels.data()};
+  for (const auto y : iter::range(height)) {
+    const auto sourceY{(static_cast<float>(y) + 0.5f) * ratio.y - 0.5f};
+    const auto y0{static_cast<int>(std::floor(sourceY))};
+    const auto fy{sourceY - static_cast<float>(y0)};
+    for (const auto x : iter::range(width)) {
+      const auto sourceX{(static_cast<float>(x) + 0.5f) * ratio.x - 0.5f};
+      const auto x0{static_cast<int>(std::floor(sourceX))};
+      const auto fx{sourceX - static_cast<float>(x0)};
+      for (const auto channel : iter::range(4)) {
+        const auto bottom{texel(x0, y0, channel) * (1.0f - fx) +
+                          texel(x0 + 1, y0, channel) * fx};
+        const auto top{texel(x0, y0 + 1, channel) * (1.0f - fx) +
+                       texel(x0 + 1, y0 + 1, channel) * fx};
+        *destination++ = static_cast<std::byte>(
+            std::lround(bottom * (1.0f - fy) + top * fy));
+      }
     }
+  }
+  return resized;
+}
+
+/**
+ * @brief Creates a 2D texture from a decoded image.
+ *
+ * @param image Image returned by abcg::decodeImage.
+ * @param generateMipmaps Whether to generate the mipmap levels.
+ * @return Texture name.
+ */
+GLuint abcg::opengl::createTexture(const Image& image, bool generateMipmaps) {
+  const GLenum format{image.channels == 3 ? GLenum{GL_RGB} : GLenum{GL_RGBA}};
+
+  // Generate the texture. Rows are tightly packed
+  GLuint textureID{};
+  glGenTextures(1, &textureID);
+  glBindTexture(GL_TEXTURE_2D, textureID);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glTexImage2D(GL_TEXTURE_2D, 0, static_cast<GLint>(format), image.width,
+               image.height, 0, format, GL_UNSIGNED_BYTE, image.pixels.data());
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+  setTextureParameters(GL_TEXTURE_2D, GL_REPEAT, generateMipmaps, false);
+
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  return textureID;
+}
+
+/**
+ * @brief Creates a 2D texture from a texture cache.
+ *
+ * The stored mipmap levels are uploaded as they are. glGenerateMipmap is
+ * only called if mipmaps are requested and the cache holds the base level
+ * only.
+ *
+ * @param cache Texture cache loaded with abcg::TextureCache::load.
+ * @param generateMipmaps Whether to use mipmap levels.
+ * @return Texture name.
+ */
+GLuint abcg::opengl::createTexture(const TextureCache& cache,
+                                   bool generateMipmaps) {
+  const GLenum format{cache.getChannels() == 3 ? GLenum{GL_RGB}
+                                               : GLenum{GL_RGBA}};
+  const auto& levels{cache.getLevels()};
+  const auto numLevels{generateMipmaps ? levels.size() : 1};
+
+  GLuint textureID{};
+  glGenTextures(1, &textureID);
+  glBindTexture(GL_TEXTURE_2D, textureID);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  for (std::size_t index{}; index < numLevels; ++index) {
+    const auto& level{levels[index]};
+    glTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(index),
+                 static_cast<GLint>(format), level.width, level.height, 0,
+                 format, GL_UNSIGNED_BYTE, level.pixels.data());
+  }
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+  setTextureParameters(GL_TEXTURE_2D, GL_REPEAT, generateMipmaps,
+                       levels.size() > 1);
+
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  return textureID;
+}
+
+/**
+ * @brief Creates a 2D texture from a mipmap chain.
+ *
+ * Each level is uploaded explicitly, so glGenerateMipmap is not called.
+ *
+ * @param levels Base level, optionally followed by the mipmap levels
+ * returned by abcg::generateMipmaps or abcg::loadMipmaps.
+ * @return Texture name.
+ *
+ * @throw abcg::Exception if no level is given.
+ */
+GLuint abcg::opengl::createTexture(gsl::span<const Image> levels) {
+  if (levels.empty()) {
+    throw abcg::Exception{
+        abcg::Exception::Runtime("No image given for texture")};
+  }
+  const GLenum format{levels.front().channels == 3 ? GLenum{GL_RGB}
+                                                   : GLenum{GL_RGBA}};
+
+  GLuint textureID{};
+  glGenTextures(1, &textureID);
+  glBindTexture(GL_TEXTURE_2D, textureID);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  for (auto&& [index, level] : iter::enumerate(levels)) {
+    glTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(index),
+                 static_cast<GLint>(format), level.width, level.height, 0,
+                 format, GL_UNSIGNED_BYTE, level.pixels.data());
+  }
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+  // A partial chain would otherwise leave the texture incomplete
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL,
+                  static_cast<GLint>(levels.size() - 1));
+  setTextureParameters(GL_TEXTURE_2D, GL_REPEAT, levels.size() > 1, true);
+
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  return textureID;
+}
+
+/**
+ * @brief Creates a 2D texture from a block-compressed image.
+ *
+ * The stored levels are uploaded as they are with glCompressedTexImage2D if
+ * the OpenGL context supports the format (see
+ * abcg::opengl::isCompressedFormatSupported). Otherwise, each level is
+ * decoded on the CPU and uploaded as 8-bit RGBA.
+ *
+ * Compressed textures cannot be passed to glGenerateMipmap, so an image
+ * without mipmap levels is decoded when mipmaps are required. As with PNG
+ * and JPEG files, colors are sampled as they are stored: sRGB formats are
+ * uploaded with the corresponding linear format.
+ *
+ * @param image Compressed image, loaded from a KTX2 or DDS file.
+ * @param generateMipmaps Whether to use mipmap levels.
+ * @return Texture name.
+ *
+ * @throw abcg::Exception if the image is empty.
+ */
+GLuint abcg::opengl::createTexture(const CompressedImage& image,
+                                   bool generateMipmaps) {
+  const auto& levels{image.getLevels()};
+  if (levels.empty()) {
+    throw abcg::Exception{
+        abcg::Exception::Runtime("No image given for texture")};
+  }
+  const auto useStoredLevels{!generateMipmaps || levels.size() > 1};
+  const auto levelCount{generateMipmaps ? levels.size() : 1};
+
+  GLuint textureID{};
+  glGenTextures(1, &textureID);
+  glBindTexture(GL_TEXTURE_2D, textureID);
 
-    // Set texture wrapping
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  if (useStoredLevels && isCompressedFormatSupported(image.getFormat())) {
+    const auto format{getInternalFormat(image.getFormat())};
+    for (std::size_t index{}; index < levelCount; ++index) {
+      const auto& level{levels.at(index)};
+      glCompressedTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(index), format,
+                             level.width, level.height, 0,
+                             static_cast<GLsizei>(level.data.size()),
+                             level.data.data());
+    }
   } else {
-    throw abcg::Exception{abcg::Exception::Runtime(
-        fmt::format("Failed to load texture file {}", path))};
+    for (std::size_t index{}; index < levelCount; ++index) {
+      const auto level{image.decode(index)};
+      glTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(index), GL_RGBA,
+                   level.width, level.height, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                   level.pixels.data());
+    }
   }
 
+  if (useStoredLevels) {
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL,
+                    static_cast<GLint>(levelCount - 1));
+  }
+  setTextureParameters(GL_TEXTURE_2D, GL_REPEAT, generateMipmaps,
+                       useStoredLevels);
+
   glBindTexture(GL_TEXTURE_2D, 0);
 
   return textureID;
 }
 
-GLuint abcg::opengl::loadCubemap(std::array<std::string_view, 6> paths,
-                                 bool generateMipmaps) {
+/**
+ * @brief Creates a 2D texture with the storage of its mipmap levels
+ * allocated, but not initialized.
+ *
+ * The storage is immutable, allocated with glTexStorage2D, if the OpenGL
+ * context supports it (see abcg::opengl::isTextureStorageSupported), so that
+ * the driver need not check the texture for completeness on each draw.
+ * Otherwise, each level is allocated with glTexImage2D, which only supports
+ * uncompressed formats.
+ *
+ * The levels are filled with glTexSubImage2D, e.g. through an
+ * abcg::PixelUnpackRing. The texture is filtered linearly, with mipmaps if
+ * it has more than one level, and repeated.
+ *
+ * @param width Width of the base level.
+ * @param height Height of the base level.
+ * @param numLevels Number of mipmap levels, from the base level.
+ * @param internalFormat Sized internal format, i.e. GL_R8, GL_RG8, GL_RGB8,
+ * GL_RGBA8 or a compressed format (see abcg::opengl::getInternalFormat).
+ * @return Texture name.
+ *
+ * @throw abcg::Exception if the storage of the format cannot be allocated.
+ */
+GLuint abcg::opengl::createTextureStorage(int width, int height,
+                                          int numLevels,
+                                          GLenum internalFormat) {
+  GLenum format{};
+  if (!isTextureStorageSupported()) {
+    switch (internalFormat) {
+      case GL_R8:
+        format = GL_RED;
+        break;
+      case GL_RG8:
+        format = GL_RG;
+        break;
+      case GL_RGB8:
+        format = GL_RGB;
+        break;
+      case GL_RGBA8:
+        format = GL_RGBA;
+        break;
+      default:
+        throw abcg::Exception{abcg::Exception::Runtime(fmt::format(
+            "Texture storage of format {:#x} is not supported",
+            internalFormat))};
+    }
+  }
+
   GLuint textureID{};
   glGenTextures(1, &textureID);
-  glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+  glBindTexture(GL_TEXTURE_2D, textureID);
+  if (format == 0) {
+    glTexStorage2D(GL_TEXTURE_2D, numLevels, internalFormat, width, height);
+  } else {
+    for (const auto level : iter::range(numLevels)) {
+      glTexImage2D(GL_TEXTURE_2D, level, static_cast<GLint>(internalFormat),
+                   std::max(width >> level, 1), std::max(height >> level, 1),
+                   0, format, GL_UNSIGNED_BYTE, nullptr);
+    }
+  }
+
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, numLevels - 1);
+  setTextureParameters(GL_TEXTURE_2D, GL_REPEAT, numLevels > 1, true);
+
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  return textureID;
+}
 
-  for (auto&& [index, path] : iter::enumerate(paths)) {
-    // Copy file data into buffer
-    std::ifstream input(path.data(), std::ios::binary);
-    if (!input) {
+/**
+ * @brief Creates a 2D array texture from images of the same size.
+ *
+ * Layers are sampled with a sampler2DArray, e.g. `texture(sampler,
+ * vec3(uv, layer))`, so images packed with abcg::packTextureArray or
+ * abcg::packTextureAtlas are drawn without rebinding textures.
+ *
+ * @param layers Images of the layers, from layer 0.
+ * @param generateMipmaps Whether to generate the mipmap levels.
+ * @return Texture name.
+ *
+ * @throw abcg::Exception if no layer is given, or if the layers differ in
+ * size or number of channels.
+ */
+GLuint abcg::opengl::createTextureArray(gsl::span<const Image> layers,
+                                        bool generateMipmaps) {
+  if (layers.empty()) {
+    throw abcg::Exception{
+        abcg::Exception::Runtime("No image given for texture")};
+  }
+  const auto& first{layers.front()};
+  for (const auto& layer : layers) {
+    if (layer.width != first.width || layer.height != first.height ||
+        layer.channels != first.channels) {
       throw abcg::Exception{abcg::Exception::Runtime(
-          fmt::format("Failed to open texture file {}", path))};
+          fmt::format("Array texture layers differ in size: {}x{}x{} and "
+                      "{}x{}x{}",
+                      first.width, first.height, first.channels, layer.width,
+                      layer.height, layer.channels))};
     }
-    std::vector<char> buffer((std::istreambuf_iterator<char>(input)),
-                             std::istreambuf_iterator<char>());
+  }
+  const GLenum format{first.channels == 3 ? GLenum{GL_RGB} : GLenum{GL_RGBA}};
+
+  GLuint textureID{};
+  glGenTextures(1, &textureID);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, textureID);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, static_cast<GLint>(format),
+               first.width, first.height,
+               static_cast<GLsizei>(layers.size()), 0, format,
+               GL_UNSIGNED_BYTE, nullptr);
+  for (auto&& [index, layer] : iter::enumerate(layers)) {
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, static_cast<GLint>(index),
+                    layer.width, layer.height, 1, format, GL_UNSIGNED_BYTE,
+                    layer.pixels.data());
+  }
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
 
-    // Load the bitmap
-    if (SDL_Surface * surface{IMG_Load(path.data())}) {
-      // Enforce RGB
-      SDL_Surface* formattedSurface{
-          SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_RGB24, 0)};
-      SDL_FreeSurface(surface);
+  setTextureParameters(GL_TEXTURE_2D_ARRAY, GL_REPEAT, generateMipmaps, false);
 
-      // Create texture
-      glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + static_cast<GLenum>(index),
-                   0, GL_RGB, formattedSurface->w, formattedSurface->h, 0,
-                   GL_RGB, GL_UNSIGNED_BYTE, formattedSurface->pixels);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
 
-      SDL_FreeSurface(formattedSurface);
-    } else {
-      throw abcg::Exception{abcg::Exception::Runtime(
-          fmt::format("Failed to load texture file {}", path))};
+  return textureID;
+}
+
+/**
+ * @brief Returns whether the storage of textures can be allocated with
+ * glTexStorage2D.
+ *
+ * Texture storage is core in OpenGL 4.2, OpenGL ES 3.0 and WebGL 2.0.
+ *
+ * @return true if the OpenGL context supports immutable texture storage.
+ */
+bool abcg::opengl::isTextureStorageSupported() {
+#if defined(__EMSCRIPTEN__)
+  return true;
+#else
+  return GLEW_VERSION_4_2 || GLEW_ARB_texture_storage;
+#endif
+}
+
+/**
+ * @brief Returns whether textures of a compressed format are uploaded
+ * without being decoded on the CPU.
+ *
+ * The extensions of the OpenGL context are queried on the first call. Must
+ * be called on the thread that owns the OpenGL context.
+ *
+ * @param format Compressed format.
+ * @return true if the OpenGL context supports the format.
+ */
+bool abcg::opengl::isCompressedFormatSupported(CompressedFormat format) {
+  static const auto support{queryCompressionSupport()};
+  switch (format) {
+    case CompressedFormat::BC1:
+    case CompressedFormat::BC1A:
+    case CompressedFormat::BC2:
+    case CompressedFormat::BC3:
+      return support.s3tc;
+    case CompressedFormat::BC4:
+    case CompressedFormat::BC5:
+      return support.rgtc;
+    case CompressedFormat::BC7:
+      return support.bptc;
+    case CompressedFormat::ETC2RGB:
+    case CompressedFormat::ETC2RGBA1:
+    case CompressedFormat::ETC2RGBA:
+    case CompressedFormat::EACR11:
+    case CompressedFormat::EACRG11:
+      return support.etc2;
+  }
+  return false;
+}
+
+/**
+ * @brief Returns the internal format of the textures of a compressed format.
+ *
+ * @param format Compressed format.
+ * @return Value passed to glCompressedTexImage2D or glTexStorage2D.
+ */
+GLenum abcg::opengl::getInternalFormat(CompressedFormat format) {
+  return compressedFormats.at(static_cast<std::size_t>(format));
+}
+
+/**
+ * @brief Loads a 2D texture from an image file.
+ *
+ * If the image has been compiled by abcg-assetc with the box filter, the
+ * texture is created from the texture cache, so that neither decoding nor
+ * mipmap generation take place at load time.
+ *
+ * Otherwise, the file is read once and decoded from memory. The rows of the
+ * decoded image are flipped in place and uploaded directly, without any
+ * intermediate copy.
+ *
+ * KTX2 and DDS files are uploaded with abcg::opengl::createTexture, keeping
+ * their compressed format and stored mipmap levels whenever possible.
+ *
+ * @param path Path to the image file.
+ * @param generateMipmaps Whether to use mipmap levels.
+ * @return Texture name.
+ *
+ * @throw abcg::Exception if the file cannot be opened or decoded.
+ */
+GLuint abcg::opengl::loadTexture(std::string_view path, bool generateMipmaps) {
+  if (CompressedImage::isCompressedImage(path)) {
+    return createTexture(CompressedImage{path}, generateMipmaps);
+  }
+
+  // Levels generated with glGenerateMipmap are box filtered
+  if (TextureCache cache;
+      cache.load(TextureCache::getCachePath(path),
+                 TextureCache::computeKey(
+                     path, static_cast<std::uint64_t>(MipmapFilter::Box)))) {
+    return createTexture(cache, generateMipmaps);
+  }
+
+  const auto surface{loadSurface(path)};
+  flipRows(*surface);
+
+  GLuint textureID{};
+  glGenTextures(1, &textureID);
+  glBindTexture(GL_TEXTURE_2D, textureID);
+  if (!uploadSurface(GL_TEXTURE_2D, *surface)) {
+    // Unusual row padding: flip back and copy tightly packed rows
+    glDeleteTextures(1, &textureID);
+    flipRows(*surface);
+    return createTexture(copySurface(*surface), generateMipmaps);
+  }
+  setTextureParameters(GL_TEXTURE_2D, GL_REPEAT, generateMipmaps, false);
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  return textureID;
+}
+
+/**
+ * @brief Loads a 2D texture from an image file, with a mipmap chain
+ * generated on the CPU.
+ *
+ * The chain is computed with abcg::loadMipmaps and each level is uploaded
+ * explicitly, instead of calling glGenerateMipmap. If the texture cache of
+ * the image holds a complete chain generated with the same filter, compiled
+ * by abcg-assetc or persisted by a previous call, it is uploaded as it is.
+ *
+ * KTX2 and DDS files that store mipmap levels are uploaded with
+ * abcg::opengl::createTexture. Otherwise, the chain is generated from their
+ * decoded base level.
+ *
+ * @param path Path to the image file.
+ * @param filter Filter used to compute each level from the previous one.
+ * @param persist Whether to store the generated chain in the texture cache.
+ * @return Texture name.
+ *
+ * @throw abcg::Exception if the file cannot be opened or decoded.
+ */
+GLuint abcg::opengl::loadTexture(std::string_view path, MipmapFilter filter,
+                                 bool persist) {
+  if (CompressedImage::isCompressedImage(path)) {
+    if (CompressedImage image{path}; image.getLevels().size() > 1) {
+      return createTexture(image);
     }
   }
 
-  // Set texture wrapping
-  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+  if (TextureCache cache;
+      cache.load(TextureCache::getCachePath(path),
+                 TextureCache::computeKey(
+                     path, static_cast<std::uint64_t>(filter))) &&
+      cache.getLevels().size() > 1) {
+    return createTexture(cache);
+  }
+  return createTexture(loadMipmaps(path, filter, persist));
+}
 
-  // Set texture filtering
-  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+/**
+ * @brief Loads a cube map texture from six image files.
+ *
+ * The six files are read and decoded concurrently on the default thread
+ * pool. Only the uploads and the generation of the mipmap levels run on the
+ * calling thread, which must own the OpenGL context. The rows of the faces
+ * are not flipped, as expected by the cube map coordinate system.
+ *
+ * @param paths Paths to the +x, -x, +y, -y, +z and -z faces.
+ * @param generateMipmaps Whether to generate the mipmap levels.
+ * @return Texture name.
+ *
+ * @throw abcg::Exception if a file cannot be opened or decoded.
+ */
+GLuint abcg::opengl::loadCubemap(std::array<std::string_view, 6> paths,
+                                 bool generateMipmaps) {
+  // Decode before creating the texture, so that nothing leaks if a face
+  // fails to load
+  std::array<SurfacePtr, 6> surfaces;
+  auto& pool{ThreadPool::getDefault()};
+  pool.parallelFor(surfaces.size(), [&](std::size_t index) {
+    surfaces.at(index) = loadSurface(paths.at(index));
+  });
 
-  // Generate the mipmap levels
-  if (generateMipmaps) {
-    glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+  GLuint textureID{};
+  glGenTextures(1, &textureID);
+  glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
 
-    // Override minifying filtering
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER,
-                    GL_LINEAR_MIPMAP_LINEAR);
+  for (auto&& [index, surface] : iter::enumerate(surfaces)) {
+    const auto target{GL_TEXTURE_CUBE_MAP_POSITIVE_X +
+                      static_cast<GLenum>(index)};
+    if (!uploadSurface(target, *surface)) {
+      // Unusual row padding: copy tightly packed rows, top to bottom
+      flipRows(*surface);
+      const auto image{copySurface(*surface)};
+      const GLenum format{image.channels == 3 ? GLenum{GL_RGB}
+                                              : GLenum{GL_RGBA}};
+      glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+      glTexImage2D(target, 0, static_cast<GLint>(format), image.width,
+                   image.height, 0, format, GL_UNSIGNED_BYTE,
+                   image.pixels.data());
+      glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    }
+    // Free each face as soon as it is uploaded
+    surface.reset();
   }
 
+  setTextureParameters(GL_TEXTURE_CUBE_MAP, GL_CLAMP_TO_EDGE, generateMipmaps,
+                       false);
+
   return textureID;
 }
@@ -10,11 +10,76 @@
 
 #include <abcg_external.hpp>
 #include <array>
+#include <cstddef>
+#include <gsl/gsl>
 #include <string_view>
+#include <vector>
+
+#include "abcg_threadpool.hpp"
+
+namespace abcg {
+class CompressedImage;
+class TextureCache;
+enum class CompressedFormat;
+
+/**
+ * @brief Filter used to compute each mipmap level from the previous one.
+ */
+enum class MipmapFilter {
+  /** @brief Average of 2x2 blocks, as in glGenerateMipmap. */
+  Box,
+  /** @brief Sinc with a Kaiser window of radius 3 (alpha = 4). */
+  Kaiser,
+  /** @brief Sinc with a Lanczos window of radius 3. */
+  Lanczos
+};
+
+/**
+ * @brief Decoded 8-bit RGB or RGBA image.
+ *
+ * Rows are tightly packed and stored bottom to top, as expected by
+ * glTexImage2D.
+ */
+struct Image {
+  int width{};
+  int height{};
+  /** @brief Number of 8-bit channels (3 or 4). */
+  int channels{};
+  std::vector<std::byte> pixels;
+};
+
+[[nodiscard]] Image decodeImage(std::string_view path);
+[[nodiscard]] std::vector<Image> generateMipmaps(
+    Image image, MipmapFilter filter = MipmapFilter::Box);
+[[nodiscard]] std::vector<Image> generateMipmaps(Image image,
+                                                 MipmapFilter filter,
+                                                 ThreadPool& threadPool);
+[[nodiscard]] std::vector<Image> loadMipmaps(std::string_view path,
+                                             MipmapFilter filter,
+                                             bool persist = false);
+[[nodiscard]] Image resizeImage(const Image& image, int width, int height);
+}  // namespace abcg
 
 namespace abcg::opengl {
+[[nodiscard]] GLuint createTexture(const Image& image,
+                                   bool generateMipmaps = true);
+[[nodiscard]] GLuint createTexture(const TextureCache& cache,
+                                   bool generateMipmaps = true);
+[[nodiscard]] GLuint createTexture(gsl::span<const Image> levels);
+[[nodiscard]] GLuint createTexture(const CompressedImage& image,
+                                   bool generateMipmaps = true);
+[[nodiscard]] GLuint createTextureStorage(int width, int height,
+                                          int numLevels,
+                                          GLenum internalFormat);
+[[nodiscard]] GLuint createTextureArray(gsl::span<const Image> layers,
+                                        bool generateMipmaps = true);
+[[nodiscard]] bool isTextureStorageSupported();
+[[nodiscard]] bool isCompressedFormatSupported(CompressedFormat format);
+[[nodiscard]] GLenum getInternalFormat(CompressedFormat format);
 [[nodiscard]] GLuint loadTexture(std::string_view path,
                                  bool generateMipmaps = true);
+[[nodiscard]] GLuint loadTexture(std::string_view path, MipmapFilter filter,
+                                 bool persist = false);
 [[nodiscard]] GLuint loadCubemap(std::array<std::string_view, 6> paths,
                                  bool generateMipmaps = true);
 }  // namespace abcg::opengl
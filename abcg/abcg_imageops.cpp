@@ -0,0 +1,958 @@
+/**
+ * @file abcg_imageops.cpp
+ * @brief Definition of vectorized pixel processing functions.
+ *
+ * Each function has a portable implementation and SSE2, SSSE3 and AVX2
+ * implementations on x86 CPUs, selected at run time. All implementations
+ * produce the same output bit for bit.
+ *
+ * This project is released under the MIT License.
+ */
+
+#include "abcg_imageops.hpp"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// SSSE3 and AVX2 functions are compiled with target attributes, so that the
+// rest of the library does not require these instruction sets
+#if defined(__SSE2__) && (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__GNUC__) || defined(__clang__))
+#define ABCG_IMAGEOPS_DISPATCH
+#define ABCG_SSSE3 __attribute__((target("ssse3")))
+#define ABCG_AVX2 __attribute__((target("avx2")))
+#include <immintrin.h>
+#endif
+
+#include "abcg_exception.hpp"
+
+namespace {
+using abcg::image::InstructionSet;
+
+// 8-bit sRGB to linear conversion. Entries 256 to 511 convert alpha values,
+// which are not gamma-encoded
+struct DecodeTable {
+  alignas(32) std::array<float, 512> values{};
+
+  DecodeTable() {
+    for (std::size_t index{}; index < 256; ++index) {
+      const auto value{static_cast<double>(index) / 255.0};
+      values.at(index) = static_cast<float>(
+          value <= 0.04045 ? value / 12.92
+                           : std::pow((value + 0.055) / 1.055, 2.4));
+      values.at(index + 256) = static_cast<float>(value);
+    }
+  }
+};
+
+const DecodeTable& getDecodeTable() {
+  static const DecodeTable table{};
+  return table;
+}
+
+// Linear to 8-bit sRGB conversion, approximated by a linear function of the
+// input in each of 16 segments per octave between 2^-13 and 1. The segment is
+// given by the exponent and the 4 upper bits of the mantissa. Inputs below
+// 2^-13 are rounded to 0 anyway
+constexpr std::uint32_t encodeMinBits{0x39000000};  // 2^-13
+constexpr std::uint32_t encodeMaxBits{0x3f7fffff};  // Largest float below 1
+constexpr int encodeShift{19};
+constexpr std::size_t encodeSegments{
+    ((encodeMaxBits - encodeMinBits) >> encodeShift) + 1};
+
+struct EncodeTable {
+  float minValue{std::bit_cast<float>(encodeMinBits)};
+  float maxValue{std::bit_cast<float>(encodeMaxBits)};
+  alignas(32) std::array<float, encodeSegments> bias{};
+  alignas(32) std::array<float, encodeSegments> scale{};
+
+  EncodeTable() {
+    const auto encode{[](double value) {
+      return 255.0 * (value <= 0.0031308
+                           ? value * 12.92
+                           : 1.055 * std::pow(value, 1.0 / 2.4) - 0.055);
+    }};
+    for (std::size_t segment{}; segment < encodeSegments; ++segment) {
+      const auto bits{encodeMinBits +
+                      static_cast<std::uint32_t>(segment << encodeShift)};
+      const auto first{static_cast<double>(std::bit_cast<float>(bits))};
+      const auto last{static_cast<double>(
+          std::bit_cast<float>(bits + (1U << encodeShift)))};
+
+      // Chord through the ends of the segment, shifted to split the error
+      // evenly above and below the curve
+      const auto slope{(encode(last) - encode(first)) / (last - first)};
+      auto offset{encode(first) - slope * first};
+      auto minError{0.0};
+      auto maxError{0.0};
+      for (auto sample{0}; sample <= 64; ++sample) {
+        const auto value{first + (last - first) * sample / 64.0};
+        const auto error{encode(value) - (offset + slope * value)};
+        minError = std::min(minError, error);
+        maxError = std::max(maxError, error);
+      }
+      offset += (minError + maxError) / 2.0;
+
+      // Add 0.5 so that truncation rounds to nearest
+      bias.at(segment) = static_cast<float>(offset + 0.5);
+      scale.at(segment) = static_cast<float>(slope);
+    }
+  }
+};
+
+const EncodeTable& getEncodeTable() {
+  static const EncodeTable table{};
+  return table;
+}
+
+/* Portable implementations. The SIMD implementations call them for the
+ * remaining elements */
+
+void swapRowsScalar(std::byte* first, std::byte* second, std::size_t size) {
+  std::swap_ranges(first, first + size, second);
+}
+
+void convertRGBToRGBAScalar(const std::byte* rgb, std::byte* rgba,
+                            std::size_t count, std::byte alpha) {
+  for (std::size_t pixel{}; pixel < count; ++pixel) {
+    rgba[pixel * 4 + 0] = rgb[pixel * 3 + 0];
+    rgba[pixel * 4 + 1] = rgb[pixel * 3 + 1];
+    rgba[pixel * 4 + 2] = rgb[pixel * 3 + 2];
+    rgba[pixel * 4 + 3] = alpha;
+  }
+}
+
+void convertRGBAToRGBScalar(const std::byte* rgba, std::byte* rgb,
+                            std::size_t count) {
+  for (std::size_t pixel{}; pixel < count; ++pixel) {
+    rgb[pixel * 3 + 0] = rgba[pixel * 4 + 0];
+    rgb[pixel * 3 + 1] = rgba[pixel * 4 + 1];
+    rgb[pixel * 3 + 2] = rgba[pixel * 4 + 2];
+  }
+}
+
+void swizzleChannelsScalar(std::byte* pixels, std::size_t count,
+                           int channels, const std::array<int, 4>& order) {
+  const auto size{static_cast<std::size_t>(channels)};
+  std::array<std::byte, 4> pixel{};
+  for (std::size_t index{}; index < count; ++index, pixels += size) {
+    std::copy_n(pixels, size, pixel.begin());
+    for (std::size_t channel{}; channel < size; ++channel) {
+      pixels[channel] = pixel.at(static_cast<std::size_t>(order.at(channel)));
+    }
+  }
+}
+
+void convertSRGBToLinearScalar(const std::byte* srgb, float* linear,
+                               std::size_t count, int channels) {
+  const auto& table{getDecodeTable().values};
+  for (std::size_t index{}; index < count; ++index) {
+    const auto isAlpha{channels == 4 && index % 4 == 3};
+    linear[index] =
+        table[std::to_integer<std::size_t>(srgb[index]) + (isAlpha ? 256 : 0)];
+  }
+}
+
+std::byte encodeSRGB(float value) {
+  const auto& table{getEncodeTable()};
+  // Written as in _mm_max_ps and _mm_min_ps, so that NaN maps to 0
+  value = value > table.minValue ? value : table.minValue;
+  value = value < table.maxValue ? value : table.maxValue;
+  const auto segment{(std::bit_cast<std::uint32_t>(value) - encodeMinBits) >>
+                     encodeShift};
+  return static_cast<std::byte>(
+      static_cast<int>(table.bias[segment] + table.scale[segment] * value));
+}
+
+std::byte encodeAlpha(float value) {
+  value = value > 0.0f ? value : 0.0f;
+  value = value < 1.0f ? value : 1.0f;
+  return static_cast<std::byte>(static_cast<int>(value * 255.0f + 0.5f));
+}
+
+void convertLinearToSRGBScalar(const float* linear, std::byte* srgb,
+                               std::size_t count, int channels) {
+  for (std::size_t index{}; index < count; ++index) {
+    const auto isAlpha{channels == 4 && index % 4 == 3};
+    srgb[index] =
+        isAlpha ? encodeAlpha(linear[index]) : encodeSRGB(linear[index]);
+  }
+}
+
+void premultiplyAlphaScalar(std::byte* pixels, std::size_t count) {
+  for (std::size_t pixel{}; pixel < count; ++pixel, pixels += 4) {
+    const auto alpha{std::to_integer<unsigned>(pixels[3])};
+    for (std::size_t channel{}; channel < 3; ++channel) {
+      // Rounded c * a / 255
+      const auto product{std::to_integer<unsigned>(pixels[channel]) * alpha +
+                         128};
+      pixels[channel] = static_cast<std::byte>((product + (product >> 8)) >> 8);
+    }
+  }
+}
+
+// Averages 2x2 blocks of two source rows into count pixels. The source rows
+// hold at least 2 * count pixels
+void downsampleRowScalar(const std::byte* row0, const std::byte* row1,
+                         std::byte* output, std::size_t count, int channels) {
+  const auto size{static_cast<std::size_t>(channels)};
+  for (std::size_t pixel{}; pixel < count; ++pixel) {
+    for (std::size_t channel{}; channel < size; ++channel) {
+      const auto sum{std::to_integer<unsigned>(row0[channel]) +
+                     std::to_integer<unsigned>(row0[channel + size]) +
+                     std::to_integer<unsigned>(row1[channel]) +
+                     std::to_integer<unsigned>(row1[channel + size])};
+      *output++ = static_cast<std::byte>((sum + 2) / 4);
+    }
+    row0 += 2 * size;
+    row1 += 2 * size;
+  }
+}
+
+/* SSE2 implementations */
+
+#if defined(__SSE2__)
+__m128i loadBytes(const std::byte* address) {
+  return _mm_loadu_si128(reinterpret_cast<const __m128i*>(address));
+}
+
+void storeBytes(std::byte* address, __m128i value) {
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(address), value);
+}
+
+void swapRowsSSE2(std::byte* first, std::byte* second, std::size_t size) {
+  std::size_t offset{};
+  for (; offset + 16 <= size; offset += 16) {
+    const auto value{loadBytes(first + offset)};
+    storeBytes(first + offset, loadBytes(second + offset));
+    storeBytes(second + offset, value);
+  }
+  swapRowsScalar(first + offset, second + offset, size - offset);
+}
+
+// Packs eight 32-bit integers in [0, 255] into bytes
+void storePacked(std::byte* address, __m128i low, __m128i high) {
+  const auto words{_mm_packs_epi32(low, high)};
+  _mm_storel_epi64(reinterpret_cast<__m128i*>(address),
+                   _mm_packus_epi16(words, words));
+}
+
+void convertLinearToSRGBSSE2(const float* linear, std::byte* srgb,
+                             std::size_t count, int channels) {
+  const auto& table{getEncodeTable()};
+  const auto minValue{_mm_set1_ps(table.minValue)};
+  const auto maxValue{_mm_set1_ps(table.maxValue)};
+  const auto minBits{_mm_set1_epi32(static_cast<int>(encodeMinBits))};
+  const auto alphaMask{_mm_castsi128_ps(
+      channels == 4 ? _mm_setr_epi32(0, 0, 0, -1) : _mm_setzero_si128())};
+
+  const auto encode{[&](__m128 value) {
+    const auto clamped{_mm_min_ps(_mm_max_ps(value, minValue), maxValue)};
+    alignas(16) std::array<std::uint32_t, 4> segments{};
+    _mm_store_si128(
+        reinterpret_cast<__m128i*>(segments.data()),
+        _mm_srli_epi32(_mm_sub_epi32(_mm_castps_si128(clamped), minBits),
+                       encodeShift));
+    const auto bias{
+        _mm_setr_ps(table.bias[segments[0]], table.bias[segments[1]],
+                    table.bias[segments[2]], table.bias[segments[3]])};
+    const auto scale{
+        _mm_setr_ps(table.scale[segments[0]], table.scale[segments[1]],
+                    table.scale[segments[2]], table.scale[segments[3]])};
+    const auto color{_mm_add_ps(bias, _mm_mul_ps(scale, clamped))};
+    const auto alpha{_mm_add_ps(
+        _mm_mul_ps(_mm_min_ps(_mm_max_ps(value, _mm_setzero_ps()),
+                              _mm_set1_ps(1.0f)),
+                   _mm_set1_ps(255.0f)),
+        _mm_set1_ps(0.5f))};
+    return _mm_cvttps_epi32(_mm_or_ps(_mm_and_ps(alphaMask, alpha),
+                                      _mm_andnot_ps(alphaMask, color)));
+  }};
+
+  std::size_t index{};
+  for (; index + 8 <= count; index += 8) {
+    storePacked(srgb + index, encode(_mm_loadu_ps(linear + index)),
+                encode(_mm_loadu_ps(linear + index + 4)));
+  }
+  convertLinearToSRGBScalar(linear + index, srgb + index, count - index,
+                            channels);
+}
+
+// Multiplies the color channels of two pixels, widened to 16 bits, by their
+// alpha channel
+__m128i multiplyByAlpha(__m128i pixels) {
+  const auto alphaLanes{_mm_setr_epi16(0, 0, 0, -1, 0, 0, 0, -1)};
+  auto alpha{_mm_shufflehi_epi16(
+      _mm_shufflelo_epi16(pixels, _MM_SHUFFLE(3, 3, 3, 3)),
+      _MM_SHUFFLE(3, 3, 3, 3))};
+  // Alpha is multiplied by 255, which leaves it unchanged
+  alpha = _mm_or_si128(_mm_andnot_si128(alphaLanes, alpha),
+                       _mm_and_si128(alphaLanes, _mm_set1_epi16(255)));
+  const auto product{
+      _mm_add_epi16(_mm_mullo_epi16(pixels, alpha), _mm_set1_epi16(128))};
+  return _mm_srli_epi16(_mm_add_epi16(product, _mm_srli_epi16(product, 8)), 8);
+}
+
+void premultiplyAlphaSSE2(std::byte* pixels, std::size_t count) {
+  const auto zero{_mm_setzero_si128()};
+  std::size_t pixel{};
+  for (; pixel + 4 <= count; pixel += 4) {
+    auto* address{pixels + pixel * 4};
+    const auto value{loadBytes(address)};
+    const auto low{multiplyByAlpha(_mm_unpacklo_epi8(value, zero))};
+    const auto high{multiplyByAlpha(_mm_unpackhi_epi8(value, zero))};
+    storeBytes(address, _mm_packus_epi16(low, high));
+  }
+  premultiplyAlphaScalar(pixels + pixel * 4, count - pixel);
+}
+
+// Averages four RGBA pixels of two rows into two pixels, as 16-bit values
+__m128i averageRGBA(__m128i top, __m128i bottom) {
+  const auto zero{_mm_setzero_si128()};
+  const auto low{_mm_add_epi16(_mm_unpacklo_epi8(top, zero),
+                               _mm_unpacklo_epi8(bottom, zero))};
+  const auto high{_mm_add_epi16(_mm_unpackhi_epi8(top, zero),
+                                _mm_unpackhi_epi8(bottom, zero))};
+  const auto sum{_mm_add_epi16(_mm_unpacklo_epi64(low, high),
+                               _mm_unpackhi_epi64(low, high))};
+  return _mm_srli_epi16(_mm_add_epi16(sum, _mm_set1_epi16(2)), 2);
+}
+
+void downsampleRowSSE2(const std::byte* row0, const std::byte* row1,
+                       std::byte* output, std::size_t count, int channels) {
+  std::size_t pixel{};
+  if (channels == 4) {
+    for (; pixel + 4 <= count; pixel += 4) {
+      const auto offset{pixel * 8};
+      storeBytes(output + pixel * 4,
+                 _mm_packus_epi16(averageRGBA(loadBytes(row0 + offset),
+                                              loadBytes(row1 + offset)),
+                                  averageRGBA(loadBytes(row0 + offset + 16),
+                                              loadBytes(row1 + offset + 16))));
+    }
+  }
+  const auto size{static_cast<std::size_t>(channels)};
+  downsampleRowScalar(row0 + pixel * 2 * size, row1 + pixel * 2 * size,
+                      output + pixel * size, count - pixel, channels);
+}
+#endif
+
+/* SSSE3 implementations */
+
+#if defined(ABCG_IMAGEOPS_DISPATCH)
+ABCG_SSSE3 void convertRGBToRGBASSSE3(const std::byte* rgb, std::byte* rgba,
+                                      std::size_t count, std::byte alpha) {
+  const auto shuffle{_mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9,
+                                   10, 11, -1)};
+  const auto alphaBytes{
+      _mm_and_si128(_mm_set1_epi32(static_cast<int>(0xff000000U)),
+                    _mm_set1_epi8(static_cast<char>(alpha)))};
+  std::size_t pixel{};
+  // Each iteration reads 16 bytes to convert 4 pixels
+  for (; pixel * 3 + 16 <= count * 3; pixel += 4) {
+    storeBytes(rgba + pixel * 4,
+               _mm_or_si128(_mm_shuffle_epi8(loadBytes(rgb + pixel * 3),
+                                             shuffle),
+                            alphaBytes));
+  }
+  convertRGBToRGBAScalar(rgb + pixel * 3, rgba + pixel * 4, count - pixel,
+                         alpha);
+}
+
+ABCG_SSSE3 void convertRGBAToRGBSSSE3(const std::byte* rgba, std::byte* rgb,
+                                      std::size_t count) {
+  const auto shuffle{_mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1,
+                                   -1, -1, -1)};
+  std::size_t pixel{};
+  // Each iteration writes 16 bytes, 4 of which are overwritten by the next
+  for (; pixel * 3 + 16 <= count * 3; pixel += 4) {
+    storeBytes(rgb + pixel * 3,
+               _mm_shuffle_epi8(loadBytes(rgba + pixel * 4), shuffle));
+  }
+  convertRGBAToRGBScalar(rgba + pixel * 4, rgb + pixel * 3, count - pixel);
+}
+
+// Shuffle mask of a block of 16 bytes. With 3 channels, the block holds 5
+// pixels and one byte; the last 4 bytes are left in place
+__m128i makeSwizzleMask(int channels, const std::array<int, 4>& order) {
+  alignas(16) std::array<char, 16> mask{};
+  const auto size{static_cast<std::size_t>(channels)};
+  const auto end{channels == 3 ? std::size_t{12} : std::size_t{16}};
+  for (std::size_t byte{}; byte < mask.size(); ++byte) {
+    mask.at(byte) = static_cast<char>(
+        byte < end ? byte / size * size +
+                         static_cast<std::size_t>(order.at(byte % size))
+                   : byte);
+  }
+  return _mm_load_si128(reinterpret_cast<const __m128i*>(mask.data()));
+}
+
+ABCG_SSSE3 void swizzleChannelsSSSE3(std::byte* pixels, std::size_t count,
+                                     int channels,
+                                     const std::array<int, 4>& order) {
+  const auto size{static_cast<std::size_t>(channels)};
+  std::size_t pixel{};
+  if (channels == 3 || channels == 4) {
+    const auto mask{makeSwizzleMask(channels, order)};
+    // Each iteration reads and writes 16 bytes to reorder 4 pixels
+    for (; pixel * size + 16 <= count * size; pixel += 4) {
+      auto* address{pixels + pixel * size};
+      storeBytes(address, _mm_shuffle_epi8(loadBytes(address), mask));
+    }
+  }
+  swizzleChannelsScalar(pixels + pixel * size, count - pixel, channels, order);
+}
+
+ABCG_SSSE3 void downsampleRowSSSE3(const std::byte* row0,
+                                   const std::byte* row1, std::byte* output,
+                                   std::size_t count, int channels) {
+  if (channels != 3) {
+    downsampleRowSSE2(row0, row1, output, count, channels);
+    return;
+  }
+
+  // RGB pixels are expanded to RGBA, averaged as RGBA and packed back
+  const auto expand{_mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9,
+                                  10, 11, -1)};
+  const auto pack{_mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1,
+                                -1, -1, -1)};
+  std::size_t pixel{};
+  // Each iteration reads 28 bytes of each row and writes 16 bytes, 4 of which
+  // are overwritten by the next
+  for (; pixel * 3 + 16 <= count * 3 && pixel * 6 + 28 <= count * 6;
+       pixel += 4) {
+    const auto offset{pixel * 6};
+    const auto first{
+        averageRGBA(_mm_shuffle_epi8(loadBytes(row0 + offset), expand),
+                    _mm_shuffle_epi8(loadBytes(row1 + offset), expand))};
+    const auto second{
+        averageRGBA(_mm_shuffle_epi8(loadBytes(row0 + offset + 12), expand),
+                    _mm_shuffle_epi8(loadBytes(row1 + offset + 12), expand))};
+    storeBytes(output + pixel * 3,
+               _mm_shuffle_epi8(_mm_packus_epi16(first, second), pack));
+  }
+  downsampleRowScalar(row0 + pixel * 6, row1 + pixel * 6, output + pixel * 3,
+                      count - pixel, channels);
+}
+
+/* AVX2 implementations */
+
+ABCG_AVX2 __m256i loadBytes256(const std::byte* address) {
+  return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(address));
+}
+
+ABCG_AVX2 void storeBytes256(std::byte* address, __m256i value) {
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(address), value);
+}
+
+// Loads 16 bytes into each 128-bit lane
+ABCG_AVX2 __m256i loadLanes(const std::byte* low, const std::byte* high) {
+  return _mm256_inserti128_si256(_mm256_castsi128_si256(loadBytes(low)),
+                                 loadBytes(high), 1);
+}
+
+ABCG_AVX2 void swapRowsAVX2(std::byte* first, std::byte* second,
+                            std::size_t size) {
+  std::size_t offset{};
+  for (; offset + 32 <= size; offset += 32) {
+    const auto value{loadBytes256(first + offset)};
+    storeBytes256(first + offset, loadBytes256(second + offset));
+    storeBytes256(second + offset, value);
+  }
+  swapRowsSSE2(first + offset, second + offset, size - offset);
+}
+
+ABCG_AVX2 void convertRGBToRGBAAVX2(const std::byte* rgb, std::byte* rgba,
+                                    std::size_t count, std::byte alpha) {
+  const auto shuffle{_mm256_setr_epi8(
+      0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1, 0, 1, 2, -1, 3, 4,
+      5, -1, 6, 7, 8, -1, 9, 10, 11, -1)};
+  const auto alphaBytes{
+      _mm256_and_si256(_mm256_set1_epi32(static_cast<int>(0xff000000U)),
+                       _mm256_set1_epi8(static_cast<char>(alpha)))};
+  std::size_t pixel{};
+  // Each iteration reads 28 bytes to convert 8 pixels
+  for (; pixel * 3 + 28 <= count * 3; pixel += 8) {
+    const auto* address{rgb + pixel * 3};
+    storeBytes256(
+        rgba + pixel * 4,
+        _mm256_or_si256(
+            _mm256_shuffle_epi8(loadLanes(address, address + 12), shuffle),
+            alphaBytes));
+  }
+  convertRGBToRGBASSSE3(rgb + pixel * 3, rgba + pixel * 4, count - pixel,
+                        alpha);
+}
+
+ABCG_AVX2 void convertRGBAToRGBAVX2(const std::byte* rgba, std::byte* rgb,
+                                    std::size_t count) {
+  const auto shuffle{_mm256_setr_epi8(
+      0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1, 0, 1, 2, 4, 5, 6,
+      8, 9, 10, 12, 13, 14, -1, -1, -1, -1)};
+  // Moves the 12 bytes of the upper lane next to those of the lower lane
+  const auto permutation{_mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7)};
+  std::size_t pixel{};
+  // Each iteration writes 32 bytes, 8 of which are overwritten by the next
+  for (; pixel * 3 + 32 <= count * 3; pixel += 8) {
+    storeBytes256(rgb + pixel * 3,
+                  _mm256_permutevar8x32_epi32(
+                      _mm256_shuffle_epi8(loadBytes256(rgba + pixel * 4),
+                                          shuffle),
+                      permutation));
+  }
+  convertRGBAToRGBSSSE3(rgba + pixel * 4, rgb + pixel * 3, count - pixel);
+}
+
+ABCG_AVX2 void swizzleChannelsAVX2(std::byte* pixels, std::size_t count,
+                                   int channels,
+                                   const std::array<int, 4>& order) {
+  // Pixels of 3 bytes straddle the lanes, so only 4 channels are handled here
+  std::size_t pixel{};
+  if (channels == 4) {
+    const auto mask{_mm256_broadcastsi128_si256(makeSwizzleMask(4, order))};
+    for (; pixel + 8 <= count; pixel += 8) {
+      auto* address{pixels + pixel * 4};
+      storeBytes256(address, _mm256_shuffle_epi8(loadBytes256(address), mask));
+    }
+  }
+  const auto size{static_cast<std::size_t>(channels)};
+  swizzleChannelsSSSE3(pixels + pixel * size, count - pixel, channels, order);
+}
+
+ABCG_AVX2 void convertSRGBToLinearAVX2(const std::byte* srgb, float* linear,
+                                       std::size_t count, int channels) {
+  const auto* table{getDecodeTable().values.data()};
+  const auto offsets{channels == 4
+                         ? _mm256_setr_epi32(0, 0, 0, 256, 0, 0, 0, 256)
+                         : _mm256_setzero_si256()};
+  std::size_t index{};
+  for (; index + 8 <= count; index += 8) {
+    const auto bytes{
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(srgb + index))};
+    const auto indices{_mm256_add_epi32(_mm256_cvtepu8_epi32(bytes), offsets)};
+    _mm256_storeu_ps(linear + index, _mm256_i32gather_ps(table, indices, 4));
+  }
+  convertSRGBToLinearScalar(srgb + index, linear + index, count - index,
+                            channels);
+}
+
+ABCG_AVX2 void convertLinearToSRGBAVX2(const float* linear, std::byte* srgb,
+                                       std::size_t count, int channels) {
+  const auto& table{getEncodeTable()};
+  const auto minValue{_mm256_set1_ps(table.minValue)};
+  const auto maxValue{_mm256_set1_ps(table.maxValue)};
+  const auto minBits{_mm256_set1_epi32(static_cast<int>(encodeMinBits))};
+  const auto alphaMask{_mm256_castsi256_ps(
+      channels == 4 ? _mm256_setr_epi32(0, 0, 0, -1, 0, 0, 0, -1)
+                    : _mm256_setzero_si256())};
+  std::size_t index{};
+  for (; index + 8 <= count; index += 8) {
+    const auto value{_mm256_loadu_ps(linear + index)};
+    const auto clamped{
+        _mm256_min_ps(_mm256_max_ps(value, minValue), maxValue)};
+    const auto segments{_mm256_srli_epi32(
+        _mm256_sub_epi32(_mm256_castps_si256(clamped), minBits),
+        encodeShift)};
+    const auto bias{_mm256_i32gather_ps(table.bias.data(), segments, 4)};
+    const auto scale{_mm256_i32gather_ps(table.scale.data(), segments, 4)};
+    const auto color{_mm256_add_ps(bias, _mm256_mul_ps(scale, clamped))};
+    const auto alpha{_mm256_add_ps(
+        _mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(value, _mm256_setzero_ps()),
+                                    _mm256_set1_ps(1.0f)),
+                      _mm256_set1_ps(255.0f)),
+        _mm256_set1_ps(0.5f))};
+    const auto result{
+        _mm256_cvttps_epi32(_mm256_blendv_ps(color, alpha, alphaMask))};
+    storePacked(srgb + index, _mm256_castsi256_si128(result),
+                _mm256_extracti128_si256(result, 1));
+  }
+  convertLinearToSRGBScalar(linear + index, srgb + index, count - index,
+                            channels);
+}
+
+ABCG_AVX2 __m256i multiplyByAlpha256(__m256i pixels) {
+  const auto alphaLanes{_mm256_set1_epi64x(
+      static_cast<long long>(0xffff000000000000ULL))};
+  auto alpha{_mm256_shufflehi_epi16(
+      _mm256_shufflelo_epi16(pixels, _MM_SHUFFLE(3, 3, 3, 3)),
+      _MM_SHUFFLE(3, 3, 3, 3))};
+  alpha = _mm256_or_si256(_mm256_andnot_si256(alphaLanes, alpha),
+                          _mm256_and_si256(alphaLanes, _mm256_set1_epi16(255)));
+  const auto product{_mm256_add_epi16(_mm256_mullo_epi16(pixels, alpha),
+                                      _mm256_set1_epi16(128))};
+  return _mm256_srli_epi16(
+      _mm256_add_epi16(product, _mm256_srli_epi16(product, 8)), 8);
+}
+
+ABCG_AVX2 void premultiplyAlphaAVX2(std::byte* pixels, std::size_t count) {
+  std::size_t pixel{};
+  for (; pixel + 8 <= count; pixel += 8) {
+    auto* address{pixels + pixel * 4};
+    const auto low{
+        multiplyByAlpha256(_mm256_cvtepu8_epi16(loadBytes(address)))};
+    const auto high{
+        multiplyByAlpha256(_mm256_cvtepu8_epi16(loadBytes(address + 16)))};
+    // packus interleaves the lanes of its operands
+    storeBytes256(address,
+                  _mm256_permute4x64_epi64(_mm256_packus_epi16(low, high),
+                                           _MM_SHUFFLE(3, 1, 2, 0)));
+  }
+  premultiplyAlphaSSE2(pixels + pixel * 4, count - pixel);
+}
+
+ABCG_AVX2 __m256i averageRGBA256(__m256i top, __m256i bottom) {
+  const auto zero{_mm256_setzero_si256()};
+  const auto low{_mm256_add_epi16(_mm256_unpacklo_epi8(top, zero),
+                                  _mm256_unpacklo_epi8(bottom, zero))};
+  const auto high{_mm256_add_epi16(_mm256_unpackhi_epi8(top, zero),
+                                   _mm256_unpackhi_epi8(bottom, zero))};
+  const auto sum{_mm256_add_epi16(_mm256_unpacklo_epi64(low, high),
+                                  _mm256_unpackhi_epi64(low, high))};
+  return _mm256_srli_epi16(_mm256_add_epi16(sum, _mm256_set1_epi16(2)), 2);
+}
+
+ABCG_AVX2 void downsampleRowAVX2(const std::byte* row0, const std::byte* row1,
+                                 std::byte* output, std::size_t count,
+                                 int channels) {
+  std::size_t pixel{};
+  if (channels == 4) {
+    for (; pixel + 8 <= count; pixel += 8) {
+      const auto offset{pixel * 8};
+      const auto first{averageRGBA256(loadBytes256(row0 + offset),
+                                      loadBytes256(row1 + offset))};
+      const auto second{averageRGBA256(loadBytes256(row0 + offset + 32),
+                                       loadBytes256(row1 + offset + 32))};
+      storeBytes256(output + pixel * 4,
+                    _mm256_permute4x64_epi64(_mm256_packus_epi16(first, second),
+                                             _MM_SHUFFLE(3, 1, 2, 0)));
+    }
+  }
+  const auto size{static_cast<std::size_t>(channels)};
+  downsampleRowSSSE3(row0 + pixel * 2 * size, row1 + pixel * 2 * size,
+                     output + pixel * size, count - pixel, channels);
+}
+#endif
+
+/* Dispatch */
+
+struct Kernels {
+  void (*swapRows)(std::byte*, std::byte*, std::size_t);
+  void (*convertRGBToRGBA)(const std::byte*, std::byte*, std::size_t,
+                           std::byte);
+  void (*convertRGBAToRGB)(const std::byte*, std::byte*, std::size_t);
+  void (*swizzleChannels)(std::byte*, std::size_t, int,
+                          const std::array<int, 4>&);
+  void (*convertSRGBToLinear)(const std::byte*, float*, std::size_t, int);
+  void (*convertLinearToSRGB)(const float*, std::byte*, std::size_t, int);
+  void (*premultiplyAlpha)(std::byte*, std::size_t);
+  void (*downsampleRow)(const std::byte*, const std::byte*, std::byte*,
+                        std::size_t, int);
+};
+
+constexpr Kernels scalarKernels{
+    swapRowsScalar,           convertRGBToRGBAScalar,
+    convertRGBAToRGBScalar,   swizzleChannelsScalar,
+    convertSRGBToLinearScalar, convertLinearToSRGBScalar,
+    premultiplyAlphaScalar,   downsampleRowScalar};
+
+#if defined(__SSE2__)
+constexpr Kernels sse2Kernels{
+    swapRowsSSE2,              convertRGBToRGBAScalar,
+    convertRGBAToRGBScalar,    swizzleChannelsScalar,
+    convertSRGBToLinearScalar, convertLinearToSRGBSSE2,
+    premultiplyAlphaSSE2,      downsampleRowSSE2};
+#endif
+
+#if defined(ABCG_IMAGEOPS_DISPATCH)
+constexpr Kernels ssse3Kernels{
+    swapRowsSSE2,              convertRGBToRGBASSSE3,
+    convertRGBAToRGBSSSE3,     swizzleChannelsSSSE3,
+    convertSRGBToLinearScalar, convertLinearToSRGBSSE2,
+    premultiplyAlphaSSE2,      downsampleRowSSSE3};
+
+constexpr Kernels avx2Kernels{
+    swapRowsAVX2,            convertRGBToRGBAAVX2,
+    convertRGBAToRGBAVX2,    swizzleChannelsAVX2,
+    convertSRGBToLinearAVX2, convertLinearToSRGBAVX2,
+    premultiplyAlphaAVX2,    downsampleRowAVX2};
+#endif
+
+InstructionSet getSupportedInstructionSet() noexcept {
+#if defined(ABCG_IMAGEOPS_DISPATCH)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) return InstructionSet::AVX2;
+  if (__builtin_cpu_supports("ssse3")) return InstructionSet::SSSE3;
+  return InstructionSet::SSE2;
+#elif defined(__SSE2__)
+  return InstructionSet::SSE2;
+#else
+  return InstructionSet::Scalar;
+#endif
+}
+
+std::atomic<InstructionSet>& getActiveInstructionSet() noexcept {
+  static std::atomic<InstructionSet> instructionSet{
+      getSupportedInstructionSet()};
+  return instructionSet;
+}
+
+const Kernels& getKernels() noexcept {
+  switch (getActiveInstructionSet().load(std::memory_order_relaxed)) {
+#if defined(ABCG_IMAGEOPS_DISPATCH)
+  case InstructionSet::AVX2:
+    return avx2Kernels;
+  case InstructionSet::SSSE3:
+    return ssse3Kernels;
+#endif
+#if defined(__SSE2__)
+  case InstructionSet::SSE2:
+    return sse2Kernels;
+#endif
+  default:
+    return scalarKernels;
+  }
+}
+
+void checkChannels(int channels) {
+  if (channels < 1 || channels > 4) {
+    throw abcg::Exception{abcg::Exception::Runtime(
+        fmt::format("Invalid number of channels: {}", channels))};
+  }
+}
+
+void checkSize(std::size_t size, std::size_t expected) {
+  if (size != expected) {
+    throw abcg::Exception{abcg::Exception::Runtime(
+        fmt::format("Invalid pixel array size: {} (expected {})", size,
+                    expected))};
+  }
+}
+}  // namespace
+
+/**
+ * @brief Returns the instruction set used by the functions of abcg::image.
+ */
+abcg::image::InstructionSet abcg::image::getInstructionSet() noexcept {
+  return getActiveInstructionSet().load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief Selects the instruction set used by the functions of abcg::image.
+ *
+ * Meant for comparing the implementations. The instruction set is limited to
+ * the best one supported by the CPU.
+ *
+ * @param instructionSet Requested instruction set.
+ * @return Instruction set actually used.
+ */
+abcg::image::InstructionSet
+abcg::image::setInstructionSet(InstructionSet instructionSet) noexcept {
+  instructionSet = std::min(instructionSet, getSupportedInstructionSet());
+  getActiveInstructionSet().store(instructionSet, std::memory_order_relaxed);
+  return instructionSet;
+}
+
+/**
+ * @brief Reverses the order of the rows of an image in place.
+ *
+ * @param pixels Pixels of the image. Row padding, if any, is swapped along
+ * with the rows.
+ * @param pitch Distance in bytes between the start of consecutive rows.
+ *
+ * @throw abcg::Exception if the size of the pixel array is not a multiple of
+ * the pitch.
+ */
+void abcg::image::flipVertically(gsl::span<std::byte> pixels,
+                                 std::size_t pitch) {
+  if (pitch == 0 || pixels.size() % pitch != 0) {
+    throw abcg::Exception{abcg::Exception::Runtime(fmt::format(
+        "Invalid pitch {} for {} bytes of pixels", pitch, pixels.size()))};
+  }
+  const auto height{pixels.size() / pitch};
+  if (height < 2) return;
+
+  const auto swapRows{getKernels().swapRows};
+  for (std::size_t top{}, bottom{height - 1}; top < bottom; ++top, --bottom) {
+    swapRows(pixels.data() + top * pitch, pixels.data() + bottom * pitch,
+             pitch);
+  }
+}
+
+/**
+ * @brief Adds an alpha channel to RGB pixels.
+ *
+ * @param rgb Source pixels.
+ * @param rgba Destination pixels. Must not overlap the source pixels.
+ * @param alpha Value of the alpha channel.
+ *
+ * @throw abcg::Exception if the arrays do not hold the same number of pixels.
+ */
+void abcg::image::convertRGBToRGBA(gsl::span<const std::byte> rgb,
+                                   gsl::span<std::byte> rgba, std::byte alpha) {
+  const auto count{rgb.size() / 3};
+  checkSize(rgb.size(), count * 3);
+  checkSize(rgba.size(), count * 4);
+  getKernels().convertRGBToRGBA(rgb.data(), rgba.data(), count, alpha);
+}
+
+/**
+ * @brief Removes the alpha channel of RGBA pixels.
+ *
+ * @param rgba Source pixels.
+ * @param rgb Destination pixels. Must not overlap the source pixels.
+ *
+ * @throw abcg::Exception if the arrays do not hold the same number of pixels.
+ */
+void abcg::image::convertRGBAToRGB(gsl::span<const std::byte> rgba,
+                                   gsl::span<std::byte> rgb) {
+  const auto count{rgba.size() / 4};
+  checkSize(rgba.size(), count * 4);
+  checkSize(rgb.size(), count * 3);
+  getKernels().convertRGBAToRGB(rgba.data(), rgb.data(), count);
+}
+
+/**
+ * @brief Reorders the channels of each pixel in place.
+ *
+ * For instance, order {2, 1, 0, 3} converts BGRA pixels to RGBA.
+ *
+ * @param pixels Pixels to be reordered.
+ * @param channels Number of 8-bit channels per pixel, from 1 to 4.
+ * @param order Source channel of each destination channel. Only the first
+ * channels entries are used.
+ *
+ * @throw abcg::Exception if the number of channels or the order is invalid.
+ */
+void abcg::image::swizzleChannels(gsl::span<std::byte> pixels, int channels,
+                                  std::array<int, 4> order) {
+  checkChannels(channels);
+  const auto size{static_cast<std::size_t>(channels)};
+  checkSize(pixels.size(), pixels.size() / size * size);
+  if (std::any_of(order.begin(), order.begin() + channels,
+                  [channels](int channel) {
+                    return channel < 0 || channel >= channels;
+                  })) {
+    throw abcg::Exception{abcg::Exception::Runtime(
+        fmt::format("Invalid channel order for {} channels", channels))};
+  }
+  getKernels().swizzleChannels(pixels.data(), pixels.size() / size, channels,
+                               order);
+}
+
+/**
+ * @brief Converts 8-bit sRGB values to linear floating-point values.
+ *
+ * @param srgb Source values.
+ * @param linear Destination values, in [0, 1].
+ * @param channels Number of channels per pixel, from 1 to 4. With 4 channels,
+ * the last one is alpha, which is only scaled to [0, 1].
+ *
+ * @throw abcg::Exception if the arrays do not have the same size.
+ */
+void abcg::image::convertSRGBToLinear(gsl::span<const std::byte> srgb,
+                                      gsl::span<float> linear, int channels) {
+  checkChannels(channels);
+  checkSize(linear.size(), srgb.size());
+  getKernels().convertSRGBToLinear(srgb.data(), linear.data(), srgb.size(),
+                                   channels);
+}
+
+/**
+ * @brief Converts linear floating-point values to 8-bit sRGB values.
+ *
+ * Values are clamped to [0, 1] and rounded to the nearest 8-bit value. The
+ * transfer function is approximated, so that values within 0.02 unit of a
+ * rounding boundary may be rounded the other way.
+ *
+ * @param linear Source values.
+ * @param srgb Destination values.
+ * @param channels Number of channels per pixel, from 1 to 4. With 4 channels,
+ * the last one is alpha, which is only scaled to [0, 255].
+ *
+ * @throw abcg::Exception if the arrays do not have the same size.
+ */
+void abcg::image::convertLinearToSRGB(gsl::span<const float> linear,
+                                      gsl::span<std::byte> srgb, int channels) {
+  checkChannels(channels);
+  checkSize(srgb.size(), linear.size());
+  getKernels().convertLinearToSRGB(linear.data(), srgb.data(), linear.size(),
+                                   channels);
+}
+
+/**
+ * @brief Multiplies the color channels of RGBA pixels by their alpha channel.
+ *
+ * Each channel is set to round(c * a / 255).
+ *
+ * @param rgba Pixels to be premultiplied.
+ *
+ * @throw abcg::Exception if the size of the array is not a multiple of 4.
+ */
+void abcg::image::premultiplyAlpha(gsl::span<std::byte> rgba) {
+  checkSize(rgba.size(), rgba.size() / 4 * 4);
+  getKernels().premultiplyAlpha(rgba.data(), rgba.size() / 4);
+}
+
+/**
+ * @brief Halves the width and height of an image with a 2x2 box filter.
+ *
+ * The destination image is max(width / 2, 1) by max(height / 2, 1) pixels.
+ * Odd rows and columns are clamped to the edge of the source image, as in
+ * glGenerateMipmap. Each channel is set to the rounded average of the 4
+ * source values.
+ *
+ * @param source Tightly packed source pixels.
+ * @param width Width of the source image.
+ * @param height Height of the source image.
+ * @param channels Number of 8-bit channels per pixel, from 1 to 4.
+ * @param destination Tightly packed destination pixels.
+ *
+ * @throw abcg::Exception if the size of an array does not match the image
+ * dimensions.
+ */
+void abcg::image::downsample(gsl::span<const std::byte> source, int width,
+                             int height, int channels,
+                             gsl::span<std::byte> destination) {
+  checkChannels(channels);
+  if (width < 1 || height < 1) {
+    throw abcg::Exception{abcg::Exception::Runtime(
+        fmt::format("Invalid image size {}x{}", width, height))};
+  }
+  const auto size{static_cast<std::size_t>(channels)};
+  const auto sourceWidth{static_cast<std::size_t>(width)};
+  const auto sourceHeight{static_cast<std::size_t>(height)};
+  const auto outputWidth{std::max<std::size_t>(sourceWidth / 2, 1)};
+  const auto outputHeight{std::max<std::size_t>(sourceHeight / 2, 1)};
+  checkSize(source.size(), sourceWidth * sourceHeight * size);
+  checkSize(destination.size(), outputWidth * outputHeight * size);
+
+  const auto downsampleRow{getKernels().downsampleRow};
+  const auto sourcePitch{sourceWidth * size};
+  for (std::size_t y{}; y < outputHeight; ++y) {
+    const auto* row0{source.data() +
+                     std::min(2 * y, sourceHeight - 1) * sourcePitch};
+    const auto* row1{source.data() +
+                     std::min(2 * y + 1, sourceHeight - 1) * sourcePitch};
+    auto* output{destination.data() + y * outputWidth * size};
+    if (sourceWidth == 1) {
+      // A single column is averaged with itself
+      for (std::size_t channel{}; channel < size; ++channel) {
+        const auto sum{std::to_integer<unsigned>(row0[channel]) +
+                       std::to_integer<unsigned>(row1[channel])};
+        output[channel] = static_cast<std::byte>((2 * sum + 2) / 4);
+      }
+    } else {
+      downsampleRow(row0, row1, output, outputWidth, channels);
+    }
+  }
+}
@@ -0,0 +1,53 @@
+/**
+ * @file abcg_imageops.hpp
+ * @brief Declaration of vectorized pixel processing functions.
+ *
+ * This project is released under the MIT License.
+ */
+
+#ifndef ABCG_IMAGEOPS_HPP_
+#define ABCG_IMAGEOPS_HPP_
+
+#include <array>
+#include <cstddef>
+#include <gsl/gsl>
+
+namespace abcg::image {
+/**
+ * @brief Instruction set used by the functions of abcg::image.
+ *
+ * The best instruction set supported by the CPU is selected when the program
+ * starts. Each level also uses the instructions of the previous levels.
+ */
+enum class InstructionSet {
+  /** @brief Portable C++ code. */
+  Scalar,
+  /** @brief SSE2, part of every x86-64 CPU. */
+  SSE2,
+  /** @brief SSSE3, which adds byte shuffles. */
+  SSSE3,
+  /** @brief AVX2, which doubles the register width and adds gathers. */
+  AVX2
+};
+
+[[nodiscard]] InstructionSet getInstructionSet() noexcept;
+InstructionSet setInstructionSet(InstructionSet instructionSet) noexcept;
+
+void flipVertically(gsl::span<std::byte> pixels, std::size_t pitch);
+void convertRGBToRGBA(gsl::span<const std::byte> rgb,
+                      gsl::span<std::byte> rgba,
+                      std::byte alpha = std::byte{255});
+void convertRGBAToRGB(gsl::span<const std::byte> rgba,
+                      gsl::span<std::byte> rgb);
+void swizzleChannels(gsl::span<std::byte> pixels, int channels,
+                     std::array<int, 4> order);
+void convertSRGBToLinear(gsl::span<const std::byte> srgb,
+                         gsl::span<float> linear, int channels);
+void convertLinearToSRGB(gsl::span<const float> linear,
+                         gsl::span<std::byte> srgb, int channels);
+void premultiplyAlpha(gsl::span<std::byte> rgba);
+void downsample(gsl::span<const std::byte> source, int width, int height,
+                int channels, gsl::span<std::byte> destination);
+}  // namespace abcg::image
+
+#endif
@@ -0,0 +1,158 @@
+/**
+ * @file abcg_mappedfile.cpp
+ * @brief Definition of abcg::MappedFile class members.
+ *
+ * This project is released under the MIT License.
+ */
+
+#include "abcg_mappedfile.hpp"
+
+#include <fmt/core.h>
+
+#include <fstream>
+#include <string>
+#include <utility>
+
+#include "abcg_exception.hpp"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#elif !defined(__EMSCRIPTEN__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/**
+ * @brief Constructs an abcg::MappedFile object and opens a file.
+ *
+ * @param path Path to the file.
+ *
+ * @throw abcg::Exception if the file cannot be opened.
+ */
+abcg::MappedFile::MappedFile(std::string_view path) { open(path); }
+
+abcg::MappedFile::~MappedFile() { close(); }
+
+abcg::MappedFile::MappedFile(MappedFile&& other) noexcept {
+  *this = std::move(other);
+}
+
+abcg::MappedFile& abcg::MappedFile::operator=(MappedFile&& other) noexcept {
+  if (this != &other) {
+    close();
+    m_data = std::exchange(other.m_data, nullptr);
+    m_size = std::exchange(other.m_size, 0);
+    m_buffer = std::move(other.m_buffer);
+    m_mapped = std::exchange(other.m_mapped, false);
+    m_open = std::exchange(other.m_open, false);
+#if defined(_WIN32)
+    m_fileHandle = std::exchange(other.m_fileHandle, nullptr);
+    m_mappingHandle = std::exchange(other.m_mappingHandle, nullptr);
+#endif
+  }
+  return *this;
+}
+
+/**
+ * @brief Opens a file for reading, replacing any file currently open.
+ *
+ * @param path Path to the file.
+ *
+ * @throw abcg::Exception if the file cannot be opened.
+ */
+void abcg::MappedFile::open(std::string_view path) {
+  close();
+
+  const std::string pathString{path};
+
+#if defined(_WIN32)
+  m_fileHandle = CreateFileA(pathString.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                             nullptr, OPEN_EXISTING,
+                             FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (m_fileHandle != INVALID_HANDLE_VALUE) {
+    LARGE_INTEGER fileSize{};
+    if (GetFileSizeEx(m_fileHandle, &fileSize) != 0 && fileSize.QuadPart > 0) {
+      m_mappingHandle = CreateFileMappingA(m_fileHandle, nullptr,
+                                           PAGE_READONLY, 0, 0, nullptr);
+      if (m_mappingHandle != nullptr) {
+        if (auto* view{
+                MapViewOfFile(m_mappingHandle, FILE_MAP_READ, 0, 0, 0)}) {
+          m_data = static_cast<const std::byte*>(view);
+          m_size = static_cast<std::size_t>(fileSize.QuadPart);
+          m_mapped = true;
+          m_open = true;
+          return;
+        }
+        CloseHandle(m_mappingHandle);
+        m_mappingHandle = nullptr;
+      }
+    }
+    CloseHandle(m_fileHandle);
+  }
+  m_fileHandle = nullptr;
+#elif !defined(__EMSCRIPTEN__)
+  if (const auto fd{::open(pathString.c_str(), O_RDONLY)}; fd >= 0) {
+    struct stat fileStat {};
+    if (fstat(fd, &fileStat) == 0 && fileStat.st_size > 0) {
+      const auto fileSize{static_cast<std::size_t>(fileStat.st_size)};
+      auto* view{mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0)};
+      if (view != MAP_FAILED) {
+        // The mapping stays valid after the descriptor is closed
+        ::close(fd);
+        madvise(view, fileSize, MADV_SEQUENTIAL);
+        m_data = static_cast<const std::byte*>(view);
+        m_size = fileSize;
+        m_mapped = true;
+        m_open = true;
+        return;
+      }
+    }
+    ::close(fd);
+  }
+#endif
+
+  // Fallback: read the whole file at once
+  std::ifstream input(pathString, std::ios::binary | std::ios::ate);
+  if (!input) {
+    throw abcg::Exception{abcg::Exception::Runtime(
+        fmt::format("Failed to open file {}", path))};
+  }
+  const auto fileSize{static_cast<std::size_t>(input.tellg())};
+  m_buffer.resize(fileSize);
+  input.seekg(0);
+  if (!input.read(reinterpret_cast<char*>(m_buffer.data()),
+                  static_cast<std::streamsize>(fileSize))) {
+    m_buffer.clear();
+    throw abcg::Exception{abcg::Exception::Runtime(
+        fmt::format("Failed to read file {}", path))};
+  }
+  m_data = m_buffer.data();
+  m_size = fileSize;
+  m_open = true;
+}
+
+/**
+ * @brief Closes the file and releases the mapping.
+ */
+void abcg::MappedFile::close() noexcept {
+  if (m_mapped) {
+#if defined(_WIN32)
+    UnmapViewOfFile(m_data);
+    CloseHandle(m_mappingHandle);
+    CloseHandle(m_fileHandle);
+    m_mappingHandle = nullptr;
+    m_fileHandle = nullptr;
+#elif !defined(__EMSCRIPTEN__)
+    munmap(const_cast<std::byte*>(m_data), m_size);
+#endif
+  }
+  m_buffer.clear();
+  m_buffer.shrink_to_fit();
+  m_data = nullptr;
+  m_size = 0;
+  m_mapped = false;
+  m_open = false;
+}
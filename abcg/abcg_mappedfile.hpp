@@ -0,0 +1,64 @@
+/**
+ * @file abcg_mappedfile.hpp
+ * @brief abcg::MappedFile header file.
+ *
+ * Declaration of abcg::MappedFile class.
+ *
+ * This project is released under the MIT License.
+ */
+
+#ifndef ABCG_MAPPEDFILE_HPP_
+#define ABCG_MAPPEDFILE_HPP_
+
+#include <cstddef>
+#include <gsl/gsl>
+#include <string_view>
+#include <vector>
+
+namespace abcg {
+class MappedFile;
+}  // namespace abcg
+
+/**
+ * @brief abcg::MappedFile class.
+ *
+ * Read-only view of the contents of a file. The file is memory-mapped when
+ * the platform supports it (POSIX and Windows). Otherwise (e.g. WebAssembly),
+ * the file is read into memory with a single read operation.
+ */
+class abcg::MappedFile {
+ public:
+  MappedFile() = default;
+  explicit MappedFile(std::string_view path);
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile(MappedFile&& other) noexcept;
+  MappedFile& operator=(const MappedFile&) = delete;
+  MappedFile& operator=(MappedFile&& other) noexcept;
+
+  void open(std::string_view path);
+  void close() noexcept;
+
+  [[nodiscard]] bool isOpen() const noexcept { return m_open; }
+  [[nodiscard]] std::size_t size() const noexcept { return m_size; }
+  [[nodiscard]] gsl::span<const std::byte> getData() const noexcept {
+    return {m_data, m_size};
+  }
+
+ private:
+  const std::byte* m_data{};
+  std::size_t m_size{};
+
+  // Fallback storage when memory mapping is not available
+  std::vector<std::byte> m_buffer;
+  bool m_mapped{};
+  bool m_open{};
+
+#if defined(_WIN32)
+  void* m_fileHandle{};
+  void* m_mappingHandle{};
+#endif
+};
+
+#endif
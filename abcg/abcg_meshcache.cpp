@@ -0,0 +1,557 @@
+/**
+ * @file abcg_meshcache.cpp
+ * @brief Definition of abcg::MeshCache class members.
+ *
+ * This project is released under the MIT License.
+ */
+
+#include "abcg_meshcache.hpp"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <array>
+#include <cppitertools/itertools.hpp>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#include "abcg_exception.hpp"
+
+namespace {
+constexpr std::array<char, 8> magic{'A', 'B', 'C', 'G', 'M', 'E', 'S', 'H'};
+constexpr std::uint32_t formatVersion{7};
+constexpr std::size_t dataAlignment{16};
+
+// File header. All offsets are relative to the beginning of the file.
+struct Header {
+  std::array<char, 8> magic{};
+  std::uint32_t version{};
+  std::uint32_t vertexStride{};
+  std::uint64_t key{};
+  std::uint64_t vertexCount{};
+  std::uint64_t indexCount{};
+  std::uint64_t submeshCount{};
+  std::uint32_t materialCount{};
+  std::uint32_t flags{};
+  std::array<float, 10> bounds{};
+  // ACMR and ATVR before optimization, then after
+  std::array<float, 4> vertexCache{};
+  // Largest and RMS error of the compact position, normal and texture
+  // coordinates
+  std::array<float, 6> quantizationError{};
+  std::uint64_t lodCount{};
+  std::uint64_t lodIndexCount{};
+  std::uint64_t meshletCount{};
+  std::uint64_t materialOffset{};
+  std::uint64_t submeshOffset{};
+  std::uint64_t lodOffset{};
+  std::uint64_t meshletOffset{};
+  std::uint64_t vertexOffset{};
+  std::uint64_t indexOffset{};
+  std::uint64_t fileSize{};
+};
+static_assert(sizeof(Header) == 216,
+              "Unexpected padding in mesh cache header");
+
+// Submeshes are stored as raw abcg::Submesh records (index offset, index
+// count and material ID), followed by raw abcg::Bounds records (minimum,
+// maximum, center and radius)
+constexpr std::size_t submeshRecordSize{3 * sizeof(std::uint32_t)};
+static_assert(sizeof(abcg::Submesh) == submeshRecordSize,
+              "Unexpected padding in abcg::Submesh");
+constexpr std::size_t boundsRecordSize{10 * sizeof(float)};
+static_assert(sizeof(abcg::Bounds) == boundsRecordSize,
+              "Unexpected padding in abcg::Bounds");
+
+// Each coarser level of detail is stored as its error followed by one
+// abcg::Submesh record per submesh. Their indices follow those of the finest
+// level
+std::size_t getLODRecordSize(std::size_t submeshCount) {
+  return sizeof(float) + submeshCount * submeshRecordSize;
+}
+
+// Clusters are stored as raw abcg::Meshlet records, followed by the number of
+// clusters of each submesh
+constexpr std::size_t meshletRecordSize{10 * sizeof(float)};
+static_assert(sizeof(abcg::Meshlet) == meshletRecordSize,
+              "Unexpected padding in abcg::Meshlet");
+
+// Ka, Kd, Ks (4 floats each), shininess and length of texture name
+constexpr std::size_t materialRecordSize{13 * sizeof(float) +
+                                         sizeof(std::uint32_t)};
+
+// 64-bit FNV-1a
+void hashBytes(std::uint64_t& hash, const void* data, std::size_t size) {
+  const auto* bytes{static_cast<const unsigned char*>(data)};
+  for (std::size_t i{}; i < size; ++i) {
+    hash ^= bytes[i];
+    hash *= 0x100000001b3ULL;
+  }
+}
+
+// FNV-1a applied to 8-byte words, then to the remaining bytes. Used for whole
+// source files, which it hashes several times faster than hashBytes
+void hashContents(std::uint64_t& hash, gsl::span<const std::byte> contents) {
+  const auto wordBytes{contents.size() / sizeof(std::uint64_t) *
+                       sizeof(std::uint64_t)};
+  for (std::size_t offset{}; offset < wordBytes;
+       offset += sizeof(std::uint64_t)) {
+    std::uint64_t word{};
+    std::memcpy(&word, contents.subspan(offset).data(), sizeof(word));
+    hash ^= word;
+    hash *= 0x100000001b3ULL;
+  }
+  hashBytes(hash, contents.subspan(wordBytes).data(),
+            contents.size() - wordBytes);
+}
+
+std::size_t alignUp(std::size_t value) {
+  return (value + dataAlignment - 1) / dataAlignment * dataAlignment;
+}
+
+// Whether count records of recordSize bytes starting at offset end at or
+// before end. Written so that a corrupt count cannot overflow
+bool fits(std::uint64_t offset, std::uint64_t count, std::uint64_t recordSize,
+          std::uint64_t end) {
+  return offset <= end && count <= (end - offset) / recordSize;
+}
+
+// Whether an index range (abcg::Submesh or abcg::Meshlet) is within the
+// first indexCount indices
+template <typename T>
+bool isInRange(const T& range, std::size_t indexCount) {
+  return std::size_t{range.indexOffset} + range.indexCount <= indexCount;
+}
+}  // namespace
+
+/**
+ * @brief Returns the path of the cache file associated with a source file.
+ *
+ * @param sourcePath Path to the source mesh file (e.g. an OBJ file).
+ * @return Path to the cache file, located next to the source file.
+ */
+std::string abcg::MeshCache::getCachePath(std::string_view sourcePath) {
+  return std::string{sourcePath} + ".abcgmesh";
+}
+
+/**
+ * @brief Computes the key that identifies a version of a source file.
+ *
+ * The key is a hash of the canonical path, size and last modification time of
+ * the source file, combined with user-defined options that change the
+ * contents of the cache (e.g. whether the mesh is standardized).
+ *
+ * @param sourcePath Path to the source mesh file.
+ * @param options User-defined options used when building the mesh.
+ * @return Key of the cache file, or 0 if the source file cannot be accessed.
+ */
+std::uint64_t abcg::MeshCache::computeKey(std::string_view sourcePath,
+                                          std::uint64_t options) {
+  std::error_code error;
+  const std::filesystem::path path{sourcePath};
+  const auto canonical{std::filesystem::canonical(path, error).string()};
+  const auto size{std::filesystem::file_size(path, error)};
+  const auto mtime{
+      std::filesystem::last_write_time(path, error).time_since_epoch().count()};
+  if (error) return 0;
+
+  std::uint64_t hash{0xcbf29ce484222325ULL};
+  hashBytes(hash, canonical.data(), canonical.size());
+  hashBytes(hash, &size, sizeof(size));
+  hashBytes(hash, &mtime, sizeof(mtime));
+  hashBytes(hash, &options, sizeof(options));
+  hashBytes(hash, &formatVersion, sizeof(formatVersion));
+  return hash;
+}
+
+/**
+ * @brief Computes the key of a cache compiled at build time.
+ *
+ * The key is a hash of the contents of the source file, combined with the
+ * user-defined options. Unlike computeKey, it does not depend on the path or
+ * modification time of the source file, so that a cache compiled by
+ * abcg-assetc still matches the copy of the source installed with the
+ * executable, and never matches a source that has since been edited. The
+ * whole file is read, so computeKey is tried first.
+ *
+ * @param sourcePath Path to the source mesh file.
+ * @param options User-defined options used when building the mesh.
+ * @return Key of the cache file, or 0 if the source file cannot be read.
+ */
+std::uint64_t abcg::MeshCache::computeBuildKey(std::string_view sourcePath,
+                                               std::uint64_t options) {
+  MappedFile file;
+  try {
+    file.open(sourcePath);
+  } catch (const abcg::Exception&) {
+    return 0;
+  }
+  const auto contents{file.getData()};
+
+  std::uint64_t hash{0xcbf29ce484222325ULL};
+  hashContents(hash, contents);
+  hashBytes(hash, &options, sizeof(options));
+  hashBytes(hash, &formatVersion, sizeof(formatVersion));
+  return hash;
+}
+
+/**
+ * @brief Writes a mesh to a cache file.
+ *
+ * The file is first written to a temporary file and then renamed, so that a
+ * partially written cache is never read.
+ *
+ * @param cachePath Path to the cache file.
+ * @param key Key computed with abcg::MeshCache::computeKey or
+ * abcg::MeshCache::computeBuildKey.
+ * @param contents Mesh data to be stored.
+ *
+ * @throw abcg::Exception if the submesh, level of detail or cluster tables
+ * are inconsistent, or if the cache file cannot be written.
+ */
+void abcg::MeshCache::store(std::string_view cachePath, std::uint64_t key,
+                            const MeshCacheContents& contents) {
+  const auto submeshCount{contents.submeshes.size()};
+  const auto indexCount{contents.indices.size()};
+  const auto allIndexCount{indexCount + contents.lodIndices.size()};
+  auto isInvalid{[](const auto& ranges, std::size_t count) {
+    return std::any_of(ranges.begin(), ranges.end(), [&](const auto& range) {
+      return !isInRange(range, count);
+    });
+  }};
+  if (contents.submeshBounds.size() != submeshCount ||
+      contents.lodSubmeshes.size() != contents.lodErrors.size() * submeshCount ||
+      (!contents.submeshMeshlets.empty() &&
+       (contents.submeshMeshlets.size() != submeshCount + 1 ||
+        contents.submeshMeshlets.back() != contents.meshlets.size())) ||
+      isInvalid(contents.submeshes, indexCount) ||
+      isInvalid(contents.lodSubmeshes, allIndexCount) ||
+      isInvalid(contents.meshlets, indexCount)) {
+    throw abcg::Exception{abcg::Exception::Runtime(
+        fmt::format("Invalid submesh table for mesh cache {}", cachePath))};
+  }
+
+  // Serialize material table
+  std::vector<std::byte> materialTable;
+  for (const auto& material : contents.materials) {
+    std::array<float, 13> values{
+        material.Ka.r, material.Ka.g, material.Ka.b, material.Ka.a,
+        material.Kd.r, material.Kd.g, material.Kd.b, material.Kd.a,
+        material.Ks.r, material.Ks.g, material.Ks.b, material.Ks.a,
+        material.shininess};
+    const auto nameLength{
+        static_cast<std::uint32_t>(material.diffuseTexName.size())};
+    const auto offset{materialTable.size()};
+    materialTable.resize(offset + materialRecordSize + nameLength);
+    auto* record{materialTable.data() + offset};
+    std::memcpy(record, values.data(), sizeof(values));
+    std::memcpy(record + sizeof(values), &nameLength, sizeof(nameLength));
+    std::memcpy(record + materialRecordSize, material.diffuseTexName.data(),
+                nameLength);
+  }
+
+  // Serialize level of detail table
+  std::vector<std::byte> lodTable(contents.lodErrors.size() *
+                                  getLODRecordSize(submeshCount));
+  for (const auto level : iter::range(contents.lodErrors.size())) {
+    auto* record{lodTable.data() + level * getLODRecordSize(submeshCount)};
+    std::memcpy(record, &contents.lodErrors[level], sizeof(float));
+    std::memcpy(record + sizeof(float),
+                contents.lodSubmeshes.subspan(level * submeshCount).data(),
+                submeshCount * submeshRecordSize);
+  }
+
+  // Number of clusters of each submesh
+  std::vector<std::uint32_t> meshletCounts(submeshCount);
+  if (!contents.submeshMeshlets.empty()) {
+    for (const auto submesh : iter::range(submeshCount)) {
+      meshletCounts[submesh] =
+          static_cast<std::uint32_t>(contents.submeshMeshlets[submesh + 1] -
+                                     contents.submeshMeshlets[submesh]);
+    }
+  }
+
+  Header header{};
+  header.magic = magic;
+  header.version = formatVersion;
+  header.vertexStride = static_cast<std::uint32_t>(contents.vertexStride);
+  header.key = key;
+  header.vertexCount =
+      contents.vertexStride == 0
+          ? 0
+          : contents.vertices.size() / contents.vertexStride;
+  header.indexCount = indexCount;
+  header.submeshCount = submeshCount;
+  header.materialCount = static_cast<std::uint32_t>(contents.materials.size());
+  header.flags = contents.flags;
+  const auto& bounds{contents.bounds};
+  header.bounds = {bounds.min.x,    bounds.min.y,    bounds.min.z,
+                   bounds.max.x,    bounds.max.y,    bounds.max.z,
+                   bounds.center.x, bounds.center.y, bounds.center.z,
+                   bounds.radius};
+  header.vertexCache = {
+      contents.vertexCacheBefore.ACMR, contents.vertexCacheBefore.ATVR,
+      contents.vertexCacheAfter.ACMR, contents.vertexCacheAfter.ATVR};
+  header.quantizationError = {contents.quantizationError.position.max,
+                              contents.quantizationError.position.rms,
+                              contents.quantizationError.normal.max,
+                              contents.quantizationError.normal.rms,
+                              contents.quantizationError.texCoord.max,
+                              contents.quantizationError.texCoord.rms};
+  header.lodCount = contents.lodErrors.size();
+  header.lodIndexCount = contents.lodIndices.size();
+  header.meshletCount = contents.meshlets.size();
+  header.materialOffset = sizeof(Header);
+  header.submeshOffset = header.materialOffset + materialTable.size();
+  header.lodOffset = header.submeshOffset + contents.submeshes.size_bytes() +
+                     contents.submeshBounds.size_bytes();
+  header.meshletOffset = header.lodOffset + lodTable.size();
+  header.vertexOffset =
+      alignUp(header.meshletOffset + contents.meshlets.size_bytes() +
+              meshletCounts.size() * sizeof(std::uint32_t));
+  header.indexOffset =
+      alignUp(header.vertexOffset + contents.vertices.size_bytes());
+  header.fileSize = header.indexOffset + contents.indices.size_bytes() +
+                    contents.lodIndices.size_bytes();
+
+  const auto tempPath{std::string{cachePath} + ".tmp"};
+  {
+    std::ofstream output(tempPath, std::ios::binary | std::ios::trunc);
+    if (!output) {
+      throw abcg::Exception{abcg::Exception::Runtime(
+          fmt::format("Failed to create mesh cache {}", cachePath))};
+    }
+
+    const std::array<char, dataAlignment> padding{};
+    auto pad{[&](std::uint64_t offset) {
+      const auto current{static_cast<std::uint64_t>(output.tellp())};
+      output.write(padding.data(),
+                   static_cast<std::streamsize>(offset - current));
+    }};
+
+    output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    output.write(reinterpret_cast<const char*>(materialTable.data()),
+                 static_cast<std::streamsize>(materialTable.size()));
+    output.write(reinterpret_cast<const char*>(contents.submeshes.data()),
+                 static_cast<std::streamsize>(contents.submeshes.size_bytes()));
+    output.write(
+        reinterpret_cast<const char*>(contents.submeshBounds.data()),
+        static_cast<std::streamsize>(contents.submeshBounds.size_bytes()));
+    output.write(reinterpret_cast<const char*>(lodTable.data()),
+                 static_cast<std::streamsize>(lodTable.size()));
+    output.write(reinterpret_cast<const char*>(contents.meshlets.data()),
+                 static_cast<std::streamsize>(contents.meshlets.size_bytes()));
+    output.write(reinterpret_cast<const char*>(meshletCounts.data()),
+                 static_cast<std::streamsize>(meshletCounts.size() *
+                                              sizeof(std::uint32_t)));
+    pad(header.vertexOffset);
+    output.write(reinterpret_cast<const char*>(contents.vertices.data()),
+                 static_cast<std::streamsize>(contents.vertices.size_bytes()));
+    pad(header.indexOffset);
+    output.write(reinterpret_cast<const char*>(contents.indices.data()),
+                 static_cast<std::streamsize>(contents.indices.size_bytes()));
+    output.write(
+        reinterpret_cast<const char*>(contents.lodIndices.data()),
+        static_cast<std::streamsize>(contents.lodIndices.size_bytes()));
+
+    if (!output) {
+      throw abcg::Exception{abcg::Exception::Runtime(
+          fmt::format("Failed to write mesh cache {}", cachePath))};
+    }
+  }
+
+  std::error_code error;
+  std::filesystem::rename(tempPath, cachePath, error);
+  if (error) {
+    std::filesystem::remove(tempPath, error);
+    throw abcg::Exception{abcg::Exception::Runtime(
+        fmt::format("Failed to write mesh cache {}", cachePath))};
+  }
+}
+
+/**
+ * @brief Maps a cache file into memory.
+ *
+ * @param cachePath Path to the cache file.
+ * @param key Expected key of the cache file.
+ * @param vertexStride Expected size of each vertex, in bytes.
+ * @return true if the cache file exists, is valid and matches the key and
+ * vertex stride; false otherwise.
+ */
+bool abcg::MeshCache::load(std::string_view cachePath, std::uint64_t key,
+                           std::size_t vertexStride) {
+  close();
+
+  std::error_code error;
+  if (key == 0 || !std::filesystem::exists(cachePath, error)) return false;
+
+  try {
+    m_file.open(cachePath);
+  } catch (const abcg::Exception&) {
+    return false;
+  }
+
+  const auto data{m_file.getData()};
+  Header header{};
+  if (data.size() < sizeof(Header)) {
+    close();
+    return false;
+  }
+  std::memcpy(&header, data.data(), sizeof(Header));
+
+  // Each count is checked against the size of its section before it is
+  // multiplied, so that a corrupt header cannot overflow the offsets
+  const std::uint64_t fileSize{data.size()};
+  const auto submeshCount{header.submeshCount};
+  const auto meshletCountsOffset{header.meshletOffset +
+                                 header.meshletCount * meshletRecordSize};
+  const auto lodIndexOffset{header.indexOffset +
+                            header.indexCount * sizeof(std::uint32_t)};
+  if (header.magic != magic || header.version != formatVersion ||
+      header.key != key || header.vertexStride != vertexStride ||
+      header.fileSize != fileSize || vertexStride == 0 ||
+      header.materialOffset > header.submeshOffset ||
+      !fits(header.submeshOffset, submeshCount,
+            submeshRecordSize + boundsRecordSize, header.lodOffset) ||
+      !fits(header.lodOffset, header.lodCount, getLODRecordSize(submeshCount),
+            header.meshletOffset) ||
+      !fits(header.meshletOffset, header.meshletCount, meshletRecordSize,
+            header.vertexOffset) ||
+      !fits(meshletCountsOffset, submeshCount, sizeof(std::uint32_t),
+            header.vertexOffset) ||
+      !fits(header.vertexOffset, header.vertexCount, header.vertexStride,
+            header.indexOffset) ||
+      !fits(header.indexOffset, header.indexCount, sizeof(std::uint32_t),
+            fileSize) ||
+      !fits(lodIndexOffset, header.lodIndexCount, sizeof(std::uint32_t),
+            fileSize) ||
+      header.vertexOffset % dataAlignment != 0 ||
+      header.indexOffset % dataAlignment != 0) {
+    close();
+    return false;
+  }
+
+  // Parse material table
+  std::size_t offset{header.materialOffset};
+  for (std::uint32_t index{}; index < header.materialCount; ++index) {
+    if (offset + materialRecordSize > header.submeshOffset) {
+      close();
+      return false;
+    }
+    std::array<float, 13> values{};
+    std::uint32_t nameLength{};
+    std::memcpy(values.data(), data.subspan(offset).data(), sizeof(values));
+    std::memcpy(&nameLength, data.subspan(offset + sizeof(values)).data(),
+                sizeof(nameLength));
+    offset += materialRecordSize;
+    if (offset + nameLength > header.submeshOffset) {
+      close();
+      return false;
+    }
+
+    MeshCacheMaterial material{};
+    material.Ka = {values[0], values[1], values[2], values[3]};
+    material.Kd = {values[4], values[5], values[6], values[7]};
+    material.Ks = {values[8], values[9], values[10], values[11]};
+    material.shininess = values[12];
+    material.diffuseTexName.assign(
+        reinterpret_cast<const char*>(data.subspan(offset).data()),
+        nameLength);
+    offset += nameLength;
+    m_materials.push_back(std::move(material));
+  }
+
+  m_vertices = data.subspan(header.vertexOffset,
+                            header.vertexCount * header.vertexStride);
+  m_indices = {reinterpret_cast<const std::uint32_t*>(
+                   data.subspan(header.indexOffset).data()),
+               header.indexCount};
+  m_lodIndices = {reinterpret_cast<const std::uint32_t*>(
+                      data.subspan(lodIndexOffset).data()),
+                  header.lodIndexCount};
+  const auto& bounds{header.bounds};
+  m_bounds = {.min = {bounds[0], bounds[1], bounds[2]},
+              .max = {bounds[3], bounds[4], bounds[5]},
+              .center = {bounds[6], bounds[7], bounds[8]},
+              .radius = bounds[9]};
+  const auto& vertexCache{header.vertexCache};
+  m_vertexCacheBefore = {.ACMR = vertexCache[0], .ATVR = vertexCache[1]};
+  m_vertexCacheAfter = {.ACMR = vertexCache[2], .ATVR = vertexCache[3]};
+  const auto& quantizationError{header.quantizationError};
+  m_quantizationError = {
+      .position = {.max = quantizationError[0], .rms = quantizationError[1]},
+      .normal = {.max = quantizationError[2], .rms = quantizationError[3]},
+      .texCoord = {.max = quantizationError[4], .rms = quantizationError[5]}};
+
+  const auto submeshData{data.subspan(header.submeshOffset)};
+  m_submeshes.resize(submeshCount);
+  std::memcpy(static_cast<void*>(m_submeshes.data()), submeshData.data(),
+              submeshCount * submeshRecordSize);
+  m_submeshBounds.resize(submeshCount);
+  std::memcpy(static_cast<void*>(m_submeshBounds.data()),
+              submeshData.subspan(submeshCount * submeshRecordSize).data(),
+              submeshCount * boundsRecordSize);
+
+  const auto lodData{data.subspan(header.lodOffset)};
+  m_lodErrors.resize(header.lodCount);
+  m_lodSubmeshes.resize(header.lodCount * submeshCount);
+  for (const auto level : iter::range(m_lodErrors.size())) {
+    const auto record{lodData.subspan(level * getLODRecordSize(submeshCount))};
+    std::memcpy(&m_lodErrors[level], record.data(), sizeof(float));
+    std::memcpy(static_cast<void*>(&m_lodSubmeshes[level * submeshCount]),
+                record.subspan(sizeof(float)).data(),
+                submeshCount * submeshRecordSize);
+  }
+
+  m_meshlets.resize(header.meshletCount);
+  std::memcpy(static_cast<void*>(m_meshlets.data()),
+              data.subspan(header.meshletOffset).data(),
+              header.meshletCount * meshletRecordSize);
+  std::vector<std::uint32_t> meshletCounts(submeshCount);
+  std::memcpy(meshletCounts.data(), data.subspan(meshletCountsOffset).data(),
+              submeshCount * sizeof(std::uint32_t));
+  m_submeshMeshlets = {0};
+  for (const auto count : meshletCounts) {
+    m_submeshMeshlets.push_back(m_submeshMeshlets.back() + count);
+  }
+
+  const auto allIndexCount{m_indices.size() + m_lodIndices.size()};
+  auto isInvalid{[](const auto& ranges, std::size_t count) {
+    return std::any_of(ranges.begin(), ranges.end(), [&](const auto& range) {
+      return !isInRange(range, count);
+    });
+  }};
+  if (m_submeshMeshlets.back() != m_meshlets.size() ||
+      isInvalid(m_submeshes, m_indices.size()) ||
+      isInvalid(m_lodSubmeshes, allIndexCount) ||
+      isInvalid(m_meshlets, m_indices.size())) {
+    close();
+    return false;
+  }
+  m_flags = header.flags;
+
+  return true;
+}
+
+/**
+ * @brief Releases the mapping of the cache file.
+ */
+void abcg::MeshCache::close() noexcept {
+  m_file.close();
+  m_vertices = {};
+  m_indices = {};
+  m_materials.clear();
+  m_bounds = {};
+  m_submeshes.clear();
+  m_submeshBounds.clear();
+  m_lodErrors.clear();
+  m_lodSubmeshes.clear();
+  m_lodIndices = {};
+  m_meshlets.clear();
+  m_submeshMeshlets.clear();
+  m_vertexCacheBefore = {};
+  m_vertexCacheAfter = {};
+  m_quantizationError = {};
+  m_flags = 0;
+}
@@ -0,0 +1,207 @@
+/**
+ * @file abcg_meshcache.hpp
+ * @brief abcg::MeshCache header file.
+ *
+ * Declaration of abcg::MeshCache class and of the binary mesh format used to
+ * skip OBJ parsing on subsequent loads.
+ *
+ * This project is released under the MIT License.
+ */
+
+#ifndef ABCG_MESHCACHE_HPP_
+#define ABCG_MESHCACHE_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <gsl/gsl>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "abcg_bounds.hpp"
+#include "abcg_mappedfile.hpp"
+#include "abcg_meshoptimizer.hpp"
+
+namespace abcg {
+class MeshCache;
+struct MeshCacheMaterial;
+struct MeshCacheContents;
+struct QuantizationError;
+}  // namespace abcg
+
+/**
+ * @brief Material properties stored in the mesh cache.
+ *
+ */
+struct abcg::MeshCacheMaterial {
+  glm::vec4 Ka{};
+  glm::vec4 Kd{};
+  glm::vec4 Ks{};
+  float shininess{};
+  std::string diffuseTexName{};
+};
+
+/**
+ * @brief Largest and root mean square difference between the attributes of
+ * abcg::MeshVertex and those decoded from abcg::PackedMeshVertex.
+ *
+ */
+struct abcg::QuantizationError {
+  struct Error {
+    float max{};
+    float rms{};
+  };
+  /** @brief Position error, in object space units. */
+  Error position{};
+  Error normal{};
+  Error texCoord{};
+};
+
+/**
+ * @brief Contents of a mesh to be written to the mesh cache.
+ *
+ * Vertices are stored as raw bytes so that any trivially copyable vertex
+ * layout can be cached. The stride is validated when the cache is loaded.
+ */
+struct abcg::MeshCacheContents {
+  gsl::span<const std::byte> vertices{};
+  std::size_t vertexStride{};
+  gsl::span<const std::uint32_t> indices{};
+  std::vector<MeshCacheMaterial> materials{};
+  Bounds bounds{};
+  /** @brief Index ranges of each material, as returned by
+   * abcg::sortByMaterial. */
+  gsl::span<const Submesh> submeshes{};
+  /** @brief Bounds of each submesh. */
+  gsl::span<const Bounds> submeshBounds{};
+  /** @brief Geometric error of each coarser level of detail. */
+  gsl::span<const float> lodErrors{};
+  /** @brief Index range of each submesh in each coarser level of detail,
+   * level by level. */
+  gsl::span<const Submesh> lodSubmeshes{};
+  /** @brief Indices of the coarser levels of detail, which follow indices. */
+  gsl::span<const std::uint32_t> lodIndices{};
+  /** @brief Clusters of the finest level of detail, grouped by submesh. */
+  gsl::span<const Meshlet> meshlets{};
+  /** @brief Position of the first cluster of each submesh in meshlets,
+   * followed by the number of clusters. */
+  gsl::span<const std::size_t> submeshMeshlets{};
+  /** @brief Vertex cache statistics of indices before and after
+   * optimization. */
+  VertexCacheStatistics vertexCacheBefore{};
+  VertexCacheStatistics vertexCacheAfter{};
+  /** @brief Precision lost by the compact vertices. */
+  QuantizationError quantizationError{};
+  std::uint32_t flags{};
+};
+
+/**
+ * @brief abcg::MeshCache class.
+ *
+ * Reads and writes a compact binary representation of a deduplicated mesh
+ * (vertices, indices, material table, index range of each material, bounds of
+ * the mesh and of each submesh, levels of detail, clusters, vertex cache
+ * statistics and quantization error). Each cache file is keyed on the canonical
+ * path, size and modification time of its source file (computeKey), so that a
+ * stale cache is rebuilt whenever the source changes.  Caches compiled ahead of
+ * time by abcg-assetc are keyed on a hash of the contents of the source file
+ * instead (computeBuildKey), which still matches after the assets are copied
+ * next to the executable.
+ */
+class abcg::MeshCache {
+ public:
+  /**
+   * @brief Flags stored with the cached mesh.
+   *
+   */
+  enum Flags : std::uint32_t { HasNormals = 1U << 0U, HasTexCoords = 1U << 1U };
+
+  [[nodiscard]] static std::string getCachePath(std::string_view sourcePath);
+  [[nodiscard]] static std::uint64_t computeKey(std::string_view sourcePath,
+                                                std::uint64_t options = 0);
+  [[nodiscard]] static std::uint64_t computeBuildKey(
+      std::string_view sourcePath, std::uint64_t options = 0);
+  static void store(std::string_view cachePath, std::uint64_t key,
+                    const MeshCacheContents& contents);
+
+  bool load(std::string_view cachePath, std::uint64_t key,
+            std::size_t vertexStride);
+  void close() noexcept;
+
+  /**
+   * @brief Returns a view of the cached vertices.
+   *
+   * @tparam T Vertex type. Its size must match the stride given to load().
+   */
+  template <typename T>
+  [[nodiscard]] gsl::span<const T> getVertices() const noexcept {
+    return {reinterpret_cast<const T*>(m_vertices.data()),
+            m_vertices.size() / sizeof(T)};
+  }
+  [[nodiscard]] gsl::span<const std::uint32_t> getIndices() const noexcept {
+    return m_indices;
+  }
+  [[nodiscard]] const std::vector<MeshCacheMaterial>& getMaterials()
+      const noexcept {
+    return m_materials;
+  }
+  [[nodiscard]] const Bounds& getBounds() const noexcept { return m_bounds; }
+  [[nodiscard]] gsl::span<const Submesh> getSubmeshes() const noexcept {
+    return m_submeshes;
+  }
+  [[nodiscard]] const std::vector<Bounds>& getSubmeshBounds() const noexcept {
+    return m_submeshBounds;
+  }
+  [[nodiscard]] const std::vector<float>& getLODErrors() const noexcept {
+    return m_lodErrors;
+  }
+  [[nodiscard]] const std::vector<Submesh>& getLODSubmeshes() const noexcept {
+    return m_lodSubmeshes;
+  }
+  [[nodiscard]] gsl::span<const std::uint32_t> getLODIndices() const noexcept {
+    return m_lodIndices;
+  }
+  [[nodiscard]] const std::vector<Meshlet>& getMeshlets() const noexcept {
+    return m_meshlets;
+  }
+  [[nodiscard]] const std::vector<std::size_t>& getSubmeshMeshlets()
+      const noexcept {
+    return m_submeshMeshlets;
+  }
+  [[nodiscard]] const VertexCacheStatistics& getVertexCacheBefore()
+      const noexcept {
+    return m_vertexCacheBefore;
+  }
+  [[nodiscard]] const VertexCacheStatistics& getVertexCacheAfter()
+      const noexcept {
+    return m_vertexCacheAfter;
+  }
+  [[nodiscard]] const QuantizationError& getQuantizationError()
+      const noexcept {
+    return m_quantizationError;
+  }
+  [[nodiscard]] std::uint32_t getFlags() const noexcept { return m_flags; }
+
+ private:
+  MappedFile m_file;
+
+  gsl::span<const std::byte> m_vertices{};
+  gsl::span<const std::uint32_t> m_indices{};
+  std::vector<MeshCacheMaterial> m_materials;
+  Bounds m_bounds{};
+  std::vector<Submesh> m_submeshes;
+  std::vector<Bounds> m_submeshBounds;
+  std::vector<float> m_lodErrors;
+  std::vector<Submesh> m_lodSubmeshes;
+  gsl::span<const std::uint32_t> m_lodIndices{};
+  std::vector<Meshlet> m_meshlets;
+  std::vector<std::size_t> m_submeshMeshlets;
+  VertexCacheStatistics m_vertexCacheBefore{};
+  VertexCacheStatistics m_vertexCacheAfter{};
+  QuantizationError m_quantizationError{};
+  std::uint32_t m_flags{};
+};
+
+#endif
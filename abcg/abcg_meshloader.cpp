@@ -0,0 +1,674 @@
+/**
+ * @file abcg_meshloader.cpp
+ * @brief Definition of the functions that load OBJ files into indexed
+ * triangle meshes ready to be drawn.
+ *
+ * This project is released under the MIT License.
+ */
+
+#include "abcg_meshloader.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cppitertools/itertools.hpp>
+#include <cstring>
+#include <filesystem>
+#include <glm/gtc/packing.hpp>
+#include <glm/gtx/component_wise.hpp>
+#include <glm/gtx/hash.hpp>
+#include <limits>
+#include <utility>
+
+#include "abcg_exception.hpp"
+#include "abcg_objreader.hpp"
+#include "abcg_vertexwelder.hpp"
+
+namespace {
+struct MeshVertexHash {
+  std::size_t operator()(const abcg::MeshVertex& vertex) const noexcept {
+    std::size_t seed{};
+    abcg::hashCombine(seed, vertex.position);
+    abcg::hashCombine(seed, vertex.normal);
+    abcg::hashCombine(seed, vertex.texCoord);
+    return seed;
+  }
+};
+
+template <typename T>
+std::vector<std::byte> toBytes(gsl::span<const T> values) {
+  std::vector<std::byte> bytes(values.size_bytes());
+  if (!bytes.empty()) std::memcpy(bytes.data(), values.data(), bytes.size());
+  return bytes;
+}
+
+// Compact positions are relative to the bounding box, so that their
+// precision does not depend on the scale or placement of the mesh. Flat
+// axes get a tiny scale, so that they are decoded exactly
+glm::vec3 getPositionScale(const abcg::Bounds& bounds) {
+  return glm::max(bounds.max - bounds.min,
+                  glm::vec3{std::numeric_limits<float>::min()});
+}
+
+abcg::PackedMeshVertex packVertex(const abcg::MeshVertex& vertex,
+                                  const glm::vec3& positionOffset,
+                                  const glm::vec3& positionScale) {
+  const auto position{glm::clamp(
+      (vertex.position - positionOffset) / positionScale, 0.0f, 1.0f)};
+  return {.position = {glm::packUnorm1x16(position.x),
+                       glm::packUnorm1x16(position.y),
+                       glm::packUnorm1x16(position.z), 0},
+          .normal = glm::packSnorm3x10_1x2(glm::vec4(vertex.normal, 0.0f)),
+          .texCoord = {glm::packHalf1x16(vertex.texCoord.x),
+                       glm::packHalf1x16(vertex.texCoord.y)}};
+}
+
+abcg::MeshVertex unpackVertex(const abcg::PackedMeshVertex& vertex,
+                              const glm::vec3& positionOffset,
+                              const glm::vec3& positionScale) {
+  const glm::vec3 position{glm::unpackUnorm1x16(vertex.position[0]),
+                           glm::unpackUnorm1x16(vertex.position[1]),
+                           glm::unpackUnorm1x16(vertex.position[2])};
+  return {.position = positionOffset + position * positionScale,
+          .normal = glm::vec3(glm::unpackSnorm3x10_1x2(vertex.normal)),
+          .texCoord = {glm::unpackHalf1x16(vertex.texCoord[0]),
+                       glm::unpackHalf1x16(vertex.texCoord[1])}};
+}
+
+// Packs and unpacks every vertex as abcg::packMeshBuffers would
+abcg::QuantizationError measureQuantizationError(const abcg::Mesh& mesh) {
+  const auto positionScale{getPositionScale(mesh.bounds)};
+  abcg::QuantizationError error;
+  auto accumulate{[](abcg::QuantizationError::Error& statistics,
+                      float distance) {
+    statistics.max = std::max(statistics.max, distance);
+    statistics.rms += distance * distance;
+  }};
+  for (const auto& vertex : mesh.vertices) {
+    const auto decoded{unpackVertex(
+        packVertex(vertex, mesh.bounds.min, positionScale), mesh.bounds.min,
+        positionScale)};
+    accumulate(error.position,
+               glm::distance(vertex.position, decoded.position));
+    accumulate(error.normal, glm::distance(vertex.normal, decoded.normal));
+    accumulate(error.texCoord,
+               glm::distance(vertex.texCoord, decoded.texCoord));
+  }
+  if (!mesh.vertices.empty()) {
+    const auto count{static_cast<float>(mesh.vertices.size())};
+    for (auto* statistics :
+         {&error.position, &error.normal, &error.texCoord}) {
+      statistics->rms = std::sqrt(statistics->rms / count);
+    }
+  }
+  return error;
+}
+
+std::string getBasePath(std::string_view path) {
+  return std::filesystem::path{path}.parent_path().string() + "/";
+}
+
+gsl::span<std::uint32_t> getSubmeshIndices(abcg::Mesh& mesh,
+                                           const abcg::Submesh& submesh) {
+  return gsl::span{mesh.indices}.subspan(submesh.indexOffset,
+                                         submesh.indexCount);
+}
+
+std::vector<glm::vec3> getPositions(const abcg::Mesh& mesh) {
+  std::vector<glm::vec3> positions(mesh.vertices.size());
+  std::transform(
+      mesh.vertices.begin(), mesh.vertices.end(), positions.begin(),
+      [](const abcg::MeshVertex& vertex) { return vertex.position; });
+  return positions;
+}
+
+void resolveTexturePaths(abcg::Mesh& mesh, std::string_view basePath) {
+  mesh.diffuseTexturePaths.clear();
+  for (const auto& material : mesh.materials) {
+    // Some exporters write Windows path separators. The path is normalized
+    // so that materials that use the same file share the texture
+    auto texName{material.diffuseTexName};
+    std::replace(texName.begin(), texName.end(), '\\', '/');
+    mesh.diffuseTexturePaths.push_back(
+        texName.empty()
+            ? std::string{}
+            : std::filesystem::path{std::string{basePath} + texName}
+                  .lexically_normal()
+                  .string());
+  }
+}
+
+// Centers the mesh at the origin and normalizes its largest bound to [-1, 1]
+void standardizeMesh(abcg::Mesh& mesh) {
+  const auto center{(mesh.bounds.min + mesh.bounds.max) / 2.0f};
+  const auto scaling{2.0f / glm::length(mesh.bounds.max - mesh.bounds.min)};
+  for (auto& vertex : mesh.vertices) {
+    vertex.position = (vertex.position - center) * scaling;
+  }
+
+  // Apply the same transform to the bounds
+  mesh.bounds = abcg::transformBounds(mesh.bounds, scaling, -center * scaling);
+  for (auto& bounds : mesh.submeshBounds) {
+    bounds = abcg::transformBounds(bounds, scaling, -center * scaling);
+  }
+}
+
+// Reorders triangles for the post-transform vertex cache, then clusters of
+// triangles for overdraw, within each submesh. Then reorders vertices for
+// pre-transform fetch locality
+void optimizeMesh(abcg::Mesh& mesh) {
+  const auto positions{getPositions(mesh)};
+  for (const auto& submesh : mesh.submeshes) {
+    const auto indices{getSubmeshIndices(mesh, submesh)};
+    abcg::optimizeVertexCache(indices, mesh.vertices.size());
+    abcg::optimizeOverdraw(indices, positions);
+  }
+  abcg::optimizeVertexFetch(mesh.vertices, mesh.indices);
+}
+
+// Each level halves the triangle count of the previous one, until the
+// simplifier stalls or the mesh gets too coarse. Submeshes are simplified
+// separately so that each level keeps one index range per material
+void generateLODs(abcg::Mesh& mesh, const abcg::MeshLoadOptions& options) {
+  mesh.lods = {{.submeshes = mesh.submeshes,
+                .indexCount = mesh.indices.size(),
+                .error = 0.0f}};
+  mesh.lodIndices.clear();
+
+  const auto extent{glm::compMax(mesh.bounds.max - mesh.bounds.min)};
+  const auto positions{getPositions(mesh)};
+
+  std::vector<std::vector<std::uint32_t>> submeshIndices;
+  for (const auto& submesh : mesh.submeshes) {
+    const auto indices{getSubmeshIndices(mesh, submesh)};
+    submeshIndices.emplace_back(indices.begin(), indices.end());
+  }
+  auto error{0.0f};
+  while (mesh.lods.back().indexCount / 3 > options.minLODTriangles) {
+    auto simplifiedAny{false};
+    auto levelError{0.0f};
+    for (auto& indices : submeshIndices) {
+      if (indices.empty()) continue;
+      auto simplified{abcg::simplify(indices, positions,
+                                     indices.size() / 6 * 3,
+                                     options.maxLODError)};
+      // Submeshes that stall are kept as they are
+      if (simplified.indices.size() > indices.size() * 9 / 10) continue;
+
+      simplifiedAny = true;
+      levelError = std::max(levelError, simplified.error);
+      abcg::optimizeVertexCache(simplified.indices, mesh.vertices.size());
+      indices = std::move(simplified.indices);
+    }
+    if (!simplifiedAny) break;
+
+    // Errors of successive simplifications add up at most
+    error += levelError * extent;
+    abcg::MeshLOD level{.error = error};
+    for (auto&& [submesh, indices] :
+         iter::zip(mesh.submeshes, submeshIndices)) {
+      level.submeshes.push_back(
+          {.indexOffset = static_cast<std::uint32_t>(mesh.indices.size() +
+                                                     mesh.lodIndices.size()),
+           .indexCount = static_cast<std::uint32_t>(indices.size()),
+           .materialID = submesh.materialID});
+      level.indexCount += indices.size();
+      mesh.lodIndices.insert(mesh.lodIndices.end(), indices.begin(),
+                             indices.end());
+    }
+    mesh.lods.push_back(std::move(level));
+  }
+}
+
+// Reorders each submesh so that each cluster is a contiguous range
+void buildClusters(abcg::Mesh& mesh) {
+  const auto positions{getPositions(mesh)};
+  mesh.meshlets.clear();
+  mesh.submeshMeshlets = {0};
+  for (const auto& submesh : mesh.submeshes) {
+    auto meshlets{
+        abcg::buildMeshlets(getSubmeshIndices(mesh, submesh), positions)};
+    for (auto& meshlet : meshlets) {
+      meshlet.indexOffset += submesh.indexOffset;
+    }
+    mesh.meshlets.insert(mesh.meshlets.end(), meshlets.begin(),
+                         meshlets.end());
+    mesh.submeshMeshlets.push_back(mesh.meshlets.size());
+  }
+}
+}  // namespace
+
+/**
+ * @brief Returns the options that change the processed mesh, as hashed into
+ * the key of its mesh cache.
+ *
+ * @return Bit 0 if the mesh is standardized, bit 1 if it is optimized and bit
+ * 2 if its normals are weighted by angle. Bits 8 to 31 hold minLODTriangles,
+ * saturated, and bits 32 to 63 the bit pattern of maxLODError.
+ */
+std::uint64_t abcg::MeshLoadOptions::getCacheOptions() const noexcept {
+  const std::uint64_t flags{
+      (standardize ? 1U : 0U) | (optimize ? 2U : 0U) |
+      (normalWeighting == NormalWeighting::Angle ? 4U : 0U)};
+  const std::uint64_t minTriangles{
+      std::min<std::size_t>(minLODTriangles, 0xFFFFFF)};
+  const std::uint64_t maxError{std::bit_cast<std::uint32_t>(maxLODError)};
+  return flags | minTriangles << 8U | maxError << 32U;
+}
+
+/**
+ * @brief Parses an OBJ file and processes its mesh, without using the mesh
+ * cache.
+ *
+ * Vertices are welded, triangles are grouped by material, the bounds of the
+ * mesh and of each submesh are computed, the mesh is optionally
+ * standardized, missing normals are computed and the buffers are optionally
+ * reordered for the vertex cache, overdraw and vertex fetch. Then levels of
+ * detail are generated, and the finest one is split into clusters.
+ *
+ * Only touches CPU memory, so it can be called from worker threads.
+ *
+ * @param path Path to the OBJ file. Material libraries are searched in the
+ * same directory.
+ * @param options Mesh processing options.
+ * @param progress Progress of the load, updated at each stage.
+ * @return Processed mesh.
+ *
+ * @throw abcg::Exception if the file cannot be parsed, or if the load is
+ * cancelled.
+ */
+abcg::Mesh abcg::buildMesh(std::string_view path,
+                           const MeshLoadOptions& options,
+                           LoadProgress& progress) {
+  const auto basePath{getBasePath(path)};
+
+  progress.setStage("Parsing", 0.0f);
+  ObjReader reader;
+  reader.parseFromFile(path, basePath);  // Path to material files
+
+  Mesh mesh;
+  mesh.warning = reader.getWarning();
+  const auto& attrib{reader.getAttrib()};
+  const auto& shapes{reader.getShapes()};
+
+  // Count the indices to size the vertex deduplication table
+  progress.setStage("Welding vertices", 0.3f);
+  std::size_t numIndices{};
+  for (const auto& shape : shapes) {
+    numIndices += shape.mesh.indices.size();
+  }
+  mesh.indices.reserve(numIndices);
+  VertexWelder<MeshVertex, MeshVertexHash> welder{mesh.vertices, numIndices};
+
+  // Material of each triangle
+  std::vector<int> materialIDs;
+  materialIDs.reserve(numIndices / 3);
+
+  for (const auto& shape : shapes) {
+    materialIDs.insert(materialIDs.end(), shape.mesh.material_ids.begin(),
+                       shape.mesh.material_ids.end());
+    for (const auto& index : shape.mesh.indices) {
+      MeshVertex vertex{};
+      auto startIndex{3 * static_cast<std::size_t>(index.vertex_index)};
+      vertex.position = {attrib.vertices.at(startIndex + 0),
+                         attrib.vertices.at(startIndex + 1),
+                         attrib.vertices.at(startIndex + 2)};
+      if (index.normal_index >= 0) {
+        mesh.hasNormals = true;
+        startIndex = 3 * static_cast<std::size_t>(index.normal_index);
+        vertex.normal = {attrib.normals.at(startIndex + 0),
+                         attrib.normals.at(startIndex + 1),
+                         attrib.normals.at(startIndex + 2)};
+      }
+      if (index.texcoord_index >= 0) {
+        mesh.hasTexCoords = true;
+        startIndex = 2 * static_cast<std::size_t>(index.texcoord_index);
+        vertex.texCoord = {attrib.texcoords.at(startIndex + 0),
+                           attrib.texcoords.at(startIndex + 1)};
+      }
+
+      // Add the vertex if it is new and get its index
+      mesh.indices.push_back(welder.insert(vertex));
+    }
+  }
+
+  // Group triangles by material so that each material is drawn at once. The
+  // following stages reorder triangles within each submesh only
+  mesh.submeshes = sortByMaterial(mesh.indices, materialIDs);
+
+  // Bounds of the whole mesh and of each submesh. Later stages only transform
+  // them, so the vertex data is not traversed again
+  mesh.bounds = computeBounds<MeshVertex>(mesh.vertices);
+  for (const auto& submesh : mesh.submeshes) {
+    mesh.submeshBounds.push_back(computeBounds<MeshVertex>(
+        getSubmeshIndices(mesh, submesh), mesh.vertices));
+  }
+
+  for (const auto& mat : reader.getMaterials()) {
+    mesh.materials.push_back(
+        {.Ka = glm::vec4(mat.ambient[0], mat.ambient[1], mat.ambient[2], 1),
+         .Kd = glm::vec4(mat.diffuse[0], mat.diffuse[1], mat.diffuse[2], 1),
+         .Ks = glm::vec4(mat.specular[0], mat.specular[1], mat.specular[2], 1),
+         .shininess = mat.shininess,
+         .diffuseTexName = mat.diffuse_texname});
+  }
+  resolveTexturePaths(mesh, basePath);
+
+  if (options.standardize) {
+    standardizeMesh(mesh);
+  }
+
+  if (!mesh.hasNormals) {
+    progress.setStage("Computing normals", 0.4f);
+    computeVertexNormals(mesh.indices, gsl::span{mesh.vertices},
+                         options.normalWeighting);
+    mesh.hasNormals = true;
+  }
+
+  mesh.vertexCacheBefore =
+      analyzeVertexCache(mesh.indices, mesh.vertices.size());
+  if (options.optimize) {
+    progress.setStage("Optimizing", 0.45f);
+    optimizeMesh(mesh);
+  }
+
+  progress.setStage("Generating LODs", 0.6f);
+  generateLODs(mesh, options);
+  progress.setStage("Building clusters", 0.8f);
+  buildClusters(mesh);
+
+  mesh.vertexCacheAfter =
+      analyzeVertexCache(mesh.indices, mesh.vertices.size());
+  mesh.quantizationError = measureQuantizationError(mesh);
+  return mesh;
+}
+
+/**
+ * @brief Loads an OBJ file into a mesh ready to be drawn.
+ *
+ * The mesh is read from its mesh cache if it is up to date, or from the one
+ * compiled at build time by abcg-assetc, along with its levels of detail and
+ * clusters. Otherwise, it is built with abcg::buildMesh and stored in the
+ * mesh cache, so that the next load skips every processing stage. Failing to
+ * write the cache (e.g. in a read-only directory) is not an error.
+ *
+ * Only touches CPU memory, so it can be called from worker threads.
+ *
+ * @param path Path to the OBJ file.
+ * @param options Mesh processing options.
+ * @param progress Progress of the load, updated at each stage.
+ * @return Processed mesh, with its levels of detail and clusters.
+ *
+ * @throw abcg::Exception if the file cannot be parsed, or if the load is
+ * cancelled.
+ */
+abcg::Mesh abcg::loadMesh(std::string_view path,
+                          const MeshLoadOptions& options,
+                          LoadProgress& progress) {
+  progress.setStage("Reading cache", 0.0f);
+  const auto cachePath{MeshCache::getCachePath(path)};
+  const auto cacheOptions{options.getCacheOptions()};
+  const auto key{MeshCache::computeKey(path, cacheOptions)};
+
+  MeshCache cache;
+  if (!cache.load(cachePath, key, sizeof(MeshVertex)) &&
+      !cache.load(cachePath, MeshCache::computeBuildKey(path, cacheOptions),
+                  sizeof(MeshVertex))) {
+    auto mesh{buildMesh(path, options, progress)};
+    if (key != 0) {
+      try {
+        storeMesh(cachePath, key, mesh);
+      } catch (const abcg::Exception&) {
+        // The cache only saves time on later loads
+      }
+    }
+    return mesh;
+  }
+
+  Mesh mesh;
+  const auto vertices{cache.getVertices<MeshVertex>()};
+  const auto indices{cache.getIndices()};
+  const auto submeshes{cache.getSubmeshes()};
+  const auto lodIndices{cache.getLODIndices()};
+  mesh.vertices.assign(vertices.begin(), vertices.end());
+  mesh.indices.assign(indices.begin(), indices.end());
+  mesh.submeshes.assign(submeshes.begin(), submeshes.end());
+  mesh.materials = cache.getMaterials();
+  mesh.bounds = cache.getBounds();
+  mesh.submeshBounds = cache.getSubmeshBounds();
+  mesh.hasNormals = (cache.getFlags() & MeshCache::HasNormals) != 0;
+  mesh.hasTexCoords = (cache.getFlags() & MeshCache::HasTexCoords) != 0;
+  resolveTexturePaths(mesh, getBasePath(path));
+
+  mesh.lods = {{.submeshes = mesh.submeshes,
+                .indexCount = mesh.indices.size(),
+                .error = 0.0f}};
+  const auto& lodSubmeshes{cache.getLODSubmeshes()};
+  for (auto&& [level, error] : iter::enumerate(cache.getLODErrors())) {
+    const auto first{lodSubmeshes.begin() + static_cast<std::ptrdiff_t>(
+                                                level * submeshes.size())};
+    MeshLOD lod{.submeshes = {first, first + static_cast<std::ptrdiff_t>(
+                                                 submeshes.size())},
+                .error = error};
+    for (const auto& range : lod.submeshes) lod.indexCount += range.indexCount;
+    mesh.lods.push_back(std::move(lod));
+  }
+  mesh.lodIndices.assign(lodIndices.begin(), lodIndices.end());
+  mesh.meshlets = cache.getMeshlets();
+  mesh.submeshMeshlets = cache.getSubmeshMeshlets();
+
+  mesh.vertexCacheBefore = cache.getVertexCacheBefore();
+  mesh.vertexCacheAfter = cache.getVertexCacheAfter();
+  mesh.quantizationError = cache.getQuantizationError();
+  return mesh;
+}
+
+/**
+ * @brief Writes a mesh, with its levels of detail and clusters, to a mesh
+ * cache.
+ *
+ * @param cachePath Path to the cache file.
+ * @param key Key computed with abcg::MeshCache::computeKey or
+ * abcg::MeshCache::computeBuildKey, with the options returned by
+ * abcg::MeshLoadOptions::getCacheOptions.
+ * @param mesh Mesh to be stored.
+ *
+ * @throw abcg::Exception if the cache file cannot be written.
+ */
+void abcg::storeMesh(std::string_view cachePath, std::uint64_t key,
+                     const Mesh& mesh) {
+  // Coarser levels of detail, flattened
+  std::vector<float> lodErrors;
+  std::vector<Submesh> lodSubmeshes;
+  for (const auto& lod : gsl::span{mesh.lods}.subspan(1)) {
+    lodErrors.push_back(lod.error);
+    lodSubmeshes.insert(lodSubmeshes.end(), lod.submeshes.begin(),
+                        lod.submeshes.end());
+  }
+
+  MeshCache::store(
+      cachePath, key,
+      {.vertices = gsl::as_bytes(gsl::span{mesh.vertices}),
+       .vertexStride = sizeof(MeshVertex),
+       .indices = mesh.indices,
+       .materials = mesh.materials,
+       .bounds = mesh.bounds,
+       .submeshes = mesh.submeshes,
+       .submeshBounds = mesh.submeshBounds,
+       .lodErrors = lodErrors,
+       .lodSubmeshes = lodSubmeshes,
+       .lodIndices = mesh.lodIndices,
+       .meshlets = mesh.meshlets,
+       .submeshMeshlets = mesh.submeshMeshlets,
+       .vertexCacheBefore = mesh.vertexCacheBefore,
+       .vertexCacheAfter = mesh.vertexCacheAfter,
+       .quantizationError = mesh.quantizationError,
+       .flags = (mesh.hasNormals ? MeshCache::HasNormals : 0U) |
+                (mesh.hasTexCoords ? MeshCache::HasTexCoords : 0U)});
+}
+
+/**
+ * @brief Packs the vertices and indices of a mesh into the contents of its
+ * vertex and index buffers.
+ *
+ * @param vertices Vertices of the mesh.
+ * @param indices Indices of the finest level of detail.
+ * @param lodIndices Indices of the other levels of detail, which follow
+ * indices in the index buffer.
+ * @param bounds Bounds of the mesh, to which compact positions are relative.
+ * @param compactVertices Whether to write abcg::PackedMeshVertex instead of
+ * abcg::MeshVertex.
+ * @return Buffer contents. 16-bit indices are used whenever they are enough.
+ */
+abcg::MeshBuffers abcg::packMeshBuffers(
+    gsl::span<const MeshVertex> vertices,
+    gsl::span<const std::uint32_t> indices,
+    gsl::span<const std::uint32_t> lodIndices, const Bounds& bounds,
+    bool compactVertices) {
+  MeshBuffers buffers;
+  if (compactVertices) {
+    buffers.positionOffset = bounds.min;
+    buffers.positionScale = getPositionScale(bounds);
+    std::vector<PackedMeshVertex> packedVertices(vertices.size());
+    std::transform(vertices.begin(), vertices.end(), packedVertices.begin(),
+                   [&](const MeshVertex& vertex) {
+                     return packVertex(vertex, buffers.positionOffset,
+                                       buffers.positionScale);
+                   });
+    buffers.vertices =
+        toBytes(gsl::span<const PackedMeshVertex>{packedVertices});
+  } else {
+    buffers.vertices = toBytes(vertices);
+  }
+
+  std::vector<std::uint32_t> allIndices(indices.begin(), indices.end());
+  allIndices.insert(allIndices.end(), lodIndices.begin(), lodIndices.end());
+  if (vertices.size() <= std::numeric_limits<std::uint16_t>::max() + 1U) {
+    std::vector<std::uint16_t> shortIndices(allIndices.size());
+    std::transform(
+        allIndices.begin(), allIndices.end(), shortIndices.begin(),
+        [](std::uint32_t index) { return static_cast<std::uint16_t>(index); });
+    buffers.indices = toBytes(gsl::span<const std::uint16_t>{shortIndices});
+    buffers.indexSize = sizeof(std::uint16_t);
+  } else {
+    buffers.indices = toBytes(gsl::span<const std::uint32_t>{allIndices});
+    buffers.indexSize = sizeof(std::uint32_t);
+  }
+  return buffers;
+}
+
+/**
+ * @brief Selects the level of detail of a mesh to be drawn.
+ *
+ * @param lods Levels of detail of the mesh, finest first.
+ * @param bounds Object space bounds of the mesh.
+ * @param modelMatrix Model matrix of the mesh.
+ * @param viewMatrix View matrix.
+ * @param projMatrix Perspective projection matrix.
+ * @param viewportHeight Height of the viewport, in pixels.
+ * @param pixelError Largest screen space error, in pixels.
+ * @return Index of the coarsest level whose error projects to at most
+ * pixelError pixels at the bounding sphere, or 0 if the viewer is inside the
+ * sphere.
+ */
+std::size_t abcg::selectLOD(gsl::span<const MeshLOD> lods,
+                            const Bounds& bounds, const glm::mat4& modelMatrix,
+                            const glm::mat4& viewMatrix,
+                            const glm::mat4& projMatrix, int viewportHeight,
+                            float pixelError) {
+  // Largest scale factor of the model matrix
+  const auto scale{std::max({glm::length(glm::vec3(modelMatrix[0])),
+                             glm::length(glm::vec3(modelMatrix[1])),
+                             glm::length(glm::vec3(modelMatrix[2]))})};
+  const auto center{viewMatrix * modelMatrix * glm::vec4(bounds.center, 1.0f)};
+  const auto distance{-center.z};
+  const auto radius{bounds.radius * scale};
+  if (distance <= radius) return 0;
+
+  // Size in pixels of one object space unit at the bounding sphere
+  const auto pixelsPerUnit{projMatrix[1][1] * 0.5f *
+                           static_cast<float>(viewportHeight) * scale /
+                           distance};
+
+  std::size_t lod{};
+  while (lod + 1 < lods.size() &&
+         lods[lod + 1].error * pixelsPerUnit <= pixelError) {
+    ++lod;
+  }
+  return lod;
+}
+
+/**
+ * @brief Selects the clusters of a mesh that may be visible.
+ *
+ * Clusters outside the view frustum, and optionally those whose triangles
+ * all face away from the viewer, are culled.
+ *
+ * @param meshlets Clusters of the mesh, grouped by submesh.
+ * @param submeshMeshlets Position of the first cluster of each submesh in
+ * meshlets, followed by the number of clusters.
+ * @param bounds Object space bounds of the mesh. No cluster is tested if the
+ * mesh is outside the frustum.
+ * @param modelMatrix Model matrix of the mesh.
+ * @param viewMatrix View matrix.
+ * @param projMatrix Projection matrix.
+ * @param cullBackFacing Whether to cull back-facing clusters.
+ * @return Index ranges of the clusters that passed, grouped by submesh.
+ */
+abcg::MeshDrawRanges abcg::cullMeshlets(
+    gsl::span<const Meshlet> meshlets,
+    gsl::span<const std::size_t> submeshMeshlets, const Bounds& bounds,
+    const glm::mat4& modelMatrix, const glm::mat4& viewMatrix,
+    const glm::mat4& projMatrix, bool cullBackFacing) {
+  // Frustum planes in object space, extracted from the rows of the
+  // model-view-projection matrix (Gribb and Hartmann)
+  const auto rows{glm::transpose(projMatrix * viewMatrix * modelMatrix)};
+  std::array planes{rows[3] + rows[0], rows[3] - rows[0], rows[3] + rows[1],
+                    rows[3] - rows[1], rows[3] + rows[2], rows[3] - rows[2]};
+  for (auto& plane : planes) {
+    plane /= glm::length(glm::vec3(plane));
+  }
+  const glm::vec3 viewerPosition{glm::inverse(viewMatrix * modelMatrix)[3]};
+
+  const auto isOutside{[&planes](const glm::vec3& center, float radius) {
+    return std::any_of(
+        planes.begin(), planes.end(), [&](const glm::vec4& plane) {
+          return glm::dot(glm::vec3(plane), center) + plane.w < -radius;
+        });
+  }};
+
+  MeshDrawRanges draws;
+  draws.submeshRanges = {0};
+  const auto submeshCount{submeshMeshlets.empty() ? 0
+                                                  : submeshMeshlets.size() - 1};
+  if (isOutside(bounds.center, bounds.radius)) {
+    draws.submeshRanges.resize(submeshCount + 1, 0);
+    return draws;
+  }
+
+  for (const auto submesh : iter::range(submeshCount)) {
+    const auto firstRange{draws.indexCounts.size()};
+    std::uint32_t rangeEnd{};
+    for (const auto& meshlet : meshlets.subspan(
+             submeshMeshlets[submesh],
+             submeshMeshlets[submesh + 1] - submeshMeshlets[submesh])) {
+      if (isOutside(meshlet.center, meshlet.radius) ||
+          (cullBackFacing && isBackFacing(meshlet, viewerPosition))) {
+        continue;
+      }
+
+      // Extend the previous range if the clusters are adjacent
+      if (draws.indexCounts.size() > firstRange &&
+          rangeEnd == meshlet.indexOffset) {
+        draws.indexCounts.back() += meshlet.indexCount;
+      } else {
+        draws.indexOffsets.push_back(meshlet.indexOffset);
+        draws.indexCounts.push_back(meshlet.indexCount);
+      }
+      rangeEnd = meshlet.indexOffset + meshlet.indexCount;
+    }
+    draws.submeshRanges.push_back(draws.indexCounts.size());
+  }
+  return draws;
+}
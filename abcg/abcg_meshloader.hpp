@@ -0,0 +1,216 @@
+/**
+ * @file abcg_meshloader.hpp
+ * @brief Declaration of the functions that load OBJ files into indexed
+ * triangle meshes ready to be drawn.
+ *
+ * This project is released under the MIT License.
+ */
+
+#ifndef ABCG_MESHLOADER_HPP_
+#define ABCG_MESHLOADER_HPP_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <glm/gtc/epsilon.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <gsl/gsl>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "abcg_asyncload.hpp"
+#include "abcg_bounds.hpp"
+#include "abcg_meshcache.hpp"
+#include "abcg_meshnormals.hpp"
+#include "abcg_meshoptimizer.hpp"
+
+namespace abcg {
+struct MeshVertex;
+struct PackedMeshVertex;
+struct MeshLoadOptions;
+struct MeshLOD;
+struct Mesh;
+struct MeshBuffers;
+struct MeshDrawRanges;
+
+[[nodiscard]] Mesh buildMesh(std::string_view path,
+                             const MeshLoadOptions& options,
+                             LoadProgress& progress);
+[[nodiscard]] Mesh loadMesh(std::string_view path,
+                            const MeshLoadOptions& options,
+                            LoadProgress& progress);
+void storeMesh(std::string_view cachePath, std::uint64_t key,
+               const Mesh& mesh);
+[[nodiscard]] MeshBuffers packMeshBuffers(
+    gsl::span<const MeshVertex> vertices,
+    gsl::span<const std::uint32_t> indices,
+    gsl::span<const std::uint32_t> lodIndices, const Bounds& bounds,
+    bool compactVertices);
+[[nodiscard]] std::size_t selectLOD(gsl::span<const MeshLOD> lods,
+                                    const Bounds& bounds,
+                                    const glm::mat4& modelMatrix,
+                                    const glm::mat4& viewMatrix,
+                                    const glm::mat4& projMatrix,
+                                    int viewportHeight, float pixelError);
+[[nodiscard]] MeshDrawRanges cullMeshlets(
+    gsl::span<const Meshlet> meshlets,
+    gsl::span<const std::size_t> submeshMeshlets, const Bounds& bounds,
+    const glm::mat4& modelMatrix, const glm::mat4& viewMatrix,
+    const glm::mat4& projMatrix, bool cullBackFacing = true);
+}  // namespace abcg
+
+/**
+ * @brief Vertex of a mesh loaded with abcg::loadMesh.
+ *
+ * Vertices closer than the machine epsilon in every attribute are welded.
+ */
+struct abcg::MeshVertex {
+  glm::vec3 position{};
+  glm::vec3 normal{};
+  glm::vec2 texCoord{};
+
+  [[nodiscard]] bool operator==(const MeshVertex& other) const noexcept {
+    static const auto epsilon{std::numeric_limits<float>::epsilon()};
+    return glm::all(glm::epsilonEqual(position, other.position, epsilon)) &&
+           glm::all(glm::epsilonEqual(normal, other.normal, epsilon)) &&
+           glm::all(glm::epsilonEqual(texCoord, other.texCoord, epsilon));
+  }
+};
+
+/**
+ * @brief Compact layout of abcg::MeshVertex written by abcg::packMeshBuffers.
+ *
+ * Position as unsigned normalized 16-bit offsets within the bounding box of
+ * the mesh, half-float texture coordinates, and normal packed as signed
+ * normalized 10-10-10-2: 16 bytes instead of 32, with attributes decoded by
+ * the vertex fetch stage. The vertex shader maps the position back to object
+ * space with abcg::MeshBuffers::positionOffset and
+ * abcg::MeshBuffers::positionScale.
+ */
+struct abcg::PackedMeshVertex {
+  /** @brief Position, with w used as padding. */
+  std::array<std::uint16_t, 4> position{};
+  std::uint32_t normal{};
+  std::array<std::uint16_t, 2> texCoord{};
+};
+
+/**
+ * @brief Mesh processing options of abcg::loadMesh.
+ *
+ */
+struct abcg::MeshLoadOptions {
+  /** @brief Whether to center the mesh at the origin and scale it so that
+   * the diagonal of its bounding box is 2. */
+  bool standardize{true};
+  /** @brief Whether to reorder the buffers for the vertex cache, overdraw
+   * and vertex fetch. */
+  bool optimize{true};
+  /** @brief Weighting of the normals computed for meshes that have none. */
+  NormalWeighting normalWeighting{NormalWeighting::Area};
+  /** @brief Number of triangles under which no coarser level of detail is
+   * generated. */
+  std::size_t minLODTriangles{64};
+  /** @brief Largest error of each simplification step, relative to the
+   * largest extent of the mesh. */
+  float maxLODError{0.05f};
+
+  [[nodiscard]] std::uint64_t getCacheOptions() const noexcept;
+};
+
+/**
+ * @brief Level of detail of a mesh.
+ *
+ */
+struct abcg::MeshLOD {
+  /** @brief Index range of each submesh, in the same order as
+   * abcg::Mesh::submeshes. */
+  std::vector<Submesh> submeshes{};
+  /** @brief Number of indices of the level. */
+  std::size_t indexCount{};
+  /** @brief Geometric error, in object space units. */
+  float error{};
+};
+
+/**
+ * @brief Indexed triangle mesh loaded from an OBJ file.
+ *
+ */
+struct abcg::Mesh {
+  std::vector<MeshVertex> vertices;
+  /** @brief Triangle list of the finest level of detail, grouped by
+   * material. */
+  std::vector<std::uint32_t> indices;
+  /** @brief Index range of each material in indices. */
+  std::vector<Submesh> submeshes;
+  /** @brief Materials, with texture names as in the material library. */
+  std::vector<MeshCacheMaterial> materials;
+  /** @brief Path of the diffuse texture of each material, normalized so
+   * that materials that use the same file have the same path, or an empty
+   * string. */
+  std::vector<std::string> diffuseTexturePaths;
+  Bounds bounds{};
+  std::vector<Bounds> submeshBounds;
+  bool hasNormals{};
+  bool hasTexCoords{};
+
+  /** @brief Levels of detail, finest first. Level 0 is indices; the others
+   * are stored in lodIndices, whose offsets follow indices. */
+  std::vector<MeshLOD> lods;
+  std::vector<std::uint32_t> lodIndices;
+
+  /** @brief Clusters of the finest level of detail, grouped by submesh. The
+   * clusters of submesh i start at submeshMeshlets[i] and end where those of
+   * submesh i + 1 start. */
+  std::vector<Meshlet> meshlets;
+  std::vector<std::size_t> submeshMeshlets;
+
+  /** @brief Vertex cache statistics of the finest level of detail as read
+   * from the file, and as stored in indices. */
+  VertexCacheStatistics vertexCacheBefore{};
+  VertexCacheStatistics vertexCacheAfter{};
+  /** @brief Precision lost by the compact vertices of
+   * abcg::packMeshBuffers. */
+  QuantizationError quantizationError{};
+
+  /** @brief Warnings of the OBJ parser. */
+  std::string warning;
+};
+
+/**
+ * @brief Vertex and index buffer contents written by abcg::packMeshBuffers.
+ *
+ */
+struct abcg::MeshBuffers {
+  /** @brief Vertices, as abcg::MeshVertex or abcg::PackedMeshVertex. */
+  std::vector<std::byte> vertices;
+  /** @brief Indices of every level of detail, finest first. */
+  std::vector<std::byte> indices;
+  /** @brief Size of each index: 2 if every vertex can be indexed with 16
+   * bits, or 4. */
+  std::size_t indexSize{};
+  /** @brief Object space position of a vertex: positionOffset +
+   * positionScale * position. Identity unless the vertices are compact. */
+  glm::vec3 positionOffset{0.0f};
+  glm::vec3 positionScale{1.0f};
+};
+
+/**
+ * @brief Index ranges to be drawn, as returned by abcg::cullMeshlets.
+ *
+ * Adjacent clusters are merged into a single range.
+ */
+struct abcg::MeshDrawRanges {
+  /** @brief Position of the first index of each range. */
+  std::vector<std::uint32_t> indexOffsets;
+  /** @brief Number of indices of each range. */
+  std::vector<std::uint32_t> indexCounts;
+  /** @brief Ranges grouped by submesh. The ranges of submesh i start at
+   * submeshRanges[i] and end where those of submesh i + 1 start. */
+  std::vector<std::size_t> submeshRanges;
+};
+
+#endif
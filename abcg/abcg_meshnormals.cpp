@@ -0,0 +1,446 @@
+/**
+ * @file abcg_meshnormals.cpp
+ * @brief Definition of vertex normal generation functions for indexed
+ * triangle meshes.
+ *
+ * This project is released under the MIT License.
+ */
+
+#include "abcg_meshnormals.hpp"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cmath>
+#include <functional>
+#include <glm/geometric.hpp>
+#include <numeric>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "abcg_exception.hpp"
+#include "abcg_threadpool.hpp"
+
+namespace {
+// Number of elements (indices, triangles or vertices) processed by each task
+constexpr std::size_t blockSize{16384};
+
+// Normals of up to four consecutive triangles, and their angles at each
+// corner (angles[corner][lane]) if the normals are angle-weighted. Area
+// weighted normals are the unnormalized cross products; angle-weighted ones
+// are unit vectors
+struct FaceBatch {
+  alignas(16) std::array<float, 4> x;
+  alignas(16) std::array<float, 4> y;
+  alignas(16) std::array<float, 4> z;
+  alignas(16) std::array<std::array<float, 4>, 3> angles;
+};
+
+// Unchecked views of the input and output arrays, since the bounds checks of
+// gsl::span would dominate the cost of the loops below. Indices are
+// validated beforehand
+struct MeshArrays {
+  const std::uint32_t* indices{};
+  const std::byte* positions{};
+  std::byte* normals{};
+  std::size_t stride{};
+  std::size_t numTriangles{};
+  std::size_t numVertices{};
+  bool angleWeighted{};
+
+  [[nodiscard]] const glm::vec3& position(std::size_t vertex) const {
+    return *reinterpret_cast<const glm::vec3*>(positions + vertex * stride);
+  }
+  [[nodiscard]] glm::vec3& normal(std::size_t vertex) const {
+    return *reinterpret_cast<glm::vec3*>(normals + vertex * stride);
+  }
+};
+
+// Face normals of the whole mesh in structure-of-arrays form
+struct FaceNormals {
+  std::vector<float> x;
+  std::vector<float> y;
+  std::vector<float> z;
+  std::vector<float> cornerAngles;
+};
+
+// Coefficients of a polynomial approximation of atan in [0, 1], with an
+// absolute error below 2e-6 rad
+constexpr std::array atanCoefficients{-0.01172120f, 0.05265332f, -0.11643287f,
+                                      0.19354346f,  -0.33262347f, 0.99997726f};
+constexpr float halfPi{1.57079633f};
+constexpr float pi{3.14159265f};
+
+// atan2(y, x) for y >= 0
+float approxAtan2(float y, float x) {
+  const auto absX{std::abs(x)};
+  const auto ratio{std::min(absX, y) / std::max({absX, y, 1e-30f})};
+  const auto square{ratio * ratio};
+  auto result{0.0f};
+  for (const auto coefficient : atanCoefficients) {
+    result = result * square + coefficient;
+  }
+  result *= ratio;
+  if (y > absX) result = halfPi - result;
+  if (x < 0.0f) result = pi - result;
+  return result;
+}
+
+#if defined(__SSE2__)
+__m128 select(__m128 mask, __m128 ifTrue, __m128 ifFalse) {
+  return _mm_or_ps(_mm_and_ps(mask, ifTrue), _mm_andnot_ps(mask, ifFalse));
+}
+
+__m128 approxAtan2(__m128 y, __m128 x) {
+  const auto absX{_mm_andnot_ps(_mm_set1_ps(-0.0f), x)};
+  const auto ratio{
+      _mm_div_ps(_mm_min_ps(absX, y),
+                 _mm_max_ps(_mm_max_ps(absX, y), _mm_set1_ps(1e-30f)))};
+  const auto square{_mm_mul_ps(ratio, ratio)};
+  auto result{_mm_setzero_ps()};
+  for (const auto coefficient : atanCoefficients) {
+    result = _mm_add_ps(_mm_mul_ps(result, square), _mm_set1_ps(coefficient));
+  }
+  result = _mm_mul_ps(result, ratio);
+  result = select(_mm_cmpgt_ps(y, absX),
+                  _mm_sub_ps(_mm_set1_ps(halfPi), result), result);
+  return select(_mm_cmplt_ps(x, _mm_setzero_ps()),
+                _mm_sub_ps(_mm_set1_ps(pi), result), result);
+}
+
+__m128 dot(__m128 x1, __m128 y1, __m128 z1, __m128 x2, __m128 y2, __m128 z2) {
+  return _mm_add_ps(_mm_add_ps(_mm_mul_ps(x1, x2), _mm_mul_ps(y1, y2)),
+                    _mm_mul_ps(z1, z2));
+}
+#endif
+
+// Computes the normals of triangles [first, first + count), with count <= 4
+void computeFaceBatch(const MeshArrays& mesh, std::size_t first,
+                      std::size_t count, FaceBatch& batch) {
+  const auto* indices{mesh.indices};
+#if defined(__SSE2__)
+  if (count == 4) {
+    // Gather the corners a, b and c of the four triangles into registers
+    // holding one coordinate of four corners each
+    std::array<const glm::vec3*, 12> corners{};
+    for (std::size_t corner{}; corner < 12; ++corner) {
+      corners[corner] = &mesh.position(indices[first * 3 + corner]);
+    }
+    const auto gather{[&corners](std::size_t corner, int component) {
+      return _mm_setr_ps((*corners[corner + 0])[component],
+                         (*corners[corner + 3])[component],
+                         (*corners[corner + 6])[component],
+                         (*corners[corner + 9])[component]);
+    }};
+    const auto ax{gather(0, 0)};
+    const auto ay{gather(0, 1)};
+    const auto az{gather(0, 2)};
+    const auto e1x{_mm_sub_ps(gather(1, 0), ax)};
+    const auto e1y{_mm_sub_ps(gather(1, 1), ay)};
+    const auto e1z{_mm_sub_ps(gather(1, 2), az)};
+    const auto e2x{_mm_sub_ps(gather(2, 0), ax)};
+    const auto e2y{_mm_sub_ps(gather(2, 1), ay)};
+    const auto e2z{_mm_sub_ps(gather(2, 2), az)};
+
+    auto nx{_mm_sub_ps(_mm_mul_ps(e1y, e2z), _mm_mul_ps(e1z, e2y))};
+    auto ny{_mm_sub_ps(_mm_mul_ps(e1z, e2x), _mm_mul_ps(e1x, e2z))};
+    auto nz{_mm_sub_ps(_mm_mul_ps(e1x, e2y), _mm_mul_ps(e1y, e2x))};
+
+    if (mesh.angleWeighted) {
+      // |e1 x e2| is shared by the angles at the three corners
+      const auto length{_mm_sqrt_ps(dot(nx, ny, nz, nx, ny, nz))};
+      const auto dot12{dot(e1x, e1y, e1z, e2x, e2y, e2z)};
+      _mm_store_ps(batch.angles[0].data(), approxAtan2(length, dot12));
+      _mm_store_ps(
+          batch.angles[1].data(),
+          approxAtan2(length,
+                      _mm_sub_ps(dot(e1x, e1y, e1z, e1x, e1y, e1z), dot12)));
+      _mm_store_ps(
+          batch.angles[2].data(),
+          approxAtan2(length,
+                      _mm_sub_ps(dot(e2x, e2y, e2z, e2x, e2y, e2z), dot12)));
+
+      // Degenerate triangles get a zero normal
+      const auto inverse{
+          _mm_and_ps(_mm_cmpgt_ps(length, _mm_setzero_ps()),
+                     _mm_div_ps(_mm_set1_ps(1.0f), length))};
+      nx = _mm_mul_ps(nx, inverse);
+      ny = _mm_mul_ps(ny, inverse);
+      nz = _mm_mul_ps(nz, inverse);
+    }
+
+    _mm_store_ps(batch.x.data(), nx);
+    _mm_store_ps(batch.y.data(), ny);
+    _mm_store_ps(batch.z.data(), nz);
+    return;
+  }
+#endif
+  for (std::size_t lane{}; lane < count; ++lane) {
+    const auto triangle{first + lane};
+    const auto& a{mesh.position(indices[triangle * 3 + 0])};
+    const auto& b{mesh.position(indices[triangle * 3 + 1])};
+    const auto& c{mesh.position(indices[triangle * 3 + 2])};
+    const auto edge1{b - a};
+    const auto edge2{c - a};
+    auto normal{glm::cross(edge1, edge2)};
+
+    if (mesh.angleWeighted) {
+      const auto length{glm::length(normal)};
+      const auto dot12{glm::dot(edge1, edge2)};
+      batch.angles[0][lane] = approxAtan2(length, dot12);
+      batch.angles[1][lane] =
+          approxAtan2(length, glm::dot(edge1, edge1) - dot12);
+      batch.angles[2][lane] =
+          approxAtan2(length, glm::dot(edge2, edge2) - dot12);
+      normal = length > 0.0f ? normal / length : glm::vec3{};
+    }
+
+    batch.x[lane] = normal.x;
+    batch.y[lane] = normal.y;
+    batch.z[lane] = normal.z;
+  }
+}
+
+// Normalizes vertex normals [first, last), leaving zero vectors unchanged
+void normalize(const MeshArrays& mesh, std::size_t first, std::size_t last) {
+  auto vertex{first};
+#if defined(__SSE2__)
+  for (; vertex + 4 <= last; vertex += 4) {
+    std::array<glm::vec3*, 4> normals{
+        &mesh.normal(vertex), &mesh.normal(vertex + 1),
+        &mesh.normal(vertex + 2), &mesh.normal(vertex + 3)};
+    const auto gather{[&normals](int component) {
+      return _mm_setr_ps((*normals[0])[component], (*normals[1])[component],
+                         (*normals[2])[component], (*normals[3])[component]);
+    }};
+    const auto x{gather(0)};
+    const auto y{gather(1)};
+    const auto z{gather(2)};
+    const auto length{_mm_sqrt_ps(dot(x, y, z, x, y, z))};
+    const auto inverse{
+        _mm_and_ps(_mm_cmpgt_ps(length, _mm_setzero_ps()),
+                   _mm_div_ps(_mm_set1_ps(1.0f), length))};
+    alignas(16) std::array<std::array<float, 4>, 3> lanes{};
+    _mm_store_ps(lanes[0].data(), _mm_mul_ps(x, inverse));
+    _mm_store_ps(lanes[1].data(), _mm_mul_ps(y, inverse));
+    _mm_store_ps(lanes[2].data(), _mm_mul_ps(z, inverse));
+    for (std::size_t lane{}; lane < 4; ++lane) {
+      *normals[lane] = {lanes[0][lane], lanes[1][lane], lanes[2][lane]};
+    }
+  }
+#endif
+  for (; vertex < last; ++vertex) {
+    auto& normal{mesh.normal(vertex)};
+    const auto length{glm::length(normal)};
+    normal = length > 0.0f ? normal * (1.0f / length) : glm::vec3{};
+  }
+}
+
+void forEachBlock(
+    abcg::ThreadPool& threadPool, std::size_t count,
+    const std::function<void(std::size_t, std::size_t)>& function) {
+  const auto numBlocks{(count + blockSize - 1) / blockSize};
+  threadPool.parallelFor(numBlocks, [&](std::size_t block) {
+    const auto first{block * blockSize};
+    function(first, std::min(first + blockSize, count));
+  });
+}
+
+// Single-threaded path: each triangle adds its normal to its vertices. The
+// sums are accumulated in triangle order, as in the gather of the
+// multithreaded path, so both give the same result
+void scatterVertexNormals(const MeshArrays& mesh) {
+  for (std::size_t vertex{}; vertex < mesh.numVertices; ++vertex) {
+    mesh.normal(vertex) = {};
+  }
+
+  FaceBatch batch{};
+  for (std::size_t first{}; first < mesh.numTriangles; first += 4) {
+    const auto count{std::min<std::size_t>(4, mesh.numTriangles - first)};
+    computeFaceBatch(mesh, first, count, batch);
+    for (std::size_t lane{}; lane < count; ++lane) {
+      const glm::vec3 normal{batch.x[lane], batch.y[lane], batch.z[lane]};
+      for (std::size_t corner{}; corner < 3; ++corner) {
+        const auto weight{mesh.angleWeighted ? batch.angles[corner][lane]
+                                             : 1.0f};
+        mesh.normal(mesh.indices[(first + lane) * 3 + corner]) +=
+            weight * normal;
+      }
+    }
+  }
+
+  normalize(mesh, 0, mesh.numVertices);
+}
+
+// Relaxed increment for counters shared by concurrent tasks
+std::uint32_t increment(std::atomic<std::uint32_t>& counter) {
+  return counter.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Multithreaded path: each vertex sums the normals of its triangles through
+// a vertex-to-corner adjacency in compressed sparse row format, so that no
+// two tasks write to the same vertex
+void gatherVertexNormals(const MeshArrays& mesh,
+                         abcg::ThreadPool& threadPool) {
+  const auto* indices{mesh.indices};
+  const auto numIndices{mesh.numTriangles * 3};
+  const auto numVertices{mesh.numVertices};
+
+  // Number of corners of each vertex
+  std::vector<std::atomic<std::uint32_t>> counts(numVertices);
+  forEachBlock(threadPool, numIndices,
+               [&](std::size_t first, std::size_t last) {
+                 for (auto corner{first}; corner < last; ++corner) {
+                   increment(counts[indices[corner]]);
+                 }
+               });
+
+  // Row offsets: prefix sums within each block, then across blocks
+  std::vector<std::uint32_t> offsets(numVertices + 1);
+  std::vector<std::uint32_t> blockTotals((numVertices + blockSize - 1) /
+                                         blockSize);
+  forEachBlock(threadPool, numVertices,
+               [&](std::size_t first, std::size_t last) {
+                 std::uint32_t total{};
+                 for (auto vertex{first}; vertex < last; ++vertex) {
+                   total += counts[vertex].load(std::memory_order_relaxed);
+                   offsets[vertex + 1] = total;
+                 }
+                 blockTotals[first / blockSize] = total;
+               });
+  std::exclusive_scan(blockTotals.begin(), blockTotals.end(),
+                      blockTotals.begin(), std::uint32_t{});
+  forEachBlock(threadPool, numVertices,
+               [&](std::size_t first, std::size_t last) {
+                 const auto base{blockTotals[first / blockSize]};
+                 for (auto vertex{first}; vertex < last; ++vertex) {
+                   offsets[vertex + 1] += base;
+                   // Start of the row; offsets[vertex] may belong to
+                   // another block
+                   counts[vertex].store(
+                       offsets[vertex + 1] -
+                           counts[vertex].load(std::memory_order_relaxed),
+                       std::memory_order_relaxed);
+                 }
+               });
+
+  // Fill the rows with corner numbers (3 * triangle + corner), reusing the
+  // counts as insertion cursors
+  std::vector<std::uint32_t> adjacency(numIndices);
+  forEachBlock(threadPool, numIndices,
+               [&](std::size_t first, std::size_t last) {
+                 for (auto corner{first}; corner < last; ++corner) {
+                   adjacency[increment(counts[indices[corner]])] =
+                       static_cast<std::uint32_t>(corner);
+                 }
+               });
+
+  // Face normals in batches of four triangles. Blocks start at multiples of
+  // four, so batches are the same as in the single-threaded path
+  FaceNormals faces{.x = std::vector<float>(mesh.numTriangles),
+                    .y = std::vector<float>(mesh.numTriangles),
+                    .z = std::vector<float>(mesh.numTriangles),
+                    .cornerAngles = {}};
+  if (mesh.angleWeighted) faces.cornerAngles.resize(numIndices);
+  forEachBlock(
+      threadPool, mesh.numTriangles, [&](std::size_t first, std::size_t last) {
+        FaceBatch batch{};
+        for (auto triangle{first}; triangle < last; triangle += 4) {
+          const auto count{std::min<std::size_t>(4, last - triangle)};
+          computeFaceBatch(mesh, triangle, count, batch);
+          for (std::size_t lane{}; lane < count; ++lane) {
+            faces.x[triangle + lane] = batch.x[lane];
+            faces.y[triangle + lane] = batch.y[lane];
+            faces.z[triangle + lane] = batch.z[lane];
+            if (mesh.angleWeighted) {
+              for (std::size_t corner{}; corner < 3; ++corner) {
+                faces.cornerAngles[(triangle + lane) * 3 + corner] =
+                    batch.angles[corner][lane];
+              }
+            }
+          }
+        }
+      });
+
+  forEachBlock(
+      threadPool, numVertices, [&](std::size_t first, std::size_t last) {
+        for (auto vertex{first}; vertex < last; ++vertex) {
+          // Rows were filled concurrently; sorting restores triangle order
+          const auto rowBegin{adjacency.begin() + offsets[vertex]};
+          const auto rowEnd{adjacency.begin() + offsets[vertex + 1]};
+          std::sort(rowBegin, rowEnd);
+
+          glm::vec3 normal{};
+          for (auto it{rowBegin}; it != rowEnd; ++it) {
+            const auto corner{*it};
+            const auto triangle{corner / 3};
+            const auto weight{mesh.angleWeighted ? faces.cornerAngles[corner]
+                                                 : 1.0f};
+            normal += weight * glm::vec3{faces.x[triangle], faces.y[triangle],
+                                         faces.z[triangle]};
+          }
+          mesh.normal(vertex) = normal;
+        }
+        normalize(mesh, first, last);
+      });
+}
+}  // namespace
+
+/**
+ * @brief Computes smooth vertex normals of an array of vertices.
+ *
+ * Face normals are computed four triangles at a time, with SSE2 when
+ * available. With worker threads, each vertex then gathers the normals of its
+ * triangles through a vertex-to-triangle adjacency in compressed sparse row
+ * format, so that no two tasks write to the same vertex. Otherwise, each
+ * triangle adds its normal to its vertices directly. Both paths sum in
+ * triangle order, so the result does not depend on the number of threads.
+ *
+ * Vertices not referenced by any triangle get a zero normal.
+ *
+ * @param indices Triangle list.
+ * @param positions Position of the first vertex.
+ * @param normals Normal of the first vertex, to be overwritten.
+ * @param vertexCount Number of vertices.
+ * @param stride Distance in bytes between consecutive positions and between
+ * consecutive normals.
+ * @param weighting Weight of each triangle in the normals of its vertices.
+ * @param threadPool Pool used to process blocks of triangles and vertices
+ * concurrently.
+ *
+ * @throw abcg::Exception if an index is out of range.
+ */
+void abcg::computeVertexNormals(gsl::span<const std::uint32_t> indices,
+                                const glm::vec3* positions, glm::vec3* normals,
+                                std::size_t vertexCount, std::size_t stride,
+                                NormalWeighting weighting,
+                                ThreadPool& threadPool) {
+  const MeshArrays mesh{
+      .indices = indices.data(),
+      .positions = reinterpret_cast<const std::byte*>(positions),
+      .normals = reinterpret_cast<std::byte*>(normals),
+      .stride = stride,
+      .numTriangles = indices.size() / 3,
+      .numVertices = vertexCount,
+      .angleWeighted = weighting == NormalWeighting::Angle};
+  const auto* indicesEnd{mesh.indices + mesh.numTriangles * 3};
+  if (const auto* invalid{std::find_if(
+          mesh.indices, indicesEnd,
+          [vertexCount](std::uint32_t index) { return index >= vertexCount; })};
+      invalid != indicesEnd) {
+    throw abcg::Exception{abcg::Exception::Runtime(fmt::format(
+        "Vertex index {} out of range ({} vertices)", *invalid, vertexCount))};
+  }
+
+  if (threadPool.getNumThreads() == 0 || mesh.numTriangles <= blockSize) {
+    scatterVertexNormals(mesh);
+  } else {
+    gatherVertexNormals(mesh, threadPool);
+  }
+}
@@ -0,0 +1,65 @@
+/**
+ * @file abcg_meshnormals.hpp
+ * @brief Declaration of vertex normal generation functions for indexed
+ * triangle meshes.
+ *
+ * This project is released under the MIT License.
+ */
+
+#ifndef ABCG_MESHNORMALS_HPP_
+#define ABCG_MESHNORMALS_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <glm/vec3.hpp>
+#include <gsl/gsl>
+
+#include "abcg_threadpool.hpp"
+
+namespace abcg {
+/**
+ * @brief Weight of each triangle in the normal of its vertices.
+ *
+ */
+enum class NormalWeighting {
+  /** @brief Weight proportional to the area of the triangle. */
+  Area,
+  /** @brief Weight proportional to the angle of the triangle at the vertex.
+   * Less sensitive to how a surface is tessellated. */
+  Angle
+};
+
+void computeVertexNormals(gsl::span<const std::uint32_t> indices,
+                          const glm::vec3* positions, glm::vec3* normals,
+                          std::size_t vertexCount, std::size_t stride,
+                          NormalWeighting weighting, ThreadPool& threadPool);
+
+template <typename TVertex>
+void computeVertexNormals(gsl::span<const std::uint32_t> indices,
+                          gsl::span<TVertex> vertices,
+                          NormalWeighting weighting = NormalWeighting::Area);
+}  // namespace abcg
+
+/**
+ * @brief Computes smooth vertex normals of an array of vertices using the
+ * default thread pool.
+ *
+ * @tparam TVertex Vertex type with glm::vec3 members named position and
+ * normal.
+ * @param indices Triangle list.
+ * @param vertices Vertices whose normals are to be overwritten.
+ * @param weighting Weight of each triangle in the normals of its vertices.
+ *
+ * @throw abcg::Exception if an index is out of range.
+ */
+template <typename TVertex>
+void abcg::computeVertexNormals(gsl::span<const std::uint32_t> indices,
+                                gsl::span<TVertex> vertices,
+                                NormalWeighting weighting) {
+  if (vertices.empty()) return;
+  computeVertexNormals(indices, &vertices.front().position,
+                       &vertices.front().normal, vertices.size(),
+                       sizeof(TVertex), weighting, ThreadPool::getDefault());
+}
+
+#endif
@@ -0,0 +1,995 @@
+/**
+ * @file abcg_meshoptimizer.cpp
+ * @brief Definition of index and vertex reordering functions for indexed
+ * triangle meshes.
+ *
+ * This project is released under the MIT License.
+ */
+
+#include "abcg_meshoptimizer.hpp"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <glm/geometric.hpp>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
+
+#include "abcg_exception.hpp"
+#include "abcg_vertexwelder.hpp"
+
+namespace {
+// Parameters of the vertex cache optimizer (Tom Forsyth, "Linear-Speed Vertex
+// Cache Optimisation", 2006)
+constexpr std::size_t lruCacheSize{32};
+constexpr float cacheDecayPower{1.5f};
+constexpr float lastTriangleScore{0.75f};
+constexpr float valenceBoostScale{2.0f};
+constexpr float valenceBoostPower{0.5f};
+constexpr std::size_t maxValence{32};
+
+// Cache size used to split the index buffer into clusters for overdraw
+// optimization. Matches the default of abcg::analyzeVertexCache.
+constexpr std::size_t fifoCacheSize{16};
+
+constexpr auto invalidIndex{~std::uint32_t{}};
+
+void checkIndices(gsl::span<const std::uint32_t> indices,
+                  std::size_t vertexCount) {
+  const auto it{std::find_if(indices.begin(), indices.end(),
+                             [=](auto index) { return index >= vertexCount; })};
+  if (it != indices.end()) {
+    throw abcg::Exception{abcg::Exception::Runtime(
+        fmt::format("Index {} out of range (vertex count is {})", *it,
+                    vertexCount))};
+  }
+}
+
+struct ScoreTables {
+  std::array<float, lruCacheSize + 1> cache{};
+  std::array<float, maxValence + 1> valence{};
+
+  ScoreTables() {
+    for (std::size_t position{}; position < lruCacheSize; ++position) {
+      if (position < 3) {
+        // The three vertices of the last triangle get a fixed score so that
+        // the next triangle does not simply reuse the same edge
+        cache.at(position) = lastTriangleScore;
+      } else {
+        const auto scaler{1.0f / static_cast<float>(lruCacheSize - 3)};
+        cache.at(position) = std::pow(
+            1.0f - static_cast<float>(position - 3) * scaler, cacheDecayPower);
+      }
+    }
+    for (std::size_t count{1}; count <= maxValence; ++count) {
+      // Vertices with few triangles left are favored to avoid leaving lone
+      // triangles behind
+      valence.at(count) =
+          valenceBoostScale *
+          std::pow(static_cast<float>(count), -valenceBoostPower);
+    }
+  }
+
+  [[nodiscard]] float score(std::size_t cachePosition,
+                            std::uint32_t liveTriangles) const {
+    if (liveTriangles == 0) return -1.0f;
+    return cache.at(std::min(cachePosition, lruCacheSize)) +
+           valence.at(std::min<std::size_t>(liveTriangles, maxValence));
+  }
+};
+
+// Simulates a FIFO cache and calls onTriangle(triangle, misses) for each
+// triangle. The cache is flushed whenever onTriangle returns true.
+template <typename TFun>
+void simulateFifoCache(gsl::span<const std::uint32_t> indices,
+                       std::size_t vertexCount, std::size_t cacheSize,
+                       TFun&& onTriangle) {
+  std::vector<std::size_t> timestamps(vertexCount, 0);
+  // Start after cacheSize so that zero-initialized timestamps are misses
+  auto time{cacheSize + 1};
+  for (std::size_t triangle{}; triangle < indices.size() / 3; ++triangle) {
+    std::size_t misses{};
+    for (const auto corner : {0U, 1U, 2U}) {
+      auto& timestamp{timestamps[indices[triangle * 3 + corner]]};
+      if (time - timestamp > cacheSize) {
+        timestamp = time++;
+        ++misses;
+      }
+    }
+    if (onTriangle(triangle, misses)) {
+      // Reset: move time forward so that every vertex is evicted
+      time += cacheSize + 1;
+    }
+  }
+}
+}  // namespace
+
+/**
+ * @brief Computes post-transform vertex cache statistics.
+ *
+ * Simulates a FIFO cache of the given size, which approximates the behavior
+ * of most GPUs.
+ *
+ * @param indices Triangle list.
+ * @param vertexCount Number of vertices referenced by the index buffer.
+ * @param cacheSize Number of entries of the simulated cache.
+ * @return ACMR and ATVR of the index buffer.
+ */
+abcg::VertexCacheStatistics abcg::analyzeVertexCache(
+    gsl::span<const std::uint32_t> indices, std::size_t vertexCount,
+    std::size_t cacheSize) {
+  checkIndices(indices, vertexCount);
+
+  const auto numTriangles{indices.size() / 3};
+  if (numTriangles == 0) return {};
+
+  std::size_t totalMisses{};
+  simulateFifoCache(indices, vertexCount, cacheSize,
+                    [&](std::size_t, std::size_t misses) {
+                      totalMisses += misses;
+                      return false;
+                    });
+
+  std::vector<bool> referenced(vertexCount, false);
+  for (const auto index : indices) referenced[index] = true;
+  const auto numReferenced{
+      std::count(referenced.begin(), referenced.end(), true)};
+
+  return {.ACMR = static_cast<float>(totalMisses) /
+                  static_cast<float>(numTriangles),
+          .ATVR = static_cast<float>(totalMisses) /
+                  static_cast<float>(numReferenced)};
+}
+
+/**
+ * @brief Reorders triangles to improve post-transform vertex cache locality.
+ *
+ * Uses Forsyth's linear-speed algorithm: triangles are greedily emitted by
+ * score, where a vertex score favors vertices that are recently used in a
+ * simulated LRU cache and vertices with few remaining triangles.
+ *
+ * @param indices Triangle list to be reordered in place.
+ * @param vertexCount Number of vertices referenced by the index buffer.
+ *
+ * @throw abcg::Exception if an index is out of range.
+ */
+void abcg::optimizeVertexCache(gsl::span<std::uint32_t> indices,
+                               std::size_t vertexCount) {
+  checkIndices(indices, vertexCount);
+
+  const auto numTriangles{indices.size() / 3};
+  if (numTriangles == 0) return;
+
+  static const ScoreTables tables{};
+
+  // Vertex-triangle adjacency in compressed sparse row form
+  std::vector<std::uint32_t> liveTriangles(vertexCount, 0);
+  for (std::size_t index{}; index < numTriangles * 3; ++index) {
+    ++liveTriangles[indices[index]];
+  }
+  std::vector<std::uint32_t> offsets(vertexCount + 1, 0);
+  std::partial_sum(liveTriangles.begin(), liveTriangles.end(),
+                   offsets.begin() + 1);
+  std::vector<std::uint32_t> adjacency(numTriangles * 3);
+  {
+    auto fill{offsets};
+    for (std::size_t index{}; index < numTriangles * 3; ++index) {
+      adjacency[fill[indices[index]]++] = static_cast<std::uint32_t>(index / 3);
+    }
+  }
+
+  std::vector<std::size_t> cachePositions(vertexCount, lruCacheSize);
+  std::vector<float> vertexScores(vertexCount);
+  for (std::size_t vertex{}; vertex < vertexCount; ++vertex) {
+    vertexScores[vertex] = tables.score(lruCacheSize, liveTriangles[vertex]);
+  }
+
+  std::vector<float> triangleScores(numTriangles);
+  for (std::size_t triangle{}; triangle < numTriangles; ++triangle) {
+    triangleScores[triangle] = vertexScores[indices[triangle * 3 + 0]] +
+                               vertexScores[indices[triangle * 3 + 1]] +
+                               vertexScores[indices[triangle * 3 + 2]];
+  }
+
+  std::vector<bool> emitted(numTriangles, false);
+  std::vector<std::uint32_t> result;
+  result.reserve(numTriangles * 3);
+
+  // The cache holds up to three extra entries for the vertices of the
+  // triangle just emitted
+  std::vector<std::uint32_t> cache;
+  std::vector<std::uint32_t> newCache;
+  cache.reserve(lruCacheSize + 3);
+  newCache.reserve(lruCacheSize + 3);
+
+  auto bestTriangle{static_cast<std::size_t>(std::distance(
+      triangleScores.begin(),
+      std::max_element(triangleScores.begin(), triangleScores.end())))};
+  std::size_t nextUnemitted{};
+
+  for (std::size_t count{}; count < numTriangles; ++count) {
+    if (bestTriangle == numTriangles) {
+      // No candidate in the cache: take the next triangle in input order
+      while (emitted[nextUnemitted]) ++nextUnemitted;
+      bestTriangle = nextUnemitted;
+    }
+
+    const std::array triangleVertices{indices[bestTriangle * 3 + 0],
+                                      indices[bestTriangle * 3 + 1],
+                                      indices[bestTriangle * 3 + 2]};
+    result.insert(result.end(), triangleVertices.begin(),
+                  triangleVertices.end());
+    emitted[bestTriangle] = true;
+
+    // Remove the triangle from the adjacency of its vertices
+    for (const auto vertex : triangleVertices) {
+      const auto first{adjacency.begin() + offsets[vertex]};
+      const auto last{first + liveTriangles[vertex]};
+      if (const auto it{std::find(first, last, bestTriangle)}; it != last) {
+        std::iter_swap(it, last - 1);
+        --liveTriangles[vertex];
+      }
+    }
+
+    // Move the vertices of the triangle to the front of the cache
+    newCache.assign(triangleVertices.begin(), triangleVertices.end());
+    for (const auto vertex : cache) {
+      if (std::find(triangleVertices.begin(), triangleVertices.end(),
+                    vertex) == triangleVertices.end()) {
+        newCache.push_back(vertex);
+      }
+    }
+    for (std::size_t position{}; position < newCache.size(); ++position) {
+      cachePositions[newCache[position]] = position;
+    }
+    std::swap(cache, newCache);
+
+    // Update scores of vertices in the cache (including the ones that are
+    // just falling out of it) and pick the best triangle among them
+    auto bestScore{-1.0f};
+    bestTriangle = numTriangles;
+    for (const auto vertex : cache) {
+      if (cachePositions[vertex] >= lruCacheSize) {
+        cachePositions[vertex] = lruCacheSize;
+      }
+      const auto score{
+          tables.score(cachePositions[vertex], liveTriangles[vertex])};
+      const auto delta{score - vertexScores[vertex]};
+      vertexScores[vertex] = score;
+
+      const auto first{offsets[vertex]};
+      for (auto adjacent{first}; adjacent < first + liveTriangles[vertex];
+           ++adjacent) {
+        const auto triangle{adjacency[adjacent]};
+        triangleScores[triangle] += delta;
+        if (triangleScores[triangle] > bestScore) {
+          bestScore = triangleScores[triangle];
+          bestTriangle = triangle;
+        }
+      }
+    }
+    if (cache.size() > lruCacheSize) cache.resize(lruCacheSize);
+  }
+
+  std::copy(result.begin(), result.end(), indices.begin());
+}
+
+/**
+ * @brief Reorders clusters of triangles to reduce overdraw.
+ *
+ * The index buffer, usually optimized for the vertex cache beforehand, is
+ * split into clusters at points where the cache is flushed and at points
+ * where restarting the cache costs little (Sander et al., "Fast
+ * Triangle Reordering for Vertex Locality and Reduced Overdraw", 2007).
+ * Clusters are then sorted so that those facing away from the center of the
+ * mesh, which are more likely to occlude others, are drawn first.
+ *
+ * @param indices Triangle list to be reordered in place.
+ * @param positions Vertex positions.
+ * @param threshold Maximum allowed degradation of the vertex cache miss
+ * ratio of each cluster (1.05 allows 5%).
+ *
+ * @throw abcg::Exception if an index is out of range.
+ */
+void abcg::optimizeOverdraw(gsl::span<std::uint32_t> indices,
+                            gsl::span<const glm::vec3> positions,
+                            float threshold) {
+  checkIndices(indices, positions.size());
+
+  const auto numTriangles{indices.size() / 3};
+  if (numTriangles == 0) return;
+
+  // Hard boundaries: triangles whose three vertices miss the cache
+  std::vector<std::size_t> hardClusters;
+  simulateFifoCache(indices, positions.size(), fifoCacheSize,
+                    [&](std::size_t triangle, std::size_t misses) {
+                      if (triangle == 0 || misses == 3) {
+                        hardClusters.push_back(triangle);
+                      }
+                      return false;
+                    });
+  hardClusters.push_back(numTriangles);
+
+  // Soft boundaries: split a hard cluster wherever its miss ratio so far is
+  // within the threshold of the miss ratio of the whole hard cluster
+  std::vector<std::size_t> clusters;
+  for (std::size_t hard{}; hard + 1 < hardClusters.size(); ++hard) {
+    const auto first{hardClusters[hard]};
+    const auto last{hardClusters[hard + 1]};
+    const auto clusterIndices{indices.subspan(first * 3, (last - first) * 3)};
+
+    std::size_t totalMisses{};
+    simulateFifoCache(clusterIndices, positions.size(), fifoCacheSize,
+                      [&](std::size_t, std::size_t misses) {
+                        totalMisses += misses;
+                        return false;
+                      });
+    const auto maxRatio{static_cast<float>(totalMisses) /
+                        static_cast<float>(last - first) * threshold};
+
+    clusters.push_back(first);
+    std::size_t misses{};
+    std::size_t count{};
+    simulateFifoCache(
+        clusterIndices, positions.size(), fifoCacheSize,
+        [&](std::size_t triangle, std::size_t triangleMisses) {
+          misses += triangleMisses;
+          ++count;
+          if (first + triangle + 1 < last &&
+              static_cast<float>(misses) <=
+                  maxRatio * static_cast<float>(count)) {
+            clusters.push_back(first + triangle + 1);
+            misses = 0;
+            count = 0;
+            return true;
+          }
+          return false;
+        });
+  }
+  clusters.push_back(numTriangles);
+
+  // Area-weighted centroid and normal of each cluster
+  const auto numClusters{clusters.size() - 1};
+  std::vector<glm::vec3> centroids(numClusters);
+  std::vector<glm::vec3> normals(numClusters);
+  std::vector<float> areas(numClusters);
+  glm::vec3 meshCentroid{};
+  auto meshArea{0.0f};
+  for (std::size_t cluster{}; cluster < numClusters; ++cluster) {
+    for (auto triangle{clusters[cluster]}; triangle < clusters[cluster + 1];
+         ++triangle) {
+      const auto& a{positions[indices[triangle * 3 + 0]]};
+      const auto& b{positions[indices[triangle * 3 + 1]]};
+      const auto& c{positions[indices[triangle * 3 + 2]]};
+      const auto normal{glm::cross(b - a, c - a)};
+      const auto area{glm::length(normal)};
+      centroids[cluster] += (a + b + c) * (area / 3.0f);
+      normals[cluster] += normal;
+      areas[cluster] += area;
+    }
+    meshCentroid += centroids[cluster];
+    meshArea += areas[cluster];
+  }
+  if (meshArea <= 0.0f) return;
+  meshCentroid /= meshArea;
+
+  std::vector<float> sortKeys(numClusters);
+  for (std::size_t cluster{}; cluster < numClusters; ++cluster) {
+    if (areas[cluster] <= 0.0f) continue;
+    const auto length{glm::length(normals[cluster])};
+    if (length <= 0.0f) continue;
+    const auto centroid{centroids[cluster] / areas[cluster]};
+    sortKeys[cluster] =
+        glm::dot(centroid - meshCentroid, normals[cluster] / length);
+  }
+
+  std::vector<std::size_t> order(numClusters);
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](auto lhs, auto rhs) {
+    return sortKeys[lhs] > sortKeys[rhs];
+  });
+
+  std::vector<std::uint32_t> result;
+  result.reserve(numTriangles * 3);
+  for (const auto cluster : order) {
+    result.insert(
+        result.end(),
+        indices.begin() + static_cast<std::ptrdiff_t>(clusters[cluster] * 3),
+        indices.begin() +
+            static_cast<std::ptrdiff_t>(clusters[cluster + 1] * 3));
+  }
+  std::copy(result.begin(), result.end(), indices.begin());
+}
+
+namespace {
+// Symmetric 4x4 matrix of a quadric error metric (Garland and Heckbert,
+// "Surface Simplification Using Quadric Error Metrics", 1997)
+struct Quadric {
+  float a2{}, ab{}, ac{}, ad{};
+  float b2{}, bc{}, bd{};
+  float c2{}, cd{};
+  float d2{};
+
+  static Quadric fromPlane(glm::vec3 normal, float distance, float weight) {
+    const auto n{normal * weight};
+    return {n.x * normal.x,   n.x * normal.y,   n.x * normal.z,
+            n.x * distance,   n.y * normal.y,   n.y * normal.z,
+            n.y * distance,   n.z * normal.z,   n.z * distance,
+            weight * distance * distance};
+  }
+
+  Quadric& operator+=(const Quadric& other) {
+    a2 += other.a2;
+    ab += other.ab;
+    ac += other.ac;
+    ad += other.ad;
+    b2 += other.b2;
+    bc += other.bc;
+    bd += other.bd;
+    c2 += other.c2;
+    cd += other.cd;
+    d2 += other.d2;
+    return *this;
+  }
+
+  // Sum of squared distances of a point to the planes of the quadric
+  [[nodiscard]] float evaluate(glm::vec3 p) const {
+    const auto error{p.x * (a2 * p.x + 2.0f * (ab * p.y + ac * p.z + ad)) +
+                     p.y * (b2 * p.y + 2.0f * (bc * p.z + bd)) +
+                     p.z * (c2 * p.z + 2.0f * cd) + d2};
+    return std::max(error, 0.0f);
+  }
+};
+
+struct PositionHash {
+  std::size_t operator()(const glm::vec3& position) const noexcept {
+    std::size_t seed{};
+    abcg::hashCombine(seed, position.x);
+    abcg::hashCombine(seed, position.y);
+    abcg::hashCombine(seed, position.z);
+    return seed;
+  }
+};
+
+struct Collapse {
+  std::uint32_t source{};
+  std::uint32_t target{};
+  float cost{};
+};
+}  // namespace
+
+/**
+ * @brief Reduces the number of triangles of a mesh by edge collapse.
+ *
+ * Each collapse moves one vertex onto a neighbor, so the simplified index
+ * buffer references the original vertex array and can share its vertex
+ * buffer. Collapses are chosen in order of increasing quadric error. Vertices
+ * on open borders and on attribute seams (vertices sharing a position with
+ * other vertices) are never moved, and collapses that would flip a triangle
+ * are rejected.
+ *
+ * @param indices Triangle list.
+ * @param positions Vertex positions.
+ * @param targetIndexCount Number of indices to stop at.
+ * @param targetError Maximum geometric error, relative to the largest
+ * extent of the mesh.
+ * @return Simplified triangle list and the error actually reached. The index
+ * count may be larger than the target if the error limit is reached first.
+ *
+ * @throw abcg::Exception if an index is out of range.
+ */
+abcg::SimplifiedMesh abcg::simplify(gsl::span<const std::uint32_t> indices,
+                                    gsl::span<const glm::vec3> positions,
+                                    std::size_t targetIndexCount,
+                                    float targetError) {
+  checkIndices(indices, positions.size());
+
+  SimplifiedMesh result{};
+  result.indices.assign(indices.begin(),
+                        indices.begin() + static_cast<std::ptrdiff_t>(
+                                              indices.size() / 3 * 3));
+  if (result.indices.size() <= targetIndexCount || positions.empty()) {
+    return result;
+  }
+
+  // Work in a frame where the largest extent of the mesh is 1
+  glm::vec3 min{positions[0]};
+  glm::vec3 max{positions[0]};
+  for (const auto& position : positions) {
+    min = glm::min(min, position);
+    max = glm::max(max, position);
+  }
+  const auto extent{std::max({max.x - min.x, max.y - min.y, max.z - min.z})};
+  const auto scale{extent > 0.0f ? 1.0f / extent : 1.0f};
+  std::vector<glm::vec3> scaled(positions.size());
+  std::transform(positions.begin(), positions.end(), scaled.begin(),
+                 [&](const glm::vec3& position) {
+                   return (position - min) * scale;
+                 });
+
+  // Vertices sharing a position (attribute seams) form a group
+  std::vector<glm::vec3> uniquePositions;
+  std::vector<std::uint32_t> groups(positions.size());
+  {
+    abcg::VertexWelder<glm::vec3, PositionHash> welder{uniquePositions,
+                                                       positions.size()};
+    for (std::size_t vertex{}; vertex < positions.size(); ++vertex) {
+      groups[vertex] = welder.insert(scaled[vertex]);
+    }
+  }
+  const auto numGroups{uniquePositions.size()};
+
+  std::vector<std::uint32_t> groupSizes(numGroups, 0);
+  std::vector<bool> referenced(positions.size(), false);
+  for (const auto index : result.indices) referenced[index] = true;
+  for (std::size_t vertex{}; vertex < positions.size(); ++vertex) {
+    if (referenced[vertex]) ++groupSizes[groups[vertex]];
+  }
+
+  // Lock seams, open borders and non-manifold edges
+  std::vector<bool> locked(numGroups, false);
+  for (std::size_t group{}; group < numGroups; ++group) {
+    locked[group] = groupSizes[group] > 1;
+  }
+  {
+    std::unordered_map<std::uint64_t, int> edgeCount;
+    edgeCount.reserve(result.indices.size());
+    auto edgeKey{[&](std::uint32_t a, std::uint32_t b) {
+      const auto ga{groups[a]};
+      const auto gb{groups[b]};
+      return (std::uint64_t{std::min(ga, gb)} << 32U) | std::max(ga, gb);
+    }};
+    for (std::size_t index{}; index < result.indices.size(); index += 3) {
+      for (const auto corner : {0U, 1U, 2U}) {
+        ++edgeCount[edgeKey(result.indices[index + corner],
+                            result.indices[index + (corner + 1) % 3])];
+      }
+    }
+    for (const auto& [key, count] : edgeCount) {
+      if (count != 2) {
+        locked[key >> 32U] = true;
+        locked[key & 0xffffffffU] = true;
+      }
+    }
+  }
+
+  // Accumulate the planes of the triangles around each position
+  std::vector<Quadric> quadrics(numGroups);
+  for (std::size_t index{}; index < result.indices.size(); index += 3) {
+    const auto& a{scaled[result.indices[index + 0]]};
+    const auto& b{scaled[result.indices[index + 1]]};
+    const auto& c{scaled[result.indices[index + 2]]};
+    const auto cross{glm::cross(b - a, c - a)};
+    const auto length{glm::length(cross)};
+    if (length <= 0.0f) continue;
+    const auto normal{cross / length};
+    const auto quadric{
+        Quadric::fromPlane(normal, -glm::dot(normal, a), length * 0.5f)};
+    for (const auto corner : {0U, 1U, 2U}) {
+      quadrics[groups[result.indices[index + corner]]] += quadric;
+    }
+  }
+
+  const auto maxCost{targetError * targetError};
+  std::vector<std::uint32_t> remap(positions.size());
+  std::vector<bool> touched(positions.size());
+  std::vector<Collapse> collapses;
+  std::vector<std::uint32_t> offsets(positions.size() + 1);
+  std::vector<std::uint32_t> adjacency;
+
+  while (result.indices.size() > targetIndexCount) {
+    const auto numTriangles{result.indices.size() / 3};
+
+    // Vertex-triangle adjacency of the current triangles
+    std::fill(offsets.begin(), offsets.end(), 0);
+    for (const auto index : result.indices) ++offsets[index + 1];
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+    adjacency.resize(result.indices.size());
+    {
+      auto fill{offsets};
+      for (std::size_t index{}; index < result.indices.size(); ++index) {
+        adjacency[fill[result.indices[index]]++] =
+            static_cast<std::uint32_t>(index / 3);
+      }
+    }
+
+    // Cheapest collapse of each movable vertex
+    collapses.clear();
+    for (std::size_t vertex{}; vertex < positions.size(); ++vertex) {
+      if (offsets[vertex] == offsets[vertex + 1] || locked[groups[vertex]]) {
+        continue;
+      }
+      Collapse best{.source = static_cast<std::uint32_t>(vertex),
+                    .target = static_cast<std::uint32_t>(vertex),
+                    .cost = std::numeric_limits<float>::max()};
+      for (auto adjacent{offsets[vertex]}; adjacent < offsets[vertex + 1];
+           ++adjacent) {
+        const auto triangle{adjacency[adjacent]};
+        for (const auto corner : {0U, 1U, 2U}) {
+          const auto target{result.indices[triangle * 3 + corner]};
+          if (target == vertex) continue;
+          auto quadric{quadrics[groups[vertex]]};
+          quadric += quadrics[groups[target]];
+          const auto cost{quadric.evaluate(scaled[target])};
+          if (cost < best.cost) {
+            best.target = target;
+            best.cost = cost;
+          }
+        }
+      }
+      if (best.target != vertex && best.cost <= maxCost) {
+        collapses.push_back(best);
+      }
+    }
+    if (collapses.empty()) break;
+
+    std::sort(collapses.begin(), collapses.end(),
+              [](const auto& lhs, const auto& rhs) {
+                return lhs.cost < rhs.cost;
+              });
+
+    // Apply independent collapses until the target is reached
+    std::iota(remap.begin(), remap.end(), 0);
+    std::fill(touched.begin(), touched.end(), false);
+    auto remainingTriangles{numTriangles};
+    std::size_t numCollapses{};
+    for (const auto& collapse : collapses) {
+      if (remainingTriangles * 3 <= targetIndexCount) break;
+      if (touched[collapse.source] || touched[collapse.target]) continue;
+
+      // Reject collapses that flip or degenerate a triangle
+      auto valid{true};
+      std::size_t removed{};
+      const auto sourceGroup{groups[collapse.source]};
+      const auto targetGroup{groups[collapse.target]};
+      for (auto adjacent{offsets[collapse.source]};
+           valid && adjacent < offsets[collapse.source + 1]; ++adjacent) {
+        const auto triangle{adjacency[adjacent]};
+        std::array<glm::vec3, 3> before{};
+        std::array<glm::vec3, 3> after{};
+        auto hasTarget{false};
+        for (const auto corner : {0U, 1U, 2U}) {
+          const auto vertex{result.indices[triangle * 3 + corner]};
+          hasTarget |= groups[vertex] == targetGroup;
+          before.at(corner) = scaled[vertex];
+          after.at(corner) = groups[vertex] == sourceGroup
+                                 ? scaled[collapse.target]
+                                 : scaled[vertex];
+        }
+        if (hasTarget) {
+          ++removed;
+          continue;
+        }
+        const auto normalBefore{
+            glm::cross(before[1] - before[0], before[2] - before[0])};
+        const auto normalAfter{
+            glm::cross(after[1] - after[0], after[2] - after[0])};
+        valid = glm::dot(normalBefore, normalAfter) > 0.0f;
+      }
+      if (!valid) continue;
+
+      remap[collapse.source] = collapse.target;
+      quadrics[targetGroup] += quadrics[sourceGroup];
+      result.error = std::max(result.error, collapse.cost);
+      remainingTriangles -= removed;
+      ++numCollapses;
+
+      // Keep the collapses of this pass independent of each other
+      for (auto adjacent{offsets[collapse.source]};
+           adjacent < offsets[collapse.source + 1]; ++adjacent) {
+        const auto triangle{adjacency[adjacent]};
+        for (const auto corner : {0U, 1U, 2U}) {
+          touched[result.indices[triangle * 3 + corner]] = true;
+        }
+      }
+    }
+    if (numCollapses == 0) break;
+
+    // Rewrite the triangles and drop the ones that became degenerate
+    std::size_t write{};
+    for (std::size_t index{}; index < result.indices.size(); index += 3) {
+      const std::array triangle{remap[result.indices[index + 0]],
+                                remap[result.indices[index + 1]],
+                                remap[result.indices[index + 2]]};
+      if (groups[triangle[0]] == groups[triangle[1]] ||
+          groups[triangle[1]] == groups[triangle[2]] ||
+          groups[triangle[2]] == groups[triangle[0]]) {
+        continue;
+      }
+      std::copy(triangle.begin(), triangle.end(),
+                result.indices.begin() + static_cast<std::ptrdiff_t>(write));
+      write += 3;
+    }
+    result.indices.resize(write);
+  }
+
+  result.error = std::sqrt(result.error);
+  return result;
+}
+
+/**
+ * @brief Splits a triangle list into clusters with bounding volumes for
+ * culling.
+ *
+ * Clusters are grown greedily from a seed triangle, adding at each step the
+ * adjacent triangle that brings the fewest new vertices and whose normal is
+ * closest to the average normal of the cluster. The index buffer is reordered
+ * so that each cluster is a contiguous range.
+ *
+ * @param indices Triangle list to be reordered in place.
+ * @param positions Vertex positions.
+ * @param maxVertices Maximum number of distinct vertices per cluster.
+ * @param maxTriangles Maximum number of triangles per cluster.
+ * @return Clusters in index buffer order.
+ *
+ * @throw abcg::Exception if an index is out of range or if a limit is too
+ * small to hold one triangle.
+ */
+std::vector<abcg::Meshlet> abcg::buildMeshlets(
+    gsl::span<std::uint32_t> indices, gsl::span<const glm::vec3> positions,
+    std::size_t maxVertices, std::size_t maxTriangles) {
+  checkIndices(indices, positions.size());
+  if (maxVertices < 3 || maxTriangles < 1) {
+    throw abcg::Exception{abcg::Exception::Runtime(
+        fmt::format("Invalid meshlet limits ({} vertices, {} triangles)",
+                    maxVertices, maxTriangles))};
+  }
+
+  const auto numTriangles{indices.size() / 3};
+  const auto numVertices{positions.size()};
+
+  // Triangles adjacent to each vertex, in compressed sparse row format
+  std::vector<std::uint32_t> adjacencyOffsets(numVertices + 1);
+  for (const auto index : indices) ++adjacencyOffsets[index + 1];
+  std::partial_sum(adjacencyOffsets.begin(), adjacencyOffsets.end(),
+                   adjacencyOffsets.begin());
+  std::vector<std::uint32_t> adjacency(numTriangles * 3);
+  {
+    auto fill{adjacencyOffsets};
+    for (std::size_t triangle{}; triangle < numTriangles; ++triangle) {
+      for (std::size_t corner{}; corner < 3; ++corner) {
+        adjacency[fill[indices[triangle * 3 + corner]]++] =
+            static_cast<std::uint32_t>(triangle);
+      }
+    }
+  }
+
+  // Unit normals, or zero for degenerate triangles
+  std::vector<glm::vec3> normals(numTriangles);
+  for (std::size_t triangle{}; triangle < numTriangles; ++triangle) {
+    const auto& a{positions[indices[triangle * 3 + 0]]};
+    const auto& b{positions[indices[triangle * 3 + 1]]};
+    const auto& c{positions[indices[triangle * 3 + 2]]};
+    const auto normal{glm::cross(b - a, c - a)};
+    const auto length{glm::length(normal)};
+    if (length > 0.0f) normals[triangle] = normal / length;
+  }
+
+  std::vector<std::uint32_t> result;
+  result.reserve(numTriangles * 3);
+  std::vector<Meshlet> meshlets;
+  std::vector<bool> emitted(numTriangles);
+  // Last cluster in which each vertex was added, and its index there
+  std::vector<std::uint32_t> vertexCluster(numVertices, invalidIndex);
+  std::vector<std::uint32_t> localIndices(numVertices);
+  std::vector<std::uint32_t> clusterVertices;
+  std::vector<std::size_t> clusterTriangles;
+  std::size_t seed{};
+
+  const auto countNewVertices{[&](std::size_t triangle, std::uint32_t id) {
+    std::size_t count{};
+    for (std::size_t corner{}; corner < 3; ++corner) {
+      if (vertexCluster[indices[triangle * 3 + corner]] != id) ++count;
+    }
+    return count;
+  }};
+
+  while (true) {
+    while (seed < numTriangles && emitted[seed]) ++seed;
+    if (seed == numTriangles) break;
+
+    const auto id{static_cast<std::uint32_t>(meshlets.size())};
+    Meshlet meshlet{.indexOffset = static_cast<std::uint32_t>(result.size())};
+    clusterVertices.clear();
+    clusterTriangles.clear();
+    glm::vec3 normalSum{};
+
+    auto triangle{seed};
+    for (std::size_t count{1};; ++count) {
+      emitted[triangle] = true;
+      clusterTriangles.push_back(triangle);
+      for (std::size_t corner{}; corner < 3; ++corner) {
+        const auto vertex{indices[triangle * 3 + corner]};
+        result.push_back(vertex);
+        if (vertexCluster[vertex] != id) {
+          vertexCluster[vertex] = id;
+          localIndices[vertex] =
+              static_cast<std::uint32_t>(clusterVertices.size());
+          clusterVertices.push_back(vertex);
+        }
+      }
+      normalSum += normals[triangle];
+      if (count == maxTriangles) break;
+
+      // Pick the best adjacent triangle that still fits
+      const auto axisLength{glm::length(normalSum)};
+      const auto axis{axisLength > 0.0f ? normalSum / axisLength
+                                        : glm::vec3{}};
+      auto bestTriangle{numTriangles};
+      auto bestScore{std::numeric_limits<float>::max()};
+      for (const auto vertex : clusterVertices) {
+        for (auto adjacent{adjacencyOffsets[vertex]};
+             adjacent < adjacencyOffsets[vertex + 1]; ++adjacent) {
+          const auto candidate{adjacency[adjacent]};
+          if (emitted[candidate]) continue;
+          const auto newVertices{countNewVertices(candidate, id)};
+          if (clusterVertices.size() + newVertices > maxVertices) continue;
+
+          const auto score{static_cast<float>(newVertices) + 1.0f -
+                           glm::dot(normals[candidate], axis)};
+          if (score < bestScore) {
+            bestScore = score;
+            bestTriangle = candidate;
+          }
+        }
+      }
+
+      // Otherwise continue with the next triangle in input order, which is
+      // usually close to the previous ones
+      if (bestTriangle == numTriangles) {
+        while (seed < numTriangles && emitted[seed]) ++seed;
+        if (seed == numTriangles ||
+            clusterVertices.size() + countNewVertices(seed, id) >
+                maxVertices) {
+          break;
+        }
+        bestTriangle = seed;
+      }
+      triangle = bestTriangle;
+    }
+    meshlet.indexCount =
+        static_cast<std::uint32_t>(result.size()) - meshlet.indexOffset;
+
+    // Restore vertex cache locality within the cluster. Local indices keep
+    // the tables of the optimizer small
+    const auto clusterIndices{
+        gsl::span{result}.subspan(meshlet.indexOffset, meshlet.indexCount)};
+    for (auto& index : clusterIndices) index = localIndices[index];
+    optimizeVertexCache(clusterIndices, clusterVertices.size());
+    for (auto& index : clusterIndices) index = clusterVertices[index];
+
+    // Bounding sphere centered at the center of the bounding box
+    auto min{positions[clusterVertices.front()]};
+    auto max{min};
+    for (const auto vertex : clusterVertices) {
+      min = glm::min(min, positions[vertex]);
+      max = glm::max(max, positions[vertex]);
+    }
+    meshlet.center = (min + max) * 0.5f;
+    for (const auto vertex : clusterVertices) {
+      meshlet.radius = std::max(
+          meshlet.radius, glm::distance(positions[vertex], meshlet.center));
+    }
+
+    // Normal cone. A cone wider than a hemisphere (with some margin for
+    // precision) cannot be entirely back-facing
+    const auto axisLength{glm::length(normalSum)};
+    if (axisLength > 0.0f) {
+      meshlet.coneAxis = normalSum / axisLength;
+      auto minDot{1.0f};
+      for (const auto clusterTriangle : clusterTriangles) {
+        const auto& normal{normals[clusterTriangle]};
+        if (normal != glm::vec3{}) {
+          minDot = std::min(minDot, glm::dot(normal, meshlet.coneAxis));
+        }
+      }
+      if (minDot > 0.1f) {
+        meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+      }
+    }
+
+    meshlets.push_back(meshlet);
+  }
+
+  std::copy(result.begin(), result.end(), indices.begin());
+  return meshlets;
+}
+
+/**
+ * @brief Tests whether all triangles of a cluster face away from a viewer.
+ *
+ * The test is conservative: it considers every point of the bounding sphere
+ * as a possible apex of the normal cone.
+ *
+ * @param meshlet Cluster to be tested.
+ * @param viewerPosition Position of the viewer in the space of the mesh.
+ * @return Whether the cluster can be culled, assuming back-face culling.
+ */
+bool abcg::isBackFacing(const Meshlet& meshlet,
+                        const glm::vec3& viewerPosition) {
+  const auto direction{meshlet.center - viewerPosition};
+  return glm::dot(direction, meshlet.coneAxis) >=
+         meshlet.coneCutoff * glm::length(direction) + meshlet.radius;
+}
+
+/**
+ * @brief Groups the triangles of a triangle list by material.
+ *
+ * Triangles are sorted by material ID with a stable counting sort, so that the
+ * order produced by the other optimizations is kept within each material.
+ * Each material can then be drawn with a single call.
+ *
+ * @param indices Triangle list to be reordered in place.
+ * @param materialIDs Material of each triangle, or -1 for no material.
+ * @return One submesh per material used, by increasing material ID. Triangles
+ * with no material come first.
+ *
+ * @throw abcg::Exception if the number of material IDs does not match the
+ * number of triangles.
+ */
+std::vector<abcg::Submesh> abcg::sortByMaterial(
+    gsl::span<std::uint32_t> indices, gsl::span<const int> materialIDs) {
+  const auto numTriangles{indices.size() / 3};
+  if (materialIDs.size() != numTriangles) {
+    throw abcg::Exception{abcg::Exception::Runtime(
+        fmt::format("Expected {} material IDs, got {}", numTriangles,
+                    materialIDs.size()))};
+  }
+  if (numTriangles == 0) return {};
+
+  // Slot 0 holds the triangles with no material
+  const auto maxID{*std::max_element(materialIDs.begin(), materialIDs.end())};
+  std::vector<std::uint32_t> offsets(
+      static_cast<std::size_t>(std::max(maxID, -1) + 3));
+  auto slot{[](int materialID) {
+    return static_cast<std::size_t>(std::max(materialID, -1) + 1);
+  }};
+  for (const auto materialID : materialIDs) ++offsets[slot(materialID) + 1];
+
+  std::vector<abcg::Submesh> submeshes;
+  for (std::size_t index{1}; index < offsets.size(); ++index) {
+    if (offsets[index] > 0) {
+      submeshes.push_back({.indexOffset = offsets[index - 1] * 3,
+                           .indexCount = offsets[index] * 3,
+                           .materialID = static_cast<std::int32_t>(index) - 2});
+    }
+    offsets[index] += offsets[index - 1];
+  }
+  if (submeshes.size() == 1) return submeshes;
+
+  std::vector<std::uint32_t> sorted(indices.size());
+  for (std::size_t triangle{}; triangle < numTriangles; ++triangle) {
+    const auto target{offsets[slot(materialIDs[triangle])]++};
+    std::copy_n(indices.begin() + static_cast<std::ptrdiff_t>(triangle * 3), 3,
+                sorted.begin() + static_cast<std::ptrdiff_t>(target * 3));
+  }
+  std::copy(sorted.begin(), sorted.end(), indices.begin());
+  return submeshes;
+}
+
+/**
+ * @brief Computes a vertex remapping table that lists vertices in the order
+ * they are first referenced, and applies it to the index buffer.
+ *
+ * @param indices Index buffer to be remapped in place.
+ * @param vertexCount Number of vertices referenced by the index buffer.
+ * @return Table mapping each old vertex index to its new index, or to
+ * ~std::uint32_t{} if the vertex is not referenced.
+ *
+ * @throw abcg::Exception if an index is out of range.
+ */
+std::vector<std::uint32_t> abcg::computeVertexFetchRemap(
+    gsl::span<std::uint32_t> indices, std::size_t vertexCount) {
+  checkIndices(indices, vertexCount);
+
+  std::vector<std::uint32_t> remap(vertexCount, invalidIndex);
+  std::uint32_t nextIndex{};
+  for (auto& index : indices) {
+    if (remap[index] == invalidIndex) remap[index] = nextIndex++;
+    index = remap[index];
+  }
+  return remap;
+}
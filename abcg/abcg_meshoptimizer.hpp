@@ -0,0 +1,134 @@
+/**
+ * @file abcg_meshoptimizer.hpp
+ * @brief Declaration of index and vertex reordering functions for indexed
+ * triangle meshes.
+ *
+ * This project is released under the MIT License.
+ */
+
+#ifndef ABCG_MESHOPTIMIZER_HPP_
+#define ABCG_MESHOPTIMIZER_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <glm/vec3.hpp>
+#include <gsl/gsl>
+#include <utility>
+#include <vector>
+
+namespace abcg {
+/**
+ * @brief Post-transform vertex cache statistics of an index buffer.
+ *
+ */
+struct VertexCacheStatistics {
+  /** @brief Average cache miss ratio: transformed vertices per triangle. */
+  float ACMR{};
+  /** @brief Average transform to vertex ratio: transformed vertices per
+   * referenced vertex (1 is optimal). */
+  float ATVR{};
+};
+
+/**
+ * @brief Index buffer produced by abcg::simplify.
+ *
+ */
+struct SimplifiedMesh {
+  /** @brief Simplified triangle list referencing the original vertices. */
+  std::vector<std::uint32_t> indices;
+  /** @brief Geometric error, relative to the largest extent of the mesh. */
+  float error{};
+};
+
+/**
+ * @brief Cluster of triangles produced by abcg::buildMeshlets.
+ *
+ */
+struct Meshlet {
+  /** @brief Position of the first index of the cluster in the index buffer. */
+  std::uint32_t indexOffset{};
+  /** @brief Number of indices of the cluster. */
+  std::uint32_t indexCount{};
+  /** @brief Center of the bounding sphere. */
+  glm::vec3 center{};
+  /** @brief Radius of the bounding sphere. */
+  float radius{};
+  /** @brief Average normal of the triangles. */
+  glm::vec3 coneAxis{};
+  /** @brief Sine of the half-angle of the normal cone, or 1 if the triangles
+   * never all face away from the viewer at once. */
+  float coneCutoff{1.0f};
+};
+
+/**
+ * @brief Range of triangles that share a material, produced by
+ * abcg::sortByMaterial.
+ *
+ */
+struct Submesh {
+  /** @brief Position of the first index of the range in the index buffer. */
+  std::uint32_t indexOffset{};
+  /** @brief Number of indices of the range. */
+  std::uint32_t indexCount{};
+  /** @brief Index of the material, or -1 if the triangles have none. */
+  std::int32_t materialID{-1};
+};
+
+[[nodiscard]] VertexCacheStatistics analyzeVertexCache(
+    gsl::span<const std::uint32_t> indices, std::size_t vertexCount,
+    std::size_t cacheSize = 16);
+
+void optimizeVertexCache(gsl::span<std::uint32_t> indices,
+                         std::size_t vertexCount);
+void optimizeOverdraw(gsl::span<std::uint32_t> indices,
+                      gsl::span<const glm::vec3> positions,
+                      float threshold = 1.05f);
+[[nodiscard]] SimplifiedMesh simplify(gsl::span<const std::uint32_t> indices,
+                                      gsl::span<const glm::vec3> positions,
+                                      std::size_t targetIndexCount,
+                                      float targetError = 1e-2f);
+[[nodiscard]] std::vector<Meshlet> buildMeshlets(
+    gsl::span<std::uint32_t> indices, gsl::span<const glm::vec3> positions,
+    std::size_t maxVertices = 64, std::size_t maxTriangles = 124);
+[[nodiscard]] bool isBackFacing(const Meshlet& meshlet,
+                                const glm::vec3& viewerPosition);
+[[nodiscard]] std::vector<Submesh> sortByMaterial(
+    gsl::span<std::uint32_t> indices, gsl::span<const int> materialIDs);
+[[nodiscard]] std::vector<std::uint32_t> computeVertexFetchRemap(
+    gsl::span<std::uint32_t> indices, std::size_t vertexCount);
+
+template <typename TVertex>
+void optimizeVertexFetch(std::vector<TVertex>& vertices,
+                         gsl::span<std::uint32_t> indices);
+}  // namespace abcg
+
+/**
+ * @brief Renumbers vertices in the order they are first referenced by the
+ * index buffer.
+ *
+ * Indices are updated accordingly. Vertices not referenced by any index are
+ * removed.
+ *
+ * @param vertices Vertex array to be reordered.
+ * @param indices Index buffer referencing the vertex array.
+ */
+template <typename TVertex>
+void abcg::optimizeVertexFetch(std::vector<TVertex>& vertices,
+                               gsl::span<std::uint32_t> indices) {
+  const auto remap{computeVertexFetchRemap(indices, vertices.size())};
+
+  std::size_t numUsed{};
+  for (const auto newIndex : remap) {
+    if (newIndex != ~std::uint32_t{}) ++numUsed;
+  }
+
+  std::vector<TVertex> reordered(numUsed);
+  for (std::size_t index{}; index < remap.size(); ++index) {
+    if (remap[index] != ~std::uint32_t{}) {
+      reordered[remap[index]] = vertices[index];
+    }
+  }
+  vertices = std::move(reordered);
+}
+
+#endif
@@ -0,0 +1,753 @@
+/**
+ * @file abcg_objreader.cpp
+ * @brief Definition of abcg::ObjReader class members.
+ *
+ * This project is released under the MIT License.
+ */
+
+#include "abcg_objreader.hpp"
+
+#include <cppitertools/itertools.hpp>
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <iterator>
+#include <limits>
+#include <map>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "abcg_exception.hpp"
+#include "abcg_mappedfile.hpp"
+#include "abcg_threadpool.hpp"
+
+namespace {
+// Chunks smaller than this are not worth the scheduling overhead
+constexpr std::size_t minChunkSize{256 * 1024};
+
+// Face indices that are relative to the end of the attribute arrays (negative
+// OBJ indices) are resolved in two steps. While parsing, they are stored
+// relative to the start of the chunk (possibly referring to a previous chunk)
+// and biased to a negative range, so that -1 keeps meaning "not present". The
+// chunk base is added when the chunks are merged.
+constexpr int localBias{1 << 30};
+constexpr int encodeLocal(int localIndex) { return localIndex - localBias; }
+constexpr bool isLocal(int index) { return index <= -2; }
+constexpr int decodeLocal(int index) { return index + localBias; }
+
+struct Event {
+  enum class Type { Shape, Material };
+  Type type{};
+  std::size_t indexOffset{};  // Number of indices of the chunk before event
+  std::size_t nameIndex{};
+};
+
+// Face with more than 3 vertices. It is triangulated as a fan while parsing,
+// and its triangles are replaced once every position is known
+struct Polygon {
+  std::size_t indexOffset{};
+  std::size_t numVertices{};
+};
+
+struct Chunk {
+  const char* begin{};
+  const char* end{};
+
+  std::vector<float> vertices;
+  std::vector<float> normals;
+  std::vector<float> texcoords;
+  std::vector<float> colors;
+  std::vector<tinyobj::index_t> indices;  // Triangulated faces
+  std::vector<Polygon> polygons;
+
+  std::vector<Event> events;
+  std::vector<std::string> names;
+  std::vector<std::vector<std::string>> materialLibraries;
+
+  std::string error;
+  const char* errorPosition{};
+};
+
+bool isSpace(char character) { return character == ' ' || character == '\t'; }
+
+bool isDigit(char character) {
+  return static_cast<unsigned char>(character - '0') < 10;
+}
+
+const char* skipSpaces(const char* first, const char* last) {
+  while (first != last && isSpace(*first)) ++first;
+  return first;
+}
+
+// Finds the newlines of a chunk in order. With SSE2, the newlines of each
+// 16-byte block are found at once as a bit mask, so that short lines do not
+// each pay for a call to memchr
+class NewlineScanner {
+ public:
+  NewlineScanner(const char* first, const char* last)
+      : m_next{first}, m_last{last} {}
+
+  // Returns the position of the next newline, or the end of the chunk
+  const char* next() {
+#if defined(__SSE2__)
+    while (m_mask == 0 && m_last - m_next >= 16) {
+      const auto block{
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(m_next))};
+      m_mask = static_cast<unsigned>(
+          _mm_movemask_epi8(_mm_cmpeq_epi8(block, _mm_set1_epi8('\n'))));
+      m_block = m_next;
+      m_next += 16;
+    }
+    if (m_mask != 0) {
+      const auto* newline{m_block + std::countr_zero(m_mask)};
+      m_mask &= m_mask - 1;
+      return newline;
+    }
+#endif
+    if (m_next >= m_last) return m_last;
+    const auto* newline{static_cast<const char*>(std::memchr(
+        m_next, '\n', static_cast<std::size_t>(m_last - m_next)))};
+    if (newline == nullptr) newline = m_last;
+    m_next = newline + 1;
+    return newline;
+  }
+
+ private:
+  const char* m_next{};
+  const char* m_last{};
+#if defined(__SSE2__)
+  const char* m_block{};
+  unsigned m_mask{};
+#endif
+};
+
+constexpr std::array<std::uint64_t, 9> powersOf10{
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000};
+
+// Number of leading decimal digits of 8 characters loaded as a little-endian
+// word
+int countDigits(std::uint64_t word) {
+  // Zero the bytes that are digits: high nibble 3 and low nibble below 10
+  const auto x{word ^ 0x3030303030303030ULL};
+  const auto nonDigits{(x & 0xF0F0F0F0F0F0F0F0ULL) |
+                       (((x & 0x0F0F0F0F0F0F0F0FULL) + 0x0606060606060606ULL) &
+                        0xF0F0F0F0F0F0F0F0ULL)};
+  if (nonDigits == 0) return 8;
+  return std::countr_zero(nonDigits) / 8;
+}
+
+// Converts the digits of a little-endian word, first digit in the lowest
+// byte, to their value. Bytes above numDigits are ignored
+std::uint64_t convertDigits(std::uint64_t word, int numDigits) {
+  // Leading zeros are shifted in below the digits. Non-digit bytes can only
+  // borrow from the bytes above them, which are shifted out
+  auto value{(word - 0x3030303030303030ULL) << (64 - 8 * numDigits)};
+  value = value * 10 + (value >> 8U);
+  value = (((value & 0x000000FF000000FFULL) * (100 + (1000000ULL << 32U))) +
+           (((value >> 16U) & 0x000000FF000000FFULL) *
+            (1 + (10000ULL << 32U)))) >>
+          32U;
+  return value & 0xFFFFFFFFULL;
+}
+
+// Accumulates a run of decimal digits into value and returns the number of
+// digits. The digits are converted 8 at a time when 8 characters can be read
+// without passing the end of the line. value overflows after 19 digits
+std::size_t parseDigits(const char*& first, const char* last,
+                        std::uint64_t& value) {
+  std::size_t count{};
+  if constexpr (std::endian::native == std::endian::little) {
+    while (last - first >= 8) {
+      std::uint64_t word{};
+      std::memcpy(&word, first, sizeof(word));
+      const auto numDigits{countDigits(word)};
+      if (numDigits == 0) return count;
+      value = value * powersOf10.at(static_cast<std::size_t>(numDigits)) +
+              convertDigits(word, numDigits);
+      first += numDigits;
+      count += static_cast<std::size_t>(numDigits);
+      if (numDigits < 8) return count;
+    }
+  }
+  while (first != last && isDigit(*first)) {
+    value = value * 10 + static_cast<std::uint64_t>(*first - '0');
+    ++first;
+    ++count;
+  }
+  return count;
+}
+
+// Parses with std::from_chars, which rounds correctly, or with std::strtof
+// where it is not available for floats
+bool parseFloat(const char*& first, const char* last, float& value) {
+  first = skipSpaces(first, last);
+  // std::from_chars does not accept a leading plus sign
+  if (first != last && *first == '+') ++first;
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+  const auto [ptr, ec]{std::from_chars(first, last, value)};
+  if (ec != std::errc{}) return false;
+  first = ptr;
+#else
+  // Copy the token since the mapped data is not null-terminated
+  std::array<char, 64> token{};
+  std::size_t length{};
+  while (first + length != last && !isSpace(first[length]) &&
+         first[length] != '\r' && length + 1 < token.size()) {
+    token.at(length) = first[length];
+    ++length;
+  }
+  char* tokenEnd{};
+  value = std::strtof(token.data(), &tokenEnd);
+  if (tokenEnd == token.data()) return false;
+  first += tokenEnd - token.data();
+#endif
+  return true;
+}
+
+bool parseInt(const char*& first, const char* last, int& value) {
+  if (first != last && *first == '+') ++first;
+  const auto* position{first};
+  const auto negative{position != last && *position == '-'};
+  if (negative) ++position;
+
+  std::uint64_t magnitude{};
+  const auto numDigits{parseDigits(position, last, magnitude)};
+  if (numDigits == 0 || numDigits > 10 ||
+      magnitude > static_cast<std::uint64_t>(
+                      std::numeric_limits<int>::max())) {
+    return false;
+  }
+  value = negative ? -static_cast<int>(magnitude)
+                   : static_cast<int>(magnitude);
+  first = position;
+  return true;
+}
+
+std::string_view trim(const char* first, const char* last) {
+  first = skipSpaces(first, last);
+  while (last != first && isSpace(*(last - 1))) --last;
+  return {first, static_cast<std::size_t>(last - first)};
+}
+
+// Converts a 1-based (or negative, relative) OBJ index to a 0-based index
+bool fixIndex(int index, std::size_t localCount, int& result) {
+  if (index > 0) {
+    result = index - 1;
+    return true;
+  }
+  if (index < 0) {
+    const auto localIndex{static_cast<int>(localCount) + index};
+    result = encodeLocal(localIndex);
+    return localIndex >= -localBias && localIndex < localBias - 2;
+  }
+  return false;
+}
+
+bool parseFace(Chunk& chunk, const char* first, const char* last,
+               std::vector<tinyobj::index_t>& polygon) {
+  polygon.clear();
+  const auto numVertices{chunk.vertices.size() / 3};
+  const auto numNormals{chunk.normals.size() / 3};
+  const auto numTexCoords{chunk.texcoords.size() / 2};
+
+  while ((first = skipSpaces(first, last)) != last) {
+    tinyobj::index_t index{-1, -1, -1};
+    int value{};
+
+    if (!parseInt(first, last, value) ||
+        !fixIndex(value, numVertices, index.vertex_index)) {
+      return false;
+    }
+    if (first != last && *first == '/') {
+      ++first;
+      if (first != last && *first != '/') {
+        if (!parseInt(first, last, value) ||
+            !fixIndex(value, numTexCoords, index.texcoord_index)) {
+          return false;
+        }
+      }
+      if (first != last && *first == '/') {
+        ++first;
+        if (!parseInt(first, last, value) ||
+            !fixIndex(value, numNormals, index.normal_index)) {
+          return false;
+        }
+      }
+    }
+    if (first != last && !isSpace(*first)) return false;
+    polygon.push_back(index);
+  }
+
+  if (polygon.size() < 3) return false;
+
+  // Triangulate as a fan
+  if (polygon.size() > 3) {
+    chunk.polygons.push_back({chunk.indices.size(), polygon.size()});
+  }
+  for (std::size_t vertex{1}; vertex + 1 < polygon.size(); ++vertex) {
+    chunk.indices.push_back(polygon.front());
+    chunk.indices.push_back(polygon.at(vertex));
+    chunk.indices.push_back(polygon.at(vertex + 1));
+  }
+  return true;
+}
+
+// Same crossing test as tinyobjloader
+bool isInTriangle(const std::array<glm::vec2, 3>& corners, glm::vec2 point) {
+  auto inside{false};
+  for (std::size_t i{}, j{corners.size() - 1}; i < corners.size(); j = i++) {
+    if ((corners.at(i).y > point.y) != (corners.at(j).y > point.y) &&
+        point.x < (corners.at(j).x - corners.at(i).x) *
+                          (point.y - corners.at(i).y) /
+                          (corners.at(j).y - corners.at(i).y) +
+                      corners.at(i).x) {
+      inside = !inside;
+    }
+  }
+  return inside;
+}
+
+// Replaces the fan of a polygon with the triangles of the ear clipping of
+// tinyobj::ObjReader, which handles concave polygons. The ears are clipped in
+// the plane of the two axes that best preserve the first non-degenerate
+// corner. tinyobj drops the vertices left when no ear can be found; they are
+// kept here as a fan, so that the polygon still covers its index range
+void clipEars(const std::vector<float>& positions,
+              std::vector<tinyobj::index_t>& indices, const Polygon& face,
+              std::vector<tinyobj::index_t>& polygon) {
+  auto triangle{face.indexOffset};
+  polygon.assign({indices.at(triangle), indices.at(triangle + 1)});
+  for (auto vertex : iter::range(face.numVertices - 2)) {
+    polygon.push_back(indices.at(triangle + vertex * 3 + 2));
+  }
+
+  auto getPosition{[&](const tinyobj::index_t& index) {
+    const auto offset{static_cast<std::size_t>(index.vertex_index) * 3};
+    return glm::vec3{positions.at(offset), positions.at(offset + 1),
+                     positions.at(offset + 2)};
+  }};
+
+  std::array<glm::vec3::length_type, 2> axes{1, 2};
+  for (auto vertex : iter::range(face.numVertices)) {
+    const auto a{getPosition(polygon.at(vertex))};
+    const auto b{getPosition(polygon.at((vertex + 1) % face.numVertices))};
+    const auto c{getPosition(polygon.at((vertex + 2) % face.numVertices))};
+    const auto normal{glm::abs(glm::cross(b - a, c - b))};
+    constexpr auto epsilon{std::numeric_limits<float>::epsilon()};
+    if (normal.x > epsilon || normal.y > epsilon || normal.z > epsilon) {
+      if (normal.x <= normal.y || normal.x <= normal.z) {
+        axes[0] = 0;
+        if (normal.z > normal.x && normal.z > normal.y) axes[1] = 1;
+      }
+      break;
+    }
+  }
+  auto project{[&](const tinyobj::index_t& index) {
+    const auto position{getPosition(index)};
+    return glm::vec2{position[axes[0]], position[axes[1]]};
+  }};
+
+  auto area{0.0f};
+  for (auto vertex : iter::range(face.numVertices)) {
+    const auto a{project(polygon.at(vertex))};
+    const auto b{project(polygon.at((vertex + 1) % face.numVertices))};
+    area += (a.x * b.y - a.y * b.x) * 0.5f;
+  }
+
+  auto emit{[&](const tinyobj::index_t& a, const tinyobj::index_t& b,
+                const tinyobj::index_t& c) {
+    indices.at(triangle++) = a;
+    indices.at(triangle++) = b;
+    indices.at(triangle++) = c;
+  }};
+
+  std::size_t guess{};
+  auto previousSize{polygon.size()};
+  auto remainingIterations{polygon.size()};
+  while (polygon.size() > 3 && remainingIterations > 0) {
+    const auto size{polygon.size()};
+    if (guess >= size) guess -= size;
+    if (previousSize != size) {
+      previousSize = size;
+      remainingIterations = size;
+    } else {
+      --remainingIterations;
+    }
+
+    std::array<glm::vec2, 3> corners{};
+    for (auto&& [offset, corner] : iter::enumerate(corners)) {
+      corner = project(polygon.at((guess + offset) % size));
+    }
+    const auto edge0{corners[1] - corners[0]};
+    const auto edge1{corners[2] - corners[1]};
+    // Reflex corner
+    if ((edge0.x * edge1.y - edge0.y * edge1.x) * area < 0.0f) {
+      ++guess;
+      continue;
+    }
+    auto overlaps{false};
+    for (std::size_t other{3}; other < size && !overlaps; ++other) {
+      overlaps = isInTriangle(corners, project(polygon.at((guess + other) %
+                                                          size)));
+    }
+    if (overlaps) {
+      ++guess;
+      continue;
+    }
+
+    emit(polygon.at(guess), polygon.at((guess + 1) % size),
+         polygon.at((guess + 2) % size));
+    polygon.erase(polygon.begin() +
+                  static_cast<std::ptrdiff_t>((guess + 1) % size));
+  }
+
+  for (std::size_t vertex{1}; vertex + 1 < polygon.size(); ++vertex) {
+    emit(polygon.front(), polygon.at(vertex), polygon.at(vertex + 1));
+  }
+}
+
+void parseChunk(Chunk& chunk) {
+  std::vector<tinyobj::index_t> polygon;
+  auto fail{[&](const char* position, std::string_view what) {
+    chunk.error = what;
+    chunk.errorPosition = position;
+  }};
+
+  NewlineScanner newlines{chunk.begin, chunk.end};
+  const char* line{chunk.begin};
+  while (line < chunk.end) {
+    const auto* lineEnd{newlines.next()};
+    const auto* next{lineEnd + 1};
+    if (lineEnd != line && *(lineEnd - 1) == '\r') --lineEnd;
+
+    const auto* token{skipSpaces(line, lineEnd)};
+    const auto length{static_cast<std::size_t>(lineEnd - token)};
+    line = next;
+
+    if (length < 2 || *token == '#') continue;
+
+    if (token[0] == 'v' && isSpace(token[1])) {
+      const char* first{token + 2};
+      std::array<float, 6> values{};
+      std::size_t count{};
+      while (count < values.size() &&
+             skipSpaces(first, lineEnd) != lineEnd &&
+             parseFloat(first, lineEnd, values.at(count))) {
+        ++count;
+      }
+      if (count < 3) {
+        fail(token, "Invalid vertex");
+        return;
+      }
+      chunk.vertices.insert(chunk.vertices.end(), values.begin(),
+                            values.begin() + 3);
+      if (count == 6 && chunk.colors.empty()) {
+        // First vertex color of the chunk: previous vertices are white
+        chunk.colors.resize(chunk.vertices.size() - 3, 1.0f);
+      }
+      if (count == 6) {
+        chunk.colors.insert(chunk.colors.end(), values.begin() + 3,
+                            values.end());
+      } else if (!chunk.colors.empty()) {
+        chunk.colors.insert(chunk.colors.end(), 3, 1.0f);
+      }
+    } else if (length > 2 && token[0] == 'v' && token[1] == 'n' &&
+               isSpace(token[2])) {
+      const char* first{token + 3};
+      std::array<float, 3> values{};
+      for (auto& value : values) {
+        if (!parseFloat(first, lineEnd, value)) {
+          fail(token, "Invalid normal");
+          return;
+        }
+      }
+      chunk.normals.insert(chunk.normals.end(), values.begin(), values.end());
+    } else if (length > 2 && token[0] == 'v' && token[1] == 't' &&
+               isSpace(token[2])) {
+      const char* first{token + 3};
+      std::array<float, 2> values{};
+      if (!parseFloat(first, lineEnd, values[0])) {
+        fail(token, "Invalid texture coordinate");
+        return;
+      }
+      // The second coordinate is optional (1D textures)
+      if (!parseFloat(first, lineEnd, values[1])) values[1] = 0.0f;
+      chunk.texcoords.insert(chunk.texcoords.end(), values.begin(),
+                             values.end());
+    } else if (token[0] == 'f' && isSpace(token[1])) {
+      if (!parseFace(chunk, token + 2, lineEnd, polygon)) {
+        fail(token, "Invalid face");
+        return;
+      }
+    } else if ((token[0] == 'g' || token[0] == 'o') && isSpace(token[1])) {
+      chunk.events.push_back({Event::Type::Shape, chunk.indices.size(),
+                              chunk.names.size()});
+      chunk.names.emplace_back(trim(token + 2, lineEnd));
+    } else if (length > 6 && std::strncmp(token, "usemtl", 6) == 0 &&
+               isSpace(token[6])) {
+      chunk.events.push_back({Event::Type::Material, chunk.indices.size(),
+                              chunk.names.size()});
+      chunk.names.emplace_back(trim(token + 7, lineEnd));
+    } else if (length > 6 && std::strncmp(token, "mtllib", 6) == 0 &&
+               isSpace(token[6])) {
+      std::vector<std::string> fileNames;
+      const char* first{token + 7};
+      while ((first = skipSpaces(first, lineEnd)) != lineEnd) {
+        const char* nameEnd{first};
+        while (nameEnd != lineEnd && !isSpace(*nameEnd)) ++nameEnd;
+        fileNames.emplace_back(first, nameEnd);
+        first = nameEnd;
+      }
+      chunk.materialLibraries.push_back(std::move(fileNames));
+    }
+    // Other statements (l, p, s, vp, curves...) are ignored
+  }
+}
+
+// Adds the attribute bases of the chunk to chunk-relative indices and checks
+// bounds
+bool resolveIndices(Chunk& chunk, std::array<std::size_t, 3> base,
+                    std::array<std::size_t, 3> total) {
+  auto resolve{[](int& index, std::size_t chunkBase, std::size_t count) {
+    if (isLocal(index)) {
+      index = static_cast<int>(chunkBase) + decodeLocal(index);
+      if (index < 0) return false;
+    }
+    return index < static_cast<int>(count);
+  }};
+
+  for (auto& index : chunk.indices) {
+    if (!resolve(index.vertex_index, base[0], total[0]) ||
+        !resolve(index.normal_index, base[1], total[1]) ||
+        !resolve(index.texcoord_index, base[2], total[2])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void loadMaterialLibraries(
+    const std::vector<std::vector<std::string>>& materialLibraries,
+    std::string_view mtlSearchPath,
+    std::vector<tinyobj::material_t>& materials,
+    std::map<std::string, int>& materialMap, std::string& warning) {
+  std::string basePath{mtlSearchPath};
+  if (!basePath.empty() && basePath.back() != '/' && basePath.back() != '\\') {
+    basePath += '/';
+  }
+
+  for (const auto& fileNames : materialLibraries) {
+    auto found{false};
+    for (const auto& fileName : fileNames) {
+      std::ifstream input(basePath + fileName);
+      if (!input) continue;
+      std::string mtlWarning;
+      std::string mtlError;
+      tinyobj::LoadMtl(&materialMap, &materials, &input, &mtlWarning,
+                       &mtlError);
+      warning += mtlWarning;
+      found = true;
+      break;
+    }
+    if (!found) {
+      warning += "Failed to load material file(s). Use default material.\n";
+    }
+  }
+}
+
+// Builds the shapes by replaying the g/o/usemtl events of every chunk
+void buildShapes(const std::vector<Chunk>& chunks,
+                 const std::map<std::string, int>& materialMap,
+                 std::vector<tinyobj::shape_t>& shapes, std::string& warning) {
+  tinyobj::shape_t shape;
+  int materialID{-1};
+
+  auto append{[&](const Chunk& chunk, std::size_t first, std::size_t last) {
+    if (first == last) return;
+    const auto numFaces{(last - first) / 3};
+    auto& mesh{shape.mesh};
+    mesh.indices.insert(mesh.indices.end(),
+                        chunk.indices.begin() + static_cast<std::ptrdiff_t>(first),
+                        chunk.indices.begin() + static_cast<std::ptrdiff_t>(last));
+    mesh.num_face_vertices.insert(mesh.num_face_vertices.end(), numFaces, 3);
+    mesh.material_ids.insert(mesh.material_ids.end(), numFaces, materialID);
+    mesh.smoothing_group_ids.insert(mesh.smoothing_group_ids.end(), numFaces,
+                                    0);
+  }};
+
+  for (const auto& chunk : chunks) {
+    std::size_t offset{};
+    for (const auto& event : chunk.events) {
+      append(chunk, offset, event.indexOffset);
+      offset = event.indexOffset;
+
+      const auto& name{chunk.names.at(event.nameIndex)};
+      if (event.type == Event::Type::Shape) {
+        if (!shape.mesh.indices.empty()) {
+          shapes.push_back(std::move(shape));
+          shape = {};
+        }
+        shape.name = name;
+      } else if (const auto it{materialMap.find(name)};
+                 it != materialMap.end()) {
+        materialID = it->second;
+      } else {
+        materialID = -1;
+        warning += fmt::format("material [ '{}' ] not found in .mtl\n", name);
+      }
+    }
+    append(chunk, offset, chunk.indices.size());
+  }
+
+  if (!shape.mesh.indices.empty()) {
+    shapes.push_back(std::move(shape));
+  }
+}
+}  // namespace
+
+/**
+ * @brief Parses an OBJ file using the default thread pool.
+ *
+ * @param path Path to the OBJ file.
+ * @param mtlSearchPath Directory of the material files. If empty, the
+ * directory of the OBJ file is used.
+ *
+ * @throw abcg::Exception if the file cannot be read or is malformed.
+ */
+void abcg::ObjReader::parseFromFile(std::string_view path,
+                                    std::string_view mtlSearchPath) {
+  parseFromFile(path, mtlSearchPath, ThreadPool::getDefault());
+}
+
+/**
+ * @brief Parses an OBJ file using the given thread pool.
+ *
+ * @param path Path to the OBJ file.
+ * @param mtlSearchPath Directory of the material files. If empty, the
+ * directory of the OBJ file is used.
+ * @param threadPool Pool used to parse the chunks concurrently.
+ *
+ * @throw abcg::Exception if the file cannot be read or is malformed.
+ */
+void abcg::ObjReader::parseFromFile(std::string_view path,
+                                    std::string_view mtlSearchPath,
+                                    ThreadPool& threadPool) {
+  m_attrib = {};
+  m_shapes.clear();
+  m_materials.clear();
+  m_warning.clear();
+
+  const MappedFile file{path};
+  const auto data{file.getData()};
+  const auto* fileBegin{reinterpret_cast<const char*>(data.data())};
+  const auto* fileEnd{fileBegin + data.size()};
+
+  // Split at line boundaries
+  const auto maxChunks{(threadPool.getNumThreads() + 1) * 4};
+  const auto numChunks{
+      std::clamp<std::size_t>(data.size() / minChunkSize, 1, maxChunks)};
+  std::vector<Chunk> chunks(numChunks);
+  const auto* chunkBegin{fileBegin};
+  for (auto&& [index, chunk] : iter::enumerate(chunks)) {
+    const auto* chunkEnd{fileEnd};
+    if (index + 1 < numChunks) {
+      chunkEnd = std::max(chunkBegin, fileBegin + data.size() *
+                                                      (index + 1) / numChunks);
+      const auto* newline{static_cast<const char*>(std::memchr(
+          chunkEnd, '\n', static_cast<std::size_t>(fileEnd - chunkEnd)))};
+      chunkEnd = newline ? newline + 1 : fileEnd;
+    }
+    chunk.begin = chunkBegin;
+    chunk.end = chunkEnd;
+    chunkBegin = chunkEnd;
+  }
+
+  threadPool.parallelFor(numChunks,
+                         [&](std::size_t index) { parseChunk(chunks[index]); });
+
+  for (const auto& chunk : chunks) {
+    if (!chunk.error.empty()) {
+      const auto lineNumber{
+          std::count(fileBegin, chunk.errorPosition, '\n') + 1};
+      throw abcg::Exception{abcg::Exception::Runtime(fmt::format(
+          "Failed to load model {} ({} at line {})", path, chunk.error,
+          lineNumber))};
+    }
+  }
+
+  // Offsets of each chunk in the merged attribute arrays
+  std::vector<std::array<std::size_t, 3>> bases(numChunks);
+  std::array<std::size_t, 3> totals{};
+  auto hasColors{false};
+  for (auto&& [index, chunk] : iter::enumerate(chunks)) {
+    bases[index] = totals;
+    totals[0] += chunk.vertices.size() / 3;
+    totals[1] += chunk.normals.size() / 3;
+    totals[2] += chunk.texcoords.size() / 2;
+    hasColors |= !chunk.colors.empty();
+  }
+
+  m_attrib.vertices.resize(totals[0] * 3);
+  m_attrib.normals.resize(totals[1] * 3);
+  m_attrib.texcoords.resize(totals[2] * 2);
+  if (hasColors) m_attrib.colors.resize(totals[0] * 3, 1.0f);
+
+  std::atomic<bool> valid{true};
+  threadPool.parallelFor(numChunks, [&](std::size_t index) {
+    auto& chunk{chunks[index]};
+    const auto& base{bases[index]};
+    std::copy(chunk.vertices.begin(), chunk.vertices.end(),
+              m_attrib.vertices.begin() + static_cast<std::ptrdiff_t>(base[0] * 3));
+    std::copy(chunk.normals.begin(), chunk.normals.end(),
+              m_attrib.normals.begin() + static_cast<std::ptrdiff_t>(base[1] * 3));
+    std::copy(chunk.texcoords.begin(), chunk.texcoords.end(),
+              m_attrib.texcoords.begin() + static_cast<std::ptrdiff_t>(base[2] * 2));
+    std::copy(chunk.colors.begin(), chunk.colors.end(),
+              m_attrib.colors.begin() + static_cast<std::ptrdiff_t>(base[0] * 3));
+    if (!resolveIndices(chunk, base, totals)) valid = false;
+  });
+
+  if (!valid) {
+    throw abcg::Exception{abcg::Exception::Runtime(fmt::format(
+        "Failed to load model {} (face index out of bounds)", path))};
+  }
+
+  // Polygons can refer to the positions of any chunk
+  threadPool.parallelFor(numChunks, [&](std::size_t index) {
+    auto& chunk{chunks[index]};
+    std::vector<tinyobj::index_t> polygon;
+    for (const auto& face : chunk.polygons) {
+      clipEars(m_attrib.vertices, chunk.indices, face, polygon);
+    }
+  });
+
+  // Load materials in the order the libraries are declared
+  std::vector<std::vector<std::string>> materialLibraries;
+  for (auto& chunk : chunks) {
+    std::move(chunk.materialLibraries.begin(), chunk.materialLibraries.end(),
+              std::back_inserter(materialLibraries));
+  }
+  const auto basePath{
+      mtlSearchPath.empty()
+          ? std::filesystem::path{path}.parent_path().string()
+          : std::string{mtlSearchPath}};
+  std::map<std::string, int> materialMap;
+  loadMaterialLibraries(materialLibraries, basePath, m_materials, materialMap,
+                        m_warning);
+
+  buildShapes(chunks, materialMap, m_shapes, m_warning);
+}
@@ -0,0 +1,64 @@
+/**
+ * @file abcg_objreader.hpp
+ * @brief abcg::ObjReader header file.
+ *
+ * Declaration of abcg::ObjReader class.
+ *
+ * This project is released under the MIT License.
+ */
+
+#ifndef ABCG_OBJREADER_HPP_
+#define ABCG_OBJREADER_HPP_
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "tiny_obj_loader.h"
+
+namespace abcg {
+class ObjReader;
+class ThreadPool;
+}  // namespace abcg
+
+/**
+ * @brief abcg::ObjReader class.
+ *
+ * Multithreaded Wavefront OBJ parser. The file is memory-mapped and split at
+ * line boundaries into chunks that are parsed concurrently. The per-chunk
+ * attribute and face arrays are then merged into the same attrib/shape/
+ * material structures produced by tinyobj::ObjReader, with polygons
+ * triangulated by the same ear clipping.
+ *
+ * Material libraries (.mtl) are parsed with tinyobjloader.
+ */
+class abcg::ObjReader {
+ public:
+  void parseFromFile(std::string_view path,
+                     std::string_view mtlSearchPath = {});
+  void parseFromFile(std::string_view path, std::string_view mtlSearchPath,
+                     ThreadPool& threadPool);
+
+  [[nodiscard]] const tinyobj::attrib_t& getAttrib() const noexcept {
+    return m_attrib;
+  }
+  [[nodiscard]] const std::vector<tinyobj::shape_t>& getShapes()
+      const noexcept {
+    return m_shapes;
+  }
+  [[nodiscard]] const std::vector<tinyobj::material_t>& getMaterials()
+      const noexcept {
+    return m_materials;
+  }
+  [[nodiscard]] const std::string& getWarning() const noexcept {
+    return m_warning;
+  }
+
+ private:
+  tinyobj::attrib_t m_attrib;
+  std::vector<tinyobj::shape_t> m_shapes;
+  std::vector<tinyobj::material_t> m_materials;
+  std::string m_warning;
+};
+
+#endif
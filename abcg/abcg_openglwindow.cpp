@@ -21,6 +21,7 @@
 #include "SDL_events.h"
 #include "SDL_video.h"
 #include "abcg_application.hpp"
+#include "abcg_assetmanager.hpp"
 #include "abcg_embeddedfonts.hpp"
 #include "abcg_openglfunctions.hpp"
 #include "abcg_string.hpp"
@@ -237,6 +238,16 @@ void abcg::OpenGLWindow::paintUI() {
                      static_cast<int>(offset), label.c_str(), 0.0f,
                      *std::max_element(frames.begin(), frames.end()) * 2,
                      ImVec2(static_cast<float>(frames.size()), 50));
+    if (m_assetManager != nullptr) {
+      const auto& statistics{m_assetManager->getStatistics()};
+      ImGui::TextUnformatted(fmt::format("{} hits, {} misses", statistics.hits,
+                                         statistics.misses)
+                                 .c_str());
+      ImGui::TextUnformatted(
+          fmt::format("{} evicted, {:.1f} MiB", statistics.evictions,
+                      static_cast<double>(statistics.bytes) / (1024 * 1024))
+              .c_str());
+    }
     ImGui::End();
   }
 
@@ -18,6 +18,7 @@
 namespace abcg {
 enum class OpenGLProfile;
 class Application;
+class AssetManager;
 class OpenGLWindow;
 struct OpenGLSettings;
 struct WindowSettings;
@@ -90,6 +91,15 @@ class abcg::OpenGLWindow {
   [[nodiscard]] double getDeltaTime() const;
   [[nodiscard]] double getElapsedTime() const;
   void toggleFullscreen();
+  /**
+   * @brief Shows the statistics of an asset cache below the FPS counter.
+   *
+   * @param assetManager Cache to show, or nullptr to hide the statistics.
+   * Must outlive the window or be reset before it is destroyed.
+   */
+  void showAssetStatistics(const AssetManager* assetManager) noexcept {
+    m_assetManager = assetManager;
+  }
 
  private:
   void handleEvent(SDL_Event& event, bool& done);
@@ -109,6 +119,8 @@ class abcg::OpenGLWindow {
   int m_viewportWidth{};
   int m_viewportHeight{};
 
+  const AssetManager* m_assetManager{};
+
   ElapsedTimer m_deltaTime;
   ElapsedTimer m_windowStartTime;
   double m_lastDeltaTime{0.0};
@@ -0,0 +1,193 @@
+/**
+ * @file abcg_pixelunpackring.cpp
+ * @brief Definition of abcg::PixelUnpackRing class members.
+ *
+ * This project is released under the MIT License.
+ */
+
+#include "abcg_pixelunpackring.hpp"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include "abcg_exception.hpp"
+
+namespace {
+// Alignment of each upload in the buffers, enough for any texel or block
+constexpr std::size_t uploadAlignment{16};
+}  // namespace
+
+/**
+ * @brief Constructs an empty ring. No OpenGL object is created yet.
+ *
+ * @param bufferSize Size of each buffer, in bytes, which is also the
+ * largest upload.
+ * @param numBuffers Number of buffers, at least 2. With 3 buffers, data can
+ * be staged while the GPU copies from the buffers filled in the last two
+ * frames.
+ */
+abcg::PixelUnpackRing::PixelUnpackRing(std::size_t bufferSize,
+                                       std::size_t numBuffers)
+    : m_bufferSize{bufferSize},
+      m_numBuffers{std::max<std::size_t>(numBuffers, 2)} {}
+
+abcg::PixelUnpackRing::~PixelUnpackRing() { clear(); }
+
+/**
+ * @brief Uploads pixels to a region of a level of a 2D texture.
+ *
+ * The pixels are copied to the current buffer, and the texture is updated
+ * from the buffer by the GPU. The pixels can be discarded on return.
+ *
+ * @param texture Name of the texture.
+ * @param level Mipmap level.
+ * @param offset Position of the lower left corner of the region.
+ * @param size Size of the region, in texels.
+ * @param format Format of the pixels, e.g. GL_RED or GL_RGBA, with 8 bits
+ * per channel. Rows are tightly packed.
+ * @param pixels Pixels of the region, from the bottom row.
+ * @return false, and the texture is not changed, if every buffer is still
+ * in use by the GPU.
+ *
+ * @throw abcg::Exception if the pixels are larger than a buffer.
+ */
+bool abcg::PixelUnpackRing::upload(GLuint texture, GLint level,
+                                   glm::ivec2 offset, glm::ivec2 size,
+                                   GLenum format,
+                                   gsl::span<const std::byte> pixels) {
+  const auto bufferOffset{stage(pixels)};
+  if (!bufferOffset) return false;
+
+  glBindTexture(GL_TEXTURE_2D, texture);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  // NOLINTNEXTLINE(performance-no-int-to-ptr)
+  glTexSubImage2D(GL_TEXTURE_2D, level, offset.x, offset.y, size.x, size.y,
+                  format, GL_UNSIGNED_BYTE,
+                  reinterpret_cast<const void*>(*bufferOffset));
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  return true;
+}
+
+/**
+ * @brief Uploads blocks of a compressed format to a region of a level of a
+ * 2D texture.
+ *
+ * See upload(). The region must be aligned to the 4x4 blocks, except on the
+ * right and top edges of the level.
+ *
+ * @param texture Name of the texture.
+ * @param level Mipmap level.
+ * @param offset Position of the lower left corner of the region.
+ * @param size Size of the region, in texels.
+ * @param format Internal format of the texture (see
+ * abcg::opengl::getInternalFormat).
+ * @param data Blocks of the region, row by row from the bottom row.
+ * @return false, and the texture is not changed, if every buffer is still
+ * in use by the GPU.
+ *
+ * @throw abcg::Exception if the data is larger than a buffer.
+ */
+bool abcg::PixelUnpackRing::uploadCompressed(GLuint texture, GLint level,
+                                             glm::ivec2 offset,
+                                             glm::ivec2 size, GLenum format,
+                                             gsl::span<const std::byte> data) {
+  const auto bufferOffset{stage(data)};
+  if (!bufferOffset) return false;
+
+  glBindTexture(GL_TEXTURE_2D, texture);
+  // NOLINTNEXTLINE(performance-no-int-to-ptr)
+  glCompressedTexSubImage2D(GL_TEXTURE_2D, level, offset.x, offset.y, size.x,
+                            size.y, format, static_cast<GLsizei>(data.size()),
+                            reinterpret_cast<const void*>(*bufferOffset));
+  glBindTexture(GL_TEXTURE_2D, 0);
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  return true;
+}
+
+/**
+ * @brief Deletes the buffers and their fences.
+ *
+ * Uploads already issued are not affected. The buffers are created again by
+ * the next upload. Statistics are kept.
+ */
+void abcg::PixelUnpackRing::clear() noexcept {
+  for (auto& buffer : m_buffers) {
+    if (buffer.fence != nullptr) glDeleteSync(buffer.fence);
+    glDeleteBuffers(1, &buffer.name);
+  }
+  m_buffers.clear();
+  m_current = 0;
+  m_offset = 0;
+}
+
+// Copies data to the current buffer, or to the next one if it does not fit,
+// and leaves the buffer bound to GL_PIXEL_UNPACK_BUFFER. Returns the offset
+// of the data in the buffer, or std::nullopt if the next buffer is in use
+std::optional<std::size_t> abcg::PixelUnpackRing::stage(
+    gsl::span<const std::byte> data) {
+  if (data.size() > m_bufferSize) {
+    throw abcg::Exception{abcg::Exception::Runtime(
+        fmt::format("Upload of {} bytes does not fit in a {} byte buffer",
+                    data.size(), m_bufferSize))};
+  }
+
+  if (m_buffers.empty()) {
+    m_buffers.resize(m_numBuffers);
+    for (auto& buffer : m_buffers) {
+      glGenBuffers(1, &buffer.name);
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer.name);
+      glBufferData(GL_PIXEL_UNPACK_BUFFER,
+                   static_cast<GLsizeiptr>(m_bufferSize), nullptr,
+                   GL_STREAM_DRAW);
+    }
+  }
+
+  auto offset{(m_offset + uploadAlignment - 1) / uploadAlignment *
+              uploadAlignment};
+  if (offset + data.size() > m_bufferSize) {
+    // The fence of the next buffer follows the copies that read from it
+    const auto next{(m_current + 1) % m_buffers.size()};
+    if (auto& fence{m_buffers[next].fence}; fence != nullptr) {
+      if (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0) ==
+          GL_TIMEOUT_EXPIRED) {
+        ++m_statistics.rejected;
+        return std::nullopt;
+      }
+      glDeleteSync(fence);
+      fence = nullptr;
+    }
+
+    m_buffers[m_current].fence =
+        glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    m_current = next;
+    offset = 0;
+  }
+
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_buffers[m_current].name);
+  const auto glOffset{static_cast<GLintptr>(offset)};
+  const auto glSize{static_cast<GLsizeiptr>(data.size())};
+#if defined(__EMSCRIPTEN__)
+  // WebGL cannot map buffers
+  glBufferSubData(GL_PIXEL_UNPACK_BUFFER, glOffset, glSize, data.data());
+#else
+  // The range is not read by the GPU, so the driver need not synchronize
+  if (auto* mapped{glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, glOffset, glSize,
+                                    GL_MAP_WRITE_BIT |
+                                        GL_MAP_INVALIDATE_RANGE_BIT |
+                                        GL_MAP_UNSYNCHRONIZED_BIT)}) {
+    std::memcpy(mapped, data.data(), data.size());
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+  } else {
+    glBufferSubData(GL_PIXEL_UNPACK_BUFFER, glOffset, glSize, data.data());
+  }
+#endif
+  m_offset = offset + data.size();
+
+  ++m_statistics.uploads;
+  m_statistics.bytes += data.size();
+  return offset;
+}
@@ -0,0 +1,100 @@
+/**
+ * @file abcg_pixelunpackring.hpp
+ * @brief abcg::PixelUnpackRing header file.
+ *
+ * Declaration of abcg::PixelUnpackRing class.
+ *
+ * This project is released under the MIT License.
+ */
+
+#ifndef ABCG_PIXELUNPACKRING_HPP_
+#define ABCG_PIXELUNPACKRING_HPP_
+
+#include <cstddef>
+#include <glm/vec2.hpp>
+#include <gsl/gsl>
+#include <optional>
+#include <vector>
+
+#include "abcg_external.hpp"
+
+namespace abcg {
+class PixelUnpackRing;
+}  // namespace abcg
+
+/**
+ * @brief abcg::PixelUnpackRing class.
+ *
+ * Uploads texture data through a ring of pixel unpack buffer objects, so
+ * that glTexSubImage2D returns without copying the data and the copy to the
+ * texture runs asynchronously on the GPU.
+ *
+ * Uploads are staged one after the other in the current buffer. When it is
+ * full, a fence is inserted after the copies that read from it, and the next
+ * buffer is used. A buffer is reused only once its fence is signaled, which
+ * is checked without waiting: if the GPU is still reading from it, upload()
+ * returns false and the caller tries again in a later frame. The CPU
+ * therefore never waits for the copies, and data is only written to parts of
+ * buffers that the GPU no longer reads.
+ *
+ * Buffers are created on the first upload. All member functions must be
+ * called on the thread that owns the OpenGL context, and the object must be
+ * destroyed or cleared while the context exists.
+ */
+class abcg::PixelUnpackRing {
+ public:
+  /** @brief Counters of the uploads. */
+  struct Statistics {
+    /** @brief Number of uploads staged in the buffers. */
+    std::size_t uploads{};
+    /** @brief Number of bytes staged in the buffers. */
+    std::size_t bytes{};
+    /** @brief Number of uploads refused as every buffer was in use. */
+    std::size_t rejected{};
+  };
+
+  explicit PixelUnpackRing(std::size_t bufferSize = 4 * 1024 * 1024,
+                           std::size_t numBuffers = 3);
+  ~PixelUnpackRing();
+
+  PixelUnpackRing(const PixelUnpackRing&) = delete;
+  PixelUnpackRing(PixelUnpackRing&&) = delete;
+  PixelUnpackRing& operator=(const PixelUnpackRing&) = delete;
+  PixelUnpackRing& operator=(PixelUnpackRing&&) = delete;
+
+  [[nodiscard]] bool upload(GLuint texture, GLint level, glm::ivec2 offset,
+                            glm::ivec2 size, GLenum format,
+                            gsl::span<const std::byte> pixels);
+  [[nodiscard]] bool uploadCompressed(GLuint texture, GLint level,
+                                      glm::ivec2 offset, glm::ivec2 size,
+                                      GLenum format,
+                                      gsl::span<const std::byte> data);
+  void clear() noexcept;
+
+  /** @brief Returns the largest upload that fits in a buffer, in bytes. */
+  [[nodiscard]] std::size_t getBufferSize() const noexcept {
+    return m_bufferSize;
+  }
+  [[nodiscard]] const Statistics& getStatistics() const noexcept {
+    return m_statistics;
+  }
+
+ private:
+  struct Buffer {
+    GLuint name{};
+    // Signaled when the GPU no longer reads from the buffer
+    GLsync fence{};
+  };
+
+  std::size_t m_bufferSize{};
+  std::size_t m_numBuffers{};
+  std::vector<Buffer> m_buffers;
+  std::size_t m_current{};
+  std::size_t m_offset{};  // Bytes used in the current buffer
+  Statistics m_statistics;
+
+  [[nodiscard]] std::optional<std::size_t> stage(
+      gsl::span<const std::byte> data);
+};
+
+#endif
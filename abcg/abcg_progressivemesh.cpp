@@ -0,0 +1,318 @@
+/**
+ * @file abcg_progressivemesh.cpp
+ * @brief Definition of the progressive mesh builder and of
+ * abcg::ProgressiveMeshStream class members.
+ *
+ * This project is released under the MIT License.
+ */
+
+#include "abcg_progressivemesh.hpp"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <array>
+#include <filesystem>
+#include <limits>
+
+#include "abcg_exception.hpp"
+#include "abcg_meshoptimizer.hpp"
+
+namespace {
+constexpr std::array<char, 8> magic{'A', 'B', 'C', 'G', 'P', 'M', 'S', 'H'};
+constexpr std::uint32_t formatVersion{1};
+
+// File header, followed by the batches. Each batch is a BatchHeader followed
+// by its vertices and indices
+struct Header {
+  std::array<char, 8> magic{};
+  std::uint32_t version{};
+  std::uint32_t vertexStride{};
+  std::uint64_t key{};
+  std::uint64_t vertexCount{};
+  std::uint64_t indexCount{};
+  std::uint64_t batchCount{};
+  std::array<float, 10> bounds{};
+};
+static_assert(sizeof(Header) == 88,
+              "Unexpected padding in progressive mesh header");
+
+struct BatchHeader {
+  std::uint32_t vertexCount{};
+  std::uint32_t indexCount{};
+};
+
+constexpr auto invalidIndex{~std::uint32_t{}};
+}  // namespace
+
+/**
+ * @brief Builds a progressive mesh from an indexed triangle mesh.
+ *
+ * The mesh is simplified repeatedly with abcg::simplify, each level from the
+ * previous one, so that the vertices of a level are a subset of those of the
+ * finer level. Vertices are then renumbered in the order they are first used
+ * from the coarsest level to the finest, so that each batch only appends
+ * vertices. Vertices not referenced by the mesh are dropped.
+ *
+ * @param vertices Vertex array, as raw bytes.
+ * @param vertexStride Size of each vertex, in bytes.
+ * @param indices Triangle list referencing the vertex array.
+ * @param positions Position of each vertex.
+ * @param baseTriangleCount Number of triangles to aim for in the base mesh.
+ * Fewer levels are built if the simplifier cannot get there.
+ * @param levelRatio Ratio between the triangle counts of consecutive levels.
+ * @return Refinement batches, from the base mesh to the full mesh.
+ *
+ * @throw abcg::Exception if the arguments are inconsistent or an index is out
+ * of range.
+ */
+std::vector<abcg::ProgressiveMeshBatch> abcg::buildProgressiveMesh(
+    gsl::span<const std::byte> vertices, std::size_t vertexStride,
+    gsl::span<const std::uint32_t> indices,
+    gsl::span<const glm::vec3> positions, std::size_t baseTriangleCount,
+    float levelRatio) {
+  const auto vertexCount{vertexStride == 0 ? 0
+                                           : vertices.size() / vertexStride};
+  if (positions.size() != vertexCount) {
+    throw abcg::Exception{abcg::Exception::Runtime(
+        fmt::format("{} positions given for {} vertices", positions.size(),
+                    vertexCount))};
+  }
+  if (levelRatio <= 1.0f) {
+    throw abcg::Exception{abcg::Exception::Runtime(
+        fmt::format("Invalid progressive mesh level ratio {}", levelRatio))};
+  }
+  if (const auto invalid{std::find_if(
+          indices.begin(), indices.end(),
+          [vertexCount](std::uint32_t index) { return index >= vertexCount; })};
+      invalid != indices.end()) {
+    throw abcg::Exception{abcg::Exception::Runtime(fmt::format(
+        "Vertex index {} out of range ({} vertices)", *invalid, vertexCount))};
+  }
+
+  // Levels from the full mesh to the base mesh
+  std::vector<std::vector<std::uint32_t>> levels;
+  levels.emplace_back(indices.begin(),
+                      indices.begin() +
+                          static_cast<std::ptrdiff_t>(indices.size() / 3 * 3));
+  const auto baseIndexCount{baseTriangleCount * 3};
+  while (levels.back().size() > baseIndexCount) {
+    const auto& finer{levels.back()};
+    const auto targetIndexCount{std::max(
+        baseIndexCount,
+        static_cast<std::size_t>(static_cast<float>(finer.size() / 3) /
+                                 levelRatio) *
+            3)};
+    auto coarser{simplify(finer, positions, targetIndexCount,
+                          std::numeric_limits<float>::max())
+                     .indices};
+
+    // Stop when the simplifier removes less than a tenth of the triangles
+    if (coarser.empty() || coarser.size() * 10 > finer.size() * 9) break;
+    optimizeVertexCache(coarser, vertexCount);
+    levels.push_back(std::move(coarser));
+  }
+  std::reverse(levels.begin(), levels.end());
+
+  std::vector<std::uint32_t> remap(vertexCount, invalidIndex);
+  std::uint32_t numVertices{};
+  std::vector<ProgressiveMeshBatch> batches(levels.size());
+  for (std::size_t level{}; level < levels.size(); ++level) {
+    auto& batch{batches[level]};
+    for (auto& index : levels[level]) {
+      auto& newIndex{remap[index]};
+      if (newIndex == invalidIndex) {
+        newIndex = numVertices++;
+        const auto* vertex{vertices.data() + index * vertexStride};
+        batch.vertices.insert(batch.vertices.end(), vertex,
+                              vertex + vertexStride);
+      }
+      index = newIndex;
+    }
+    batch.indices = std::move(levels[level]);
+  }
+  return batches;
+}
+
+/**
+ * @brief Returns the path of the progressive mesh file associated with a
+ * source file.
+ *
+ * @param sourcePath Path to the source mesh file (e.g. an OBJ file).
+ * @return Path to the progressive mesh file, located next to the source file.
+ */
+std::string abcg::ProgressiveMeshStream::getPath(std::string_view sourcePath) {
+  return std::string{sourcePath} + ".abcgpm";
+}
+
+/**
+ * @brief Writes a progressive mesh to a file.
+ *
+ * The file is first written to a temporary file and then renamed, so that a
+ * partially written file is never read.
+ *
+ * @param path Path to the progressive mesh file.
+ * @param key Key computed with abcg::MeshCache::computeKey.
+ * @param contents Batches returned by abcg::buildProgressiveMesh.
+ *
+ * @throw abcg::Exception if the file cannot be written.
+ */
+void abcg::ProgressiveMeshStream::store(
+    std::string_view path, std::uint64_t key,
+    const ProgressiveMeshContents& contents) {
+  Header header{};
+  header.magic = magic;
+  header.version = formatVersion;
+  header.vertexStride = static_cast<std::uint32_t>(contents.vertexStride);
+  header.key = key;
+  for (const auto& batch : contents.batches) {
+    if (contents.vertexStride > 0) {
+      header.vertexCount += batch.vertices.size() / contents.vertexStride;
+    }
+    header.indexCount += batch.indices.size();
+  }
+  header.batchCount = contents.batches.size();
+  const auto& bounds{contents.bounds};
+  header.bounds = {bounds.min.x,    bounds.min.y,    bounds.min.z,
+                   bounds.max.x,    bounds.max.y,    bounds.max.z,
+                   bounds.center.x, bounds.center.y, bounds.center.z,
+                   bounds.radius};
+
+  const auto tempPath{std::string{path} + ".tmp"};
+  {
+    std::ofstream output(tempPath, std::ios::binary | std::ios::trunc);
+    if (!output) {
+      throw abcg::Exception{abcg::Exception::Runtime(
+          fmt::format("Failed to create progressive mesh {}", path))};
+    }
+
+    output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (const auto& batch : contents.batches) {
+      const BatchHeader batchHeader{
+          .vertexCount = static_cast<std::uint32_t>(
+              contents.vertexStride == 0
+                  ? 0
+                  : batch.vertices.size() / contents.vertexStride),
+          .indexCount = static_cast<std::uint32_t>(batch.indices.size())};
+      output.write(reinterpret_cast<const char*>(&batchHeader),
+                   sizeof(batchHeader));
+      output.write(reinterpret_cast<const char*>(batch.vertices.data()),
+                   static_cast<std::streamsize>(batch.vertices.size()));
+      output.write(reinterpret_cast<const char*>(batch.indices.data()),
+                   static_cast<std::streamsize>(batch.indices.size() *
+                                                sizeof(std::uint32_t)));
+    }
+
+    if (!output) {
+      throw abcg::Exception{abcg::Exception::Runtime(
+          fmt::format("Failed to write progressive mesh {}", path))};
+    }
+  }
+
+  std::error_code error;
+  std::filesystem::rename(tempPath, path, error);
+  if (error) {
+    std::filesystem::remove(tempPath, error);
+    throw abcg::Exception{abcg::Exception::Runtime(
+        fmt::format("Failed to write progressive mesh {}", path))};
+  }
+}
+
+/**
+ * @brief Opens a progressive mesh file and reads its header.
+ *
+ * @param path Path to the progressive mesh file.
+ * @param key Expected key of the file.
+ * @param vertexStride Expected size of each vertex, in bytes.
+ * @return true if the file exists and matches the key and vertex stride;
+ * false otherwise.
+ */
+bool abcg::ProgressiveMeshStream::open(std::string_view path,
+                                       std::uint64_t key,
+                                       std::size_t vertexStride) {
+  close();
+
+  std::error_code error;
+  if (key == 0 || !std::filesystem::exists(path, error)) return false;
+
+  m_file.open(std::string{path}, std::ios::binary);
+  Header header{};
+  m_file.read(reinterpret_cast<char*>(&header), sizeof(header));
+  if (!m_file || header.magic != magic || header.version != formatVersion ||
+      header.key != key || header.vertexStride != vertexStride) {
+    close();
+    return false;
+  }
+
+  m_path = path;
+  m_vertexStride = vertexStride;
+  m_vertexCount = header.vertexCount;
+  m_indexCount = header.indexCount;
+  m_batchCount = header.batchCount;
+  const auto& bounds{header.bounds};
+  m_bounds = {.min = {bounds[0], bounds[1], bounds[2]},
+              .max = {bounds[3], bounds[4], bounds[5]},
+              .center = {bounds[6], bounds[7], bounds[8]},
+              .radius = bounds[9]};
+  return true;
+}
+
+/**
+ * @brief Reads the next refinement batch.
+ *
+ * @param batch Batch to be filled. Its indices reference the vertices of this
+ * and of the previous batches.
+ * @return true if a batch was read; false if all batches have been read or
+ * no file is open.
+ *
+ * @throw abcg::Exception if the file is truncated or corrupt.
+ */
+bool abcg::ProgressiveMeshStream::readBatch(ProgressiveMeshBatch& batch) {
+  if (!isOpen() || m_batchesRead == m_batchCount) return false;
+
+  BatchHeader batchHeader{};
+  m_file.read(reinterpret_cast<char*>(&batchHeader), sizeof(batchHeader));
+  const auto numVertices{m_verticesRead + batchHeader.vertexCount};
+  if (!m_file || numVertices > m_vertexCount ||
+      m_indicesRead + batchHeader.indexCount > m_indexCount) {
+    throw abcg::Exception{abcg::Exception::Runtime(
+        fmt::format("Corrupt progressive mesh {}", m_path))};
+  }
+
+  batch.vertices.resize(batchHeader.vertexCount * m_vertexStride);
+  batch.indices.resize(batchHeader.indexCount);
+  m_file.read(reinterpret_cast<char*>(batch.vertices.data()),
+              static_cast<std::streamsize>(batch.vertices.size()));
+  m_file.read(reinterpret_cast<char*>(batch.indices.data()),
+              static_cast<std::streamsize>(batch.indices.size() *
+                                           sizeof(std::uint32_t)));
+  if (!m_file || std::any_of(batch.indices.begin(), batch.indices.end(),
+                             [numVertices](std::uint32_t index) {
+                               return index >= numVertices;
+                             })) {
+    throw abcg::Exception{abcg::Exception::Runtime(
+        fmt::format("Corrupt progressive mesh {}", m_path))};
+  }
+
+  ++m_batchesRead;
+  m_verticesRead = numVertices;
+  m_indicesRead += batchHeader.indexCount;
+  return true;
+}
+
+/**
+ * @brief Closes the file and resets the header information.
+ */
+void abcg::ProgressiveMeshStream::close() noexcept {
+  m_file.close();
+  m_file.clear();
+  m_path.clear();
+  m_vertexStride = 0;
+  m_vertexCount = 0;
+  m_indexCount = 0;
+  m_batchCount = 0;
+  m_bounds = {};
+  m_batchesRead = 0;
+  m_verticesRead = 0;
+  m_indicesRead = 0;
+}
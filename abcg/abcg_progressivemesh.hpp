@@ -0,0 +1,139 @@
+/**
+ * @file abcg_progressivemesh.hpp
+ * @brief abcg::ProgressiveMeshStream header file.
+ *
+ * Declaration of the progressive mesh builder and of
+ * abcg::ProgressiveMeshStream class, used to read a mesh from disk one
+ * refinement batch at a time.
+ *
+ * This project is released under the MIT License.
+ */
+
+#ifndef ABCG_PROGRESSIVEMESH_HPP_
+#define ABCG_PROGRESSIVEMESH_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <glm/vec3.hpp>
+#include <gsl/gsl>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "abcg_bounds.hpp"
+
+namespace abcg {
+class ProgressiveMeshStream;
+struct ProgressiveMeshBatch;
+struct ProgressiveMeshContents;
+
+[[nodiscard]] std::vector<ProgressiveMeshBatch> buildProgressiveMesh(
+    gsl::span<const std::byte> vertices, std::size_t vertexStride,
+    gsl::span<const std::uint32_t> indices,
+    gsl::span<const glm::vec3> positions, std::size_t baseTriangleCount = 256,
+    float levelRatio = 4.0f);
+
+template <typename TVertex>
+[[nodiscard]] std::vector<ProgressiveMeshBatch> buildProgressiveMesh(
+    gsl::span<const TVertex> vertices, gsl::span<const std::uint32_t> indices,
+    std::size_t baseTriangleCount = 256, float levelRatio = 4.0f);
+}  // namespace abcg
+
+/**
+ * @brief Refinement batch of a progressive mesh.
+ *
+ * Batch k holds the vertices first used by level k, to be appended after the
+ * vertices of batches 0, ..., k - 1, and the complete triangle list of level
+ * k. Batch 0 is the coarse base mesh; the last batch is the full mesh.
+ */
+struct abcg::ProgressiveMeshBatch {
+  /** @brief Vertices added by this batch, as raw bytes. */
+  std::vector<std::byte> vertices;
+  /** @brief Triangle list of this level. */
+  std::vector<std::uint32_t> indices;
+};
+
+/**
+ * @brief Contents of a progressive mesh to be written to disk.
+ *
+ */
+struct abcg::ProgressiveMeshContents {
+  gsl::span<const ProgressiveMeshBatch> batches{};
+  std::size_t vertexStride{};
+  Bounds bounds{};
+};
+
+/**
+ * @brief abcg::ProgressiveMeshStream class.
+ *
+ * Reads a progressive mesh file batch by batch, so that the coarse base mesh
+ * can be drawn before the rest of the file has been read. The header gives
+ * the total number of vertices and indices, so that buffers can be allocated
+ * once and each batch appended with glBufferSubData.
+ *
+ * Like abcg::MeshCache, each file is keyed on its source file so that a stale
+ * file is rebuilt whenever the source changes.
+ */
+class abcg::ProgressiveMeshStream {
+ public:
+  [[nodiscard]] static std::string getPath(std::string_view sourcePath);
+  static void store(std::string_view path, std::uint64_t key,
+                    const ProgressiveMeshContents& contents);
+
+  bool open(std::string_view path, std::uint64_t key,
+            std::size_t vertexStride);
+  bool readBatch(ProgressiveMeshBatch& batch);
+  void close() noexcept;
+
+  [[nodiscard]] bool isOpen() const noexcept { return m_file.is_open(); }
+  [[nodiscard]] std::size_t getVertexCount() const noexcept {
+    return m_vertexCount;
+  }
+  [[nodiscard]] std::size_t getIndexCount() const noexcept {
+    return m_indexCount;
+  }
+  [[nodiscard]] std::size_t getBatchCount() const noexcept {
+    return m_batchCount;
+  }
+  [[nodiscard]] const Bounds& getBounds() const noexcept { return m_bounds; }
+
+ private:
+  std::ifstream m_file;
+  std::string m_path;
+
+  std::size_t m_vertexStride{};
+  std::size_t m_vertexCount{};
+  std::size_t m_indexCount{};
+  std::size_t m_batchCount{};
+  Bounds m_bounds{};
+
+  // Totals of the batches read so far
+  std::size_t m_batchesRead{};
+  std::size_t m_verticesRead{};
+  std::size_t m_indicesRead{};
+};
+
+/**
+ * @brief Builds a progressive mesh from an indexed triangle mesh.
+ *
+ * @tparam TVertex Vertex type. Must have a glm::vec3 member named position.
+ * @param vertices Vertex array.
+ * @param indices Triangle list referencing the vertex array.
+ * @param baseTriangleCount Number of triangles to aim for in the base mesh.
+ * @param levelRatio Ratio between the triangle counts of consecutive levels.
+ * @return Refinement batches, from the base mesh to the full mesh.
+ */
+template <typename TVertex>
+std::vector<abcg::ProgressiveMeshBatch> abcg::buildProgressiveMesh(
+    gsl::span<const TVertex> vertices, gsl::span<const std::uint32_t> indices,
+    std::size_t baseTriangleCount, float levelRatio) {
+  std::vector<glm::vec3> positions;
+  positions.reserve(vertices.size());
+  for (const auto& vertex : vertices) positions.push_back(vertex.position);
+  return buildProgressiveMesh(gsl::as_bytes(vertices), sizeof(TVertex),
+                              indices, positions, baseTriangleCount,
+                              levelRatio);
+}
+
+#endif
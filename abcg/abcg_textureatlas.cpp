@@ -0,0 +1,298 @@
+/**
+ * @file abcg_textureatlas.cpp
+ * @brief Definition of texture atlas and array texture packing functions.
+ *
+ * This project is released under the MIT License.
+ */
+
+#include "abcg_textureatlas.hpp"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cppitertools/itertools.hpp>
+#include <cstring>
+#include <glm/common.hpp>
+#include <glm/vec2.hpp>
+#include <numeric>
+#include <optional>
+
+#include "abcg_exception.hpp"
+#include "abcg_imageops.hpp"
+#include "abcg_threadpool.hpp"
+
+namespace {
+// Horizontal segment of the top edge of the packed area of a layer. Each
+// layer starts with a single segment as wide as the layer
+struct SkylineSegment {
+  int x{};
+  int y{};
+  int width{};
+};
+
+using Skyline = std::vector<SkylineSegment>;
+
+// Finds the lowest position of a rectangle on a skyline, leftmost on ties,
+// and raises the skyline over it. Returns std::nullopt if the rectangle
+// would reach above maxHeight
+std::optional<glm::ivec2> insertRectangle(Skyline& skyline, int layerWidth,
+                                          int maxHeight, int width,
+                                          int height) {
+  std::optional<std::size_t> best;
+  auto bestY{maxHeight};
+  for (const auto first : iter::range(skyline.size())) {
+    const auto x{skyline[first].x};
+    if (x + width > layerWidth) break;
+
+    // The rectangle rests on the highest segment below it
+    auto y{0};
+    auto index{first};
+    for (auto remaining{width}; remaining > 0; ++index) {
+      y = std::max(y, skyline[index].y);
+      remaining -= skyline[index].width;
+    }
+    if (y + height <= maxHeight && (!best || y < bestY)) {
+      best = first;
+      bestY = y;
+    }
+  }
+  if (!best) return std::nullopt;
+
+  const auto x{skyline[*best].x};
+  const auto right{x + width};
+  skyline.insert(skyline.begin() + static_cast<std::ptrdiff_t>(*best),
+                 {.x = x, .y = bestY + height, .width = width});
+
+  // Shrink or remove the segments now covered by the rectangle
+  for (auto index{*best + 1}; index < skyline.size();) {
+    auto& segment{skyline[index]};
+    if (segment.x >= right) break;
+    const auto covered{right - segment.x};
+    if (covered < segment.width) {
+      segment.x += covered;
+      segment.width -= covered;
+      break;
+    }
+    skyline.erase(skyline.begin() + static_cast<std::ptrdiff_t>(index));
+  }
+
+  // Merge neighbors at the same height
+  for (std::size_t index{1}; index < skyline.size();) {
+    if (skyline[index - 1].y == skyline[index].y) {
+      skyline[index - 1].width += skyline[index].width;
+      skyline.erase(skyline.begin() + static_cast<std::ptrdiff_t>(index));
+    } else {
+      ++index;
+    }
+  }
+
+  return glm::ivec2{x, bestY};
+}
+
+// Returns a row of an image as RGBA pixels
+gsl::span<const std::byte> getRGBARow(const abcg::Image& image, int row,
+                                      std::vector<std::byte>& buffer) {
+  const auto width{static_cast<std::size_t>(image.width)};
+  const auto pitch{width * static_cast<std::size_t>(image.channels)};
+  const auto source{gsl::span{image.pixels}.subspan(
+      static_cast<std::size_t>(row) * pitch, pitch)};
+  if (image.channels == 4) return source;
+
+  buffer.resize(width * 4);
+  abcg::image::convertRGBToRGBA(source, buffer);
+  return buffer;
+}
+
+// Copies an image to a layer, surrounded by a border of padding texels taken
+// from the opposite edges. Bilinear filtering at the edges of the region then
+// gives the same result as GL_REPEAT
+void copyWithBorder(const abcg::Image& image, int padding, abcg::Image& layer,
+                    glm::ivec2 position) {
+  const auto wrap{[](int value, int size) {
+    return static_cast<std::size_t>((value % size + size) % size);
+  }};
+  const auto width{static_cast<std::size_t>(image.width)};
+  std::vector<std::byte> buffer;
+  for (const auto row : iter::range(-padding, image.height + padding)) {
+    const auto source{
+        getRGBARow(image, static_cast<int>(wrap(row, image.height)), buffer)};
+    auto* destination{layer.pixels.data() +
+                      (static_cast<std::size_t>(position.y + padding + row) *
+                           static_cast<std::size_t>(layer.width) +
+                       static_cast<std::size_t>(position.x)) *
+                          4};
+    for (const auto column : iter::range(padding)) {
+      std::memcpy(destination + static_cast<std::size_t>(column) * 4,
+                  source.data() + wrap(column - padding, image.width) * 4, 4);
+    }
+    destination += static_cast<std::size_t>(padding) * 4;
+    std::memcpy(destination, source.data(), width * 4);
+    destination += width * 4;
+    for (const auto column : iter::range(padding)) {
+      std::memcpy(destination + static_cast<std::size_t>(column) * 4,
+                  source.data() + wrap(column, image.width) * 4, 4);
+    }
+  }
+}
+}  // namespace
+
+/**
+ * @brief Packs images into the layers of a texture atlas.
+ *
+ * Images are placed with a skyline bottom-left heuristic, tallest first.
+ * The atlas is as wide as the square that has the area of every image, or
+ * as the widest image, and as tall as needed. Images that do not fit in a
+ * maxSize by maxSize layer go to the next layer, in which case the layers
+ * are made maxSize wide to reduce their number. Every layer has the size of
+ * the largest one.
+ *
+ * Each image is surrounded by a border of padding texels that repeats its
+ * opposite edges, so that it can be sampled as with GL_REPEAT. The mipmap
+ * levels of the atlas stay free of bleeding between images down to the
+ * level at which the border is one texel wide.
+ *
+ * @param images Images with 3 or 4 channels, e.g. returned by
+ * abcg::decodeImage.
+ * @param maxSize Maximum width and height of a layer.
+ * @param padding Width of the border around each image, in texels.
+ * @return Atlas with RGBA layers, and the region of each image.
+ *
+ * @throw abcg::Exception if an image with its border is larger than
+ * maxSize.
+ */
+abcg::TextureAtlas abcg::packTextureAtlas(gsl::span<const Image> images,
+                                          int maxSize, int padding) {
+  TextureAtlas atlas;
+  atlas.regions.resize(images.size());
+
+  // Size of each image with its border, and smallest layer width
+  std::vector<glm::ivec2> sizes;
+  std::size_t totalArea{};
+  auto layerWidth{1};
+  for (const auto& image : images) {
+    const glm::ivec2 size{image.width + padding * 2,
+                          image.height + padding * 2};
+    if (size.x > maxSize || size.y > maxSize) {
+      throw abcg::Exception{abcg::Exception::Runtime(
+          fmt::format("Image of {}x{} does not fit in a {}x{} atlas",
+                      image.width, image.height, maxSize, maxSize))};
+    }
+    sizes.push_back(size);
+    totalArea += static_cast<std::size_t>(size.x) *
+                 static_cast<std::size_t>(size.y);
+    layerWidth = std::max(layerWidth, size.x);
+  }
+  const auto squareSide{
+      static_cast<int>(std::ceil(std::sqrt(static_cast<double>(totalArea))))};
+  layerWidth = std::clamp(squareSide, layerWidth, std::max(maxSize, 1));
+
+  std::vector<std::size_t> order(images.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(),
+                   [&](std::size_t lhs, std::size_t rhs) {
+                     return sizes[lhs].y != sizes[rhs].y
+                                ? sizes[lhs].y > sizes[rhs].y
+                                : sizes[lhs].x > sizes[rhs].x;
+                   });
+
+  // Returns the number of layers needed with a given layer width
+  std::vector<glm::ivec2> positions(images.size());
+  auto layerHeight{0};
+  const auto place{[&](int width) {
+    std::vector<Skyline> skylines;
+    layerHeight = 0;
+    for (const auto index : order) {
+      const auto size{sizes[index]};
+      std::optional<glm::ivec2> position;
+      auto layer{0};
+      for (; !position; ++layer) {
+        if (layer == static_cast<int>(skylines.size())) {
+          skylines.push_back({{.x = 0, .y = 0, .width = width}});
+        }
+        position = insertRectangle(skylines[static_cast<std::size_t>(layer)],
+                                   width, maxSize, size.x, size.y);
+      }
+      positions[index] = *position;
+      atlas.regions[index].layer = layer - 1;
+      layerHeight = std::max(layerHeight, position->y + size.y);
+    }
+    return skylines.size();
+  }};
+
+  // A wider layer may avoid the cost of an array texture
+  auto layerCount{place(layerWidth)};
+  if (layerCount > 1 && layerWidth < maxSize) {
+    layerWidth = maxSize;
+    layerCount = place(layerWidth);
+  }
+
+  atlas.layers.resize(layerCount);
+  for (auto& layer : atlas.layers) {
+    layer = {.width = layerWidth,
+             .height = layerHeight,
+             .channels = 4,
+             .pixels = std::vector<std::byte>(
+                 static_cast<std::size_t>(layerWidth) *
+                 static_cast<std::size_t>(layerHeight) * 4)};
+  }
+
+  // Images do not overlap, so they are copied concurrently
+  const glm::vec2 layerSize(layerWidth, layerHeight);
+  ThreadPool::getDefault().parallelFor(images.size(), [&](std::size_t index) {
+    const auto& image{images[index]};
+    auto& region{atlas.regions[index]};
+    region.offset = glm::vec2(positions[index] + padding) / layerSize;
+    region.scale = glm::vec2(image.width, image.height) / layerSize;
+    if (image.width > 0 && image.height > 0) {
+      copyWithBorder(image, padding,
+                     atlas.layers[static_cast<std::size_t>(region.layer)],
+                     positions[index]);
+    }
+  });
+
+  return atlas;
+}
+
+/**
+ * @brief Packs images into the layers of an array texture, one image per
+ * layer.
+ *
+ * Images of a different size than the layers are resized with a bilinear
+ * filter, after halving the ones at least twice as large. Regions cover
+ * their whole layer, so texture coordinates are kept as they are, and only
+ * the layer index is needed to sample each image.
+ *
+ * @param images Images with 3 or 4 channels, e.g. returned by
+ * abcg::decodeImage.
+ * @param width Width of the layers, or 0 to use the largest image width.
+ * @param height Height of the layers, or 0 to use the largest image height.
+ * @return Array of RGBA layers, and the region of each image.
+ */
+abcg::TextureAtlas abcg::packTextureArray(gsl::span<const Image> images,
+                                          int width, int height) {
+  glm::ivec2 largest{1};
+  for (const auto& image : images) {
+    largest = glm::max(largest, glm::ivec2{image.width, image.height});
+  }
+  if (width <= 0) width = largest.x;
+  if (height <= 0) height = largest.y;
+
+  TextureAtlas atlas;
+  atlas.layers.resize(images.size());
+  atlas.regions.resize(images.size());
+  ThreadPool::getDefault().parallelFor(images.size(), [&](std::size_t index) {
+    const auto& image{images[index]};
+    atlas.layers[index] =
+        image.width > 0 && image.height > 0
+            ? resizeImage(image, width, height)
+            : Image{.width = width,
+                    .height = height,
+                    .channels = 4,
+                    .pixels = std::vector<std::byte>(
+                        static_cast<std::size_t>(width) *
+                        static_cast<std::size_t>(height) * 4)};
+    atlas.regions[index].layer = static_cast<int>(index);
+  });
+  return atlas;
+}
@@ -0,0 +1,56 @@
+/**
+ * @file abcg_textureatlas.hpp
+ * @brief Declaration of functions that pack many images into the layers of
+ * a texture atlas or array texture.
+ *
+ * This project is released under the MIT License.
+ */
+
+#ifndef ABCG_TEXTUREATLAS_HPP_
+#define ABCG_TEXTUREATLAS_HPP_
+
+#include <glm/vec2.hpp>
+#include <gsl/gsl>
+#include <vector>
+
+#include "abcg_image.hpp"
+
+namespace abcg {
+/**
+ * @brief Part of a texture atlas that holds one of the packed images.
+ *
+ * The texture coordinates of the image are mapped to the atlas with
+ * `offset + fract(uv) * scale`, which also repeats the image like
+ * GL_REPEAT. Coordinates within [0, 1] can be remapped once, with
+ * `offset + uv * scale`, and sampled without the fract.
+ */
+struct TextureRegion {
+  /** @brief Texture coordinates of the lower left corner of the image. */
+  glm::vec2 offset{};
+  /** @brief Size of the image in texture coordinates. */
+  glm::vec2 scale{1.0f};
+  /** @brief Layer of the array texture that holds the image. */
+  int layer{};
+};
+
+/**
+ * @brief Images packed by abcg::packTextureAtlas or abcg::packTextureArray.
+ *
+ * Layers are RGBA images of the same size. A single layer is uploaded with
+ * abcg::opengl::createTexture, and more layers with
+ * abcg::opengl::createTextureArray.
+ */
+struct TextureAtlas {
+  std::vector<Image> layers;
+  /** @brief Region of each packed image, in the order they were given. */
+  std::vector<TextureRegion> regions;
+};
+
+[[nodiscard]] TextureAtlas packTextureAtlas(gsl::span<const Image> images,
+                                            int maxSize = 4096,
+                                            int padding = 8);
+[[nodiscard]] TextureAtlas packTextureArray(gsl::span<const Image> images,
+                                            int width = 0, int height = 0);
+}  // namespace abcg
+
+#endif
@@ -0,0 +1,266 @@
+/**
+ * @file abcg_texturecache.cpp
+ * @brief Definition of abcg::TextureCache class members.
+ *
+ * This project is released under the MIT License.
+ */
+
+#include "abcg_texturecache.hpp"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#include "abcg_exception.hpp"
+
+namespace {
+constexpr std::array<char, 8> magic{'A', 'B', 'C', 'G', 'T', 'E', 'X', '1'};
+constexpr std::uint32_t formatVersion{1};
+
+// File header, followed by the pixels of each level, from the base level to
+// the smallest
+struct Header {
+  std::array<char, 8> magic{};
+  std::uint32_t version{};
+  std::uint32_t channels{};
+  std::uint64_t key{};
+  std::uint32_t width{};
+  std::uint32_t height{};
+  std::uint64_t levelCount{};
+  std::uint64_t fileSize{};
+};
+static_assert(sizeof(Header) == 48,
+              "Unexpected padding in texture cache header");
+
+// 64-bit FNV-1a
+void hashBytes(std::uint64_t& hash, const void* data, std::size_t size) {
+  const auto* bytes{static_cast<const unsigned char*>(data)};
+  for (std::size_t i{}; i < size; ++i) {
+    hash ^= bytes[i];
+    hash *= 0x100000001b3ULL;
+  }
+}
+
+// FNV-1a applied to 8-byte words, then to the remaining bytes. Used for whole
+// source files, which it hashes several times faster than hashBytes
+void hashContents(std::uint64_t& hash, gsl::span<const std::byte> contents) {
+  const auto wordBytes{contents.size() / sizeof(std::uint64_t) *
+                       sizeof(std::uint64_t)};
+  for (std::size_t offset{}; offset < wordBytes;
+       offset += sizeof(std::uint64_t)) {
+    std::uint64_t word{};
+    std::memcpy(&word, contents.subspan(offset).data(), sizeof(word));
+    hash ^= word;
+    hash *= 0x100000001b3ULL;
+  }
+  hashBytes(hash, contents.subspan(wordBytes).data(),
+            contents.size() - wordBytes);
+}
+
+// Number of levels of a complete mipmap chain
+std::size_t countLevels(std::size_t width, std::size_t height) {
+  std::size_t count{1};
+  while (width > 1 || height > 1) {
+    width = std::max<std::size_t>(width / 2, 1);
+    height = std::max<std::size_t>(height / 2, 1);
+    ++count;
+  }
+  return count;
+}
+}  // namespace
+
+/**
+ * @brief Returns the path of the cache file associated with a source file.
+ *
+ * @param sourcePath Path to the source image file (e.g. a PNG file).
+ * @return Path to the cache file, located next to the source file.
+ */
+std::string abcg::TextureCache::getCachePath(std::string_view sourcePath) {
+  return std::string{sourcePath} + ".abcgtex";
+}
+
+/**
+ * @brief Computes the key that identifies a version of a source file.
+ *
+ * As in abcg::MeshCache::computeBuildKey, the key is a hash of the contents
+ * of the source file and of the options, so that it still matches after the
+ * assets are copied next to the executable, and never matches a source that
+ * has since been edited.
+ *
+ * @param sourcePath Path to the source image file.
+ * @param options Filter of the stored mipmap chain (see abcg::MipmapFilter),
+ * as an integer. Caches that store the base level only are keyed with
+ * abcg::MipmapFilter::Box.
+ * @return Key of the cache file, or 0 if the source file cannot be read.
+ */
+std::uint64_t abcg::TextureCache::computeKey(std::string_view sourcePath,
+                                             std::uint64_t options) {
+  MappedFile file;
+  try {
+    file.open(sourcePath);
+  } catch (const abcg::Exception&) {
+    return 0;
+  }
+  const auto contents{file.getData()};
+
+  std::uint64_t hash{0xcbf29ce484222325ULL};
+  hashContents(hash, contents);
+  hashBytes(hash, &options, sizeof(options));
+  hashBytes(hash, &formatVersion, sizeof(formatVersion));
+  return hash;
+}
+
+/**
+ * @brief Writes an image and its mipmap levels to a cache file.
+ *
+ * The file is first written to a temporary file and then renamed, so that a
+ * partially written cache is never read.
+ *
+ * @param cachePath Path to the cache file.
+ * @param key Key computed with abcg::TextureCache::computeKey.
+ * @param levels Base level, optionally followed by the complete mipmap chain
+ * returned by abcg::generateMipmaps.
+ *
+ * @throw abcg::Exception if the levels are inconsistent or the cache file
+ * cannot be written.
+ */
+void abcg::TextureCache::store(std::string_view cachePath, std::uint64_t key,
+                               gsl::span<const Image> levels) {
+  if (levels.empty()) {
+    throw abcg::Exception{abcg::Exception::Runtime(
+        fmt::format("No image given for texture cache {}", cachePath))};
+  }
+
+  const auto& base{levels.front()};
+  auto width{static_cast<std::size_t>(std::max(base.width, 0))};
+  auto height{static_cast<std::size_t>(std::max(base.height, 0))};
+  const auto channels{static_cast<std::size_t>(base.channels)};
+  const auto fullLevelCount{countLevels(width, height)};
+  if (width == 0 || height == 0 || (channels != 3 && channels != 4) ||
+      (levels.size() != 1 && levels.size() != fullLevelCount)) {
+    throw abcg::Exception{abcg::Exception::Runtime(
+        fmt::format("Invalid mipmap chain for texture cache {}", cachePath))};
+  }
+
+  Header header{};
+  header.magic = magic;
+  header.version = formatVersion;
+  header.channels = static_cast<std::uint32_t>(channels);
+  header.key = key;
+  header.width = static_cast<std::uint32_t>(width);
+  header.height = static_cast<std::uint32_t>(height);
+  header.levelCount = levels.size();
+  header.fileSize = sizeof(Header);
+  for (const auto& level : levels) {
+    if (static_cast<std::size_t>(level.width) != width ||
+        static_cast<std::size_t>(level.height) != height ||
+        static_cast<std::size_t>(level.channels) != channels ||
+        level.pixels.size() != width * height * channels) {
+      throw abcg::Exception{abcg::Exception::Runtime(
+          fmt::format("Invalid mipmap chain for texture cache {}", cachePath))};
+    }
+    header.fileSize += level.pixels.size();
+    width = std::max<std::size_t>(width / 2, 1);
+    height = std::max<std::size_t>(height / 2, 1);
+  }
+
+  const auto tempPath{std::string{cachePath} + ".tmp"};
+  {
+    std::ofstream output(tempPath, std::ios::binary | std::ios::trunc);
+    if (!output) {
+      throw abcg::Exception{abcg::Exception::Runtime(
+          fmt::format("Failed to create texture cache {}", cachePath))};
+    }
+
+    output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (const auto& level : levels) {
+      output.write(reinterpret_cast<const char*>(level.pixels.data()),
+                   static_cast<std::streamsize>(level.pixels.size()));
+    }
+
+    if (!output) {
+      throw abcg::Exception{abcg::Exception::Runtime(
+          fmt::format("Failed to write texture cache {}", cachePath))};
+    }
+  }
+
+  std::error_code error;
+  std::filesystem::rename(tempPath, cachePath, error);
+  if (error) {
+    std::filesystem::remove(tempPath, error);
+    throw abcg::Exception{abcg::Exception::Runtime(
+        fmt::format("Failed to write texture cache {}", cachePath))};
+  }
+}
+
+/**
+ * @brief Maps a cache file into memory.
+ *
+ * @param cachePath Path to the cache file.
+ * @param key Expected key of the cache file.
+ * @return true if the cache file exists, is valid and matches the key; false
+ * otherwise.
+ */
+bool abcg::TextureCache::load(std::string_view cachePath, std::uint64_t key) {
+  close();
+
+  std::error_code error;
+  if (key == 0 || !std::filesystem::exists(cachePath, error)) return false;
+
+  try {
+    m_file.open(cachePath);
+  } catch (const abcg::Exception&) {
+    return false;
+  }
+
+  const auto data{m_file.getData()};
+  Header header{};
+  if (data.size() < sizeof(Header)) {
+    close();
+    return false;
+  }
+  std::memcpy(&header, data.data(), sizeof(Header));
+
+  if (header.magic != magic || header.version != formatVersion ||
+      header.key != key || header.fileSize != data.size() ||
+      (header.channels != 3 && header.channels != 4) || header.width == 0 ||
+      header.height == 0 ||
+      (header.levelCount != 1 &&
+       header.levelCount != countLevels(header.width, header.height))) {
+    close();
+    return false;
+  }
+
+  std::size_t width{header.width};
+  std::size_t height{header.height};
+  auto offset{sizeof(Header)};
+  for (std::uint64_t level{}; level < header.levelCount; ++level) {
+    const auto size{width * height * header.channels};
+    if (offset + size > data.size()) {
+      close();
+      return false;
+    }
+    m_levels.push_back({.width = static_cast<int>(width),
+                        .height = static_cast<int>(height),
+                        .pixels = data.subspan(offset, size)});
+    offset += size;
+    width = std::max<std::size_t>(width / 2, 1);
+    height = std::max<std::size_t>(height / 2, 1);
+  }
+  m_channels = static_cast<int>(header.channels);
+
+  return true;
+}
+
+/**
+ * @brief Releases the mapping of the cache file.
+ */
+void abcg::TextureCache::close() noexcept {
+  m_file.close();
+  m_channels = 0;
+  m_levels.clear();
+}
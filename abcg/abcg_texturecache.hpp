@@ -0,0 +1,77 @@
+/**
+ * @file abcg_texturecache.hpp
+ * @brief abcg::TextureCache header file.
+ *
+ * Declaration of abcg::TextureCache class and of the binary texture format
+ * used to skip image decoding and mipmap generation at load time.
+ *
+ * This project is released under the MIT License.
+ */
+
+#ifndef ABCG_TEXTURECACHE_HPP_
+#define ABCG_TEXTURECACHE_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <gsl/gsl>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "abcg_image.hpp"
+#include "abcg_mappedfile.hpp"
+
+namespace abcg {
+class TextureCache;
+struct TextureCacheLevel;
+}  // namespace abcg
+
+/**
+ * @brief Mipmap level stored in the texture cache.
+ *
+ * Rows are tightly packed and stored bottom to top, as in abcg::Image.
+ */
+struct abcg::TextureCacheLevel {
+  int width{};
+  int height{};
+  gsl::span<const std::byte> pixels{};
+};
+
+/**
+ * @brief abcg::TextureCache class.
+ *
+ * Reads and writes decoded 8-bit RGB or RGBA images together with their
+ * mipmap chain, ready to be uploaded with glTexImage2D. Texture caches are
+ * compiled ahead of time by abcg-assetc and keyed like the meshes it
+ * compiles (see abcg::MeshCache::computeBuildKey).
+ */
+class abcg::TextureCache {
+ public:
+  [[nodiscard]] static std::string getCachePath(std::string_view sourcePath);
+  [[nodiscard]] static std::uint64_t computeKey(std::string_view sourcePath,
+                                                std::uint64_t options = 0);
+  static void store(std::string_view cachePath, std::uint64_t key,
+                    gsl::span<const Image> levels);
+
+  bool load(std::string_view cachePath, std::uint64_t key);
+  void close() noexcept;
+
+  [[nodiscard]] int getChannels() const noexcept { return m_channels; }
+  /**
+   * @brief Returns the stored levels, from the base level to the smallest.
+   *
+   * Either the base level only or the complete mipmap chain down to 1x1.
+   */
+  [[nodiscard]] const std::vector<TextureCacheLevel>& getLevels()
+      const noexcept {
+    return m_levels;
+  }
+
+ private:
+  MappedFile m_file;
+
+  int m_channels{};
+  std::vector<TextureCacheLevel> m_levels;
+};
+
+#endif
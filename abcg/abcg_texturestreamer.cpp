@@ -0,0 +1,507 @@
+/**
+ * @file abcg_texturestreamer.cpp
+ * @brief Definition of abcg::TextureStreamer class members.
+ *
+ * This project is released under the MIT License.
+ */
+
+#include "abcg_texturestreamer.hpp"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cppitertools/itertools.hpp>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <glm/common.hpp>
+#include <glm/gtx/component_wise.hpp>
+#include <optional>
+#include <string>
+#include <utility>
+
+#include "abcg_compressedimage.hpp"
+#include "abcg_exception.hpp"
+#include "abcg_imageops.hpp"
+#include "abcg_pixelunpackring.hpp"
+#include "abcg_texturecache.hpp"
+#include "abcg_threadpool.hpp"
+
+namespace {
+// Levels no larger than this are uploaded when the texture is created
+constexpr int tailSize{64};
+
+// Reads the size of a PNG or JPEG image from its header, without decoding
+// the image. Returns std::nullopt for other formats
+std::optional<glm::ivec2> readImageSize(std::string_view path) {
+  std::ifstream stream{std::string{path}, std::ios::binary};
+  std::array<unsigned char, 24> header{};
+  if (!stream.read(reinterpret_cast<char*>(header.data()),
+                   static_cast<std::streamsize>(header.size()))) {
+    return std::nullopt;
+  }
+  const auto readBigEndian{[](const unsigned char* bytes, int count) {
+    auto value{0};
+    for (const auto index : iter::range(count)) {
+      value = (value << 8) | bytes[index];
+    }
+    return value;
+  }};
+
+  std::optional<glm::ivec2> size;
+  if (std::memcmp(header.data(), "\x89PNG\r\n\x1a\n", 8) == 0 &&
+      std::memcmp(header.data() + 12, "IHDR", 4) == 0) {
+    // Signature followed by the IHDR chunk
+    size = {readBigEndian(header.data() + 16, 4),
+            readBigEndian(header.data() + 20, 4)};
+  } else if (header[0] == 0xFF && header[1] == 0xD8) {
+    // Segments up to the start of frame, which holds the size
+    stream.seekg(2);
+    std::array<unsigned char, 9> segment{};
+    while (stream.read(reinterpret_cast<char*>(segment.data()), 4) &&
+           segment[0] == 0xFF) {
+      const auto marker{segment[1]};
+      const auto length{readBigEndian(segment.data() + 2, 2)};
+      if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 &&
+          marker != 0xC8 && marker != 0xCC) {
+        if (stream.read(reinterpret_cast<char*>(segment.data() + 4), 5)) {
+          size = {readBigEndian(segment.data() + 7, 2),
+                  readBigEndian(segment.data() + 5, 2)};
+        }
+        break;
+      }
+      stream.seekg(length - 2, std::ios::cur);
+    }
+  }
+
+  if (size && (size->x < 1 || size->y < 1)) return std::nullopt;
+  return size;
+}
+
+template <typename T>
+bool isFutureReady(const std::future<T>& future) {
+  return future.wait_for(std::chrono::seconds{0}) ==
+         std::future_status::ready;
+}
+}  // namespace
+
+/**
+ * @brief Creates a 2D texture and starts streaming its mipmap levels.
+ *
+ * The levels are taken from the first source available:
+ *
+ * - The levels stored in KTX2 and DDS files, in their compressed format if
+ *   the OpenGL context supports it (see
+ *   abcg::opengl::isCompressedFormatSupported), or else decoded to RGBA in
+ *   the background;
+ * - The mipmap chain stored in the texture cache of the image with the same
+ *   filter, compiled by abcg-assetc or persisted by a previous call;
+ * - The mipmap chain generated with abcg::loadMipmaps in the background.
+ *   Until it is ready, the texture is a single gray texel.
+ *
+ * The first two sources draw the smallest levels of the image from the
+ * first frame. In the last case, the size of the texture is read from the
+ * header of PNG and JPEG files. Images of other formats are decoded and
+ * uploaded at once, as with AssetManager::loadTexture. So are compressed
+ * images when glTexStorage2D is not available, as the storage of their
+ * levels cannot be allocated without their data.
+ *
+ * The storage of the textures is allocated by
+ * abcg::opengl::createTextureStorage.
+ *
+ * @param path Path to the image file.
+ * @param filter Filter used to generate the mipmap chain, if not stored.
+ * @param persist Whether to store the generated chain in the texture cache.
+ * @return Shared handle to the texture. The byte size of the texture
+ * includes the levels not uploaded yet.
+ *
+ * @throw abcg::Exception if the file cannot be opened. Decoding errors are
+ * thrown by process().
+ */
+std::shared_ptr<abcg::Texture> abcg::TextureStreamer::loadTexture(
+    std::string_view path, MipmapFilter filter, bool persist) {
+  Stream stream;
+  stream.path = path;
+  std::optional<glm::ivec2> size;
+
+  if (CompressedImage::isCompressedImage(path)) {
+    auto image{std::make_shared<CompressedImage>(path)};
+    const auto& levels{image->getLevels()};
+    if (levels.size() > 1) {
+      if (opengl::isCompressedFormatSupported(image->getFormat())) {
+        if (!opengl::isTextureStorageSupported()) {
+          return std::make_shared<Texture>(
+              opengl::createTexture(*image),
+              Texture::computeByteSize(*image, true));
+        }
+        stream.format = opengl::getInternalFormat(image->getFormat());
+        stream.compressed = true;
+        stream.blockSize = CompressedImage::getBlockSize(image->getFormat());
+        stream.readLevel = [image](std::size_t level) {
+          const auto data{image->getLevels()[level].data};
+          return std::vector<std::byte>(data.begin(), data.end());
+        };
+      } else {
+        stream.format = GL_RGBA;
+        stream.blockSize = 4;
+        stream.readLevel = [image](std::size_t level) {
+          return image->decode(level).pixels;
+        };
+      }
+      for (const auto& level : levels) {
+        stream.sizes.emplace_back(level.width, level.height);
+      }
+    } else if (!levels.empty()) {
+      size = {levels.front().width, levels.front().height};
+    }
+  }
+
+  if (stream.sizes.empty() && !size) {
+    if (auto cache{std::make_shared<TextureCache>()};
+        cache->load(TextureCache::getCachePath(path),
+                    TextureCache::computeKey(
+                        path, static_cast<std::uint64_t>(filter)))) {
+      const auto& levels{cache->getLevels()};
+      if (levels.size() > 1) {
+        stream.format = cache->getChannels() == 3 ? GLenum{GL_RGB}
+                                                  : GLenum{GL_RGBA};
+        stream.blockSize = static_cast<std::size_t>(cache->getChannels());
+        stream.readLevel = [cache](std::size_t level) {
+          const auto pixels{cache->getLevels()[level].pixels};
+          return std::vector<std::byte>(pixels.begin(), pixels.end());
+        };
+        for (const auto& level : levels) {
+          stream.sizes.emplace_back(level.width, level.height);
+        }
+      } else {
+        size = {levels.front().width, levels.front().height};
+      }
+    }
+  }
+
+  if (stream.sizes.empty()) {
+    if (!size) size = readImageSize(path);
+    if (!size) {
+      const auto levels{loadMipmaps(path, filter, persist)};
+      return std::make_shared<Texture>(
+          opengl::createTexture(levels),
+          Texture::computeByteSize(levels.front(), true));
+    }
+
+    // Decoded levels are converted to RGBA, the format of the storage
+    stream.format = GL_RGBA;
+    stream.blockSize = 4;
+    stream.sizes.push_back(*size);
+    while (glm::compMax(stream.sizes.back()) > 1) {
+      stream.sizes.push_back(glm::max(stream.sizes.back() / 2, 1));
+    }
+    stream.decoding = ThreadPool::getBackground().submit(
+        [path = stream.path, filter, persist] {
+          auto levels{loadMipmaps(path, filter, persist)};
+          for (auto& level : levels) {
+            if (level.channels != 3) continue;
+            std::vector<std::byte> pixels(level.pixels.size() / 3 * 4);
+            image::convertRGBToRGBA(level.pixels, pixels);
+            level.pixels = std::move(pixels);
+            level.channels = 4;
+          }
+          return levels;
+        });
+  }
+
+  std::size_t byteSize{};
+  for (const auto level : iter::range(stream.sizes.size())) {
+    byteSize += getLevelSize(stream, level);
+  }
+  const auto numLevels{static_cast<int>(stream.sizes.size())};
+  const auto& base{stream.sizes.front()};
+  const auto internalFormat{stream.compressed        ? stream.format
+                            : stream.format == GL_RGB ? GLenum{GL_RGB8}
+                                                      : GLenum{GL_RGBA8}};
+  stream.name = opengl::createTextureStorage(base.x, base.y, numLevels,
+                                             internalFormat);
+  auto texture{std::make_shared<Texture>(stream.name, byteSize)};
+
+  stream.baseLevel = stream.sizes.size() - 1;
+  if (stream.decoding.valid()) {
+    // The smallest level of a full chain is 1x1
+    constexpr std::array<std::uint8_t, 4> gray{128, 128, 128, 255};
+    glBindTexture(GL_TEXTURE_2D, stream.name);
+    glTexSubImage2D(GL_TEXTURE_2D, numLevels - 1, 0, 0, 1, 1, GL_RGBA,
+                    GL_UNSIGNED_BYTE, gray.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, numLevels - 1);
+    glBindTexture(GL_TEXTURE_2D, 0);
+  } else {
+    uploadTail(stream, m_pixelUnpackRing);
+  }
+
+  if (stream.baseLevel > 0 || stream.decoding.valid()) {
+    stream.texture = texture;
+    m_streams.push_back(std::move(stream));
+  }
+  return texture;
+}
+
+/**
+ * @brief Uploads the next rows of the mipmap levels being streamed.
+ *
+ * Levels are uploaded from the coarsest to the finest, starting with the
+ * texture whose next level is the smallest, so that every texture gets
+ * sharper at the same pace. The smallest levels of a decoded image are
+ * uploaded as soon as it is ready, outside the budget.
+ *
+ * With a pixel unpack ring (see setPixelUnpackRing()), the uploads stop for
+ * this frame once every buffer of the ring is in use.
+ *
+ * @param byteBudget Maximum number of bytes to copy. The budget may be
+ * exceeded by one row of texels or compressed blocks.
+ *
+ * @throw abcg::Exception if an image cannot be decoded, or if its size does
+ * not match the size read from its header. Its texture is no longer
+ * streamed.
+ */
+void abcg::TextureStreamer::process(std::size_t byteBudget) {
+  std::erase_if(m_streams, [](const Stream& stream) {
+    return stream.texture.expired();
+  });
+
+  std::size_t index{};
+  try {
+    for (; index < m_streams.size(); ++index) {
+      auto& stream{m_streams[index]};
+      if (stream.decoding.valid() && isFutureReady(stream.decoding)) {
+        startDecodedLevels(stream, m_pixelUnpackRing);
+      }
+    }
+
+    while (byteBudget > 0) {
+      index = m_streams.size();
+      for (const auto candidate : iter::range(m_streams.size())) {
+        const auto& stream{m_streams[candidate]};
+        if (isReady(stream) &&
+            (index == m_streams.size() ||
+             getLevelSize(stream, stream.baseLevel - 1) <
+                 getLevelSize(m_streams[index],
+                              m_streams[index].baseLevel - 1))) {
+          index = candidate;
+        }
+      }
+      if (index == m_streams.size()) break;
+
+      auto& stream{m_streams[index]};
+      const auto level{stream.baseLevel - 1};
+      if (!stream.hasPixels) {
+        stream.pixels = stream.fetch.get();
+        stream.hasPixels = true;
+        stream.offset = 0;
+        checkLevelSize(stream, level, stream.pixels.size());
+        if (level > 0) fetchLevel(stream, level - 1);
+      }
+
+      const auto size{uploadRows(stream, level, stream.pixels, stream.offset,
+                                 byteBudget, m_pixelUnpackRing)};
+      if (size == 0) break;
+      stream.offset += size;
+      byteBudget -= std::min(byteBudget, size);
+      if (stream.offset == stream.pixels.size()) {
+        // Sample the new level from the next draw
+        glBindTexture(GL_TEXTURE_2D, stream.name);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL,
+                        static_cast<GLint>(level));
+        glBindTexture(GL_TEXTURE_2D, 0);
+        stream.baseLevel = level;
+        stream.pixels = {};
+        stream.hasPixels = false;
+      }
+    }
+  } catch (const abcg::Exception&) {
+    m_streams.erase(m_streams.begin() + static_cast<std::ptrdiff_t>(index));
+    throw;
+  }
+
+  std::erase_if(m_streams, [](const Stream& stream) {
+    return stream.baseLevel == 0 && !stream.decoding.valid();
+  });
+}
+
+/**
+ * @brief Stops streaming every texture.
+ *
+ * Textures keep the levels already uploaded, with their base level clamped
+ * to the finest of them.
+ */
+void abcg::TextureStreamer::clear() noexcept { m_streams.clear(); }
+
+/**
+ * @brief Sets the ring of pixel unpack buffers through which the levels are
+ * uploaded.
+ *
+ * The uploads then return without waiting for the driver to copy the
+ * pixels. Without a ring, the pixels are copied by glTexSubImage2D on the
+ * calling thread.
+ *
+ * @param ring Ring used by the following uploads, or nullptr. It must
+ * outlive its use by the streamer, and can be shared with other uploads.
+ */
+void abcg::TextureStreamer::setPixelUnpackRing(
+    PixelUnpackRing* ring) noexcept {
+  m_pixelUnpackRing = ring;
+}
+
+/**
+ * @brief Returns the number of bytes of the levels not uploaded yet.
+ */
+std::size_t abcg::TextureStreamer::getPendingBytes() const noexcept {
+  std::size_t pendingBytes{};
+  for (const auto& stream : m_streams) {
+    for (const auto level : iter::range(stream.baseLevel)) {
+      pendingBytes += getLevelSize(stream, level);
+    }
+    pendingBytes -= stream.offset;
+  }
+  return pendingBytes;
+}
+
+std::size_t abcg::TextureStreamer::getRowSize(const Stream& stream,
+                                              std::size_t level) noexcept {
+  const auto width{stream.sizes[level].x};
+  const auto blocks{stream.compressed ? (width + 3) / 4 : width};
+  return static_cast<std::size_t>(blocks) * stream.blockSize;
+}
+
+std::size_t abcg::TextureStreamer::getLevelSize(const Stream& stream,
+                                                std::size_t level) noexcept {
+  const auto height{stream.sizes[level].y};
+  const auto rows{stream.compressed ? (height + 3) / 4 : height};
+  return static_cast<std::size_t>(rows) * getRowSize(stream, level);
+}
+
+void abcg::TextureStreamer::checkLevelSize(const Stream& stream,
+                                           std::size_t level,
+                                           std::size_t byteSize) {
+  if (byteSize != getLevelSize(stream, level)) {
+    throw abcg::Exception{abcg::Exception::Runtime(
+        fmt::format("Invalid level {} of {}: {} bytes instead of {}", level,
+                    stream.path, byteSize, getLevelSize(stream, level)))};
+  }
+}
+
+bool abcg::TextureStreamer::isReady(const Stream& stream) {
+  return !stream.decoding.valid() && stream.baseLevel > 0 &&
+         (stream.hasPixels || isFutureReady(stream.fetch));
+}
+
+// Reads a level on a background thread. The task shares the source of the
+// levels, so that the stream can be dropped while it runs
+void abcg::TextureStreamer::fetchLevel(Stream& stream, std::size_t level) {
+  stream.fetch = ThreadPool::getBackground().submit(
+      [readLevel = stream.readLevel, level] { return readLevel(level); });
+}
+
+// Uploads the levels of a decoded image that are smaller than tailSize, and
+// starts reading the next one
+void abcg::TextureStreamer::startDecodedLevels(Stream& stream,
+                                               PixelUnpackRing* ring) {
+  auto levels{stream.decoding.get()};
+  const auto matches{
+      levels.size() == stream.sizes.size() &&
+      std::ranges::equal(levels, stream.sizes,
+                         [](const Image& level, glm::ivec2 size) {
+                           return level.width == size.x &&
+                                  level.height == size.y;
+                         })};
+  if (!matches) {
+    throw abcg::Exception{abcg::Exception::Runtime(
+        fmt::format("Decoded image {} of {}x{} does not match its header",
+                    stream.path, levels.front().width,
+                    levels.front().height))};
+  }
+
+  stream.readLevel =
+      [levels = std::make_shared<std::vector<Image>>(std::move(levels))](
+          std::size_t level) { return std::move((*levels)[level].pixels); };
+  stream.baseLevel = stream.sizes.size();
+  uploadTail(stream, ring);
+}
+
+// Uploads the smallest level and the levels no larger than tailSize, and
+// starts reading the next one. The ring is skipped while it is full, so that
+// the texture can be drawn at once
+void abcg::TextureStreamer::uploadTail(Stream& stream,
+                                       PixelUnpackRing* ring) {
+  auto first{stream.sizes.size() - 1};
+  while (first > 0 && glm::compMax(stream.sizes[first - 1]) <= tailSize) {
+    --first;
+  }
+  for (const auto level : iter::range(first, stream.sizes.size())) {
+    const auto pixels{stream.readLevel(level)};
+    checkLevelSize(stream, level, pixels.size());
+    for (std::size_t offset{}; offset < pixels.size();) {
+      auto size{uploadRows(stream, level, pixels, offset,
+                           pixels.size() - offset, ring)};
+      if (size == 0) {
+        size = uploadRows(stream, level, pixels, offset,
+                          pixels.size() - offset, nullptr);
+      }
+      offset += size;
+    }
+  }
+  glBindTexture(GL_TEXTURE_2D, stream.name);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL,
+                  static_cast<GLint>(first));
+  glBindTexture(GL_TEXTURE_2D, 0);
+  stream.baseLevel = first;
+  if (first > 0) fetchLevel(stream, first - 1);
+}
+
+// Uploads whole rows of texels, or of 4x4 blocks, of a level, at least one,
+// through the ring if given. Returns the number of bytes uploaded, or 0 if
+// the ring is full
+std::size_t abcg::TextureStreamer::uploadRows(
+    const Stream& stream, std::size_t level, gsl::span<const std::byte> pixels,
+    std::size_t offset, std::size_t byteBudget, PixelUnpackRing* ring) {
+  const auto size{stream.sizes[level]};
+  const auto rowSize{getRowSize(stream, level)};
+  const auto rowHeight{stream.compressed ? 4 : 1};
+  const auto firstRow{offset / rowSize};
+  auto numRows{std::min(pixels.size() / rowSize - firstRow,
+                        std::max<std::size_t>(byteBudget / rowSize, 1))};
+  if (ring != nullptr && ring->getBufferSize() < rowSize) ring = nullptr;
+  if (ring != nullptr) {
+    numRows = std::min(numRows, ring->getBufferSize() / rowSize);
+  }
+  const auto y{static_cast<int>(firstRow) * rowHeight};
+  const auto height{
+      std::min(static_cast<int>(numRows) * rowHeight, size.y - y)};
+  const auto byteSize{numRows * rowSize};
+
+  if (ring != nullptr) {
+    const auto data{pixels.subspan(offset, byteSize)};
+    const auto uploaded{
+        stream.compressed
+            ? ring->uploadCompressed(stream.name, static_cast<GLint>(level),
+                                     {0, y}, {size.x, height}, stream.format,
+                                     data)
+            : ring->upload(stream.name, static_cast<GLint>(level), {0, y},
+                           {size.x, height}, stream.format, data)};
+    return uploaded ? byteSize : 0;
+  }
+
+  glBindTexture(GL_TEXTURE_2D, stream.name);
+  if (stream.compressed) {
+    glCompressedTexSubImage2D(GL_TEXTURE_2D, static_cast<GLint>(level), 0, y,
+                              size.x, height, stream.format,
+                              static_cast<GLsizei>(byteSize),
+                              pixels.data() + offset);
+  } else {
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(GL_TEXTURE_2D, static_cast<GLint>(level), 0, y, size.x,
+                    height, stream.format, GL_UNSIGNED_BYTE,
+                    pixels.data() + offset);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  }
+  glBindTexture(GL_TEXTURE_2D, 0);
+  return byteSize;
+}
@@ -0,0 +1,110 @@
+/**
+ * @file abcg_texturestreamer.hpp
+ * @brief abcg::TextureStreamer header file.
+ *
+ * Declaration of abcg::TextureStreamer class.
+ *
+ * This project is released under the MIT License.
+ */
+
+#ifndef ABCG_TEXTURESTREAMER_HPP_
+#define ABCG_TEXTURESTREAMER_HPP_
+
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <glm/vec2.hpp>
+#include <gsl/gsl>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "abcg_assetmanager.hpp"
+#include "abcg_external.hpp"
+#include "abcg_image.hpp"
+
+namespace abcg {
+class PixelUnpackRing;
+class TextureStreamer;
+}  // namespace abcg
+
+/**
+ * @brief abcg::TextureStreamer class.
+ *
+ * Loads 2D textures that can be drawn from the first frame, while their
+ * larger mipmap levels are still being loaded. loadTexture() allocates the
+ * storage of every level at once, with glTexStorage2D when available, and
+ * uploads the smallest levels. The larger levels are then read or decoded on
+ * background threads, and process() uploads them from the coarsest to the
+ * finest, a few rows at a time, within a per-frame budget.
+ * GL_TEXTURE_BASE_LEVEL is lowered as each level is complete, so the texture
+ * only samples the levels already uploaded and gets sharper over the next
+ * frames.
+ *
+ * The rows can be uploaded through an abcg::PixelUnpackRing, so that the
+ * calling thread does not wait for the driver to copy them.
+ *
+ * Streaming stops when the last handle to a texture is released. All member
+ * functions must be called on the thread that owns the OpenGL context.
+ */
+class abcg::TextureStreamer {
+ public:
+  [[nodiscard]] std::shared_ptr<Texture> loadTexture(
+      std::string_view path, MipmapFilter filter = MipmapFilter::Box,
+      bool persist = false);
+
+  void process(std::size_t byteBudget);
+  void clear() noexcept;
+  void setPixelUnpackRing(PixelUnpackRing* ring) noexcept;
+
+  [[nodiscard]] bool isEmpty() const noexcept { return m_streams.empty(); }
+  [[nodiscard]] std::size_t getPendingBytes() const noexcept;
+
+ private:
+  // Returns the pixels of a mipmap level, in the format of the texture
+  using LevelReader = std::function<std::vector<std::byte>(std::size_t)>;
+
+  struct Stream {
+    std::string path;
+    std::weak_ptr<Texture> texture;
+    GLuint name{};
+    GLenum format{};  // GL_RGB, GL_RGBA or a compressed format
+    bool compressed{};
+    std::size_t blockSize{};  // Bytes per texel, or per 4x4 block
+    std::vector<glm::ivec2> sizes;
+
+    // Levels decoded by a background task, for images without stored levels
+    std::future<std::vector<Image>> decoding;
+    LevelReader readLevel;
+
+    // Finest level uploaded so far
+    std::size_t baseLevel{};
+    // Pixels of the level above baseLevel, being uploaded
+    std::vector<std::byte> pixels;
+    bool hasPixels{};
+    std::size_t offset{};  // Bytes already uploaded
+    // Pixels of the next level to be uploaded
+    std::future<std::vector<std::byte>> fetch;
+  };
+
+  [[nodiscard]] static std::size_t getRowSize(const Stream& stream,
+                                              std::size_t level) noexcept;
+  [[nodiscard]] static std::size_t getLevelSize(const Stream& stream,
+                                                std::size_t level) noexcept;
+  static void checkLevelSize(const Stream& stream, std::size_t level,
+                             std::size_t byteSize);
+  [[nodiscard]] static bool isReady(const Stream& stream);
+  static void fetchLevel(Stream& stream, std::size_t level);
+  static void startDecodedLevels(Stream& stream, PixelUnpackRing* ring);
+  static void uploadTail(Stream& stream, PixelUnpackRing* ring);
+  static std::size_t uploadRows(const Stream& stream, std::size_t level,
+                                gsl::span<const std::byte> pixels,
+                                std::size_t offset, std::size_t byteBudget,
+                                PixelUnpackRing* ring);
+
+  std::vector<Stream> m_streams;
+  PixelUnpackRing* m_pixelUnpackRing{};
+};
+
+#endif
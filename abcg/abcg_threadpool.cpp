@@ -0,0 +1,151 @@
+/**
+ * @file abcg_threadpool.cpp
+ * @brief Definition of abcg::ThreadPool class members.
+ *
+ * This project is released under the MIT License.
+ */
+
+#include "abcg_threadpool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+
+/**
+ * @brief Constructs a pool with the given number of worker threads.
+ *
+ * @param numThreads Number of worker threads. If zero, tasks are executed on
+ * the calling thread.
+ */
+abcg::ThreadPool::ThreadPool(std::size_t numThreads) {
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+  numThreads = 0;
+#endif
+  m_workers.reserve(numThreads);
+  for (std::size_t index{}; index < numThreads; ++index) {
+    m_workers.emplace_back([this] { workerLoop(); });
+  }
+}
+
+abcg::ThreadPool::~ThreadPool() {
+  {
+    std::scoped_lock lock{m_mutex};
+    m_stopping = true;
+  }
+  m_condition.notify_all();
+  for (auto& worker : m_workers) {
+    worker.join();
+  }
+}
+
+/**
+ * @brief Calls a function for each index in [0, count) using the pool.
+ *
+ * The calling thread also takes part in the work, so this function can be
+ * called from inside a task without risk of deadlock. The function returns
+ * when every index has been processed. If any call throws, the first
+ * exception is rethrown on the calling thread.
+ *
+ * @param count Number of indices.
+ * @param function Function to be called for each index.
+ */
+void abcg::ThreadPool::parallelFor(
+    std::size_t count, const std::function<void(std::size_t)>& function) {
+  if (count == 0) return;
+
+  if (m_workers.empty() || count == 1) {
+    for (std::size_t index{}; index < count; ++index) function(index);
+    return;
+  }
+
+  struct SharedState {
+    std::atomic<std::size_t> next{};
+    std::atomic<std::size_t> done{};
+    std::mutex mutex;
+    std::condition_variable finished;
+    std::exception_ptr exception;
+  };
+  auto state{std::make_shared<SharedState>()};
+
+  auto work{[state, count, &function] {
+    std::size_t processed{};
+    for (auto index{state->next++}; index < count; index = state->next++) {
+      try {
+        function(index);
+      } catch (...) {
+        std::scoped_lock lock{state->mutex};
+        if (!state->exception) state->exception = std::current_exception();
+      }
+      ++processed;
+    }
+    if (processed > 0 && (state->done += processed) == count) {
+      std::scoped_lock lock{state->mutex};
+      state->finished.notify_all();
+    }
+  }};
+
+  // Helpers that start after all indices were taken return immediately and
+  // never touch the function object
+  const auto numHelpers{std::min(m_workers.size(), count - 1)};
+  for (std::size_t index{}; index < numHelpers; ++index) {
+    enqueue(work);
+  }
+  work();
+
+  std::unique_lock lock{state->mutex};
+  state->finished.wait(lock, [&] { return state->done == count; });
+  if (state->exception) std::rethrow_exception(state->exception);
+}
+
+/**
+ * @brief Returns a pool shared by the whole application.
+ */
+abcg::ThreadPool& abcg::ThreadPool::getDefault() {
+  static ThreadPool pool{};
+  return pool;
+}
+
+/**
+ * @brief Returns a pool with a single worker for long-running tasks.
+ *
+ * Used for asynchronous loads, so that a task that takes seconds does not
+ * occupy a worker of the default pool while other code waits on
+ * parallelFor. Tasks submitted to this pool may still use the default pool.
+ */
+abcg::ThreadPool& abcg::ThreadPool::getBackground() {
+  static ThreadPool pool{1};
+  return pool;
+}
+
+/**
+ * @brief Returns the default number of worker threads.
+ *
+ * One less than the number of hardware threads, since the calling thread
+ * usually takes part in the work.
+ */
+std::size_t abcg::ThreadPool::getDefaultNumThreads() noexcept {
+  const auto hardwareThreads{std::thread::hardware_concurrency()};
+  return hardwareThreads > 1 ? hardwareThreads - 1 : 0;
+}
+
+void abcg::ThreadPool::enqueue(std::function<void()> task) {
+  {
+    std::scoped_lock lock{m_mutex};
+    m_tasks.push(std::move(task));
+  }
+  m_condition.notify_one();
+}
+
+void abcg::ThreadPool::workerLoop() {
+  while (true) {
+    std::function<void()> task;
+    {
+      std::unique_lock lock{m_mutex};
+      m_condition.wait(lock, [this] { return m_stopping || !m_tasks.empty(); });
+      if (m_stopping && m_tasks.empty()) return;
+      task = std::move(m_tasks.front());
+      m_tasks.pop();
+    }
+    task();
+  }
+}
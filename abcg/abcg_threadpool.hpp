@@ -0,0 +1,95 @@
+/**
+ * @file abcg_threadpool.hpp
+ * @brief abcg::ThreadPool header file.
+ *
+ * Declaration of abcg::ThreadPool class.
+ *
+ * This project is released under the MIT License.
+ */
+
+#ifndef ABCG_THREADPOOL_HPP_
+#define ABCG_THREADPOOL_HPP_
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace abcg {
+class ThreadPool;
+}  // namespace abcg
+
+/**
+ * @brief abcg::ThreadPool class.
+ *
+ * Fixed-size pool of worker threads used by the CPU-heavy loaders of ABCg
+ * (parsing, mesh processing and image decoding).
+ *
+ * When threads are not available (e.g. WebAssembly builds without pthreads),
+ * the pool has no workers and every task runs on the calling thread.
+ */
+class abcg::ThreadPool {
+ public:
+  explicit ThreadPool(std::size_t numThreads = getDefaultNumThreads());
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool(ThreadPool&&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+  ThreadPool& operator=(ThreadPool&&) = delete;
+
+  template <typename TFun>
+  [[nodiscard]] auto submit(TFun&& function)
+      -> std::future<std::invoke_result_t<TFun>>;
+
+  void parallelFor(std::size_t count,
+                   const std::function<void(std::size_t)>& function);
+
+  [[nodiscard]] std::size_t getNumThreads() const noexcept {
+    return m_workers.size();
+  }
+
+  [[nodiscard]] static ThreadPool& getDefault();
+  [[nodiscard]] static ThreadPool& getBackground();
+  [[nodiscard]] static std::size_t getDefaultNumThreads() noexcept;
+
+ private:
+  void enqueue(std::function<void()> task);
+  void workerLoop();
+
+  std::vector<std::thread> m_workers;
+  std::queue<std::function<void()>> m_tasks;
+  std::mutex m_mutex;
+  std::condition_variable m_condition;
+  bool m_stopping{};
+};
+
+/**
+ * @brief Submits a task to the pool.
+ *
+ * @param function Callable object with no arguments.
+ * @return Future holding the value returned by the task, or the exception
+ * thrown by it.
+ */
+template <typename TFun>
+auto abcg::ThreadPool::submit(TFun&& function)
+    -> std::future<std::invoke_result_t<TFun>> {
+  using TResult = std::invoke_result_t<TFun>;
+  auto task{std::make_shared<std::packaged_task<TResult()>>(
+      std::forward<TFun>(function))};
+  auto future{task->get_future()};
+  if (m_workers.empty()) {
+    (*task)();
+  } else {
+    enqueue([task] { (*task)(); });
+  }
+  return future;
+}
+
+#endif
@@ -0,0 +1,174 @@
+/**
+ * @file abcg_uploadqueue.cpp
+ * @brief Definition of abcg::UploadQueue class members.
+ *
+ * This project is released under the MIT License.
+ */
+
+#include "abcg_uploadqueue.hpp"
+
+#include <algorithm>
+#include <utility>
+
+namespace {
+// Smallest amount of buffer data copied by a call to process(), so that
+// uploads progress even with a tiny budget
+constexpr std::size_t minChunkSize{4096};
+}  // namespace
+
+/**
+ * @brief Creates a buffer object and queues the upload of its data.
+ *
+ * @param target Binding point of the buffer (e.g. GL_ARRAY_BUFFER). WebGL
+ * does not allow a buffer to be bound to another target afterwards.
+ * @param data Contents of the buffer.
+ * @param usage Usage hint passed to glBufferData.
+ * @return Name of the buffer object.
+ */
+GLuint abcg::UploadQueue::uploadBuffer(GLenum target,
+                                       std::vector<std::byte> data,
+                                       GLenum usage) {
+  GLuint buffer{};
+  glGenBuffers(1, &buffer);
+  m_pendingBytes += data.size();
+  m_uploads.push_back(
+      {.target = target, .name = buffer, .data = std::move(data),
+       .usage = usage});
+  return buffer;
+}
+
+/**
+ * @brief Creates a 2D texture and queues the upload of its image.
+ *
+ * Filtering and wrapping are set as in abcg::opengl::createTexture once the
+ * last row has been uploaded.
+ *
+ * @param image Image returned by abcg::decodeImage.
+ * @param generateMipmaps Whether to generate the mipmap levels.
+ * @return Name of the texture.
+ */
+GLuint abcg::UploadQueue::uploadTexture(Image image, bool generateMipmaps) {
+  GLuint texture{};
+  glGenTextures(1, &texture);
+  m_pendingBytes += image.pixels.size();
+  m_uploads.push_back({.target = GL_TEXTURE_2D,
+                       .name = texture,
+                       .data = std::move(image.pixels),
+                       .width = image.width,
+                       .height = image.height,
+                       .channels = image.channels,
+                       .generateMipmaps = generateMipmaps});
+  return texture;
+}
+
+/**
+ * @brief Uploads the next chunks of queued data.
+ *
+ * Uploads are processed in the order they were queued.
+ *
+ * @param byteBudget Maximum number of bytes to copy. The budget may be
+ * exceeded by one texture row or a few kilobytes of buffer data, so that
+ * every call makes progress.
+ */
+void abcg::UploadQueue::process(std::size_t byteBudget) {
+  if (m_uploads.empty()) return;
+
+  // Binding an element array buffer would change the bound VAO
+  glBindVertexArray(0);
+
+  while (!m_uploads.empty()) {
+    auto& upload{m_uploads.front()};
+    const auto uploaded{upload.target == GL_TEXTURE_2D
+                            ? processTexture(upload, byteBudget)
+                            : processBuffer(upload, byteBudget)};
+    m_pendingBytes -= uploaded;
+    byteBudget -= std::min(byteBudget, uploaded);
+
+    if (upload.offset < upload.data.size()) break;
+    m_uploads.pop_front();
+    if (byteBudget == 0) break;
+  }
+}
+
+/**
+ * @brief Drops the pending uploads.
+ *
+ * Objects already created are not deleted and may be left incomplete.
+ */
+void abcg::UploadQueue::clear() noexcept {
+  m_uploads.clear();
+  m_pendingBytes = 0;
+}
+
+std::size_t abcg::UploadQueue::processBuffer(Upload& upload,
+                                             std::size_t byteBudget) {
+  glBindBuffer(upload.target, upload.name);
+  if (!upload.allocated) {
+    glBufferData(upload.target, static_cast<GLsizeiptr>(upload.data.size()),
+                 nullptr, upload.usage);
+    upload.allocated = true;
+  }
+
+  const auto size{std::min(upload.data.size() - upload.offset,
+                           std::max(byteBudget, minChunkSize))};
+  if (size > 0) {
+    glBufferSubData(upload.target, static_cast<GLintptr>(upload.offset),
+                    static_cast<GLsizeiptr>(size),
+                    upload.data.data() + upload.offset);
+    upload.offset += size;
+  }
+  glBindBuffer(upload.target, 0);
+
+  return size;
+}
+
+std::size_t abcg::UploadQueue::processTexture(Upload& upload,
+                                              std::size_t byteBudget) {
+  const GLenum format{upload.channels == 3 ? GLenum{GL_RGB}
+                                           : GLenum{GL_RGBA}};
+  glBindTexture(GL_TEXTURE_2D, upload.name);
+  if (!upload.allocated) {
+    glTexImage2D(GL_TEXTURE_2D, 0, static_cast<GLint>(format), upload.width,
+                 upload.height, 0, format, GL_UNSIGNED_BYTE, nullptr);
+    upload.allocated = true;
+  }
+
+  // Whole rows, at least one
+  std::size_t size{};
+  const auto rowSize{static_cast<std::size_t>(upload.width * upload.channels)};
+  if (rowSize > 0 && upload.offset < upload.data.size()) {
+    const auto firstRow{upload.offset / rowSize};
+    const auto numRows{
+        std::min(static_cast<std::size_t>(upload.height) - firstRow,
+                 std::max<std::size_t>(byteBudget / rowSize, 1))};
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, static_cast<GLint>(firstRow),
+                    upload.width, static_cast<GLsizei>(numRows), format,
+                    GL_UNSIGNED_BYTE, upload.data.data() + upload.offset);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    size = numRows * rowSize;
+    upload.offset += size;
+  }
+
+  if (upload.offset >= upload.data.size()) {
+    // Set texture filtering
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    // Generate the mipmap levels
+    if (upload.generateMipmaps) {
+      glGenerateMipmap(GL_TEXTURE_2D);
+
+      // Override minifying filtering
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                      GL_LINEAR_MIPMAP_LINEAR);
+    }
+
+    // Set texture wrapping
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  }
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  return size;
+}
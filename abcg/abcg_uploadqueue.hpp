@@ -0,0 +1,76 @@
+/**
+ * @file abcg_uploadqueue.hpp
+ * @brief abcg::UploadQueue header file.
+ *
+ * Declaration of abcg::UploadQueue class.
+ *
+ * This project is released under the MIT License.
+ */
+
+#ifndef ABCG_UPLOADQUEUE_HPP_
+#define ABCG_UPLOADQUEUE_HPP_
+
+#include <cstddef>
+#include <deque>
+#include <vector>
+
+#include "abcg_external.hpp"
+#include "abcg_image.hpp"
+
+namespace abcg {
+class UploadQueue;
+}  // namespace abcg
+
+/**
+ * @brief abcg::UploadQueue class.
+ *
+ * Spreads the upload of buffer and texture data over several frames. Each
+ * call to upload*() creates the OpenGL object immediately and queues its
+ * data; process() then copies at most a given number of bytes per call with
+ * glBufferSubData/glTexSubImage2D.
+ *
+ * Objects are owned by the caller, who must not use them for drawing until
+ * the queue is empty. All member functions must be called on the thread that
+ * owns the OpenGL context.
+ */
+class abcg::UploadQueue {
+ public:
+  [[nodiscard]] GLuint uploadBuffer(GLenum target, std::vector<std::byte> data,
+                                    GLenum usage = GL_STATIC_DRAW);
+  [[nodiscard]] GLuint uploadTexture(Image image, bool generateMipmaps = true);
+
+  void process(std::size_t byteBudget);
+  void clear() noexcept;
+
+  [[nodiscard]] bool isEmpty() const noexcept { return m_uploads.empty(); }
+  [[nodiscard]] std::size_t getPendingBytes() const noexcept {
+    return m_pendingBytes;
+  }
+
+ private:
+  struct Upload {
+    GLenum target{};
+    GLuint name{};
+    std::vector<std::byte> data;
+    std::size_t offset{};  // Bytes already uploaded
+    bool allocated{};
+
+    // Buffers only
+    GLenum usage{};
+
+    // Textures only
+    int width{};
+    int height{};
+    int channels{};
+    bool generateMipmaps{};
+  };
+
+  static std::size_t processBuffer(Upload& upload, std::size_t byteBudget);
+  static std::size_t processTexture(Upload& upload,
+                                    std::size_t byteBudget);
+
+  std::deque<Upload> m_uploads;
+  std::size_t m_pendingBytes{};
+};
+
+#endif
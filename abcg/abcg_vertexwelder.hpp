@@ -0,0 +1,184 @@
+/**
+ * @file abcg_vertexwelder.hpp
+ * @brief abcg::VertexWelder header file.
+ *
+ * Declaration and definition of abcg::VertexWelder class template and of
+ * hashing helpers used for vertex deduplication.
+ *
+ * This project is released under the MIT License.
+ */
+
+#ifndef ABCG_VERTEXWELDER_HPP_
+#define ABCG_VERTEXWELDER_HPP_
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <vector>
+
+namespace abcg {
+template <typename TVertex, typename THash = std::hash<TVertex>,
+          typename TEqual = std::equal_to<TVertex>>
+class VertexWelder;
+
+/**
+ * @brief Finalizes a hash value so that every input bit affects every output
+ * bit.
+ *
+ * Uses the 64-bit finalizer of MurmurHash3 (or its 32-bit variant when
+ * std::size_t is 32 bits wide).
+ *
+ * @param value Hash value.
+ * @return Mixed hash value.
+ */
+[[nodiscard]] constexpr std::size_t hashMix(std::size_t value) noexcept {
+  if constexpr (sizeof(std::size_t) >= 8) {
+    std::uint64_t x{value};
+    x ^= x >> 33U;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33U;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33U;
+    return x;
+  } else {
+    auto x{static_cast<std::uint32_t>(value)};
+    x ^= x >> 16U;
+    x *= 0x85ebca6bU;
+    x ^= x >> 13U;
+    x *= 0xc2b2ae35U;
+    x ^= x >> 16U;
+    return x;
+  }
+}
+
+/**
+ * @brief Combines the hash of a value into a seed.
+ *
+ * Unlike XOR, the combination is not symmetric: swapping two values (e.g. the
+ * x and y coordinates of a mirrored vertex) yields a different hash.
+ *
+ * @param seed Hash value to be updated.
+ * @param value Value to be hashed with std::hash.
+ */
+template <typename T>
+constexpr void hashCombine(std::size_t& seed, const T& value) noexcept {
+  seed = hashMix(seed + static_cast<std::size_t>(0x9e3779b97f4a7c15ULL) +
+                 std::hash<T>{}(value));
+}
+}  // namespace abcg
+
+/**
+ * @brief abcg::VertexWelder class template.
+ *
+ * Deduplicates vertices while an indexed mesh is being built. Each call to
+ * insert() either finds an equal vertex already added to the vertex array or
+ * appends the new vertex, and returns its index.
+ *
+ * The lookup table is a flat open-addressing hash table with linear probing.
+ * Each slot stores the vertex index and 32 bits of its hash, so that most
+ * mismatches are rejected without touching the vertex array.
+ *
+ * @tparam TVertex Vertex type.
+ * @tparam THash Hash function object. Its result is passed through
+ * abcg::hashMix, so weak hashes are acceptable.
+ * @tparam TEqual Equality function object.
+ */
+template <typename TVertex, typename THash, typename TEqual>
+class abcg::VertexWelder {
+ public:
+  explicit VertexWelder(std::vector<TVertex>& vertices,
+                        std::size_t expectedCount = 0);
+
+  [[nodiscard]] std::uint32_t insert(const TVertex& vertex);
+
+ private:
+  struct Slot {
+    std::uint32_t tag{};
+    std::uint32_t index{emptyIndex};
+  };
+  static constexpr std::uint32_t emptyIndex{
+      std::numeric_limits<std::uint32_t>::max()};
+  static constexpr std::size_t minCapacity{16};
+
+  // The slot is chosen from the low bits of the hash, so the tag stored in
+  // the slot uses the high bits
+  [[nodiscard]] static std::uint32_t getTag(std::size_t hash) noexcept {
+    return static_cast<std::uint32_t>(
+        hash >> (std::numeric_limits<std::size_t>::digits - 32));
+  }
+  void rehash(std::size_t capacity);
+
+  std::vector<TVertex>& m_vertices;
+  std::vector<Slot> m_slots;
+  std::size_t m_mask{};
+  THash m_hash{};
+  TEqual m_equal{};
+};
+
+/**
+ * @brief Constructs a welder that appends to the given vertex array.
+ *
+ * Vertices already in the array take part in the deduplication.
+ *
+ * @param vertices Vertex array to be filled.
+ * @param expectedCount Expected number of insertions (typically the number of
+ * indices of the mesh). Used to size the table so that it never grows.
+ */
+template <typename TVertex, typename THash, typename TEqual>
+abcg::VertexWelder<TVertex, THash, TEqual>::VertexWelder(
+    std::vector<TVertex>& vertices, std::size_t expectedCount)
+    : m_vertices{vertices} {
+  // Keep the load factor at or below 2/3 even if no vertex is shared
+  rehash(std::bit_ceil(std::max<std::size_t>(
+      (expectedCount + m_vertices.size()) * 3 / 2, minCapacity)));
+}
+
+/**
+ * @brief Adds a vertex to the vertex array unless an equal vertex is already
+ * there.
+ *
+ * @param vertex Vertex to be inserted.
+ * @return Index of the vertex in the vertex array.
+ */
+template <typename TVertex, typename THash, typename TEqual>
+std::uint32_t abcg::VertexWelder<TVertex, THash, TEqual>::insert(
+    const TVertex& vertex) {
+  if ((m_vertices.size() + 1) * 3 > m_slots.size() * 2) {
+    rehash(m_slots.size() * 2);
+  }
+
+  const auto hash{hashMix(m_hash(vertex))};
+  const auto tag{getTag(hash)};
+  for (auto slot{hash & m_mask};; slot = (slot + 1) & m_mask) {
+    auto& entry{m_slots[slot]};
+    if (entry.index == emptyIndex) {
+      entry.tag = tag;
+      entry.index = static_cast<std::uint32_t>(m_vertices.size());
+      m_vertices.push_back(vertex);
+      return entry.index;
+    }
+    if (entry.tag == tag &&
+        m_equal(m_vertices[entry.index], vertex)) {
+      return entry.index;
+    }
+  }
+}
+
+template <typename TVertex, typename THash, typename TEqual>
+void abcg::VertexWelder<TVertex, THash, TEqual>::rehash(std::size_t capacity) {
+  m_slots.assign(capacity, Slot{});
+  m_mask = capacity - 1;
+
+  for (std::size_t index{}; index < m_vertices.size(); ++index) {
+    const auto hash{hashMix(m_hash(m_vertices[index]))};
+    auto slot{hash & m_mask};
+    while (m_slots[slot].index != emptyIndex) slot = (slot + 1) & m_mask;
+    m_slots[slot].tag = getTag(hash);
+    m_slots[slot].index = static_cast<std::uint32_t>(index);
+  }
+}
+
+#endif
@@ -0,0 +1,747 @@
+/**
+ * @file abcg_virtualtexture.cpp
+ * @brief Definition of abcg::VirtualTexture class members.
+ *
+ * This project is released under the MIT License.
+ */
+
+#include "abcg_virtualtexture.hpp"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cppitertools/itertools.hpp>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/mat2x2.hpp>
+#include <limits>
+
+#include "abcg_exception.hpp"
+#include "abcg_imageops.hpp"
+#include "abcg_threadpool.hpp"
+
+namespace {
+constexpr std::array<char, 8> magic{'A', 'B', 'C', 'G', 'V', 'T', 'X', '1'};
+constexpr std::uint32_t formatVersion{1};
+
+// File header, followed by the RGBA pixels of each tile, level by level from
+// the base level. Tiles are tileSize + 2 * border texels wide and tall
+struct Header {
+  std::array<char, 8> magic{};
+  std::uint32_t version{};
+  std::uint32_t width{};
+  std::uint32_t height{};
+  std::uint32_t tileSize{};
+  std::uint32_t border{};
+  std::uint32_t levelCount{};
+  std::uint64_t tileCount{};
+  std::uint64_t fileSize{};
+};
+static_assert(sizeof(Header) == 48,
+              "Unexpected padding in virtual texture header");
+
+// Triangles longer than this on screen are split before requesting their
+// tiles, so that the level of detail follows the perspective
+constexpr float maxEdgePixels{64.0f};
+constexpr int maxSubdivisions{6};
+
+// Size of each level, down to the first level that fits in a single tile
+std::vector<glm::ivec2> computeLevelSizes(glm::ivec2 size, int tileSize) {
+  std::vector levels{size};
+  while (levels.back().x > tileSize || levels.back().y > tileSize) {
+    levels.push_back(glm::max(levels.back() / 2, 1));
+  }
+  return levels;
+}
+
+glm::ivec2 countTiles(glm::ivec2 levelSize, int tileSize) {
+  return (levelSize + tileSize - 1) / tileSize;
+}
+
+std::size_t computePageBytes(int tileSize, int border) {
+  const auto pageSize{static_cast<std::size_t>(tileSize + 2 * border)};
+  return pageSize * pageSize * 4;
+}
+
+// Copies a tile of an RGBA level with its border. Texels outside the level
+// wrap around horizontally and are clamped vertically, as suits the
+// equirectangular maps of planets
+void copyTile(const abcg::Image& level, glm::ivec2 tile, int tileSize,
+              int border, gsl::span<std::byte> pixels) {
+  const auto pageSize{tileSize + 2 * border};
+  const auto origin{tile * tileSize - border};
+  const auto pitch{static_cast<std::size_t>(level.width) * 4};
+  auto* destination{pixels.data()};
+  for (const auto row : iter::range(pageSize)) {
+    const auto y{std::clamp(origin.y + row, 0, level.height - 1)};
+    const auto* source{level.pixels.data() +
+                       static_cast<std::size_t>(y) * pitch};
+    for (const auto column : iter::range(pageSize)) {
+      const auto x{((origin.x + column) % level.width + level.width) %
+                   level.width};
+      std::memcpy(destination, source + static_cast<std::size_t>(x) * 4, 4);
+      destination += 4;
+    }
+  }
+}
+}  // namespace
+
+/**
+ * @brief Constructs an object and opens a virtual texture.
+ *
+ * See open().
+ *
+ * @param path Path to the file written by store().
+ */
+abcg::VirtualTexture::VirtualTexture(std::string_view path) { open(path); }
+
+abcg::VirtualTexture::~VirtualTexture() { close(); }
+
+/**
+ * @brief Writes an image to a file of tiles, with its mipmap levels.
+ *
+ * This is the offline step of virtual texturing, run by abcg-assetc. The
+ * image is first resized, if needed, so that each axis has a power of two
+ * number of tiles. Each tile of a level then covers exactly 2x2 tiles of
+ * the previous level. Levels are computed with abcg::image::downsample, down
+ * to the first level that fits in a single tile. Only two levels are kept
+ * in memory at a time, and the tiles are written a row of tiles at a time.
+ *
+ * Tile borders wrap around horizontally and are clamped vertically, which
+ * suits the equirectangular maps of planets. As in
+ * abcg::TextureCache::store, the file is first written to a temporary file
+ * and then renamed.
+ *
+ * @param path Path to the tiled texture file (.abcgvt).
+ * @param image Base level, with 3 or 4 channels.
+ * @param tileSize Width and height of the tiles, without their border.
+ * @param border Width of the border around each tile, in texels.
+ *
+ * @throw abcg::Exception if the arguments are invalid or the file cannot be
+ * written.
+ */
+void abcg::VirtualTexture::store(std::string_view path, Image image,
+                                 int tileSize, int border) {
+  if (image.width < 1 || image.height < 1 ||
+      (image.channels != 3 && image.channels != 4) || tileSize < 1 ||
+      border < 0 || border > tileSize) {
+    throw abcg::Exception{abcg::Exception::Runtime(
+        fmt::format("Invalid image or tile size for virtual texture {}",
+                    path))};
+  }
+
+  const auto tiles{countTiles({image.width, image.height}, tileSize)};
+  const glm::ivec2 size{
+      static_cast<int>(std::bit_ceil(static_cast<unsigned>(tiles.x))) *
+          tileSize,
+      static_cast<int>(std::bit_ceil(static_cast<unsigned>(tiles.y))) *
+          tileSize};
+  if (size.x != image.width || size.y != image.height ||
+      image.channels != 4) {
+    image = resizeImage(image, size.x, size.y);
+  }
+
+  const auto levelSizes{computeLevelSizes(size, tileSize)};
+  const auto pageBytes{computePageBytes(tileSize, border)};
+
+  Header header{};
+  header.magic = magic;
+  header.version = formatVersion;
+  header.width = static_cast<std::uint32_t>(size.x);
+  header.height = static_cast<std::uint32_t>(size.y);
+  header.tileSize = static_cast<std::uint32_t>(tileSize);
+  header.border = static_cast<std::uint32_t>(border);
+  header.levelCount = static_cast<std::uint32_t>(levelSizes.size());
+  for (const auto& levelSize : levelSizes) {
+    const auto levelTiles{countTiles(levelSize, tileSize)};
+    header.tileCount += static_cast<std::uint64_t>(levelTiles.x) *
+                        static_cast<std::uint64_t>(levelTiles.y);
+  }
+  header.fileSize = sizeof(Header) + header.tileCount * pageBytes;
+
+  const auto tempPath{std::string{path} + ".tmp"};
+  {
+    std::ofstream output(tempPath, std::ios::binary | std::ios::trunc);
+    if (!output) {
+      throw abcg::Exception{abcg::Exception::Runtime(
+          fmt::format("Failed to create virtual texture {}", path))};
+    }
+    output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    std::vector<std::byte> row;
+    for (const auto& [index, levelSize] : iter::enumerate(levelSizes)) {
+      if (index > 0) {
+        Image level{.width = levelSize.x,
+                    .height = levelSize.y,
+                    .channels = 4,
+                    .pixels = std::vector<std::byte>(
+                        static_cast<std::size_t>(levelSize.x) *
+                        static_cast<std::size_t>(levelSize.y) * 4)};
+        image::downsample(image.pixels, image.width, image.height, 4,
+                          level.pixels);
+        image = std::move(level);
+      }
+
+      const auto levelTiles{countTiles(levelSize, tileSize)};
+      row.resize(static_cast<std::size_t>(levelTiles.x) * pageBytes);
+      for (const auto y : iter::range(levelTiles.y)) {
+        ThreadPool::getDefault().parallelFor(
+            static_cast<std::size_t>(levelTiles.x), [&](std::size_t x) {
+              copyTile(image, {static_cast<int>(x), y}, tileSize, border,
+                       gsl::span{row}.subspan(x * pageBytes, pageBytes));
+            });
+        output.write(reinterpret_cast<const char*>(row.data()),
+                     static_cast<std::streamsize>(row.size()));
+      }
+    }
+
+    if (!output) {
+      throw abcg::Exception{abcg::Exception::Runtime(
+          fmt::format("Failed to write virtual texture {}", path))};
+    }
+  }
+
+  std::error_code error;
+  std::filesystem::rename(tempPath, path, error);
+  if (error) {
+    std::filesystem::remove(tempPath, error);
+    throw abcg::Exception{abcg::Exception::Runtime(
+        fmt::format("Failed to write virtual texture {}", path))};
+  }
+}
+
+/**
+ * @brief Opens a file written by store().
+ *
+ * Maps the file into memory and creates the indirection texture and a page
+ * texture with the minimum number of pages, holding the tile of the coarsest
+ * level. Call resize() to size the page texture for the viewport.
+ *
+ * @param path Path to the tiled texture file.
+ *
+ * @throw abcg::Exception if the file cannot be opened or is not a valid
+ * virtual texture.
+ */
+void abcg::VirtualTexture::open(std::string_view path) {
+  close();
+  m_file.open(path);
+
+  const auto data{m_file.getData()};
+  Header header{};
+  if (data.size() >= sizeof(Header)) {
+    std::memcpy(&header, data.data(), sizeof(Header));
+  }
+  auto valid{header.magic == magic && header.version == formatVersion &&
+             header.width > 0 && header.height > 0 && header.tileSize > 0 &&
+             header.border <= header.tileSize &&
+             header.fileSize == data.size()};
+  std::vector<glm::ivec2> levelSizes;
+  if (valid) {
+    m_size = {static_cast<int>(header.width),
+              static_cast<int>(header.height)};
+    m_tileSize = static_cast<int>(header.tileSize);
+    m_border = static_cast<int>(header.border);
+    levelSizes = computeLevelSizes(m_size, m_tileSize);
+    std::uint64_t tileCount{};
+    for (const auto& levelSize : levelSizes) {
+      const auto tiles{countTiles(levelSize, m_tileSize)};
+      tileCount += static_cast<std::uint64_t>(tiles.x) *
+                   static_cast<std::uint64_t>(tiles.y);
+    }
+    valid = levelSizes.size() == header.levelCount &&
+            tileCount == header.tileCount &&
+            header.fileSize ==
+                sizeof(Header) +
+                    tileCount * computePageBytes(m_tileSize, m_border);
+  }
+  if (!valid) {
+    close();
+    throw abcg::Exception{abcg::Exception::Runtime(
+        fmt::format("Invalid virtual texture {}", path))};
+  }
+
+  for (const auto& levelSize : levelSizes) {
+    const auto tiles{countTiles(levelSize, m_tileSize)};
+    m_levels.push_back(
+        {.size = levelSize, .tiles = tiles, .firstTile = m_tiles.size()});
+    m_tiles.resize(m_tiles.size() + static_cast<std::size_t>(tiles.x) *
+                                        static_cast<std::size_t>(tiles.y),
+                   {.level = static_cast<int>(m_levels.size() - 1)});
+  }
+
+  // One texel per tile. The levels of the virtual texture have a power of
+  // two number of tiles, so they match the mipmap levels
+  m_indirection.resize(m_tiles.size());
+  glGenTextures(1, &m_indirectionTexture);
+  glBindTexture(GL_TEXTURE_2D, m_indirectionTexture);
+  for (const auto& [index, level] : iter::enumerate(m_levels)) {
+    glTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(index), GL_RGBA8,
+                 level.tiles.x, level.tiles.y, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                 nullptr);
+  }
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                  GL_NEAREST_MIPMAP_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL,
+                  static_cast<GLint>(m_levels.size() - 1));
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  resize(0, 0);
+}
+
+/**
+ * @brief Releases the textures and the file, after waiting for the tiles
+ * being loaded.
+ */
+void abcg::VirtualTexture::close() noexcept {
+  // Loads read the mapped file
+  for (auto& load : m_loads) load.pixels.wait();
+  m_loads.clear();
+
+  if (m_pageTexture != 0) glDeleteTextures(1, &m_pageTexture);
+  if (m_indirectionTexture != 0) glDeleteTextures(1, &m_indirectionTexture);
+  m_pageTexture = 0;
+  m_indirectionTexture = 0;
+
+  m_file.close();
+  m_size = {};
+  m_tileSize = 0;
+  m_border = 0;
+  m_levels.clear();
+  m_tiles.clear();
+  m_requests.clear();
+  m_pages.clear();
+  m_pagesPerRow = 0;
+  m_indirection.clear();
+  m_dirtyLevels = 0;
+  m_statistics = {};
+}
+
+/**
+ * @brief Sizes the page texture for a viewport.
+ *
+ * The page texture holds pagesPerScreen pages for each tile that fits in
+ * the viewport, and at least 16 pages, in a square grid limited by
+ * GL_MAX_TEXTURE_SIZE. With 128x128 tiles with a border of 1 texel, a
+ * 1920x1080 viewport uses 529 pages, or 34 MiB, whatever the size of the
+ * virtual texture.
+ *
+ * Changing the number of pages drops the loaded tiles, other than the tile
+ * of the coarsest level.
+ *
+ * @param width Width of the viewport, in pixels.
+ * @param height Height of the viewport, in pixels.
+ * @param pagesPerScreen Pages per tile that fits in the viewport. Leaves
+ * room for the partially visible tiles, the tiles of the coarser levels and
+ * the tiles that went out of view recently.
+ */
+void abcg::VirtualTexture::resize(int width, int height,
+                                  float pagesPerScreen) {
+  if (!isOpen()) return;
+
+  const auto screenTiles{static_cast<double>(std::max(width, 0)) *
+                         static_cast<double>(std::max(height, 0)) /
+                         (static_cast<double>(m_tileSize) * m_tileSize)};
+  GLint maxTextureSize{};
+  glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+  // Page coordinates are stored in 8 bits in the indirection texture
+  const auto maxPagesPerRow{
+      std::clamp(maxTextureSize / getPageSize(), 1, 256)};
+  const auto pages{screenTiles * static_cast<double>(pagesPerScreen)};
+  const auto pagesPerRow{
+      std::clamp(static_cast<int>(std::ceil(std::sqrt(std::max(pages, 16.0)))),
+                 1, maxPagesPerRow)};
+  if (pagesPerRow == m_pagesPerRow) return;
+
+  m_pagesPerRow = pagesPerRow;
+  const auto textureSize{pagesPerRow * getPageSize()};
+  if (m_pageTexture == 0) glGenTextures(1, &m_pageTexture);
+  glBindTexture(GL_TEXTURE_2D, m_pageTexture);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, textureSize, textureSize, 0,
+               GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+
+  for (auto& tile : m_tiles) tile.page = -1;
+  m_pages.assign(static_cast<std::size_t>(pagesPerRow * pagesPerRow), {});
+
+  // The tile of the coarsest level is never evicted
+  const auto root{m_tiles.size() - 1};
+  uploadTile(root, 0, getTilePixels(root));
+  m_pages.front().lastUse = std::numeric_limits<std::uint64_t>::max();
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  m_dirtyLevels = m_levels.size();
+  refreshIndirection();
+  m_statistics.pages = m_pages.size();
+  m_statistics.residentTiles = 1;
+}
+
+/**
+ * @brief Requests the tiles needed to draw a mesh (CPU feedback pass).
+ *
+ * Works out the tiles seen from the camera without reading back the
+ * framebuffer, so that it also runs on WebGL. Triangles inside the view
+ * frustum are split until their edges are at most 64 pixels long on screen.
+ * Each one then requests the tiles under the bounding box of its texture
+ * coordinates, at the level chosen by the fragment shader: the base 2
+ * logarithm of the largest number of texels covered by a one-pixel step
+ * along x or y. The ancestors of the requested tiles are requested too.
+ * Parts of triangles that cross the near plane request the base level.
+ *
+ * @param clipPositions Clip space position of each vertex, i.e. multiplied
+ * by the model, view and projection matrices.
+ * @param texCoords Texture coordinates of each vertex.
+ * @param indices Vertex indices of the triangles drawn with the texture.
+ * @param viewportSize Size of the viewport, in pixels.
+ * @param cullBackFacing Whether to skip the triangles that face away from
+ * the camera, with counterclockwise front faces.
+ */
+void abcg::VirtualTexture::addFeedback(
+    gsl::span<const glm::vec4> clipPositions,
+    gsl::span<const glm::vec2> texCoords,
+    gsl::span<const std::uint32_t> indices, glm::ivec2 viewportSize,
+    bool cullBackFacing) {
+  if (!isOpen()) return;
+
+  for (const auto first : iter::range<std::size_t>(0, indices.size() / 3 * 3,
+                                                   3)) {
+    std::array<glm::vec4, 3> triangle{};
+    std::array<glm::vec2, 3> triangleTexCoords{};
+    for (const auto vertex : iter::range<std::size_t>(3)) {
+      const auto index{indices[first + vertex]};
+      triangle.at(vertex) = clipPositions[index];
+      triangleTexCoords.at(vertex) = texCoords[index];
+    }
+    requestTriangle(triangle, triangleTexCoords, glm::vec2(viewportSize),
+                    cullBackFacing, 0);
+  }
+}
+
+/**
+ * @brief Streams the tiles requested since the last call.
+ *
+ * Starts loading the missing tiles on the background thread pool, coarsest
+ * levels first, as they replace the finer tiles until those are loaded.
+ * Then uploads the tiles that finished loading, at most setMaxUploads() per
+ * call, to free pages or to the pages of the least recently requested
+ * tiles. Pages of the tiles requested since the last call are never reused,
+ * so no more tiles are loaded than the other pages can hold. Finally,
+ * refreshes the indirection texture.
+ */
+void abcg::VirtualTexture::update() {
+  if (!isOpen()) return;
+
+  std::sort(m_requests.begin(), m_requests.end(), std::greater{});
+  for (const auto index : m_requests) {
+    if (const auto page{m_tiles[index].page}; page >= 0) {
+      auto& lastUse{m_pages[static_cast<std::size_t>(page)].lastUse};
+      lastUse = std::max(lastUse, m_frame);
+    }
+  }
+
+  auto available{static_cast<std::size_t>(
+      std::count_if(m_pages.begin(), m_pages.end(), [this](const Page& page) {
+        return !page.used || page.lastUse < m_frame;
+      }))};
+  available = available > m_loads.size() ? available - m_loads.size() : 0;
+  for (const auto index : m_requests) {
+    if (m_loads.size() >= m_maxPendingLoads || available == 0) break;
+    auto& tile{m_tiles[index]};
+    if (tile.page >= 0 || tile.loading) continue;
+
+    // Reads the tile from the mapped file, which may touch the disk
+    tile.loading = true;
+    --available;
+    m_loads.push_back(
+        {.tile = index,
+         .pixels = ThreadPool::getBackground().submit(
+             [pixels = getTilePixels(index)] {
+               return std::vector<std::byte>(pixels.begin(), pixels.end());
+             })});
+  }
+
+  std::size_t numUploads{};
+  for (auto iter{m_loads.begin()};
+       iter != m_loads.end() && numUploads < m_maxUploads;) {
+    if (iter->pixels.wait_for(std::chrono::seconds{0}) !=
+        std::future_status::ready) {
+      ++iter;
+      continue;
+    }
+
+    const auto pixels{iter->pixels.get()};
+    auto& tile{m_tiles[iter->tile]};
+    tile.loading = false;
+    if (const auto page{allocatePage()}) {
+      glBindTexture(GL_TEXTURE_2D, m_pageTexture);
+      uploadTile(iter->tile, *page, pixels);
+      m_pages[*page].lastUse = tile.lastRequest;
+      ++numUploads;
+    }
+    iter = m_loads.erase(iter);
+  }
+  if (numUploads > 0) glBindTexture(GL_TEXTURE_2D, 0);
+
+  refreshIndirection();
+
+  m_statistics.requestedTiles = m_requests.size();
+  m_statistics.residentTiles = static_cast<std::size_t>(std::count_if(
+      m_pages.begin(), m_pages.end(),
+      [](const Page& page) { return page.used; }));
+  m_statistics.pendingLoads = m_loads.size();
+  m_requests.clear();
+  ++m_frame;
+}
+
+/**
+ * @brief Binds the page and indirection textures and sets the uniform
+ * variables used to sample the virtual texture.
+ *
+ * The program must be in use. Its shaders are expected to declare:
+ *
+ *     uniform sampler2D vtPages;        // Page texture
+ *     uniform sampler2D vtIndirection;  // Page and level of each tile
+ *     uniform vec4 vtParams;  // Base level size, tile size and border
+ *     uniform float vtMaxLevel;         // Index of the coarsest level
+ *
+ * Each texel of the indirection texture holds, in its red and green
+ * channels, the column and row of the page of the tile, or of the ancestor
+ * that replaces it, and in its blue channel the level of that tile. See the
+ * fragment shader of the planettour example.
+ *
+ * @param program Program in use.
+ * @param firstUnit Texture unit of the page texture. The indirection
+ * texture uses the next unit.
+ */
+void abcg::VirtualTexture::bind(GLuint program, GLint firstUnit) const {
+  glActiveTexture(GL_TEXTURE0 + static_cast<GLenum>(firstUnit));
+  glBindTexture(GL_TEXTURE_2D, m_pageTexture);
+  glActiveTexture(GL_TEXTURE0 + static_cast<GLenum>(firstUnit + 1));
+  glBindTexture(GL_TEXTURE_2D, m_indirectionTexture);
+  glActiveTexture(GL_TEXTURE0);
+
+  glUniform1i(glGetUniformLocation(program, "vtPages"), firstUnit);
+  glUniform1i(glGetUniformLocation(program, "vtIndirection"), firstUnit + 1);
+  glUniform4f(glGetUniformLocation(program, "vtParams"),
+              static_cast<float>(m_size.x), static_cast<float>(m_size.y),
+              static_cast<float>(m_tileSize), static_cast<float>(m_border));
+  glUniform1f(glGetUniformLocation(program, "vtMaxLevel"),
+              static_cast<float>(m_levels.size() - 1));
+}
+
+gsl::span<const std::byte> abcg::VirtualTexture::getTilePixels(
+    std::size_t tile) const {
+  const auto pageBytes{computePageBytes(m_tileSize, m_border)};
+  return m_file.getData().subspan(sizeof(Header) + tile * pageBytes,
+                                  pageBytes);
+}
+
+std::size_t abcg::VirtualTexture::getTileIndex(int level,
+                                               glm::ivec2 tile) const {
+  const auto& entry{m_levels[static_cast<std::size_t>(level)]};
+  return entry.firstTile +
+         static_cast<std::size_t>(tile.y) *
+             static_cast<std::size_t>(entry.tiles.x) +
+         static_cast<std::size_t>(tile.x);
+}
+
+// Returns a free page, or else evicts the tile of the least recently used
+// page that was not requested in this frame
+std::optional<std::size_t> abcg::VirtualTexture::allocatePage() {
+  std::optional<std::size_t> oldest;
+  for (const auto index : iter::range(m_pages.size())) {
+    const auto& page{m_pages[index]};
+    if (!page.used) return index;
+    if (page.lastUse < m_frame &&
+        (!oldest || page.lastUse < m_pages[*oldest].lastUse)) {
+      oldest = index;
+    }
+  }
+
+  if (oldest) {
+    auto& page{m_pages[*oldest]};
+    auto& tile{m_tiles[page.tile]};
+    tile.page = -1;
+    m_dirtyLevels =
+        std::max(m_dirtyLevels, static_cast<std::size_t>(tile.level) + 1);
+    page.used = false;
+    ++m_statistics.evictions;
+  }
+  return oldest;
+}
+
+// Copies a tile to a page of the page texture, which must be bound
+void abcg::VirtualTexture::uploadTile(std::size_t tile, std::size_t page,
+                                      gsl::span<const std::byte> pixels) {
+  const auto pageSize{getPageSize()};
+  const auto pageIndex{static_cast<int>(page)};
+  glTexSubImage2D(GL_TEXTURE_2D, 0, pageIndex % m_pagesPerRow * pageSize,
+                  pageIndex / m_pagesPerRow * pageSize, pageSize, pageSize,
+                  GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+
+  auto& entry{m_tiles[tile]};
+  entry.page = pageIndex;
+  m_pages[page].tile = tile;
+  m_pages[page].used = true;
+  m_dirtyLevels =
+      std::max(m_dirtyLevels, static_cast<std::size_t>(entry.level) + 1);
+  ++m_statistics.uploads;
+}
+
+// Rebuilds the levels of the indirection texture that changed, from the
+// coarsest one, so that tiles not loaded take the entry of their parent
+void abcg::VirtualTexture::refreshIndirection() {
+  if (m_dirtyLevels == 0) return;
+
+  glBindTexture(GL_TEXTURE_2D, m_indirectionTexture);
+  for (auto levelIndex{m_dirtyLevels}; levelIndex-- > 0;) {
+    const auto& level{m_levels[levelIndex]};
+    const auto levelNumber{static_cast<int>(levelIndex)};
+    for (const auto y : iter::range(level.tiles.y)) {
+      for (const auto x : iter::range(level.tiles.x)) {
+        const auto index{getTileIndex(levelNumber, {x, y})};
+        if (const auto page{m_tiles[index].page}; page >= 0) {
+          m_indirection[index] = {
+              static_cast<std::uint8_t>(page % m_pagesPerRow),
+              static_cast<std::uint8_t>(page / m_pagesPerRow),
+              static_cast<std::uint8_t>(levelIndex), 255};
+        } else {
+          m_indirection[index] =
+              m_indirection[getTileIndex(levelNumber + 1, {x / 2, y / 2})];
+        }
+      }
+    }
+    glTexSubImage2D(GL_TEXTURE_2D, levelNumber, 0, 0, level.tiles.x,
+                    level.tiles.y, GL_RGBA, GL_UNSIGNED_BYTE,
+                    &m_indirection[level.firstTile]);
+  }
+  glBindTexture(GL_TEXTURE_2D, 0);
+  m_dirtyLevels = 0;
+}
+
+void abcg::VirtualTexture::requestTriangle(
+    const std::array<glm::vec4, 3>& clipPositions,
+    const std::array<glm::vec2, 3>& texCoords, glm::vec2 viewportSize,
+    bool cullBackFacing, int depth) {
+  const auto& [p0, p1, p2]{clipPositions};
+  const auto& [t0, t1, t2]{texCoords};
+
+  // Skip the triangle if its vertices are outside the same clip plane
+  for (const auto axis : iter::range(3)) {
+    const auto outside{[&](float sign) {
+      return std::all_of(clipPositions.begin(), clipPositions.end(),
+                         [&](const glm::vec4& position) {
+                           return sign * position[axis] > position.w;
+                         });
+    }};
+    if (outside(1.0f) || outside(-1.0f)) return;
+  }
+
+  const auto split{[&] {
+    const auto p01{(p0 + p1) * 0.5f};
+    const auto p12{(p1 + p2) * 0.5f};
+    const auto p20{(p2 + p0) * 0.5f};
+    const auto t01{(t0 + t1) * 0.5f};
+    const auto t12{(t1 + t2) * 0.5f};
+    const auto t20{(t2 + t0) * 0.5f};
+    const auto next{depth + 1};
+    requestTriangle({p0, p01, p20}, {t0, t01, t20}, viewportSize,
+                    cullBackFacing, next);
+    requestTriangle({p01, p1, p12}, {t01, t1, t12}, viewportSize,
+                    cullBackFacing, next);
+    requestTriangle({p20, p12, p2}, {t20, t12, t2}, viewportSize,
+                    cullBackFacing, next);
+    requestTriangle({p01, p12, p20}, {t01, t12, t20}, viewportSize,
+                    cullBackFacing, next);
+  }};
+  const auto minTexCoord{glm::min(glm::min(t0, t1), t2)};
+  const auto maxTexCoord{glm::max(glm::max(t0, t1), t2)};
+
+  if (p0.w <= 0.0f || p1.w <= 0.0f || p2.w <= 0.0f) {
+    if (depth < maxSubdivisions) {
+      split();
+    } else {
+      requestTiles(minTexCoord, maxTexCoord, 0);
+    }
+    return;
+  }
+
+  const auto toScreen{[&](const glm::vec4& position) {
+    return (glm::vec2(position) / position.w * 0.5f + 0.5f) * viewportSize;
+  }};
+  const auto s0{toScreen(p0)};
+  const glm::mat2 screenEdges{toScreen(p1) - s0, toScreen(p2) - s0};
+  const auto area{glm::determinant(screenEdges)};
+  if (area == 0.0f || (cullBackFacing && area < 0.0f)) return;
+
+  const auto maxEdge{std::max({glm::length(screenEdges[0]),
+                               glm::length(screenEdges[1]),
+                               glm::length(screenEdges[1] - screenEdges[0])})};
+  if (maxEdge > maxEdgePixels && depth < maxSubdivisions) {
+    split();
+    return;
+  }
+
+  // Texels covered by a one-pixel step along x and y
+  const glm::vec2 size{m_size};
+  const glm::mat2 texelEdges{(t1 - t0) * size, (t2 - t0) * size};
+  const auto derivatives{texelEdges * glm::inverse(screenEdges)};
+  const auto scale{
+      std::max(glm::length(derivatives[0]), glm::length(derivatives[1]))};
+  const auto maxLevel{static_cast<float>(m_levels.size() - 1)};
+  const auto level{
+      scale > 0.0f ? std::clamp(std::floor(std::log2(scale)), 0.0f, maxLevel)
+                   : 0.0f};
+  requestTiles(minTexCoord, maxTexCoord, static_cast<int>(level));
+}
+
+void abcg::VirtualTexture::requestTiles(glm::vec2 minTexCoord,
+                                        glm::vec2 maxTexCoord, int level) {
+  const auto& entry{m_levels[static_cast<std::size_t>(level)]};
+  const auto tilesPerUnit{glm::vec2(entry.size) /
+                          static_cast<float>(m_tileSize)};
+  auto first{glm::ivec2(glm::floor(minTexCoord * tilesPerUnit))};
+  auto last{glm::ivec2(glm::floor(maxTexCoord * tilesPerUnit))};
+
+  // Texture coordinates repeat, so wider ranges cover every tile
+  for (const auto axis : iter::range(2)) {
+    if (last[axis] - first[axis] >= entry.tiles[axis]) {
+      first[axis] = 0;
+      last[axis] = entry.tiles[axis] - 1;
+    }
+  }
+
+  for (const auto y : iter::range(first.y, last.y + 1)) {
+    for (const auto x : iter::range(first.x, last.x + 1)) {
+      requestTile(level, {(x % entry.tiles.x + entry.tiles.x) % entry.tiles.x,
+                          (y % entry.tiles.y + entry.tiles.y) %
+                              entry.tiles.y});
+    }
+  }
+}
+
+// Requests a tile and its ancestors, which replace it until it is loaded.
+// Stops at the first tile already requested in this frame, as its ancestors
+// are requested too
+void abcg::VirtualTexture::requestTile(int level, glm::ivec2 tile) {
+  for (; level < static_cast<int>(m_levels.size()); ++level, tile /= 2) {
+    const auto index{getTileIndex(level, tile)};
+    auto& entry{m_tiles[index]};
+    if (entry.lastRequest == m_frame) return;
+    entry.lastRequest = m_frame;
+    m_requests.push_back(index);
+  }
+}
@@ -0,0 +1,187 @@
+/**
+ * @file abcg_virtualtexture.hpp
+ * @brief abcg::VirtualTexture header file.
+ *
+ * Declaration of abcg::VirtualTexture class and of the tiled texture format
+ * used to stream textures that do not fit in memory.
+ *
+ * This project is released under the MIT License.
+ */
+
+#ifndef ABCG_VIRTUALTEXTURE_HPP_
+#define ABCG_VIRTUALTEXTURE_HPP_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <glm/vec2.hpp>
+#include <glm/vec4.hpp>
+#include <gsl/gsl>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include "abcg_external.hpp"
+#include "abcg_image.hpp"
+#include "abcg_mappedfile.hpp"
+
+namespace abcg {
+class VirtualTexture;
+}  // namespace abcg
+
+/**
+ * @brief abcg::VirtualTexture class.
+ *
+ * Texture streamed in fixed-size tiles from a file written by store(), so
+ * that only the tiles seen from the camera are kept in GPU memory. The file
+ * holds a mipmap pyramid of RGBA tiles, each surrounded by a border of texels
+ * of its neighbors so that it can be sampled with bilinear filtering.
+ *
+ * Every frame, the tiles needed to draw the meshes that use the texture are
+ * requested with addFeedback(). update() then loads the missing tiles on
+ * background threads, uploads the loaded ones to free pages of the page
+ * texture, evicting the least recently used tiles, and refreshes the
+ * indirection texture. Finally, bind() sets up the program, whose fragment
+ * shader finds the page of each texel through the indirection texture.
+ * Tiles not loaded yet are replaced by their closest loaded ancestor, down
+ * to the coarsest level, which is always loaded.
+ *
+ * The page texture holds a number of pages proportional to the size of the
+ * viewport (see resize()), so its memory use does not depend on the size of
+ * the virtual texture. Only the indirection texture does, with 4 bytes per
+ * tile. All member functions other than store() must be called on the thread
+ * that owns the OpenGL context.
+ */
+class abcg::VirtualTexture {
+ public:
+  /** @brief Counters of the tile cache. */
+  struct Statistics {
+    /** @brief Number of tiles requested in the last frame. */
+    std::size_t requestedTiles{};
+    /** @brief Number of tiles stored in the page texture. */
+    std::size_t residentTiles{};
+    /** @brief Number of pages of the page texture. */
+    std::size_t pages{};
+    /** @brief Number of tiles being loaded. */
+    std::size_t pendingLoads{};
+    /** @brief Number of tiles uploaded so far. */
+    std::size_t uploads{};
+    /** @brief Number of tiles evicted to make room for others. */
+    std::size_t evictions{};
+  };
+
+  VirtualTexture() = default;
+  explicit VirtualTexture(std::string_view path);
+  ~VirtualTexture();
+
+  VirtualTexture(const VirtualTexture&) = delete;
+  VirtualTexture(VirtualTexture&&) = delete;
+  VirtualTexture& operator=(const VirtualTexture&) = delete;
+  VirtualTexture& operator=(VirtualTexture&&) = delete;
+
+  static void store(std::string_view path, Image image, int tileSize = 128,
+                    int border = 1);
+
+  void open(std::string_view path);
+  void close() noexcept;
+  void resize(int width, int height, float pagesPerScreen = 4.0f);
+
+  void addFeedback(gsl::span<const glm::vec4> clipPositions,
+                   gsl::span<const glm::vec2> texCoords,
+                   gsl::span<const std::uint32_t> indices,
+                   glm::ivec2 viewportSize, bool cullBackFacing = true);
+  void update();
+  void bind(GLuint program, GLint firstUnit = 1) const;
+
+  /** @brief Sets the number of tiles uploaded by each call to update(). */
+  void setMaxUploads(std::size_t maxUploads) noexcept {
+    m_maxUploads = maxUploads;
+  }
+  /** @brief Sets the number of tiles that are loaded at the same time. */
+  void setMaxPendingLoads(std::size_t maxPendingLoads) noexcept {
+    m_maxPendingLoads = maxPendingLoads;
+  }
+
+  [[nodiscard]] bool isOpen() const noexcept { return m_file.isOpen(); }
+  /** @brief Returns the size of the base level, in texels. */
+  [[nodiscard]] glm::ivec2 getSize() const noexcept { return m_size; }
+  [[nodiscard]] int getTileSize() const noexcept { return m_tileSize; }
+  [[nodiscard]] std::size_t getNumLevels() const noexcept {
+    return m_levels.size();
+  }
+  [[nodiscard]] const Statistics& getStatistics() const noexcept {
+    return m_statistics;
+  }
+
+ private:
+  // Tiles of a level, stored row by row from the bottom row, after the tiles
+  // of the finer levels
+  struct Level {
+    glm::ivec2 size{};
+    glm::ivec2 tiles{};
+    std::size_t firstTile{};
+  };
+
+  struct Tile {
+    int level{};
+    int page{-1};
+    std::uint64_t lastRequest{};
+    bool loading{};
+  };
+
+  struct Page {
+    std::size_t tile{};
+    bool used{};
+    // Last frame in which the tile was requested
+    std::uint64_t lastUse{};
+  };
+
+  struct Load {
+    std::size_t tile{};
+    std::future<std::vector<std::byte>> pixels;
+  };
+
+  MappedFile m_file;
+  glm::ivec2 m_size{};
+  int m_tileSize{};
+  int m_border{};
+  std::vector<Level> m_levels;
+  std::vector<Tile> m_tiles;
+  std::vector<std::size_t> m_requests;
+  std::vector<Load> m_loads;
+
+  std::vector<Page> m_pages;
+  int m_pagesPerRow{};
+  GLuint m_pageTexture{};
+
+  // Page and level of the tile that replaces each tile, in RGBA
+  std::vector<std::array<std::uint8_t, 4>> m_indirection;
+  GLuint m_indirectionTexture{};
+  // Number of levels, from the base level, to be refreshed
+  std::size_t m_dirtyLevels{};
+
+  std::uint64_t m_frame{1};
+  std::size_t m_maxUploads{16};
+  std::size_t m_maxPendingLoads{64};
+  Statistics m_statistics;
+
+  [[nodiscard]] int getPageSize() const noexcept {
+    return m_tileSize + 2 * m_border;
+  }
+  [[nodiscard]] gsl::span<const std::byte> getTilePixels(
+      std::size_t tile) const;
+  [[nodiscard]] std::size_t getTileIndex(int level, glm::ivec2 tile) const;
+  [[nodiscard]] std::optional<std::size_t> allocatePage();
+  void uploadTile(std::size_t tile, std::size_t page,
+                  gsl::span<const std::byte> pixels);
+  void refreshIndirection();
+  void requestTriangle(const std::array<glm::vec4, 3>& clipPositions,
+                       const std::array<glm::vec2, 3>& texCoords,
+                       glm::vec2 viewportSize, bool cullBackFacing,
+                       int depth);
+  void requestTiles(glm::vec2 minTexCoord, glm::vec2 maxTexCoord, int level);
+  void requestTile(int level, glm::ivec2 tile);
+};
+
+#endif
@@ -1,3 +1,102 @@
+option(ABCG_COMPILE_ASSETS "Compile meshes and images with abcg-assetc" ON)
+set(ABCG_ASSETC
+    ""
+    CACHE FILEPATH
+          "Path to a native abcg-assetc, used when it is not built along")
+
+# Compiles the meshes (.obj) and images (.png, .jpg) of the assets directory
+# of a project with abcg-assetc, so that the application loads them without
+# parsing or decoding. Each file is compiled again only when its source, a
+# material library next to it, or abcg-assetc itself changes.
+#
+# The compiled files are written to ${CMAKE_CURRENT_BINARY_DIR}/assets. When
+# INSTALL_DIR is given, each compiled file and its source are also copied to
+# it, so that an installed assets directory is refreshed without relinking.
+# MESH_OPTIONS are passed to "abcg-assetc mesh" (e.g. --no-standardize) and
+# TEXTURE_OPTIONS to "abcg-assetc texture" (e.g. --filter lanczos). They must
+# match how the project loads its models and textures, or the compiled files
+# are ignored at run time.
+#
+# Sets ${project_target}_COMPILED_ASSETS_DIR in the parent scope if any file
+# is compiled.
+function(abcg_compile_assets project_target)
+  cmake_parse_arguments(ARG "" "INSTALL_DIR" "MESH_OPTIONS;TEXTURE_OPTIONS"
+                        ${ARGN})
+
+  set(assets_dir ${CMAKE_CURRENT_SOURCE_DIR}/assets)
+  set(compiled_dir ${CMAKE_CURRENT_BINARY_DIR}/assets)
+  if(NOT ABCG_COMPILE_ASSETS OR NOT EXISTS ${assets_dir})
+    return()
+  endif()
+
+  if(TARGET abcg-assetc)
+    set(assetc abcg-assetc)
+  elseif(ABCG_ASSETC)
+    set(assetc ${ABCG_ASSETC})
+  else()
+    return()
+  endif()
+
+  if(CMAKE_VERSION VERSION_GREATER_EQUAL 3.12)
+    set(glob_options CONFIGURE_DEPENDS)
+  endif()
+  file(
+    GLOB_RECURSE meshes ${glob_options}
+    RELATIVE ${assets_dir}
+    ${assets_dir}/*.obj)
+  file(
+    GLOB_RECURSE images ${glob_options}
+    RELATIVE ${assets_dir}
+    ${assets_dir}/*.png ${assets_dir}/*.jpg ${assets_dir}/*.jpeg)
+
+  set(outputs "")
+  foreach(asset ${meshes} ${images})
+    set(source ${assets_dir}/${asset})
+    list(FIND meshes ${asset} mesh_index)
+    if(mesh_index GREATER -1)
+      # Materials are stored in the compiled mesh
+      get_filename_component(source_dir ${source} DIRECTORY)
+      file(GLOB dependencies ${source_dir}/*.mtl)
+      set(output ${compiled_dir}/${asset}.abcgmesh)
+      set(arguments mesh ${source} ${output} ${ARG_MESH_OPTIONS})
+    else()
+      set(dependencies "")
+      set(output ${compiled_dir}/${asset}.abcgtex)
+      set(arguments texture ${source} ${output} ${ARG_TEXTURE_OPTIONS})
+    endif()
+
+    get_filename_component(output_name ${output} NAME)
+    set(install_commands "")
+    if(ARG_INSTALL_DIR)
+      get_filename_component(install_dir ${ARG_INSTALL_DIR}/${asset} DIRECTORY)
+      set(install_commands
+          COMMAND ${CMAKE_COMMAND} -E copy ${source} ${ARG_INSTALL_DIR}/${asset}
+          COMMAND ${CMAKE_COMMAND} -E copy ${output}
+                  ${install_dir}/${output_name})
+    endif()
+
+    get_filename_component(output_dir ${output} DIRECTORY)
+    add_custom_command(
+      OUTPUT ${output}
+      COMMAND ${CMAKE_COMMAND} -E make_directory ${output_dir}
+      COMMAND ${assetc} ${arguments} ${install_commands}
+      DEPENDS ${source} ${dependencies} ${assetc}
+      COMMENT "Compiling asset ${asset}"
+      VERBATIM)
+    list(APPEND outputs ${output})
+  endforeach()
+
+  if(outputs)
+    add_custom_target(${project_target}_assets DEPENDS ${outputs})
+    add_dependencies(${project_target} ${project_target}_assets)
+    set(${project_target}_COMPILED_ASSETS_DIR
+        ${compiled_dir}
+        PARENT_SCOPE)
+  endif()
+endfunction()
+
+# Sets up a project that uses ABCg. Arguments after the target name are
+# forwarded to abcg_compile_assets.
 function(enable_abcg project_target)
 
   target_link_libraries(${project_target} PUBLIC abcg)
@@ -32,6 +131,13 @@ function(enable_abcg project_target)
     if(EXISTS ${CMAKE_CURRENT_SOURCE_DIR}/assets)
       list(APPEND LINK_FLAGS
            "--preload-file ${CMAKE_CURRENT_SOURCE_DIR}/assets@/assets")
+
+      # Compiled assets are packaged next to their sources
+      abcg_compile_assets(${project_target} ${ARGN})
+      if(${project_target}_COMPILED_ASSETS_DIR)
+        list(APPEND LINK_FLAGS
+             "--preload-file ${${project_target}_COMPILED_ASSETS_DIR}@/assets")
+      endif()
     endif()
     string(REPLACE ";" " " LINK_FLAGS "${LINK_FLAGS}")
 
@@ -87,6 +193,19 @@ function(enable_abcg project_target)
           # Copy assets directory to ${project_target}.dir
           ${CMAKE_COMMAND} -E copy_directory ${CMAKE_CURRENT_SOURCE_DIR}/assets
           ${output_dir}/${project_target}.dir/assets)
+
+      # Copy compiled assets next to their sources
+      abcg_compile_assets(${project_target} INSTALL_DIR
+                          ${output_dir}/${project_target}/assets ${ARGN})
+      if(${project_target}_COMPILED_ASSETS_DIR)
+        add_custom_command(
+          TARGET ${project_target}
+          POST_BUILD
+          COMMAND
+            ${CMAKE_COMMAND} -E copy_directory
+            ${${project_target}_COMPILED_ASSETS_DIR}
+            ${output_dir}/${project_target}.dir/assets)
+      endif()
     endif()
 
     add_custom_command(
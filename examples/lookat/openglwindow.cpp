@@ -7,7 +7,6 @@
 #include <cppitertools/itertools.hpp>
 #include <glm/gtx/fast_trigonometry.hpp>
 #include <glm/gtx/hash.hpp>
-#include <unordered_map>
 
 // Custom specialization of std::hash injected in namespace std
 namespace std {
@@ -100,33 +99,27 @@ void OpenGLWindow::initializeGL() {
 }
 
 void OpenGLWindow::loadModelFromFile(std::string_view path) {
-  tinyobj::ObjReaderConfig readerConfig;
-  readerConfig.mtl_search_path =
-      getAssetsPath() + "mtl/";  // Path to material files
+  abcg::ObjReader reader;
+  reader.parseFromFile(path,
+                       getAssetsPath() + "mtl/");  // Path to material files
 
-  tinyobj::ObjReader reader;
-
-  if (!reader.ParseFromFile(path.data(), readerConfig)) {
-    if (!reader.Error().empty()) {
-      throw abcg::Exception{abcg::Exception::Runtime(
-          fmt::format("Failed to load model {} ({})", path, reader.Error()))};
-    }
-    throw abcg::Exception{
-        abcg::Exception::Runtime(fmt::format("Failed to load model {}", path))};
-  }
-
-  if (!reader.Warning().empty()) {
-    fmt::print("Warning: {}\n", reader.Warning());
+  if (!reader.getWarning().empty()) {
+    fmt::print("Warning: {}\n", reader.getWarning());
   }
 
-  const auto& attrib{reader.GetAttrib()};
-  const auto& shapes{reader.GetShapes()};
+  const auto& attrib{reader.getAttrib()};
+  const auto& shapes{reader.getShapes()};
 
   m_vertices.clear();
   m_indices.clear();
 
-  // A key:value map with key=Vertex and value=index
-  std::unordered_map<Vertex, GLuint> hash{};
+  // Count the indices to size the vertex deduplication table
+  std::size_t numIndices{};
+  for (const auto& shape : shapes) {
+    numIndices += shape.mesh.indices.size();
+  }
+  m_indices.reserve(numIndices);
+  abcg::VertexWelder<Vertex> welder{m_vertices, numIndices};
 
   // Loop over shapes
   for (const auto& shape : shapes) {
@@ -151,15 +144,8 @@ void OpenGLWindow::loadModelFromFile(std::string_view path) {
         Vertex vertex{};
         vertex.position = {vx, vy, vz};
 
-        // If uniqueVertices doesn't contain this vertex
-        if (hash.count(vertex) == 0) {
-          // Add this index (size of m_vertices)
-          hash[vertex] = m_vertices.size();
-          // Add this vertex
-          m_vertices.push_back(vertex);
-        }
-
-        m_indices.push_back(hash[vertex]);
+        // Add the vertex if it is new and get its index
+        m_indices.push_back(welder.insert(vertex));
       }
       indexOffset += numFaceVertices;
     }
@@ -17,12 +17,53 @@ uniform float shininess;
 // Diffuse texture sampler
 uniform sampler2D diffuseTex;
 
+// Virtual texture used instead of diffuseTex (see abcg::VirtualTexture)
+uniform bool virtualTexture;
+uniform sampler2D vtPages;
+uniform sampler2D vtIndirection;
+uniform vec4 vtParams;  // Base level size, tile size and border
+uniform float vtMaxLevel;
+
+// Cloud coverage drawn over the diffuse map, updated every frame
+uniform bool clouds;
+uniform sampler2D cloudTex;
+
 // Mapping mode
 // 0: triplanar; 1: cylindrical; 2: spherical; 3: from mesh
 uniform int mappingMode;
 
 out vec4 outColor;
 
+// Samples a level of the virtual texture from the page of the tile under uv,
+// or of the loaded ancestor that replaces it
+vec4 SampleVirtualLevel(vec2 uv, int level) {
+  float tileSize = vtParams.z;
+  vec2 levelSize = max(floor(vtParams.xy / exp2(float(level))), 1.0);
+  ivec2 tile = min(ivec2(uv * levelSize / tileSize),
+                   ivec2(ceil(levelSize / tileSize)) - 1);
+  vec4 entry = floor(texelFetch(vtIndirection, tile, level) * 255.0 + 0.5);
+
+  vec2 entrySize = max(floor(vtParams.xy / exp2(entry.b)), 1.0);
+  vec2 texel = mod(uv * entrySize, tileSize);
+  vec2 page = entry.rg * (tileSize + 2.0 * vtParams.w) + vtParams.w + texel;
+  return textureLod(vtPages, page / vec2(textureSize(vtPages, 0)), 0.0);
+}
+
+// Blends the two levels around the level of detail chosen as in mipmapping
+vec4 SampleVirtual(vec2 texCoord) {
+  vec2 texel = texCoord * vtParams.xy;
+  float lod = log2(max(length(dFdx(texel)), length(dFdy(texel))));
+  lod = clamp(lod, 0.0, vtMaxLevel);
+
+  vec2 uv = fract(texCoord);
+  int level = int(lod);
+  vec4 color = SampleVirtualLevel(uv, level);
+  if (float(level) < vtMaxLevel) {
+    color = mix(color, SampleVirtualLevel(uv, level + 1), lod - float(level));
+  }
+  return color;
+}
+
 // Blinn-Phong reflection model
 vec4 BlinnPhong(vec3 N, vec3 L, vec3 V, vec2 texCoord) {
   N = normalize(N);
@@ -40,7 +81,9 @@ vec4 BlinnPhong(vec3 N, vec3 L, vec3 V, vec2 texCoord) {
     specular = pow(angle, shininess);
   }
 
-  vec4 map_Kd = texture(diffuseTex, texCoord);
+  vec4 map_Kd = virtualTexture ? SampleVirtual(texCoord)
+                               : texture(diffuseTex, texCoord);
+  if (clouds) map_Kd = mix(map_Kd, vec4(1.0), texture(cloudTex, texCoord).r);
   vec4 map_Ka = map_Kd;
 
   vec4 diffuseColor = map_Kd * Kd * Id * lambertian;
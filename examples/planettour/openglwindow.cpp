@@ -1,13 +1,85 @@
 #include "openglwindow.hpp"
 
+#include <fmt/core.h>
 #include <imgui.h>
 
+#include <chrono>
 #include <cppitertools/itertools.hpp>
+#include <cstdint>
+#include <filesystem>
+#include <glm/common.hpp>
 #include <glm/gtc/matrix_inverse.hpp>
 
 #include "imfilebrowser.h"
 #include "model.hpp"
 
+namespace {
+// Size of the cloud layer, which wraps around the planet in longitude
+constexpr glm::ivec2 cloudSize{512, 256};
+constexpr int cloudOctaves{4};
+// Seconds between the starts of two cloud generations. The clouds drift about
+// a texel per update, and the single worker of the background pool is left
+// free for asset loads most of the time
+constexpr double cloudInterval{0.1};
+
+// Pseudorandom value in [0, 1] of a lattice point of an octave
+float hashLattice(int x, int y, int octave) {
+  auto hash{static_cast<std::uint32_t>(x) * 374761393U +
+            static_cast<std::uint32_t>(y) * 668265263U +
+            static_cast<std::uint32_t>(octave) * 2246822519U};
+  hash = (hash ^ (hash >> 13U)) * 1274126177U;
+  return static_cast<float>((hash ^ (hash >> 16U)) & 0xFFFFU) / 65535.0f;
+}
+
+// Value noise on a lattice that repeats every period cells in x, so that the
+// clouds have no seam
+float valueNoise(glm::vec2 position, int period, int octave) {
+  const auto cell{glm::floor(position)};
+  auto fraction{position - cell};
+  fraction = fraction * fraction * (3.0f - 2.0f * fraction);
+  const auto x0{(static_cast<int>(cell.x) % period + period) % period};
+  const auto x1{(x0 + 1) % period};
+  const auto y{static_cast<int>(cell.y)};
+  const auto bottom{glm::mix(hashLattice(x0, y, octave),
+                             hashLattice(x1, y, octave), fraction.x)};
+  const auto top{glm::mix(hashLattice(x0, y + 1, octave),
+                          hashLattice(x1, y + 1, octave), fraction.x)};
+  return glm::mix(bottom, top, fraction.y);
+}
+
+// Generates the cloud coverage at a given time, as GL_RED texels. Each
+// octave drifts at its own speed, so the clouds change shape as they move
+std::vector<std::byte> generateClouds(float time) {
+  std::vector<std::byte> pixels(
+      static_cast<std::size_t>(cloudSize.x * cloudSize.y));
+  abcg::ThreadPool::getDefault().parallelFor(
+      static_cast<std::size_t>(cloudSize.y), [&](std::size_t row) {
+        const auto v{(static_cast<float>(row) + 0.5f) /
+                     static_cast<float>(cloudSize.y)};
+        for (const auto column : iter::range(cloudSize.x)) {
+          const auto u{(static_cast<float>(column) + 0.5f) /
+                       static_cast<float>(cloudSize.x)};
+          auto noise{0.0f};
+          auto amplitude{0.5f};
+          for (const auto octave : iter::range(cloudOctaves)) {
+            const auto period{8 << octave};
+            const auto speed{0.2f + 0.15f * static_cast<float>(octave)};
+            noise += amplitude *
+                     valueNoise({u * static_cast<float>(period) + time * speed,
+                                 v * static_cast<float>(period / 2)},
+                                period, octave);
+            amplitude *= 0.5f;
+          }
+          const auto coverage{glm::smoothstep(0.4f, 0.7f, noise)};
+          pixels[row * static_cast<std::size_t>(cloudSize.x) +
+                 static_cast<std::size_t>(column)] =
+              static_cast<std::byte>(coverage * 255.0f);
+        }
+      });
+  return pixels;
+}
+}  // namespace
+
 
 void OpenGLWindow::handleEvent(SDL_Event& event) {
   glm::ivec2 mousePosition;
@@ -51,7 +123,20 @@ void OpenGLWindow::initializeGL() {
   auto program{createProgramFromFile(path + ".vert", path + ".frag")};
   m_program = program;
 
+  m_textureStreamer.setPixelUnpackRing(&m_pixelUnpackRing);
+  showAssetStatistics(&m_assets);
   loadAllModels();
+
+  // Maps larger than the GPU memory allows, e.g. 16K or 32K maps, are tiled
+  // offline with abcg-assetc vtexture
+  if (const auto path{getAssetsPath() + "textures/mars.abcgvt"};
+      std::filesystem::exists(path)) {
+    m_marsTexture = std::make_unique<abcg::VirtualTexture>(path);
+  }
+
+  // Immutable storage, updated every frame through the ring
+  m_cloudTexture = abcg::opengl::createTextureStorage(cloudSize.x,
+                                                      cloudSize.y, 1, GL_R8);
   // Load default model
   //loadModel(getAssetsPath() + "Mars 2K.obj");
   //m_mappingMode = 3;  // "From mesh" option
@@ -63,31 +148,64 @@ void OpenGLWindow::initializeGL() {
 }
 
 void OpenGLWindow::loadAllModels() {
-  setSatellites[0].m_model.loadFromFile(getAssetsPath() + "satellite.obj");
-  setSatellites[0].m_model.loadDiffuseTexture(getAssetsPath() + "textures/satellite.jpg");
-  setSatellites[0].m_model.setupVAO(m_program);
-  setSatellites[0].m_trianglesToDraw = setSatellites[0].m_model.getNumTriangles();
+  setSatellites[0].m_model = loadModel(getAssetsPath() + "satellite.obj", getAssetsPath() + "textures/satellite.jpg");
+  setSatellites[0].m_trianglesToDraw = setSatellites[0].m_model->getNumTriangles();
 
+  // Second instance of the satellite: shares the buffers and texture of the first one
+  setSatellites[1].m_model = loadModel(getAssetsPath() + "satellite.obj", getAssetsPath() + "textures/satellite.jpg");
+  setSatellites[1].m_trianglesToDraw = setSatellites[1].m_model->getNumTriangles();
 
-  setPlanets[0].m_model.loadFromFile(getAssetsPath() + "mars.obj");
-  setPlanets[0].m_model.loadDiffuseTexture(getAssetsPath() + "textures/mars.png");
-  setPlanets[0].m_model.setupVAO(m_program);
-  setPlanets[0].m_trianglesToDraw = setPlanets[0].m_model.getNumTriangles();
+  setPlanets[0].m_model = loadModel(getAssetsPath() + "mars.obj", getAssetsPath() + "textures/mars.png");
+  setPlanets[0].m_trianglesToDraw = setPlanets[0].m_model->getNumTriangles();
 
-  setPlanets[1].m_model.loadFromFile(getAssetsPath() + "moon.obj");
-  setPlanets[1].m_model.loadDiffuseTexture(getAssetsPath() + "textures/moon.png");
-  setPlanets[1].m_model.setupVAO(m_program);
-  setPlanets[1].m_trianglesToDraw = setPlanets[1].m_model.getNumTriangles();
+  setPlanets[1].m_model = loadModel(getAssetsPath() + "moon.obj", getAssetsPath() + "textures/moon.png");
+  setPlanets[1].m_trianglesToDraw = setPlanets[1].m_model->getNumTriangles();
   // Use material properties from the loaded model
-  m_Ka = setPlanets[0].m_model.getKa();
-  m_Kd = setPlanets[0].m_model.getKd();
-  m_Ks = setPlanets[0].m_model.getKs();
+  m_Ka = setPlanets[0].m_model->getKa();
+  m_Kd = setPlanets[0].m_model->getKd();
+  m_Ks = setPlanets[0].m_model->getKs();
   m_shininess = 5.0f;
 }
 
+// Models are keyed on both paths, as the texture is stored in the model. The
+// texture itself is shared by every model that uses it. Its mipmaps are
+// filtered on the CPU, as the planet textures are minified at most distances.
+// A block-compressed KTX2 copy of the texture is used instead, if installed.
+// Textures are streamed, so the models are drawn before their textures are
+// fully decoded
+std::shared_ptr<Model> OpenGLWindow::loadModel(std::string_view path,
+                                               std::string_view texturePath) {
+  return m_assets.load<Model>(
+      path, std::hash<std::string_view>{}(texturePath), [&] {
+        auto model{std::make_shared<Model>()};
+        model->loadFromFile(path);
+        const auto compressedPath{std::filesystem::path{texturePath}
+                                      .replace_extension(".ktx2")
+                                      .string()};
+        if (std::filesystem::exists(compressedPath)) {
+          model->setDiffuseTexture(
+              m_assets.loadTexture(compressedPath, m_textureStreamer,
+                                   abcg::MipmapFilter::Lanczos, true));
+        } else if (std::filesystem::exists(texturePath)) {
+          model->setDiffuseTexture(
+              m_assets.loadTexture(texturePath, m_textureStreamer,
+                                   abcg::MipmapFilter::Lanczos, true));
+        }
+        model->setupVAO(m_program);
+        return model;
+      });
+}
+
 
 void OpenGLWindow::paintGL() {
   update();
+  updateClouds();
+
+  try {
+    m_textureStreamer.process(m_uploadBudget);
+  } catch (const abcg::Exception& exception) {
+    fmt::print(stderr, "{}\n", exception.what());
+  }
 
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
   glViewport(0, 0, m_viewportWidth, m_viewportHeight);
@@ -112,6 +230,9 @@ void OpenGLWindow::paintGL() {
   GLint diffuseTexLoc{glGetUniformLocation(m_program, "diffuseTex")};
   GLint normalTexLoc{glGetUniformLocation(m_program, "normalTex")};
   GLint mappingModeLoc{glGetUniformLocation(m_program, "mappingMode")};
+  GLint virtualTextureLoc{glGetUniformLocation(m_program, "virtualTexture")};
+  GLint cloudTexLoc{glGetUniformLocation(m_program, "cloudTex")};
+  GLint cloudsLoc{glGetUniformLocation(m_program, "clouds")};
 
   // Set uniform variables used by every scene object
   glUniformMatrix4fv(viewMatrixLoc, 1, GL_FALSE, &m_viewMatrix[0][0]);
@@ -126,6 +247,7 @@ void OpenGLWindow::paintGL() {
 
   glUniform1i(diffuseTexLoc, 0);
   glUniform1i(normalTexLoc, 1);
+  glUniform1i(cloudTexLoc, 3);
   glUniform1i(mappingModeLoc, 3);
 
   glUniform4fv(lightDirLoc, 1, &m_lightDir.x);
@@ -153,7 +275,26 @@ void OpenGLWindow::paintGL() {
   glm::mat3 normalMatrix{glm::inverseTranspose(modelViewMatrix)};
   glUniformMatrix3fv(normalMatrixLoc, 1, GL_FALSE, &normalMatrix[0][0]);
 
-  setPlanets[0].m_model.render(setPlanets[0].m_trianglesToDraw);
+  auto lod{setPlanets[0].m_model->selectLOD(setPlanets[0].m_modelMatrix, m_camera.m_viewMatrix, m_camera.m_projMatrix, m_viewportHeight)};
+  setPlanets[0].m_model->cullClusters(setPlanets[0].m_modelMatrix, m_camera.m_viewMatrix, m_camera.m_projMatrix);
+  if (m_marsTexture) {
+    // Streams the tiles seen in this frame before drawing with them
+    setPlanets[0].m_model->requestVirtualTiles(
+        *m_marsTexture, setPlanets[0].m_modelMatrix, m_camera.m_viewMatrix,
+        m_camera.m_projMatrix, {m_viewportWidth, m_viewportHeight});
+    m_marsTexture->update();
+    m_marsTexture->bind(m_program);
+    glUniform1i(virtualTextureLoc, 1);
+  }
+  if (m_hasClouds) {
+    glActiveTexture(GL_TEXTURE3);
+    glBindTexture(GL_TEXTURE_2D, m_cloudTexture);
+    glActiveTexture(GL_TEXTURE0);
+    glUniform1i(cloudsLoc, 1);
+  }
+  setPlanets[0].m_model->render(setPlanets[0].m_trianglesToDraw, lod);
+  glUniform1i(virtualTextureLoc, 0);
+  glUniform1i(cloudsLoc, 0);
 
 
   glUniform1f(shininessLoc, m_shininess);
@@ -171,7 +312,9 @@ void OpenGLWindow::paintGL() {
   normalMatrix = glm::inverseTranspose(modelViewMatrix);
   glUniformMatrix3fv(normalMatrixLoc, 1, GL_FALSE, &normalMatrix[0][0]);
 
-  setPlanets[1].m_model.render(setPlanets[1].m_trianglesToDraw);
+  lod = setPlanets[1].m_model->selectLOD(setPlanets[1].m_modelMatrix, m_camera.m_viewMatrix, m_camera.m_projMatrix, m_viewportHeight);
+  setPlanets[1].m_model->cullClusters(setPlanets[1].m_modelMatrix, m_camera.m_viewMatrix, m_camera.m_projMatrix);
+  setPlanets[1].m_model->render(setPlanets[1].m_trianglesToDraw, lod);
 
 
   //Satelite
@@ -185,7 +328,26 @@ void OpenGLWindow::paintGL() {
   normalMatrix = glm::inverseTranspose(modelViewMatrix);
   glUniformMatrix3fv(normalMatrixLoc, 1, GL_FALSE, &normalMatrix[0][0]);
 
-  setSatellites[0].m_model.render(setSatellites[0].m_trianglesToDraw);
+  lod = setSatellites[0].m_model->selectLOD(setSatellites[0].m_modelMatrix, m_camera.m_viewMatrix, m_camera.m_projMatrix, m_viewportHeight);
+  setSatellites[0].m_model->cullClusters(setSatellites[0].m_modelMatrix, m_camera.m_viewMatrix, m_camera.m_projMatrix);
+  setSatellites[0].m_model->render(setSatellites[0].m_trianglesToDraw, lod);
+
+
+  // Second satellite, drawn from the same buffers as the first one. Clusters
+  // are culled again for its own model matrix
+  setSatellites[1].m_modelMatrix = glm::mat4(1.0);
+  setSatellites[1].m_modelMatrix = glm::translate(setSatellites[1].m_modelMatrix, glm::vec3(-1.2f, 0.3f, 0.4f));
+  setSatellites[1].m_modelMatrix = glm::rotate(setSatellites[1].m_modelMatrix, glm::radians(-0.015f * n_frame), glm::vec3(0, 1, 0));
+  setSatellites[1].m_modelMatrix = glm::scale(setSatellites[1].m_modelMatrix, glm::vec3(0.06f));
+  glUniformMatrix4fv(modelMatrixLoc, 1, GL_FALSE, &setSatellites[1].m_modelMatrix[0][0]);
+
+  modelViewMatrix = glm::mat3(m_camera.m_viewMatrix * setSatellites[1].m_modelMatrix);
+  normalMatrix = glm::inverseTranspose(modelViewMatrix);
+  glUniformMatrix3fv(normalMatrixLoc, 1, GL_FALSE, &normalMatrix[0][0]);
+
+  lod = setSatellites[1].m_model->selectLOD(setSatellites[1].m_modelMatrix, m_camera.m_viewMatrix, m_camera.m_projMatrix, m_viewportHeight);
+  setSatellites[1].m_model->cullClusters(setSatellites[1].m_modelMatrix, m_camera.m_viewMatrix, m_camera.m_projMatrix);
+  setSatellites[1].m_model->render(setSatellites[1].m_trianglesToDraw, lod);
 
 
   //ednd
@@ -208,12 +370,22 @@ void OpenGLWindow::resizeGL(int width, int height) {
   m_viewportWidth = width;
   m_viewportHeight = height;
   m_camera.computeProjectionMatrix(width, height);
+  if (m_marsTexture) m_marsTexture->resize(width, height);
 
 }
 
 void OpenGLWindow::terminateGL() {
   glDeleteProgram(m_program);
 
+  // Release the models while the OpenGL context exists
+  for (auto& planet : setPlanets) planet.m_model.reset();
+  for (auto& satellite : setSatellites) satellite.m_model.reset();
+  m_textureStreamer.clear();
+  m_assets.clear();
+  m_marsTexture.reset();
+  glDeleteTextures(1, &m_cloudTexture);
+  m_pixelUnpackRing.clear();
+
 }
 
 void OpenGLWindow::update() {
@@ -223,4 +395,27 @@ void OpenGLWindow::update() {
   m_camera.pan(m_panSpeed * deltaTime);
   //m_camera.lift(m_liftSpeed * deltaTime);
 
-}
\ No newline at end of file
+}
+
+// Uploads the clouds generated since the last frame, if any, and starts
+// generating the next ones when they are due. Neither the generation nor the
+// GPU is waited for: an update of the clouds is skipped instead
+void OpenGLWindow::updateClouds() {
+  if (m_cloudPixels.valid() &&
+      m_cloudPixels.wait_for(std::chrono::seconds{0}) ==
+          std::future_status::ready) {
+    const auto pixels{m_cloudPixels.get()};
+    if (m_pixelUnpackRing.upload(m_cloudTexture, 0, {0, 0}, cloudSize,
+                                 GL_RED, pixels)) {
+      m_hasClouds = true;
+    }
+  }
+  const auto elapsedTime{getElapsedTime()};
+  if (!m_cloudPixels.valid() && elapsedTime >= m_nextCloudTime) {
+    m_nextCloudTime = elapsedTime + cloudInterval;
+    m_cloudPixels = abcg::ThreadPool::getBackground().submit(
+        [time = static_cast<float>(elapsedTime)] {
+          return generateClouds(time);
+        });
+  }
+}
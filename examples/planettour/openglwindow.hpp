@@ -1,7 +1,11 @@
 #ifndef OPENGLWINDOW_HPP_
 #define OPENGLWINDOW_HPP_
 
+#include <cstddef>
+#include <future>
+#include <memory>
 #include <string_view>
+#include <vector>
 
 #include "abcg.hpp"
 #include "model.hpp"
@@ -19,17 +23,37 @@ class OpenGLWindow : public abcg::OpenGLWindow {
  private:
  struct Planet
   {
-    Model m_model;
+    std::shared_ptr<Model> m_model;
     int m_trianglesToDraw{};
     glm::mat4 m_modelMatrix{1.0f};
   };
   struct Satellite
   {
-    Model m_model;
+    std::shared_ptr<Model> m_model;
     int m_trianglesToDraw{};
     glm::mat4 m_modelMatrix{1.0f};
   };
 
+  // Meshes and textures shared by the planets and satellites
+  abcg::AssetManager m_assets;
+  // Staging buffers of the texture uploads, so that paintGL never waits for
+  // the driver to copy texels
+  abcg::PixelUnpackRing m_pixelUnpackRing;
+  // Uploads the larger mipmap levels of the textures over several frames
+  abcg::TextureStreamer m_textureStreamer;
+  std::size_t m_uploadBudget{4 * 1024 * 1024};  // Bytes per frame
+
+  // Mars map streamed in tiles, used instead of textures/mars.png if
+  // textures/mars.abcgvt is installed
+  std::unique_ptr<abcg::VirtualTexture> m_marsTexture;
+
+  // Cloud layer of Mars, generated in the background and uploaded a few
+  // times per second
+  GLuint m_cloudTexture{};
+  std::future<std::vector<std::byte>> m_cloudPixels;
+  double m_nextCloudTime{};
+  bool m_hasClouds{};
+
   Planet setPlanets[2];
 
   Satellite setSatellites[2];
@@ -75,7 +99,10 @@ class OpenGLWindow : public abcg::OpenGLWindow {
   float m_shininess{};
 
   void loadAllModels();
+  [[nodiscard]] std::shared_ptr<Model> loadModel(std::string_view path,
+                                                 std::string_view texturePath);
   void update();
+  void updateClouds();
 };
 
 #endif
\ No newline at end of file
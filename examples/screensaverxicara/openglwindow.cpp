@@ -4,10 +4,10 @@
 #include <imgui.h>
 #include <tiny_obj_loader.h>
 
+#include <algorithm>
 #include <cppitertools/itertools.hpp>
 #include <glm/gtx/fast_trigonometry.hpp>
 #include <glm/gtx/hash.hpp>
-#include <unordered_map>
 
 // Custom specialization of std::hash injected in namespace std
 namespace std {
@@ -30,25 +30,10 @@ void OpenGLWindow::initializeGL() {
   m_program = createProgramFromFile(getAssetsPath() + "loadmodel.vert",
                                     getAssetsPath() + "loadmodel.frag");
 
-  // Load model
-  loadModelFromFile(getAssetsPath() + "xicara.obj");
-  standardize();
-
-  m_verticesToDraw = m_indices.size();
-
-  // Generate VBO
+  // Generate VBO and EBO. Their storage is allocated once the size of the
+  // mesh is known
   glGenBuffers(1, &m_VBO);
-  glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(m_vertices[0]) * m_vertices.size(),
-               m_vertices.data(), GL_STATIC_DRAW);
-  glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-  // Generate EBO
   glGenBuffers(1, &m_EBO);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_EBO);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(m_indices[0]) * m_indices.size(),
-               m_indices.data(), GL_STATIC_DRAW);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 
   // Create VAO
   glGenVertexArrays(1, &m_VAO);
@@ -67,37 +52,158 @@ void OpenGLWindow::initializeGL() {
 
   // End of binding to current VAO
   glBindVertexArray(0);
+
+  // Stream the progressive mesh if it is up to date, so that the base mesh is
+  // drawn on the first frame. Otherwise, build it in the background
+  const auto path{getAssetsPath() + "xicara.obj"};
+  // Option bit 2 marks meshes reordered by optimize()
+  const auto key{abcg::MeshCache::computeKey(path, 2U)};
+  const auto streamPath{abcg::ProgressiveMeshStream::getPath(path)};
+  if (m_meshStream.open(streamPath, key, sizeof(Vertex))) {
+    allocateBuffers(m_meshStream.getVertexCount(),
+                    m_meshStream.getIndexCount());
+    streamMesh();
+    return;
+  }
+
+  // m_vertices and m_indices are only used by this task
+  m_building = abcg::loadAsync([this, path, key, streamPath](
+                                   abcg::LoadProgress& progress) {
+    progress.setStage("Loading", 0.0f);
+    loadModelFromFile(path);
+    progress.throwIfCancelled();
+    standardize();
+
+    progress.setStage("Building progressive mesh", 0.5f);
+    auto batches{abcg::buildProgressiveMesh<Vertex>(m_vertices, m_indices)};
+    m_vertices.clear();
+    m_indices.clear();
+    // Do not store the batches once the window is closing
+    progress.throwIfCancelled();
+
+    // Store the batches so that the next launch streams them from disk
+    try {
+      abcg::ProgressiveMeshStream::store(streamPath, key,
+                                         {.batches = batches,
+                                          .vertexStride = sizeof(Vertex),
+                                          .bounds = m_bounds});
+    } catch (const abcg::Exception& exception) {
+      fmt::print("Warning: {}\n", exception.what());
+    }
+    return batches;
+  });
 }
 
+void OpenGLWindow::allocateBuffers(std::size_t vertexCount,
+                                   std::size_t indexCount) {
+  glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
+  glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(Vertex), nullptr,
+               GL_STATIC_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-void OpenGLWindow::loadModelFromFile(std::string_view path) {
-  tinyobj::ObjReaderConfig readerConfig;
-  readerConfig.mtl_search_path =
-      getAssetsPath() + "mtl/";  // Path to material files
+  // The EBO is bound to the VAO
+  glBindVertexArray(m_VAO);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(GLuint), nullptr,
+               GL_STATIC_DRAW);
+  glBindVertexArray(0);
+}
+
+// Appends the next refinement batch, if any, to the buffers
+void OpenGLWindow::streamMesh() {
+  if (m_building.isReady()) {
+    try {
+      auto batches{m_building.get()};
+      std::size_t vertexCount{};
+      std::size_t indexCount{};
+      for (auto& batch : batches) {
+        vertexCount += batch.vertices.size() / sizeof(Vertex);
+        indexCount += batch.indices.size();
+        m_builtBatches.push_back(std::move(batch));
+      }
+      allocateBuffers(vertexCount, indexCount);
+    } catch (const abcg::Exception& exception) {
+      fmt::print(stderr, "{}\n", exception.what());
+    }
+  }
 
-  tinyobj::ObjReader reader;
+  if (!m_builtBatches.empty()) {
+    appendBatch(m_builtBatches.front());
+    m_builtBatches.pop_front();
+    return;
+  }
 
-  if (!reader.ParseFromFile(path.data(), readerConfig)) {
-    if (!reader.Error().empty()) {
-      throw abcg::Exception{abcg::Exception::Runtime(
-          fmt::format("Failed to load model {} ({})", path, reader.Error()))};
+  if (!m_meshStream.isOpen()) return;
+  try {
+    if (abcg::ProgressiveMeshBatch batch; m_meshStream.readBatch(batch)) {
+      appendBatch(batch);
+    } else {
+      m_meshStream.close();
     }
-    throw abcg::Exception{
-        abcg::Exception::Runtime(fmt::format("Failed to load model {}", path))};
+  } catch (const abcg::Exception& exception) {
+    fmt::print(stderr, "{}\n", exception.what());
+    m_meshStream.close();
   }
+}
+
+void OpenGLWindow::appendBatch(const abcg::ProgressiveMeshBatch& batch) {
+  glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
+  glBufferSubData(GL_ARRAY_BUFFER, m_vertexOffset * sizeof(Vertex),
+                  batch.vertices.size(), batch.vertices.data());
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-  if (!reader.Warning().empty()) {
-    fmt::print("Warning: {}\n", reader.Warning());
+  glBindVertexArray(m_VAO);
+  glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, m_indexOffset * sizeof(GLuint),
+                  batch.indices.size() * sizeof(GLuint), batch.indices.data());
+  glBindVertexArray(0);
+
+  // Draw the new level from now on, keeping the fraction of the cup revealed
+  const auto previousTriangles{m_levelIndexCount / 3};
+  m_levelOffset = m_indexOffset;
+  m_levelIndexCount = batch.indices.size();
+  m_vertexOffset += batch.vertices.size() / sizeof(Vertex);
+  m_indexOffset += batch.indices.size();
+  m_verticesToDraw = static_cast<int>(m_levelIndexCount);
+  if (previousTriangles > 0) {
+    n_trig = n_trig * (m_levelIndexCount / 3) / previousTriangles;
   }
+}
 
-  const auto& attrib{reader.GetAttrib()};
-  const auto& shapes{reader.GetShapes()};
 
+void OpenGLWindow::loadModelFromFile(std::string_view path) {
   m_vertices.clear();
   m_indices.clear();
 
-  // A key:value map with key=Vertex and value=index
-  std::unordered_map<Vertex, GLuint> hash{};
+  // Use the binary mesh cache if it is up to date
+  const auto cachePath{abcg::MeshCache::getCachePath(path)};
+  // Option bit 2 marks meshes reordered by optimize()
+  const auto cacheKey{abcg::MeshCache::computeKey(path, 2U)};
+  if (abcg::MeshCache cache; cache.load(cachePath, cacheKey, sizeof(Vertex))) {
+    const auto vertices{cache.getVertices<Vertex>()};
+    const auto indices{cache.getIndices()};
+    m_vertices.assign(vertices.begin(), vertices.end());
+    m_indices.assign(indices.begin(), indices.end());
+    m_bounds = cache.getBounds();
+    return;
+  }
+
+  abcg::ObjReader reader;
+  reader.parseFromFile(path,
+                       getAssetsPath() + "mtl/");  // Path to material files
+
+  if (!reader.getWarning().empty()) {
+    fmt::print("Warning: {}\n", reader.getWarning());
+  }
+
+  const auto& attrib{reader.getAttrib()};
+  const auto& shapes{reader.getShapes()};
+
+  // Count the indices to size the vertex deduplication table
+  std::size_t numIndices{};
+  for (const auto& shape : shapes) {
+    numIndices += shape.mesh.indices.size();
+  }
+  m_indices.reserve(numIndices);
+  abcg::VertexWelder<Vertex> welder{m_vertices, numIndices};
 
   // Loop over shapes
   for (const auto& shape : shapes) {
@@ -122,45 +228,54 @@ void OpenGLWindow::loadModelFromFile(std::string_view path) {
         Vertex vertex{};
         vertex.position = {vx, vy, vz};
 
-        // If hash doesn't contain this vertex
-        if (hash.count(vertex) == 0) {
-          // Add this index (size of m_vertices)
-          hash[vertex] = m_vertices.size();
-          // Add this vertex
-          m_vertices.push_back(vertex);
-        }
-
-        m_indices.push_back(hash[vertex]);
+        // Add the vertex if it is new and get its index
+        m_indices.push_back(welder.insert(vertex));
       }
       indexOffset += numFaceVertices;
     }
   }
+
+  optimize();
+  m_bounds = abcg::computeBounds<Vertex>(m_vertices);
+
+  // Store the mesh so that the next launch skips parsing
+  try {
+    abcg::MeshCache::store(cachePath, cacheKey,
+                           {.vertices = gsl::as_bytes(gsl::span{m_vertices}),
+                            .vertexStride = sizeof(Vertex),
+                            .indices = m_indices,
+                            .bounds = m_bounds});
+  } catch (const abcg::Exception& exception) {
+    fmt::print("Warning: {}\n", exception.what());
+  }
+}
+
+void OpenGLWindow::optimize() {
+  // Reorder triangles for the post-transform vertex cache, then clusters of
+  // triangles for overdraw, then vertices for pre-transform fetch locality
+  abcg::optimizeVertexCache(m_indices, m_vertices.size());
+  std::vector<glm::vec3> positions(m_vertices.size());
+  std::transform(m_vertices.begin(), m_vertices.end(), positions.begin(),
+                 [](const Vertex& vertex) { return vertex.position; });
+  abcg::optimizeOverdraw(m_indices, positions);
+  abcg::optimizeVertexFetch(m_vertices, m_indices);
 }
 
 void OpenGLWindow::standardize() {
   // Center to origin and normalize largest bound to [-1, 1]
 
-  // Get bounds
-  glm::vec3 max(std::numeric_limits<float>::lowest());
-  glm::vec3 min(std::numeric_limits<float>::max());
-  for (const auto& vertex : m_vertices) {
-    max.x = std::max(max.x, vertex.position.x);
-    max.y = std::max(max.y, vertex.position.y);
-    max.z = std::max(max.z, vertex.position.z);
-    min.x = std::min(min.x, vertex.position.x);
-    min.y = std::min(min.y, vertex.position.y);
-    min.z = std::min(min.z, vertex.position.z);
-  }
-
   // Center and scale
-  const auto center{(min + max) / 2.0f};
-  const auto scaling{2.0f / glm::length(max - min)};
+  const auto center{(m_bounds.min + m_bounds.max) / 2.0f};
+  const auto scaling{2.0f / glm::length(m_bounds.max - m_bounds.min)};
   for (auto& vertex : m_vertices) {
     vertex.position = (vertex.position - center) * scaling;
   }
+  m_bounds = abcg::transformBounds(m_bounds, scaling, -center * scaling);
 }
 
 void OpenGLWindow::paintGL() {
+  streamMesh();
+
   // Animate angle by 15 degrees per second
   float deltaTime{static_cast<float>(getDeltaTime())};
   m_angle = glm::wrapAngle(m_angle + glm::radians(15.0f) * deltaTime);
@@ -178,7 +293,10 @@ void OpenGLWindow::paintGL() {
   glUniform1f(angleLoc, m_angle);
 
   // Draw triangles - pega numero de triangulos que esta sendo
-  glDrawElements(GL_TRIANGLES, n_trig*3, GL_UNSIGNED_INT, nullptr);
+  const auto numTriangles{std::min<std::size_t>(n_trig, m_levelIndexCount / 3)};
+  glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(numTriangles * 3),
+                 GL_UNSIGNED_INT,
+                 reinterpret_cast<void*>(m_levelOffset * sizeof(GLuint)));
 
   glBindVertexArray(0);
   glUseProgram(0);
@@ -199,9 +317,9 @@ void OpenGLWindow::paintUI() {
 
     ImGui::End();
   }
-  n_trig = desenhou_xicara? n_trig+10 : n_trig-10;
+  n_trig = desenhou_xicara? n_trig+10 : n_trig-std::min(n_trig, 10ULL);
 
-  if(n_trig > m_indices.size() / 3) desenhou_xicara = false;
+  if(n_trig > m_levelIndexCount / 3) desenhou_xicara = false;
   if(n_trig <=0) desenhou_xicara = true;
 
 
@@ -213,6 +331,15 @@ void OpenGLWindow::resizeGL(int width, int height) {
 }
 
 void OpenGLWindow::terminateGL() {
+  // Wait for the build task, which uses the members of this window
+  if (m_building.isPending()) {
+    m_building.cancel();
+    try {
+      (void)m_building.get();
+    } catch (const abcg::Exception&) {
+    }
+  }
+
   glDeleteProgram(m_program);
   glDeleteBuffers(1, &m_EBO);
   glDeleteBuffers(1, &m_VBO);
@@ -1,6 +1,9 @@
 #ifndef OPENGLWINDOW_HPP_
 #define OPENGLWINDOW_HPP_
 
+#include <deque>
+#include <vector>
+
 #include "abcg.hpp"
 
 struct Vertex {
@@ -38,8 +41,24 @@ class OpenGLWindow : public abcg::OpenGLWindow {
 
   std::vector<Vertex> m_vertices;
   std::vector<GLuint> m_indices;
+  abcg::Bounds m_bounds{};
+
+  // Progressive mesh, read from disk or built in the background. Each frame
+  // appends one refinement batch to the buffers and draws the finest level
+  // appended so far
+  abcg::ProgressiveMeshStream m_meshStream;
+  abcg::AsyncLoad<std::vector<abcg::ProgressiveMeshBatch>> m_building;
+  std::deque<abcg::ProgressiveMeshBatch> m_builtBatches;
+  std::size_t m_vertexOffset{};  // Vertices appended so far
+  std::size_t m_indexOffset{};   // Indices appended so far
+  std::size_t m_levelOffset{};   // First index of the finest level
+  std::size_t m_levelIndexCount{};
 
+  void allocateBuffers(std::size_t vertexCount, std::size_t indexCount);
+  void streamMesh();
+  void appendBatch(const abcg::ProgressiveMeshBatch& batch);
   void loadModelFromFile(std::string_view path);
+  void optimize();
   void standardize();
 };
 
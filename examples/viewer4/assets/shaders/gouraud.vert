@@ -8,6 +8,10 @@ uniform mat4 viewMatrix;
 uniform mat4 projMatrix;
 uniform mat3 normalMatrix;
 
+// Compact vertices are relative to the bounds of the mesh
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
+
 // Light properties
 uniform vec4 lightDirWorldSpace;
 uniform vec4 Ia, Id, Is;
@@ -43,7 +47,8 @@ vec4 Phong(vec3 N, vec3 L, vec3 V) {
 }
 
 void main() {
-  vec3 P = (viewMatrix * modelMatrix * vec4(inPosition, 1.0)).xyz;
+  vec3 position = positionOffset + positionScale * inPosition;
+  vec3 P = (viewMatrix * modelMatrix * vec4(position, 1.0)).xyz;
   vec3 N = normalMatrix * inNormal;
   vec3 L = -(viewMatrix * lightDirWorldSpace).xyz;
   vec3 V = -P;
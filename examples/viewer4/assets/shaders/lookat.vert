@@ -7,10 +7,15 @@ uniform mat4 modelMatrix;
 uniform mat4 viewMatrix;
 uniform mat4 projMatrix;
 
+// Compact vertices are relative to the bounds of the mesh
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
+
 out vec4 fragColor;
 
 void main() {
-  vec4 posEyeSpace = viewMatrix * modelMatrix * vec4(inPosition, 1);
+  vec3 position = positionOffset + positionScale * inPosition;
+  vec4 posEyeSpace = viewMatrix * modelMatrix * vec4(position, 1);
 
   float i = 1.0 - (-posEyeSpace.z / 5.0);
   fragColor = vec4(i, i, i, 1) * color;
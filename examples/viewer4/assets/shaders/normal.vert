@@ -8,12 +8,17 @@ uniform mat4 viewMatrix;
 uniform mat4 projMatrix;
 uniform mat3 normalMatrix;
 
+// Compact vertices are relative to the bounds of the mesh
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
+
 out vec4 fragColor;
 
 void main() {
+  vec3 position = positionOffset + positionScale * inPosition;
   mat4 MVP = projMatrix * viewMatrix * modelMatrix;
 
-  gl_Position = MVP * vec4(inPosition, 1.0);
+  gl_Position = MVP * vec4(position, 1.0);
 
   vec3 N = inNormal;  // Object space
   // vec3 N = normalMatrix * inNormal; // Eye space
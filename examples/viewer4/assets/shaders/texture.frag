@@ -16,6 +16,8 @@ uniform float shininess;
 
 // Diffuse texture sampler
 uniform sampler2D diffuseTex;
+// Region of the diffuse texture in an atlas: offset in xy, scale in zw
+uniform vec4 diffuseRegion;
 
 // Mapping mode
 // 0: triplanar; 1: cylindrical; 2: spherical; 3: from mesh
@@ -23,6 +25,16 @@ uniform int mappingMode;
 
 out vec4 outColor;
 
+// Samples the diffuse texture, repeated within its region. The gradients
+// are those of the unwrapped coordinates, so that the jumps of fract do not
+// select the smallest mipmap level
+vec4 SampleDiffuse(vec2 texCoord) {
+  vec2 scaled = texCoord * diffuseRegion.zw;
+  return textureGrad(diffuseTex,
+                     diffuseRegion.xy + fract(texCoord) * diffuseRegion.zw,
+                     dFdx(scaled), dFdy(scaled));
+}
+
 // Blinn-Phong reflection model
 vec4 BlinnPhong(vec3 N, vec3 L, vec3 V, vec2 texCoord) {
   N = normalize(N);
@@ -40,7 +52,7 @@ vec4 BlinnPhong(vec3 N, vec3 L, vec3 V, vec2 texCoord) {
     specular = pow(angle, shininess);
   }
 
-  vec4 map_Kd = texture(diffuseTex, texCoord);
+  vec4 map_Kd = SampleDiffuse(texCoord);
   vec4 map_Ka = map_Kd;
 
   vec4 diffuseColor = map_Kd * Kd * Id * lambertian;
@@ -9,6 +9,10 @@ uniform mat4 viewMatrix;
 uniform mat4 projMatrix;
 uniform mat3 normalMatrix;
 
+// Compact vertices are relative to the bounds of the mesh
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
+
 uniform vec4 lightDirWorldSpace;
 
 out vec3 fragV;
@@ -19,7 +23,8 @@ out vec3 fragPObj;
 out vec3 fragNObj;
 
 void main() {
-  vec3 P = (viewMatrix * modelMatrix * vec4(inPosition, 1.0)).xyz;
+  vec3 position = positionOffset + positionScale * inPosition;
+  vec3 P = (viewMatrix * modelMatrix * vec4(position, 1.0)).xyz;
   vec3 N = normalMatrix * inNormal;
   vec3 L = -(viewMatrix * lightDirWorldSpace).xyz;
 
@@ -27,7 +32,7 @@ void main() {
   fragV = -P;
   fragN = N;
   fragTexCoord = inTexCoord;
-  fragPObj = inPosition;
+  fragPObj = position;
   fragNObj = inNormal;
 
   gl_Position = projMatrix * vec4(P, 1.0);
@@ -1,66 +1,24 @@
 #include "mars.hpp"
 
 #include <fmt/core.h>
-#include <tiny_obj_loader.h>
 
 #include <cppitertools/itertools.hpp>
+#include <algorithm>
+#include <cstddef>
 #include <filesystem>
-#include <glm/gtx/hash.hpp>
+#include <optional>
 #include <unordered_map>
-
-// Custom specialization of std::hash injected in namespace std
-namespace std {
-template <>
-struct hash<Vertex> {
-  size_t operator()(Vertex const& vertex) const noexcept {
-    std::size_t h1{std::hash<glm::vec3>()(vertex.position)};
-    std::size_t h2{std::hash<glm::vec3>()(vertex.normal)};
-    std::size_t h3{std::hash<glm::vec2>()(vertex.texCoord)};
-    return h1 ^ h2 ^ h3;
-  }
-};
-}  // namespace std
+#include <unordered_set>
 
 Mars::~Mars() {
-  glDeleteTextures(1, &m_diffuseTexture);
   glDeleteBuffers(1, &m_EBO);
   glDeleteBuffers(1, &m_VBO);
   glDeleteVertexArrays(1, &m_VAO);
 }
 
-void Mars::computeNormals() {
-  // Clear previous vertex normals
-  for (auto& vertex : m_vertices) {
-    vertex.normal = glm::zero<glm::vec3>();
-  }
-
-  // Compute face normals
-  for (const auto offset : iter::range<int>(0, m_indices.size(), 3)) {
-    // Get face vertices
-    Vertex& a{m_vertices.at(m_indices.at(offset + 0))};
-    Vertex& b{m_vertices.at(m_indices.at(offset + 1))};
-    Vertex& c{m_vertices.at(m_indices.at(offset + 2))};
-
-    // Compute normal
-    const auto edge1{b.position - a.position};
-    const auto edge2{c.position - b.position};
-    glm::vec3 normal{glm::cross(edge1, edge2)};
-
-    // Accumulate on vertices
-    a.normal += normal;
-    b.normal += normal;
-    c.normal += normal;
-  }
-
-  // Normalize
-  for (auto& vertex : m_vertices) {
-    vertex.normal = glm::normalize(vertex.normal);
-  }
-
-  m_hasNormals = true;
-}
-
 void Mars::createBuffers() {
+  packBuffers();
+
   // Delete previous buffers
   glDeleteBuffers(1, &m_EBO);
   glDeleteBuffers(1, &m_VBO);
@@ -68,161 +26,311 @@ void Mars::createBuffers() {
   // VBO
   glGenBuffers(1, &m_VBO);
   glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(m_vertices[0]) * m_vertices.size(),
-               m_vertices.data(), GL_STATIC_DRAW);
+  glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(m_vertexData.size()),
+               m_vertexData.data(), GL_STATIC_DRAW);
   glBindBuffer(GL_ARRAY_BUFFER, 0);
 
   // EBO
   glGenBuffers(1, &m_EBO);
   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_EBO);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(m_indices[0]) * m_indices.size(),
-               m_indices.data(), GL_STATIC_DRAW);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+               static_cast<GLsizeiptr>(m_indexData.size()), m_indexData.data(),
+               GL_STATIC_DRAW);
   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+  m_vertexData = {};
+  m_indexData = {};
 }
 
-void Mars::loadDiffuseTexture(std::string_view path) {
-  if (!std::filesystem::exists(path)) return;
+void Mars::packBuffers() {
+  auto buffers{abcg::packMeshBuffers(m_vertices, m_indices, m_lodIndices,
+                                     m_bounds, m_compactVertices)};
+  m_vertexData = std::move(buffers.vertices);
+  m_indexData = std::move(buffers.indices);
+  m_packedVertices = m_compactVertices;
+  m_indexType = buffers.indexSize == sizeof(GLushort) ? GL_UNSIGNED_SHORT
+                                                      : GL_UNSIGNED_INT;
+  m_positionOffset = buffers.positionOffset;
+  m_positionScale = buffers.positionScale;
+  m_bufferBytes = m_vertexData.size() + m_indexData.size();
+
+  // Draw every submesh until the first culling pass
+  abcg::MeshDrawRanges drawRanges;
+  drawRanges.submeshRanges = {0};
+  for (const auto& submesh : m_submeshes) {
+    drawRanges.indexOffsets.push_back(submesh.indexOffset);
+    drawRanges.indexCounts.push_back(submesh.indexCount);
+    drawRanges.submeshRanges.push_back(drawRanges.indexCounts.size());
+  }
+  setDrawRanges(std::move(drawRanges));
+}
 
-  glDeleteTextures(1, &m_diffuseTexture);
-  m_diffuseTexture = abcg::opengl::loadTexture(path);
+void Mars::setDrawRanges(abcg::MeshDrawRanges drawRanges) {
+  // Offsets are in bytes, so they depend on the index type
+  m_drawCounts.clear();
+  m_drawOffsets.clear();
+  for (auto&& [offset, count] :
+       iter::zip(drawRanges.indexOffsets, drawRanges.indexCounts)) {
+    m_drawCounts.push_back(static_cast<GLsizei>(count));
+    m_drawOffsets.push_back(reinterpret_cast<void*>(offset * getIndexSize()));
+  }
+  m_drawRanges = std::move(drawRanges);
 }
 
-void Mars::loadFromFile(std::string_view path, bool standardize) {
-  auto basePath{std::filesystem::path{path}.parent_path().string() + "/"};
+void Mars::loadDiffuseTexture(std::string_view path) {
+  if (!std::filesystem::exists(path)) return;
 
-  tinyobj::ObjReaderConfig readerConfig;
-  readerConfig.mtl_search_path = basePath;  // Path to material files
+  const auto image{abcg::decodeImage(path)};
+  m_diffuseTexture = std::make_shared<abcg::Texture>(
+      abcg::opengl::createTexture(image),
+      abcg::Texture::computeByteSize(image, true));
+}
 
-  tinyobj::ObjReader reader;
+void Mars::loadFromFile(std::string_view path, bool standardize,
+                        bool optimize) {
+  abcg::LoadProgress progress;
+  loadMesh(path, standardize, optimize, progress);
+  loadMaterialTextures();
+  createBuffers();
+}
 
-  if (!reader.ParseFromFile(path.data(), readerConfig)) {
-    if (!reader.Error().empty()) {
-      throw abcg::Exception{abcg::Exception::Runtime(
-          fmt::format("Failed to load model {} ({})", path, reader.Error()))};
+void Mars::loadMaterialTextures() {
+  // Materials that use the same file share the texture
+  std::unordered_map<std::string, std::shared_ptr<abcg::Texture>> textures;
+  for (auto& material : m_materials) {
+    const auto& path{material.diffuseTexturePath};
+    if (path.empty() || !std::filesystem::exists(path)) continue;
+
+    auto& texture{textures[path]};
+    if (!texture) {
+      const auto image{abcg::decodeImage(path)};
+      texture = std::make_shared<abcg::Texture>(
+          abcg::opengl::createTexture(image),
+          abcg::Texture::computeByteSize(image, true));
     }
-    throw abcg::Exception{
-        abcg::Exception::Runtime(fmt::format("Failed to load model {}", path))};
-  }
-
-  if (!reader.Warning().empty()) {
-    fmt::print("Warning: {}\n", reader.Warning());
+    material.diffuseTexture = texture;
   }
+}
 
-  const auto& attrib{reader.GetAttrib()};
-  const auto& shapes{reader.GetShapes()};
-  const auto& materials{reader.GetMaterials()};
-
-  m_vertices.clear();
-  m_indices.clear();
-
-  m_hasNormals = false;
-  m_hasTexCoords = false;
-
-  // A key:value map with key=Vertex and value=index
-  std::unordered_map<Vertex, GLuint> hash{};
-
-  // Loop over shapes
-  for (const auto& shape : shapes) {
-    // Loop over indices
-    for (const auto offset : iter::range(shape.mesh.indices.size())) {
-      // Access to vertex
-      tinyobj::index_t index{shape.mesh.indices.at(offset)};
-
-      // Vertex position
-      std::size_t startIndex{static_cast<size_t>(3 * index.vertex_index)};
-      float vx{attrib.vertices.at(startIndex + 0)};
-      float vy{attrib.vertices.at(startIndex + 1)};
-      float vz{attrib.vertices.at(startIndex + 2)};
-
-      // Vertex normal
-      float nx{};
-      float ny{};
-      float nz{};
-      if (index.normal_index >= 0) {
-        m_hasNormals = true;
-        startIndex = 3 * index.normal_index;
-        nx = attrib.normals.at(startIndex + 0);
-        ny = attrib.normals.at(startIndex + 1);
-        nz = attrib.normals.at(startIndex + 2);
-      }
-
-      // Vertex texture coordinates
-      float tu{};
-      float tv{};
-      if (index.texcoord_index >= 0) {
-        m_hasTexCoords = true;
-        startIndex = 2 * index.texcoord_index;
-        tu = attrib.texcoords.at(startIndex + 0);
-        tv = attrib.texcoords.at(startIndex + 1);
+abcg::AsyncLoad<std::unique_ptr<Mars>> Mars::loadFromFileAsync(
+    std::string_view path, std::string_view diffuseTexturePath,
+    bool standardize, bool optimize) const {
+  auto model{std::make_unique<Mars>()};
+  model->m_compactVertices = m_compactVertices;
+  model->m_normalWeighting = m_normalWeighting;
+  model->m_minLODTriangles = m_minLODTriangles;
+  model->m_maxLODError = m_maxLODError;
+  model->m_lodPixelError = m_lodPixelError;
+
+  return abcg::loadAsync([model = std::move(model), path = std::string{path},
+                          fallbackTexturePath = std::string{diffuseTexturePath},
+                          standardize,
+                          optimize](abcg::LoadProgress& progress) mutable {
+    model->loadMesh(path, standardize, optimize, progress);
+
+    progress.setStage("Packing buffers", 0.85f);
+    model->packBuffers();
+
+    // Decode each texture once. The fallback texture is only needed if a
+    // submesh has a material without texture
+    progress.setStage("Decoding textures", 0.9f);
+    std::unordered_set<std::string> decoded;
+    for (auto& material : model->m_materials) {
+      const auto& texturePath{material.diffuseTexturePath};
+      if (!texturePath.empty() && std::filesystem::exists(texturePath) &&
+          decoded.insert(texturePath).second) {
+        material.diffuseImage = abcg::decodeImage(texturePath);
       }
+    }
+    const auto needsFallback{std::any_of(
+        model->m_submeshes.begin(), model->m_submeshes.end(),
+        [&](const abcg::Submesh& submesh) {
+          const auto& texturePath{
+              model->getMaterial(submesh.materialID).diffuseTexturePath};
+          return texturePath.empty() || !std::filesystem::exists(texturePath);
+        })};
+    if (needsFallback && !fallbackTexturePath.empty() &&
+        std::filesystem::exists(fallbackTexturePath)) {
+      model->m_diffuseImage = abcg::decodeImage(fallbackTexturePath);
+    }
 
-      Vertex vertex{};
-      vertex.position = {vx, vy, vz};
-      vertex.normal = {nx, ny, nz};
-      vertex.texCoord = {tu, tv};
-
-      // If hash doesn't contain this vertex
-      if (hash.count(vertex) == 0) {
-        // Add this index (size of m_vertices)
-        hash[vertex] = m_vertices.size();
-        // Add this vertex
-        m_vertices.push_back(vertex);
-      }
+    progress.setStage("Uploading", 1.0f);
+    return std::move(model);
+  });
+}
 
-      m_indices.push_back(hash[vertex]);
+void Mars::queueUpload(abcg::UploadQueue& queue) {
+  glDeleteBuffers(1, &m_EBO);
+  glDeleteBuffers(1, &m_VBO);
+  m_VBO = queue.uploadBuffer(GL_ARRAY_BUFFER, std::move(m_vertexData));
+  m_EBO = queue.uploadBuffer(GL_ELEMENT_ARRAY_BUFFER, std::move(m_indexData));
+  m_vertexData = {};
+  m_indexData = {};
+
+  auto upload{[&queue](abcg::Image& image) {
+    const auto byteSize{abcg::Texture::computeByteSize(image, true)};
+    auto texture{std::make_shared<abcg::Texture>(
+        queue.uploadTexture(std::move(image)), byteSize)};
+    image = {};
+    return texture;
+  }};
+
+  // Only the first material that uses a file holds its decoded image
+  std::unordered_map<std::string, std::shared_ptr<abcg::Texture>> textures;
+  for (auto& material : m_materials) {
+    if (!material.diffuseImage.pixels.empty()) {
+      material.diffuseTexture = upload(material.diffuseImage);
+      textures.emplace(material.diffuseTexturePath, material.diffuseTexture);
+    } else if (const auto texture{textures.find(material.diffuseTexturePath)};
+               texture != textures.end()) {
+      material.diffuseTexture = texture->second;
     }
   }
-
-  // Use properties of first material, if available
-  if (!materials.empty()) {
-    const auto& mat{materials.at(0)};  // First material
-    m_Ka = glm::vec4(mat.ambient[0], mat.ambient[1], mat.ambient[2], 1);
-    m_Kd = glm::vec4(mat.diffuse[0], mat.diffuse[1], mat.diffuse[2], 1);
-    m_Ks = glm::vec4(mat.specular[0], mat.specular[1], mat.specular[2], 1);
-    m_shininess = mat.shininess;
-
-    if (!mat.diffuse_texname.empty())
-      loadDiffuseTexture(basePath + mat.diffuse_texname);
-  } else {
-    // Default values
-    m_Ka = {0.1f, 0.1f, 0.1f, 1.0f};
-    m_Kd = {0.7f, 0.7f, 0.7f, 1.0f};
-    m_Ks = {1.0f, 1.0f, 1.0f, 1.0f};
-    m_shininess = 25.0f;
+  if (!m_diffuseImage.pixels.empty()) {
+    m_diffuseTexture = upload(m_diffuseImage);
   }
+}
 
-  if (standardize) {
-    this->standardize();
+void Mars::loadMesh(std::string_view path, bool standardize, bool optimize,
+                    abcg::LoadProgress& progress) {
+  auto mesh{abcg::loadMesh(path,
+                           {.standardize = standardize,
+                            .optimize = optimize,
+                            .normalWeighting = m_normalWeighting,
+                            .minLODTriangles = m_minLODTriangles,
+                            .maxLODError = m_maxLODError},
+                           progress)};
+  if (!mesh.warning.empty()) {
+    fmt::print("Warning: {}\n", mesh.warning);
   }
 
-  if (!m_hasNormals) {
-    computeNormals();
+  loadMaterials(mesh);
+  m_vertices = std::move(mesh.vertices);
+  m_indices = std::move(mesh.indices);
+  m_submeshes = std::move(mesh.submeshes);
+  m_bounds = mesh.bounds;
+  m_submeshBounds = std::move(mesh.submeshBounds);
+  m_hasNormals = mesh.hasNormals;
+  m_hasTexCoords = mesh.hasTexCoords;
+  m_lods = std::move(mesh.lods);
+  m_lodIndices = std::move(mesh.lodIndices);
+  m_meshlets = std::move(mesh.meshlets);
+  m_submeshMeshlets = std::move(mesh.submeshMeshlets);
+}
+
+void Mars::loadMaterials(const abcg::Mesh& mesh) {
+  m_materials.clear();
+  for (auto&& [mat, texturePath] :
+       iter::zip(mesh.materials, mesh.diffuseTexturePaths)) {
+    m_materials.push_back({.Ka = mat.Ka,
+                           .Kd = mat.Kd,
+                           .Ks = mat.Ks,
+                           .shininess = mat.shininess,
+                           .diffuseTexturePath = texturePath});
   }
+}
 
-  createBuffers();
+const Mars::Material& Mars::getMaterial(int materialID) const {
+  // Used by triangles with no material, or with a missing one
+  static const Material defaultMaterial{.Ka = {0.1f, 0.1f, 0.1f, 1.0f},
+                                        .Kd = {0.7f, 0.7f, 0.7f, 1.0f},
+                                        .Ks = {1.0f, 1.0f, 1.0f, 1.0f},
+                                        .shininess = 25.0f};
+  if (materialID < 0 ||
+      static_cast<std::size_t>(materialID) >= m_materials.size()) {
+    return defaultMaterial;
+  }
+  return m_materials[static_cast<std::size_t>(materialID)];
 }
 
-void Mars::render(int numTriangles) const {
+void Mars::render(int numTriangles, std::size_t lod) const {
   glBindVertexArray(m_VAO);
 
-  glActiveTexture(GL_TEXTURE0);
-  glBindTexture(GL_TEXTURE_2D, m_diffuseTexture);
-
-  // Set minification and magnification parameters
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-  // Set texture wrapping parameters
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  // Material uniforms of the current program, if there are several materials
+  GLint program{};
+  glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+  setPositionUniforms(static_cast<GLuint>(program));
+  GLint KaLoc{-1};
+  GLint KdLoc{-1};
+  GLint KsLoc{-1};
+  GLint shininessLoc{-1};
+  if (m_submeshes.size() > 1) {
+    KaLoc = glGetUniformLocation(static_cast<GLuint>(program), "Ka");
+    KdLoc = glGetUniformLocation(static_cast<GLuint>(program), "Kd");
+    KsLoc = glGetUniformLocation(static_cast<GLuint>(program), "Ks");
+    shininessLoc =
+        glGetUniformLocation(static_cast<GLuint>(program), "shininess");
+  }
 
-  GLsizei numIndices = (numTriangles < 0) ? m_indices.size() : numTriangles * 3;
+  glActiveTexture(GL_TEXTURE0);
+  std::optional<GLuint> boundTexture;
+
+  const auto& level{m_lods.at(std::min(lod, m_lods.size() - 1))};
+  const auto levelCount{static_cast<GLsizei>(level.indexCount)};
+  GLsizei numIndices = (numTriangles < 0)
+                           ? levelCount
+                           : std::min(levelCount, numTriangles * 3);
+  // Index ranges of the clusters that survived the last culling pass
+  const auto drawClusters{lod == 0 && numIndices == levelCount};
+  const auto& submeshRanges{m_drawRanges.submeshRanges};
+
+  // One draw per submesh. Textures are only rebound when they change
+  for (const auto index : iter::range(m_submeshes.size())) {
+    const auto& range{level.submeshes[index]};
+    const auto count{
+        std::min(static_cast<GLsizei>(range.indexCount), numIndices)};
+    numIndices -= count;
+    const auto firstDraw{drawClusters ? submeshRanges[index] : 0};
+    const auto numDraws{drawClusters ? submeshRanges[index + 1] - firstDraw
+                        : count > 0  ? 1
+                                     : 0};
+    if (numDraws == 0) continue;
+
+    const auto& material{getMaterial(m_submeshes[index].materialID)};
+    const auto& texture{material.diffuseTexture ? material.diffuseTexture
+                                                : m_diffuseTexture};
+    const auto textureName{texture ? texture->getName() : 0U};
+    if (boundTexture != textureName) {
+      glBindTexture(GL_TEXTURE_2D, textureName);
+      boundTexture = textureName;
+    }
+    if (m_submeshes.size() > 1) {
+      glUniform4fv(KaLoc, 1, &material.Ka.x);
+      glUniform4fv(KdLoc, 1, &material.Kd.x);
+      glUniform4fv(KsLoc, 1, &material.Ks.x);
+      glUniform1f(shininessLoc, material.shininess);
+    }
 
-  glDrawElements(GL_TRIANGLES, numIndices, GL_UNSIGNED_INT, nullptr);
+    if (drawClusters) {
+#if defined(__EMSCRIPTEN__)
+      // Multi-draw is only an extension in WebGL 2
+      for (const auto draw : iter::range(firstDraw, firstDraw + numDraws)) {
+        glDrawElements(GL_TRIANGLES, m_drawCounts[draw], m_indexType,
+                       m_drawOffsets[draw]);
+      }
+#else
+      glMultiDrawElements(GL_TRIANGLES, &m_drawCounts[firstDraw], m_indexType,
+                          &m_drawOffsets[firstDraw],
+                          static_cast<GLsizei>(numDraws));
+#endif
+    } else {
+      glDrawElements(
+          GL_TRIANGLES, count, m_indexType,
+          reinterpret_cast<void*>(range.indexOffset * getIndexSize()));
+    }
+  }
 
   glBindVertexArray(0);
 }
 
+void Mars::setPositionUniforms(GLuint program) const {
+  // Maps compact positions back to object space
+  glUniform3fv(glGetUniformLocation(program, "positionOffset"), 1,
+               &m_positionOffset.x);
+  glUniform3fv(glGetUniformLocation(program, "positionScale"), 1,
+               &m_positionScale.x);
+}
+
 void Mars::setupVAO(GLuint program) {
   // Release previous VAO
   glDeleteVertexArrays(1, &m_VAO);
@@ -236,53 +344,78 @@ void Mars::setupVAO(GLuint program) {
   glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
 
   // Bind vertex attributes
+  if (m_packedVertices) {
+    setupPackedAttributes(program);
+  } else {
+    GLint positionAttribute{glGetAttribLocation(program, "inPosition")};
+    if (positionAttribute >= 0) {
+      glEnableVertexAttribArray(positionAttribute);
+      glVertexAttribPointer(positionAttribute, 3, GL_FLOAT, GL_FALSE,
+                            sizeof(Vertex), nullptr);
+    }
+
+    GLint normalAttribute{glGetAttribLocation(program, "inNormal")};
+    if (normalAttribute >= 0) {
+      glEnableVertexAttribArray(normalAttribute);
+      GLsizei offset{sizeof(glm::vec3)};
+      glVertexAttribPointer(normalAttribute, 3, GL_FLOAT, GL_FALSE,
+                            sizeof(Vertex), reinterpret_cast<void*>(offset));
+    }
+
+    GLint texCoordAttribute{glGetAttribLocation(program, "inTexCoord")};
+    if (texCoordAttribute >= 0) {
+      glEnableVertexAttribArray(texCoordAttribute);
+      GLsizei offset{sizeof(glm::vec3) + sizeof(glm::vec3)};
+      glVertexAttribPointer(texCoordAttribute, 2, GL_FLOAT, GL_FALSE,
+                            sizeof(Vertex), reinterpret_cast<void*>(offset));
+    }
+  }
+
+  // End of binding
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glBindVertexArray(0);
+}
+
+void Mars::setupPackedAttributes(GLuint program) const {
   GLint positionAttribute{glGetAttribLocation(program, "inPosition")};
   if (positionAttribute >= 0) {
     glEnableVertexAttribArray(positionAttribute);
-    glVertexAttribPointer(positionAttribute, 3, GL_FLOAT, GL_FALSE,
-                          sizeof(Vertex), nullptr);
+    glVertexAttribPointer(
+        positionAttribute, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(PackedVertex),
+        reinterpret_cast<void*>(offsetof(PackedVertex, position)));
   }
 
   GLint normalAttribute{glGetAttribLocation(program, "inNormal")};
   if (normalAttribute >= 0) {
     glEnableVertexAttribArray(normalAttribute);
-    GLsizei offset{sizeof(glm::vec3)};
-    glVertexAttribPointer(normalAttribute, 3, GL_FLOAT, GL_FALSE,
-                          sizeof(Vertex), reinterpret_cast<void*>(offset));
+    // Packed formats always have four components; w is dropped by the shader
+    glVertexAttribPointer(
+        normalAttribute, 4, GL_INT_2_10_10_10_REV, GL_TRUE,
+        sizeof(PackedVertex),
+        reinterpret_cast<void*>(offsetof(PackedVertex, normal)));
   }
 
   GLint texCoordAttribute{glGetAttribLocation(program, "inTexCoord")};
   if (texCoordAttribute >= 0) {
     glEnableVertexAttribArray(texCoordAttribute);
-    GLsizei offset{sizeof(glm::vec3) + sizeof(glm::vec3)};
-    glVertexAttribPointer(texCoordAttribute, 2, GL_FLOAT, GL_FALSE,
-                          sizeof(Vertex), reinterpret_cast<void*>(offset));
+    glVertexAttribPointer(
+        texCoordAttribute, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(PackedVertex),
+        reinterpret_cast<void*>(offsetof(PackedVertex, texCoord)));
   }
-
-  // End of binding
-  glBindBuffer(GL_ARRAY_BUFFER, 0);
-  glBindVertexArray(0);
 }
 
-void Mars::standardize() {
-  // Center to origin and normalize largest bound to [-1, 1]
-
-  // Get bounds
-  glm::vec3 max(std::numeric_limits<float>::lowest());
-  glm::vec3 min(std::numeric_limits<float>::max());
-  for (const auto& vertex : m_vertices) {
-    max.x = std::max(max.x, vertex.position.x);
-    max.y = std::max(max.y, vertex.position.y);
-    max.z = std::max(max.z, vertex.position.z);
-    min.x = std::min(min.x, vertex.position.x);
-    min.y = std::min(min.y, vertex.position.y);
-    min.z = std::min(min.z, vertex.position.z);
-  }
+std::size_t Mars::selectLOD(const glm::mat4& modelMatrix,
+                            const glm::mat4& viewMatrix,
+                            const glm::mat4& projMatrix,
+                            int viewportHeight) const {
+  return abcg::selectLOD(m_lods, m_bounds, modelMatrix, viewMatrix, projMatrix,
+                         viewportHeight, m_lodPixelError);
+}
 
-  // Center and scale
-  const auto center{(min + max) / 2.0f};
-  const auto scaling{2.0f / glm::length(max - min)};
-  for (auto& vertex : m_vertices) {
-    vertex.position = (vertex.position - center) * scaling;
-  }
+void Mars::cullClusters(const glm::mat4& modelMatrix,
+                        const glm::mat4& viewMatrix,
+                        const glm::mat4& projMatrix, bool cullBackFacing) {
+  setDrawRanges(abcg::cullMeshlets(m_meshlets, m_submeshMeshlets, m_bounds,
+                                   modelMatrix, viewMatrix, projMatrix,
+                                   cullBackFacing));
 }
@@ -1,20 +1,28 @@
 #ifndef MODEL_HPP_
 #define MODEL_HPP_
 
+#include <memory>
+#include <string>
 #include <string_view>
+#include <utility>
+#include <vector>
 
 #include "abcg.hpp"
 
-struct Vertex {
-  glm::vec3 position{};
-  glm::vec3 normal{};
-  glm::vec2 texCoord{};
+// Vertex layouts of abcg::loadMesh. PackedVertex is used when compact
+// vertices are enabled
+using Vertex = abcg::MeshVertex;
+using PackedVertex = abcg::PackedMeshVertex;
 
-  bool operator==(const Vertex& other) const noexcept {
-    static const auto epsilon{std::numeric_limits<float>::epsilon()};
-    return glm::all(glm::epsilonEqual(position, other.position, epsilon)) &&
-           glm::all(glm::epsilonEqual(normal, other.normal, epsilon)) &&
-           glm::all(glm::epsilonEqual(texCoord, other.texCoord, epsilon));
+// Diffuse textures of a model packed in one atlas, shared through
+// abcg::AssetManager by the models that use the same files
+struct PackedTextures {
+  std::shared_ptr<abcg::Texture> texture;
+  std::vector<std::string> paths;
+  std::vector<abcg::TextureRegion> regions;  // Same order as paths
+
+  [[nodiscard]] std::size_t getByteSize() const {
+    return texture->getByteSize();
   }
 };
 
@@ -28,42 +36,184 @@ class Model {
   Model& operator=(const Model&) = delete;
   Model& operator=(Model&&) = default;
 
+  // Texture of the materials that have no diffuse texture of their own
   void loadDiffuseTexture(std::string_view path);
-  void loadFromFile(std::string_view path, bool standardize = true);
-  void render(int numTriangles = -1) const;
+  // Same as loadDiffuseTexture, with a texture shared with other models, e.g.
+  // from abcg::AssetManager
+  void setDiffuseTexture(std::shared_ptr<abcg::Texture> texture) {
+    m_diffuseTexture = std::move(texture);
+    m_diffuseRegion = {};
+  }
+  void loadFromFile(std::string_view path, bool standardize = true,
+                    bool optimize = true);
+  // Parses and processes the mesh on a background thread, with the options
+  // of this object. diffuseTexturePath is used by the materials that have no
+  // texture
+  [[nodiscard]] abcg::AsyncLoad<std::unique_ptr<Model>> loadFromFileAsync(
+      std::string_view path, std::string_view diffuseTexturePath = {},
+      bool standardize = true, bool optimize = true) const;
+  // Image files decoded by loadTexturesAsync, or the atlas they are packed
+  // in, with their paths
+  struct DecodedTextures {
+    std::vector<std::string> paths;
+    std::vector<abcg::Image> images;
+    abcg::TextureAtlas atlas;
+  };
+  // Takes the textures of an object returned by loadFromFileAsync from
+  // assets, and decodes the missing ones on a background thread. Models
+  // with several texture files use an atlas of them, unless disabled with
+  // setPackTextures
+  [[nodiscard]] abcg::AsyncLoad<DecodedTextures> loadTexturesAsync(
+      abcg::AssetManager& assets);
+  // Queues the upload of the buffers and of the textures decoded by
+  // loadTexturesAsync. The object can be drawn once the queue is empty and
+  // setupVAO has been called
+  void queueUpload(abcg::UploadQueue& queue, DecodedTextures textures);
+  // Shares the textures with later loads, once they are uploaded
+  void cacheTextures(abcg::AssetManager& assets) const;
+  // Issues one draw per material. The material uniforms (Ka, Kd, Ks and
+  // shininess) of the current program are only set if the model has several
+  // materials, so that the caller can override those of the other models
+  void render(int numTriangles = -1, std::size_t lod = 0) const;
+  [[nodiscard]] std::size_t selectLOD(const glm::mat4& modelMatrix,
+                                      const glm::mat4& viewMatrix,
+                                      const glm::mat4& projMatrix,
+                                      int viewportHeight) const;
+  // Selects the clusters of the finest LOD to be drawn by render()
+  void cullClusters(const glm::mat4& modelMatrix, const glm::mat4& viewMatrix,
+                    const glm::mat4& projMatrix, bool cullBackFacing = true);
   void setupVAO(GLuint program);
+  // Takes effect on the next call to loadFromFile
+  void setCompactVertices(bool compact) { m_compactVertices = compact; }
+  // Takes effect on the next call to loadTexturesAsync
+  void setPackTextures(bool pack) { m_packTextures = pack; }
+  // Takes effect on the next call to loadFromFile
+  void setNormalWeighting(abcg::NormalWeighting weighting) {
+    m_normalWeighting = weighting;
+  }
 
   [[nodiscard]] int getNumTriangles() const {
     return static_cast<int>(m_indices.size()) / 3;
   }
 
-  [[nodiscard]] glm::vec4 getKa() const { return m_Ka; }
-  [[nodiscard]] glm::vec4 getKd() const { return m_Kd; }
-  [[nodiscard]] glm::vec4 getKs() const { return m_Ks; }
-  [[nodiscard]] float getShininess() const { return m_shininess; }
+  // Properties of the first material
+  [[nodiscard]] glm::vec4 getKa() const { return getMaterial(0).Ka; }
+  [[nodiscard]] glm::vec4 getKd() const { return getMaterial(0).Kd; }
+  [[nodiscard]] glm::vec4 getKs() const { return getMaterial(0).Ks; }
+  [[nodiscard]] float getShininess() const {
+    return getMaterial(0).shininess;
+  }
 
   [[nodiscard]] bool isUVMapped() const { return m_hasTexCoords; }
+  // Size of the VBO and EBO, as required by abcg::AssetManager. Textures are
+  // accounted for separately
+  [[nodiscard]] std::size_t getByteSize() const { return m_bufferBytes; }
+  [[nodiscard]] std::size_t getNumLODs() const { return m_lods.size(); }
+  // Index range of each material of the finest LOD, by material ID
+  [[nodiscard]] const std::vector<abcg::Submesh>& getSubmeshes() const {
+    return m_submeshes;
+  }
+  // Object space bounds of the whole mesh, and of each submesh
+  [[nodiscard]] const abcg::Bounds& getBounds() const { return m_bounds; }
+  [[nodiscard]] const std::vector<abcg::Bounds>& getSubmeshBounds() const {
+    return m_submeshBounds;
+  }
+  // Vertex cache efficiency of the finest LOD before and after the load-time
+  // optimizations
+  [[nodiscard]] const abcg::VertexCacheStatistics& getVertexCacheBefore()
+      const {
+    return m_vertexCacheBefore;
+  }
+  [[nodiscard]] const abcg::VertexCacheStatistics& getVertexCacheAfter()
+      const {
+    return m_vertexCacheAfter;
+  }
+  // Precision lost by compact vertices
+  [[nodiscard]] const abcg::QuantizationError& getQuantizationError() const {
+    return m_quantizationError;
+  }
 
  private:
   GLuint m_VAO{};
   GLuint m_VBO{};
   GLuint m_EBO{};
 
-  glm::vec4 m_Ka;
-  glm::vec4 m_Kd;
-  glm::vec4 m_Ks;
-  float m_shininess;
-  GLuint m_diffuseTexture{};
+  struct Material {
+    glm::vec4 Ka{};
+    glm::vec4 Kd{};
+    glm::vec4 Ks{};
+    float shininess{};
+    std::string diffuseTexturePath{};
+    std::shared_ptr<abcg::Texture> diffuseTexture{};
+    abcg::TextureRegion diffuseRegion{};  // Part of diffuseTexture used
+  };
+  std::vector<Material> m_materials;
+
+  // Texture of the materials that have none, and its file when loaded with
+  // loadFromFileAsync
+  std::shared_ptr<abcg::Texture> m_diffuseTexture;
+  std::string m_diffuseTexturePath;
+  abcg::TextureRegion m_diffuseRegion{};
+
+  // Atlas of the diffuse textures, if they are packed
+  std::shared_ptr<PackedTextures> m_packedTextures;
+  bool m_packTextures{true};
 
   std::vector<Vertex> m_vertices;
   std::vector<GLuint> m_indices;
+  std::vector<abcg::Submesh> m_submeshes;
+  abcg::Bounds m_bounds{};
+  std::vector<abcg::Bounds> m_submeshBounds;
+
+  // Buffer contents packed by packBuffers, until they are uploaded
+  std::vector<std::byte> m_vertexData;
+  std::vector<std::byte> m_indexData;
+  std::size_t m_bufferBytes{};
 
   bool m_hasNormals{false};
   bool m_hasTexCoords{false};
+  bool m_compactVertices{true};
+  bool m_packedVertices{false};
+  GLenum m_indexType{GL_UNSIGNED_INT};
+  // Decoding of the positions in the VBO, see abcg::MeshBuffers
+  glm::vec3 m_positionOffset{0.0f};
+  glm::vec3 m_positionScale{1.0f};
+  abcg::NormalWeighting m_normalWeighting{abcg::NormalWeighting::Area};
+  abcg::VertexCacheStatistics m_vertexCacheBefore{};
+  abcg::VertexCacheStatistics m_vertexCacheAfter{};
+  abcg::QuantizationError m_quantizationError{};
+
+  // Levels of detail. Level 0 is m_indices; the others are stored in
+  // m_lodIndices and follow it in the EBO
+  std::vector<abcg::MeshLOD> m_lods;
+  std::vector<GLuint> m_lodIndices;
+  std::size_t m_minLODTriangles{64};
+  float m_maxLODError{0.05f};
+  float m_lodPixelError{1.0f};
+
+  // Clusters of the finest LOD, grouped by submesh as in abcg::Mesh, and the
+  // index ranges of the ones that passed the last culling pass. The ranges
+  // are also kept as the counts and byte offsets of glMultiDrawElements
+  std::vector<abcg::Meshlet> m_meshlets;
+  std::vector<std::size_t> m_submeshMeshlets;
+  abcg::MeshDrawRanges m_drawRanges;
+  std::vector<GLsizei> m_drawCounts;
+  std::vector<const void*> m_drawOffsets;
 
-  void computeNormals();
   void createBuffers();
-  void standardize();
+  [[nodiscard]] std::size_t getIndexSize() const {
+    return m_indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+  }
+  [[nodiscard]] const Material& getMaterial(int materialID) const;
+  void loadMaterials(const abcg::Mesh& mesh);
+  void loadMaterialTextures();
+  void loadMesh(std::string_view path, bool standardize, bool optimize,
+                abcg::LoadProgress& progress);
+  void packBuffers();
+  void setDrawRanges(abcg::MeshDrawRanges drawRanges);
+  void setPackedTextures(std::shared_ptr<PackedTextures> packedTextures);
+  void setPositionUniforms(GLuint program) const;
+  void setupPackedAttributes(GLuint program) const;
 };
 
 #endif
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include "openglwindow.hpp"
 
+#include <fmt/core.h>
 #include <imgui.h>
 
 #include <cppitertools/itertools.hpp>
@@ -77,6 +78,11 @@ void OpenGLWindow::initializeGL() {
     m_programs.push_back(program);
   }
 
+  // Keep the textures of the previous models while they fit in 128 MiB, so
+  // that switching back to a model does not decode them again
+  m_assets.setBudget(128 * 1024 * 1024);
+  showAssetStatistics(&m_assets);
+
   // Load default model
   loadModel(getAssetsPath() + "Mars 2K.obj");
   m_mappingMode = 3;  // "From mesh" option
@@ -87,21 +93,55 @@ void OpenGLWindow::initializeGL() {
 }
 
 void OpenGLWindow::loadModel(std::string_view path) {
-  m_model.loadDiffuseTexture(getAssetsPath() + "maps/Diffuse_2K.png");
-  m_model.loadFromFile(path);
-  m_model.setupVAO(m_programs.at(m_currentProgramIndex));
-  m_trianglesToDraw = m_model.getNumTriangles();
-
-  // Use material properties from the loaded model
-  m_Ka = m_model.getKa();
-  m_Kd = m_model.getKd();
-  m_Ks = m_model.getKs();
-  m_shininess = m_model.getShininess();
+  cancelLoading();
+  m_loading = Model{}.loadFromFileAsync(
+      path, getAssetsPath() + "maps/Diffuse_2K.png");
+}
+
+void OpenGLWindow::cancelLoading() {
+  m_loading = {};
+  m_textureLoading = {};
+  m_uploads.clear();
+  m_pendingModel.reset();
 }
 
+// Called once per frame: retrieves the loaded model, decodes the textures
+// that are not cached, uploads the next chunk of its data and makes it
+// current once the upload is complete
+void OpenGLWindow::updateLoading() {
+  try {
+    if (m_loading.isReady()) {
+      m_pendingModel = m_loading.get();
+      m_textureLoading = m_pendingModel->loadTexturesAsync(m_assets);
+    }
+    if (m_textureLoading.isReady()) {
+      m_pendingModel->queueUpload(m_uploads, m_textureLoading.get());
+      m_uploadSize = m_uploads.getPendingBytes();
+    }
+  } catch (const abcg::Exception& exception) {
+    fmt::print(stderr, "{}\n", exception.what());
+    cancelLoading();
+  }
+
+  m_uploads.process(m_uploadBudget);
+
+  if (m_pendingModel && !m_textureLoading.isPending() && m_uploads.isEmpty()) {
+    m_model = std::move(m_pendingModel);
+    m_model->cacheTextures(m_assets);
+    m_model->setupVAO(m_programs.at(m_currentProgramIndex));
+    m_trianglesToDraw = m_model->getNumTriangles();
+
+    // Use material properties from the loaded model
+    m_Ka = m_model->getKa();
+    m_Kd = m_model->getKd();
+    m_Ks = m_model->getKs();
+    m_shininess = m_model->getShininess();
+  }
+}
 
 void OpenGLWindow::paintGL() {
   update();
+  updateLoading();
 
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
   glViewport(0, 0, m_viewportWidth, m_viewportHeight);
@@ -161,7 +201,11 @@ void OpenGLWindow::paintGL() {
   glUniform4fv(KdLoc, 1, &m_Kd.x);
   glUniform4fv(KsLoc, 1, &m_Ks.x);
 
-  m_model.render(m_trianglesToDraw);
+  if (m_model) {
+    m_model->cullClusters(m_modelMatrix, m_camera.m_viewMatrix,
+                          m_camera.m_projMatrix);
+    m_model->render(m_trianglesToDraw);
+  }
 
   glUseProgram(0);
 }
@@ -169,14 +213,89 @@ void OpenGLWindow::paintGL() {
 void OpenGLWindow::paintUI() {
   abcg::OpenGLWindow::paintUI();
 
+  static ImGui::FileBrowser fileDialogModel;
+  fileDialogModel.SetTitle("Load 3D Model");
+  fileDialogModel.SetTypeFilters({".obj"});
+  fileDialogModel.SetWindowSize(m_viewportWidth * 4 / 5,
+                                m_viewportHeight * 4 / 5);
 
   // Only in WebGL
   #if defined(__EMSCRIPTEN__)
     fileDialogModel.SetPwd(getAssetsPath());
-    fileDialogTex.SetPwd(getAssetsPath() + "/maps");
   #endif
+
+  {
+    // Below the FPS counter and the asset statistics
+    ImGui::SetNextWindowPos(ImVec2(5, 100));
+    ImGui::Begin("Model", nullptr, ImGuiWindowFlags_AlwaysAutoResize);
+
+    const auto loading{m_loading.isPending() || m_pendingModel};
+    if (!loading && ImGui::Button("Load 3D Model...")) {
+      fileDialogModel.Open();
+    }
+
+    // Progress of the background stages, then of the upload
+    if (loading) {
+      if (m_loading.isPending()) {
+        ImGui::ProgressBar(m_loading.getProgress(), ImVec2(200, 0),
+                           m_loading.getStage().c_str());
+      } else if (m_textureLoading.isPending()) {
+        ImGui::ProgressBar(m_textureLoading.getProgress(), ImVec2(200, 0),
+                           m_textureLoading.getStage().c_str());
+      } else {
+        const auto pendingBytes{m_uploads.getPendingBytes()};
+        const auto fraction{
+            m_uploadSize == 0 ? 1.0f
+                              : 1.0f - static_cast<float>(pendingBytes) /
+                                           static_cast<float>(m_uploadSize)};
+        ImGui::ProgressBar(
+            fraction, ImVec2(200, 0),
+            fmt::format("Uploading ({} KiB left)", pendingBytes / 1024)
+                .c_str());
+      }
+      if (ImGui::Button("Cancel")) {
+        cancelLoading();
+      }
+    }
+
+    // Effect of the vertex cache optimization, and precision of the compact
+    // vertices, of the current model
+    if (m_model) {
+      const auto& before{m_model->getVertexCacheBefore()};
+      const auto& after{m_model->getVertexCacheAfter()};
+      ImGui::TextUnformatted(fmt::format("ACMR {:.3f} -> {:.3f}", before.ACMR,
+                                         after.ACMR)
+                                 .c_str());
+      ImGui::TextUnformatted(fmt::format("ATVR {:.3f} -> {:.3f}", before.ATVR,
+                                         after.ATVR)
+                                 .c_str());
+      const auto& error{m_model->getQuantizationError()};
+      ImGui::TextUnformatted(
+          fmt::format("Position error {:.2g} (RMS {:.2g})",
+                      error.position.max, error.position.rms)
+              .c_str());
+      ImGui::TextUnformatted(fmt::format("Normal error {:.2g} (RMS {:.2g})",
+                                         error.normal.max, error.normal.rms)
+                                 .c_str());
+      ImGui::TextUnformatted(
+          fmt::format("UV error {:.2g} (RMS {:.2g})", error.texCoord.max,
+                      error.texCoord.rms)
+              .c_str());
+    }
+
+    ImGui::End();
+  }
+
+  fileDialogModel.Display();
+  if (fileDialogModel.HasSelected()) {
+    loadModel(fileDialogModel.GetSelected().string());
+    fileDialogModel.ClearSelected();
+  }
+
    // Slider will be stretched horizontally
-  m_trianglesToDraw = m_model.getNumTriangles();
+  if (m_model) {
+    m_trianglesToDraw = m_model->getNumTriangles();
+  }
 
   glEnable(GL_CULL_FACE);
 
@@ -205,6 +324,9 @@ void OpenGLWindow::resizeGL(int width, int height) {
 }
 
 void OpenGLWindow::terminateGL() {
+  cancelLoading();
+  m_model.reset();
+  m_assets.clear();
   for (const auto& program : m_programs) {
     glDeleteProgram(program);
   }
@@ -1,6 +1,7 @@
 #ifndef OPENGLWINDOW_HPP_
 #define OPENGLWINDOW_HPP_
 
+#include <memory>
 #include <string_view>
 
 #include "abcg.hpp"
@@ -20,9 +21,21 @@ class OpenGLWindow : public abcg::OpenGLWindow {
   int m_viewportWidth{};
   int m_viewportHeight{};
 
-  Model m_model;
+  std::unique_ptr<Model> m_model;
   int m_trianglesToDraw{};
 
+  // Model being loaded on a background thread, then uploaded over several
+  // frames before replacing m_model
+  abcg::AsyncLoad<std::unique_ptr<Model>> m_loading;
+  std::unique_ptr<Model> m_pendingModel;
+  abcg::AsyncLoad<Model::DecodedTextures> m_textureLoading;
+  abcg::UploadQueue m_uploads;
+  std::size_t m_uploadBudget{4 * 1024 * 1024};  // Bytes per frame
+  std::size_t m_uploadSize{};                   // Bytes queued
+
+  // Textures shared by the models loaded so far
+  abcg::AssetManager m_assets;
+
   TrackBall m_trackBallModel;
   TrackBall m_trackBallLight;
   float m_zoom{};
@@ -58,6 +71,8 @@ class OpenGLWindow : public abcg::OpenGLWindow {
   float m_shininess{};
 
   void loadModel(std::string_view path);
+  void cancelLoading();
+  void updateLoading();
   void update();
 };
 
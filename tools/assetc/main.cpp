@@ -0,0 +1,133 @@
+/**
+ * @file main.cpp
+ * @brief Entry point of abcg-assetc, the offline asset compiler.
+ *
+ * Converts an OBJ file into an abcg::MeshCache file, or a PNG/JPEG file into
+ * an abcg::TextureCache file, to be installed next to the source file so that
+ * the application loads it without parsing or decoding anything. Images too
+ * large to be loaded at once are split into the tiles of an
+ * abcg::VirtualTexture.
+ *
+ * Usage:
+ *
+ *     abcg-assetc mesh <input.obj> <output.abcgmesh> [--no-standardize]
+ *                 [--no-optimize] [--angle-weighted-normals]
+ *     abcg-assetc texture <input> <output.abcgtex> [--no-mipmaps]
+ *                 [--filter box|kaiser|lanczos]
+ *     abcg-assetc vtexture <input> <output.abcgvt> [--tile-size <size>]
+ *                 [--border <size>]
+ *
+ * This project is released under the MIT License.
+ */
+
+#include <fmt/core.h>
+
+#include <charconv>
+#include <cstdlib>
+#include <iterator>
+#include <string_view>
+#include <vector>
+
+#include "abcg.hpp"
+#include "meshcompiler.hpp"
+#include "texturecompiler.hpp"
+#include "virtualtexturecompiler.hpp"
+
+namespace {
+void printUsage() {
+  fmt::print(stderr,
+             "Usage: abcg-assetc mesh <input.obj> <output.abcgmesh> "
+             "[--no-standardize] [--no-optimize] [--angle-weighted-normals]\n"
+             "       abcg-assetc texture <input> <output.abcgtex> "
+             "[--no-mipmaps] [--filter box|kaiser|lanczos]\n"
+             "       abcg-assetc vtexture <input> <output.abcgvt> "
+             "[--tile-size <size>] [--border <size>]\n");
+}
+
+// Parses a non-negative integer option value
+bool parseSize(std::string_view text, int &value) {
+  const auto *end{text.data() + text.size()};
+  const auto [ptr, error]{std::from_chars(text.data(), end, value)};
+  return error == std::errc{} && ptr == end && value >= 0;
+}
+}  // namespace
+
+int main(int argc, char **argv) {
+  const std::vector<std::string_view> args(argv, argv + argc);
+  if (args.size() < 4) {
+    printUsage();
+    return EXIT_FAILURE;
+  }
+
+  const auto command{args[1]};
+  const auto input{args[2]};
+  const auto output{args[3]};
+  try {
+    if (command == "mesh") {
+      abcg::MeshLoadOptions options;
+      for (const auto arg : std::vector(args.begin() + 4, args.end())) {
+        if (arg == "--no-standardize") {
+          options.standardize = false;
+        } else if (arg == "--no-optimize") {
+          options.optimize = false;
+        } else if (arg == "--angle-weighted-normals") {
+          options.normalWeighting = abcg::NormalWeighting::Angle;
+        } else {
+          fmt::print(stderr, "Unknown option {}\n", arg);
+          return EXIT_FAILURE;
+        }
+      }
+      compileMesh(input, output, options);
+    } else if (command == "texture") {
+      auto generateMipmaps{true};
+      auto filter{abcg::MipmapFilter::Box};
+      const std::vector options(args.begin() + 4, args.end());
+      for (auto it{options.begin()}; it != options.end(); ++it) {
+        if (*it == "--no-mipmaps") {
+          generateMipmaps = false;
+        } else if (*it == "--filter" && std::next(it) != options.end()) {
+          const auto name{*++it};
+          if (name == "box") {
+            filter = abcg::MipmapFilter::Box;
+          } else if (name == "kaiser") {
+            filter = abcg::MipmapFilter::Kaiser;
+          } else if (name == "lanczos") {
+            filter = abcg::MipmapFilter::Lanczos;
+          } else {
+            fmt::print(stderr, "Unknown filter {}\n", name);
+            return EXIT_FAILURE;
+          }
+        } else {
+          fmt::print(stderr, "Unknown option {}\n", *it);
+          return EXIT_FAILURE;
+        }
+      }
+      compileTexture(input, output, generateMipmaps, filter);
+    } else if (command == "vtexture") {
+      auto tileSize{128};
+      auto border{1};
+      const std::vector options(args.begin() + 4, args.end());
+      for (auto it{options.begin()}; it != options.end(); ++it) {
+        if ((*it == "--tile-size" || *it == "--border") &&
+            std::next(it) != options.end()) {
+          const auto name{*it};
+          if (!parseSize(*++it, name == "--border" ? border : tileSize)) {
+            fmt::print(stderr, "Invalid {} {}\n", name, *it);
+            return EXIT_FAILURE;
+          }
+        } else {
+          fmt::print(stderr, "Unknown option {}\n", *it);
+          return EXIT_FAILURE;
+        }
+      }
+      compileVirtualTexture(input, output, tileSize, border);
+    } else {
+      printUsage();
+      return EXIT_FAILURE;
+    }
+  } catch (abcg::Exception &exception) {
+    fmt::print(stderr, "{}\n", exception.what());
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,46 @@
+/**
+ * @file meshcompiler.cpp
+ * @brief Definition of the OBJ to mesh cache compiler of abcg-assetc.
+ *
+ * This project is released under the MIT License.
+ */
+
+#include "meshcompiler.hpp"
+
+#include <fmt/core.h>
+
+/**
+ * @brief Converts an OBJ file into a mesh cache.
+ *
+ * The mesh is processed by abcg::buildMesh, as abcg::loadMesh does on a
+ * cache miss, and keyed on the options returned by
+ * abcg::MeshLoadOptions::getCacheOptions, so that a compiled cache is only
+ * used by meshes loaded with the same options. The levels of detail and the
+ * clusters are stored with the mesh, so the application maps them instead of
+ * generating them.
+ *
+ * @param sourcePath Path to the OBJ file. Material libraries are searched in
+ * the same directory.
+ * @param outputPath Path to the mesh cache to be written.
+ * @param options Mesh processing options.
+ *
+ * @throw abcg::Exception if the OBJ file cannot be parsed or the cache cannot
+ * be written.
+ */
+void compileMesh(std::string_view sourcePath, std::string_view outputPath,
+                 const abcg::MeshLoadOptions& options) {
+  abcg::LoadProgress progress;
+  const auto mesh{abcg::buildMesh(sourcePath, options, progress)};
+  if (!mesh.warning.empty()) {
+    fmt::print("Warning: {}\n", mesh.warning);
+  }
+
+  abcg::storeMesh(outputPath,
+                  abcg::MeshCache::computeBuildKey(sourcePath,
+                                                   options.getCacheOptions()),
+                  mesh);
+
+  fmt::print("{}: {} vertices, {} triangles, {} LODs, {} clusters\n",
+             outputPath, mesh.vertices.size(), mesh.indices.size() / 3,
+             mesh.lods.size(), mesh.meshlets.size());
+}
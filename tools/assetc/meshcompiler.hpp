@@ -0,0 +1,18 @@
+/**
+ * @file meshcompiler.hpp
+ * @brief Declaration of the OBJ to mesh cache compiler of abcg-assetc.
+ *
+ * This project is released under the MIT License.
+ */
+
+#ifndef MESHCOMPILER_HPP_
+#define MESHCOMPILER_HPP_
+
+#include <string_view>
+
+#include "abcg.hpp"
+
+void compileMesh(std::string_view sourcePath, std::string_view outputPath,
+                 const abcg::MeshLoadOptions& options);
+
+#endif
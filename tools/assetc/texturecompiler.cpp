@@ -0,0 +1,49 @@
+/**
+ * @file texturecompiler.cpp
+ * @brief Definition of the image to texture cache compiler of abcg-assetc.
+ *
+ * This project is released under the MIT License.
+ */
+
+#include "texturecompiler.hpp"
+
+#include <fmt/core.h>
+
+#include <vector>
+
+#include "abcg.hpp"
+
+/**
+ * @brief Converts an image file into a texture cache.
+ *
+ * @param sourcePath Path to the image file (PNG or JPEG).
+ * @param outputPath Path to the texture cache to be written.
+ * @param generateMipmaps Whether to store the complete mipmap chain, or the
+ * base level only.
+ * @param filter Filter used to compute each level from the previous one.
+ *
+ * @throw abcg::Exception if the image cannot be decoded or the cache cannot
+ * be written.
+ */
+void compileTexture(std::string_view sourcePath, std::string_view outputPath,
+                    bool generateMipmaps, abcg::MipmapFilter filter) {
+  auto image{abcg::decodeImage(sourcePath)};
+  std::vector<abcg::Image> levels;
+  if (generateMipmaps) {
+    levels = abcg::generateMipmaps(std::move(image), filter);
+  } else {
+    // The base level does not depend on the filter
+    levels.push_back(std::move(image));
+    filter = abcg::MipmapFilter::Box;
+  }
+
+  abcg::TextureCache::store(
+      outputPath,
+      abcg::TextureCache::computeKey(sourcePath,
+                                     static_cast<std::uint64_t>(filter)),
+      levels);
+
+  fmt::print("{}: {}x{}, {} channels, {} levels\n", outputPath,
+             levels.front().width, levels.front().height,
+             levels.front().channels, levels.size());
+}
@@ -0,0 +1,19 @@
+/**
+ * @file texturecompiler.hpp
+ * @brief Declaration of the image to texture cache compiler of abcg-assetc.
+ *
+ * This project is released under the MIT License.
+ */
+
+#ifndef TEXTURECOMPILER_HPP_
+#define TEXTURECOMPILER_HPP_
+
+#include <string_view>
+
+#include "abcg_image.hpp"
+
+void compileTexture(std::string_view sourcePath, std::string_view outputPath,
+                    bool generateMipmaps,
+                    abcg::MipmapFilter filter = abcg::MipmapFilter::Box);
+
+#endif
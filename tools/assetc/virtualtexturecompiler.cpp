@@ -0,0 +1,42 @@
+/**
+ * @file virtualtexturecompiler.cpp
+ * @brief Definition of the image to virtual texture tiler of abcg-assetc.
+ *
+ * This project is released under the MIT License.
+ */
+
+#include "virtualtexturecompiler.hpp"
+
+#include <fmt/core.h>
+
+#include <filesystem>
+
+#include "abcg.hpp"
+
+/**
+ * @brief Splits an image file into the tiles of a virtual texture.
+ *
+ * The decoded image and its next mipmap level are held in memory while the
+ * tiles are written: about 2.5 GiB for a 32K x 16K map.
+ *
+ * @param sourcePath Path to the image file (PNG, JPEG, KTX2 or DDS).
+ * @param outputPath Path to the tiled texture file to be written.
+ * @param tileSize Width and height of the tiles, without their border.
+ * @param border Width of the border around each tile, in texels.
+ *
+ * @throw abcg::Exception if the image cannot be decoded or the file cannot
+ * be written.
+ */
+void compileVirtualTexture(std::string_view sourcePath,
+                           std::string_view outputPath, int tileSize,
+                           int border) {
+  auto image{abcg::decodeImage(sourcePath)};
+  const auto width{image.width};
+  const auto height{image.height};
+  abcg::VirtualTexture::store(outputPath, std::move(image), tileSize, border);
+
+  std::error_code error;
+  const auto fileSize{std::filesystem::file_size(outputPath, error)};
+  fmt::print("{}: {}x{} image, {}x{} tiles, {} MiB\n", outputPath, width,
+             height, tileSize, tileSize, error ? 0 : fileSize >> 20);
+}
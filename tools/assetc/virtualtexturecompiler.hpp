@@ -0,0 +1,17 @@
+/**
+ * @file virtualtexturecompiler.hpp
+ * @brief Declaration of the image to virtual texture tiler of abcg-assetc.
+ *
+ * This project is released under the MIT License.
+ */
+
+#ifndef VIRTUALTEXTURECOMPILER_HPP_
+#define VIRTUALTEXTURECOMPILER_HPP_
+
+#include <string_view>
+
+void compileVirtualTexture(std::string_view sourcePath,
+                           std::string_view outputPath, int tileSize = 128,
+                           int border = 1);
+
+#endif
@@ -0,0 +1,43 @@
+/**
+ * @file benchmark.hpp
+ * @brief Helpers shared by the benchmarks.
+ *
+ * This project is released under the MIT License.
+ */
+
+#ifndef BENCHMARK_HPP_
+#define BENCHMARK_HPP_
+
+#include <algorithm>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "abcg_elapsedtimer.hpp"
+
+// Models given on the command line, or the default ones, relative to the
+// examples directory
+inline std::vector<std::string> getModels(
+    int argc, char **argv, const std::vector<std::string> &defaults) {
+  if (argc > 1) return {argv + 1, argv + argc};
+  std::vector<std::string> models;
+  for (const auto &model : defaults) {
+    models.push_back(std::string{ABCG_EXAMPLES_DIR} + "/" + model);
+  }
+  return models;
+}
+
+// Fastest of several runs of a function, in milliseconds. The first run also
+// warms up the caches
+template <typename T>
+double measure(int repetitions, T &&function) {
+  auto fastest{std::numeric_limits<double>::max()};
+  for (auto repetition{0}; repetition < repetitions; ++repetition) {
+    abcg::ElapsedTimer timer;
+    function();
+    fastest = std::min(fastest, timer.elapsed() * 1000.0);
+  }
+  return fastest;
+}
+
+#endif
@@ -0,0 +1,110 @@
+/**
+ * @file objreader.cpp
+ * @brief Benchmark of the OBJ parser of abcg::loadMesh.
+ *
+ * Compares abcg::ObjReader, with one thread and with the default thread pool,
+ * with tinyobj::ObjReader on each model, and checks that they read the same
+ * attributes and faces.
+ *
+ * Usage:
+ *
+ *     abcg-bench-objreader [model.obj...]
+ *
+ * This project is released under the MIT License.
+ */
+
+#include <cppitertools/itertools.hpp>
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+
+#include "abcg.hpp"
+#include "benchmark.hpp"
+
+namespace {
+constexpr auto repetitions{10};
+
+bool operator==(const tinyobj::index_t &lhs, const tinyobj::index_t &rhs) {
+  return lhs.vertex_index == rhs.vertex_index &&
+         lhs.normal_index == rhs.normal_index &&
+         lhs.texcoord_index == rhs.texcoord_index;
+}
+
+// Number of mismatches between the attributes and face indices of both
+// readers
+std::size_t compare(const abcg::ObjReader &reader,
+                    const tinyobj::ObjReader &expected) {
+  std::size_t mismatches{};
+  auto compareArrays{[&](const auto &values, const auto &expectedValues) {
+    if (values.size() != expectedValues.size()) {
+      mismatches += std::max(values.size(), expectedValues.size());
+      return;
+    }
+    for (auto &&[value, expectedValue] : iter::zip(values, expectedValues)) {
+      if (!(value == expectedValue)) ++mismatches;
+    }
+  }};
+
+  const auto &attrib{reader.getAttrib()};
+  const auto &expectedAttrib{expected.GetAttrib()};
+  compareArrays(attrib.vertices, expectedAttrib.vertices);
+  compareArrays(attrib.normals, expectedAttrib.normals);
+  compareArrays(attrib.texcoords, expectedAttrib.texcoords);
+
+  const auto &shapes{reader.getShapes()};
+  const auto &expectedShapes{expected.GetShapes()};
+  if (shapes.size() != expectedShapes.size()) return mismatches + 1;
+  for (auto &&[shape, expectedShape] : iter::zip(shapes, expectedShapes)) {
+    compareArrays(shape.mesh.indices, expectedShape.mesh.indices);
+  }
+  return mismatches;
+}
+}  // namespace
+
+int main(int argc, char **argv) {
+  try {
+    abcg::ThreadPool singleThread{0};
+    fmt::print("{:<16} {:>10} {:>12} {:>12} {:>12} {:>8} {:>10}\n", "Model",
+               "Size", "tinyobj", "1 thread", "Pool", "Speedup",
+               "Mismatches");
+    for (const auto &path : getModels(
+             argc, argv,
+             {"viewer4/assets/bunny.obj",
+              "screensaverxicara/assets/xicara.obj",
+              "viewer4/assets/teapot.obj"})) {
+      const auto directory{std::filesystem::path{path}.parent_path()};
+
+      tinyobj::ObjReader expected;
+      tinyobj::ObjReaderConfig config;
+      config.mtl_search_path = directory.string() + "/";
+      const auto tinyobjTime{measure(repetitions, [&] {
+        if (!expected.ParseFromFile(path, config)) {
+          throw abcg::Exception{abcg::Exception::Runtime(fmt::format(
+              "Failed to load model {} ({})", path, expected.Error()))};
+        }
+      })};
+
+      abcg::ObjReader reader;
+      const auto singleThreadTime{measure(repetitions, [&] {
+        reader.parseFromFile(path, directory.string(), singleThread);
+      })};
+      const auto poolTime{
+          measure(repetitions, [&] { reader.parseFromFile(path); })};
+
+      fmt::print(
+          "{:<16} {:>7} KB {:>9.2f} ms {:>9.2f} ms {:>9.2f} ms {:>7.1f}x "
+          "{:>10}\n",
+          std::filesystem::path{path}.filename().string(),
+          std::filesystem::file_size(path) / 1024, tinyobjTime,
+          singleThreadTime, poolTime, tinyobjTime / poolTime,
+          compare(reader, expected));
+    }
+  } catch (abcg::Exception &exception) {
+    fmt::print(stderr, "{}\n", exception.what());
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
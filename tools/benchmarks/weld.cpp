@@ -0,0 +1,145 @@
+/**
+ * @file weld.cpp
+ * @brief Benchmark of the vertex deduplication of abcg::loadMesh.
+ *
+ * Compares abcg::VertexWelder with the std::unordered_map that the examples
+ * used before, on the vertices of the triangles of each model, and checks
+ * that both build the same indexed mesh.
+ *
+ * Usage:
+ *
+ *     abcg-bench-weld [model.obj...]
+ *
+ * This project is released under the MIT License.
+ */
+
+#include <fmt/core.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <glm/gtx/hash.hpp>
+#include <unordered_map>
+#include <vector>
+
+#include "abcg.hpp"
+#include "benchmark.hpp"
+
+namespace {
+constexpr auto repetitions{10};
+
+// Hash of the examples: the attribute hashes are XORed
+struct XorHash {
+  std::size_t operator()(const abcg::MeshVertex &vertex) const noexcept {
+    const std::size_t h1{std::hash<glm::vec3>()(vertex.position)};
+    const std::size_t h2{std::hash<glm::vec3>()(vertex.normal)};
+    const std::size_t h3{std::hash<glm::vec2>()(vertex.texCoord)};
+    return h1 ^ h2 ^ h3;
+  }
+};
+
+// Hash of abcg::loadMesh
+struct CombinedHash {
+  std::size_t operator()(const abcg::MeshVertex &vertex) const noexcept {
+    std::size_t seed{};
+    abcg::hashCombine(seed, vertex.position);
+    abcg::hashCombine(seed, vertex.normal);
+    abcg::hashCombine(seed, vertex.texCoord);
+    return seed;
+  }
+};
+
+struct IndexedMesh {
+  std::vector<abcg::MeshVertex> vertices;
+  std::vector<std::uint32_t> indices;
+};
+
+IndexedMesh weldWithMap(const std::vector<abcg::MeshVertex> &corners) {
+  IndexedMesh mesh;
+  std::unordered_map<abcg::MeshVertex, std::uint32_t, XorHash> hash{};
+  for (const auto &vertex : corners) {
+    if (hash.count(vertex) == 0) {
+      hash[vertex] = static_cast<std::uint32_t>(mesh.vertices.size());
+      mesh.vertices.push_back(vertex);
+    }
+    mesh.indices.push_back(hash[vertex]);
+  }
+  return mesh;
+}
+
+IndexedMesh weldWithWelder(const std::vector<abcg::MeshVertex> &corners) {
+  IndexedMesh mesh;
+  mesh.indices.reserve(corners.size());
+  abcg::VertexWelder<abcg::MeshVertex, CombinedHash> welder{mesh.vertices,
+                                                            corners.size()};
+  for (const auto &vertex : corners) {
+    mesh.indices.push_back(welder.insert(vertex));
+  }
+  return mesh;
+}
+
+// One vertex per triangle corner, as read from the OBJ file
+std::vector<abcg::MeshVertex> readCorners(const std::string &path) {
+  abcg::ObjReader reader;
+  reader.parseFromFile(path);
+  const auto &attrib{reader.getAttrib()};
+
+  std::vector<abcg::MeshVertex> corners;
+  for (const auto &shape : reader.getShapes()) {
+    for (const auto &index : shape.mesh.indices) {
+      abcg::MeshVertex vertex{};
+      auto startIndex{3 * static_cast<std::size_t>(index.vertex_index)};
+      vertex.position = {attrib.vertices.at(startIndex + 0),
+                         attrib.vertices.at(startIndex + 1),
+                         attrib.vertices.at(startIndex + 2)};
+      if (index.normal_index >= 0) {
+        startIndex = 3 * static_cast<std::size_t>(index.normal_index);
+        vertex.normal = {attrib.normals.at(startIndex + 0),
+                         attrib.normals.at(startIndex + 1),
+                         attrib.normals.at(startIndex + 2)};
+      }
+      if (index.texcoord_index >= 0) {
+        startIndex = 2 * static_cast<std::size_t>(index.texcoord_index);
+        vertex.texCoord = {attrib.texcoords.at(startIndex + 0),
+                           attrib.texcoords.at(startIndex + 1)};
+      }
+      corners.push_back(vertex);
+    }
+  }
+  return corners;
+}
+}  // namespace
+
+int main(int argc, char **argv) {
+  try {
+    fmt::print("{:<32} {:>9} {:>9} {:>15} {:>12} {:>8}\n", "Model", "Indices",
+               "Vertices", "unordered_map", "VertexWelder", "Speedup");
+    for (const auto &path : getModels(
+             argc, argv,
+             {"viewer4/assets/bunny.obj",
+              "screensaverxicara/assets/xicara.obj"})) {
+      const auto corners{readCorners(path)};
+
+      IndexedMesh expected;
+      IndexedMesh welded;
+      const auto mapTime{
+          measure(repetitions, [&] { expected = weldWithMap(corners); })};
+      const auto welderTime{
+          measure(repetitions, [&] { welded = weldWithWelder(corners); })};
+      if (welded.indices != expected.indices ||
+          welded.vertices.size() != expected.vertices.size()) {
+        fmt::print(stderr, "{}: the welder built a different mesh\n", path);
+        return EXIT_FAILURE;
+      }
+
+      fmt::print("{:<32} {:>9} {:>9} {:>12.2f} ms {:>9.2f} ms {:>7.1f}x\n",
+                 std::filesystem::path{path}.filename().string(),
+                 corners.size(), welded.vertices.size(), mapTime, welderTime,
+                 mapTime / welderTime);
+    }
+  } catch (abcg::Exception &exception) {
+    fmt::print(stderr, "{}\n", exception.what());
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}